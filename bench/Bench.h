@@ -0,0 +1,229 @@
+#pragma once
+#include <stdio.h>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <algorithm>
+
+// 計算結果を使ったことにして最適化で消されないようにする
+template<typename T>
+inline void keep(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static const void *volatile sink;
+    sink = &value;
+#endif
+}
+
+// マイクロベンチマーク
+//  暖機で 1 回の時間を見積もり、一つの標本が一定の時間になる回数を繰り返して標本を集める
+//  コマンドライン引数
+//      --filter 文字列: 名前にこの文字列を含むものだけ計測する
+//      --samples 数: 標本の数
+//      --json ファイル名: 結果を JSON 形式で保存する
+class Bench {
+    using Clock = std::chrono::steady_clock;
+
+    // 計測結果
+    struct Result {
+        // 名前
+        std::string name;
+
+        // 一つの標本で繰り返した回数と標本の数
+        std::size_t iterations, samples;
+
+        // 1 回あたりの時間 (ナノ秒)
+        double min, median, mean, stddev, p95;
+
+        // 付随する値 (精度など)
+        std::vector<std::pair<std::string, double>> metric;
+    };
+
+    // 名前の絞り込み
+    std::string filter;
+
+    // 標本の数
+    std::size_t samples;
+
+    // JSON の保存先
+    std::string json;
+
+    // 暖機の時間と一つの標本の時間 (秒)
+    double warmupTime, sampleTime;
+
+    // 計測結果
+    std::vector<Result> result;
+
+    // コマンドライン引数が正しければ true
+    bool valid;
+
+    // 経過時間 (秒)
+    static double seconds(Clock::time_point begin, Clock::time_point end) {
+        return std::chrono::duration<double>(end - begin).count();
+    }
+
+    // 名前の結果を探す (なければ作る)
+    Result &find(const char *name) {
+        for (Result &r : result) {
+            if (r.name == name) return r;
+        }
+        Result r = { name, 0, 0, 0.0, 0.0, 0.0, 0.0, 0.0, {} };
+        result.push_back(r);
+        return result.back();
+    }
+
+public:
+
+    // コンストラクタ
+    //  argc, argv: コマンドライン引数
+    Bench(int argc, char **argv)
+        : samples(30), warmupTime(0.05), sampleTime(0.005), valid(true)
+    {
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+            else if (std::strcmp(argv[i], "--samples") == 0 && i + 1 < argc) samples = std::max(1, std::atoi(argv[++i]));
+            else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) json = argv[++i];
+            else {
+                printf("Error : Unknown option: %s\n", argv[i]);
+                printf("Usage : %s [--filter string] [--samples count] [--json file]\n", argc > 0 ? argv[0] : "glfwdraft_bench");
+                valid = false;
+                break;
+            }
+        }
+    }
+
+    // コマンドライン引数が正しいかどうか (正しくなければ計測せずに終了する)
+    bool isValid() const { return valid; }
+
+    // 計測するかどうか
+    //  name: 名前
+    bool enabled(const char *name) const {
+        return filter.empty() || std::string(name).find(filter) != std::string::npos;
+    }
+
+    // 計測する
+    //  name: 名前
+    //  func: 計測する処理 (1 回分)
+    template<typename Func>
+    void run(const char *name, Func func) {
+        if (!enabled(name)) return;
+
+        // 暖機して 1 回の時間を見積もる
+        std::size_t count(0);
+        const Clock::time_point start(Clock::now());
+        double elapsed(0.0);
+        do {
+            func();
+            ++count;
+            elapsed = seconds(start, Clock::now());
+        } while (elapsed < warmupTime);
+        const std::size_t iterations(std::max<std::size_t>(1,
+            static_cast<std::size_t>(sampleTime / (elapsed / count))));
+
+        // 標本を集める
+        std::vector<double> t(samples);
+        for (double &s : t) {
+            const Clock::time_point begin(Clock::now());
+            for (std::size_t i = 0; i < iterations; ++i) func();
+            s = seconds(begin, Clock::now()) * 1.0e9 / iterations;
+        }
+
+        // 統計量を求める
+        std::sort(t.begin(), t.end());
+        Result &r(find(name));
+        r.iterations = iterations;
+        r.samples = samples;
+        r.min = t.front();
+        r.median = t.size() % 2 ? t[t.size() / 2] : (t[t.size() / 2 - 1] + t[t.size() / 2]) * 0.5;
+        r.p95 = t[std::min(t.size() - 1, static_cast<std::size_t>(std::ceil(t.size() * 0.95)) - 1)];
+        double sum(0.0), square(0.0);
+        for (double s : t) sum += s;
+        r.mean = sum / t.size();
+        for (double s : t) square += (s - r.mean) * (s - r.mean);
+        r.stddev = t.size() > 1 ? std::sqrt(square / (t.size() - 1)) : 0.0;
+
+        printf("%-36s %12.1f %12.1f %12.1f %10.1f %10zu\n",
+            name, r.median, r.min, r.p95, r.stddev, iterations);
+    }
+
+    // 付随する値を記録する
+    //  name: 名前
+    //  key: 値の名前
+    //  value: 値
+    void metric(const char *name, const char *key, double value) {
+        if (!enabled(name)) return;
+        find(name).metric.emplace_back(key, value);
+        printf("%-36s %s = %g\n", name, key, value);
+    }
+
+    // 1 回あたりの時間の中央値 (ナノ秒, 計測していなければ 0)
+    //  name: 名前
+    double getMedian(const char *name) const {
+        for (const Result &r : result) {
+            if (r.name == name) return r.median;
+        }
+        return 0.0;
+    }
+
+    // 表の見出しを表示する
+    void header() const {
+        printf("%-36s %12s %12s %12s %10s %10s\n", "benchmark (ns/op)", "median", "min", "p95", "stddev", "iterations");
+    }
+
+    // JSON の文字列に書けるように引用符と制御文字をエスケープする
+    //  text: 文字列
+    static std::string escape(const std::string &text) {
+        std::string e;
+        for (const char c : text) {
+            switch (c) {
+            case '"': e += "\\\""; break;
+            case '\\': e += "\\\\"; break;
+            case '\n': e += "\\n"; break;
+            case '\r': e += "\\r"; break;
+            case '\t': e += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char u[8];
+                    snprintf(u, sizeof u, "\\u%04x", static_cast<unsigned char>(c));
+                    e += u;
+                }
+                else e += c;
+            }
+        }
+        return e;
+    }
+
+    // 結果を JSON 形式で保存する
+    //  戻り値: 保存できなければ 1
+    int finish() const {
+        if (json.empty()) return 0;
+
+        std::ofstream file(json);
+        if (file.fail()) {
+            printf("Error : Can't open JSON file: %s\n", json.c_str());
+            return 1;
+        }
+        file.precision(9);
+        file << "{\n  \"unit\": \"ns\",\n  \"benchmarks\": [";
+        for (std::size_t i = 0; i < result.size(); ++i) {
+            const Result &r(result[i]);
+            file << (i ? ",\n" : "\n") << "    {\"name\": \"" << escape(r.name) << "\"";
+            if (r.samples > 0) {
+                file << ", \"iterations\": " << r.iterations << ", \"samples\": " << r.samples
+                    << ", \"median\": " << r.median << ", \"min\": " << r.min << ", \"mean\": " << r.mean
+                    << ", \"p95\": " << r.p95 << ", \"stddev\": " << r.stddev;
+            }
+            for (const std::pair<std::string, double> &m : r.metric) {
+                file << ", \"" << escape(m.first) << "\": " << m.second;
+            }
+            file << "}";
+        }
+        file << "\n  ]\n}\n";
+        return file.fail() ? 1 : 0;
+    }
+};
@@ -0,0 +1,628 @@
+// GL を使わない CPU 側の処理のマイクロベンチマーク
+//  glfwdraft_bench [--filter 文字列] [--samples 数] [--json ファイル名]
+#define SHADER_QUIET
+#include <cmath>
+#include <random>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <new>
+#include <cstdlib>
+#include <cstdint>
+#include <iterator>
+#include "lib/Matrix.h"
+#include "lib/Vector.h"
+#include "lib/Quaternion.h"
+#include "lib/SimdMath.h"
+#include "lib/Sphere.h"
+#include "lib/Weld.h"
+#include "lib/Edge.h"
+#include "lib/Shader.h"
+#include "lib/Uniform.h"
+#include "lib/Material.h"
+#include "lib/Light.h"
+#include "lib/Cluster.h"
+#include "lib/RangeAllocator.h"
+#include "lib/SceneBvh.h"
+#include "lib/OcclusionCuller.h"
+#include "lib/Meshlet.h"
+#include "lib/Particles.h"
+#include "lib/Animation.h"
+#include "lib/Tube.h"
+#include "lib/FrameArena.h"
+#include "lib/Primitive.h"
+#include "lib/Rasterizer.h"
+#include "Bench.h"
+
+#ifndef GLFWDRAFT_SOURCE_DIR
+#define GLFWDRAFT_SOURCE_DIR "."
+#endif
+
+// このスレッドでヒープを確保した回数
+//  この翻訳単位だけが operator new を置き換えて数える (ワーカースレッドの確保は数えない)
+static thread_local std::size_t heapAllocations(0);
+
+// アラインメントを指定して確保する (確保した先頭を直前に置いて解放に使う)
+static void *alignedAllocate(std::size_t size, std::size_t align) {
+    if (align < sizeof (void *)) align = sizeof (void *);
+    void *const base(std::malloc(size + align + sizeof (void *)));
+    if (base == NULL) return NULL;
+    const std::uintptr_t at((reinterpret_cast<std::uintptr_t>(base) + sizeof (void *) + align - 1) & ~(align - 1));
+    reinterpret_cast<void **>(at)[-1] = base;
+    return reinterpret_cast<void *>(at);
+}
+
+// alignedAllocate で確保した領域を解放する
+static void alignedFree(void *p) {
+    if (p != NULL) std::free(reinterpret_cast<void **>(p)[-1]);
+}
+
+void *operator new(std::size_t size) {
+    ++heapAllocations;
+    void *const p(std::malloc(size > 0 ? size : 1));
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+void *operator new[](std::size_t size) { return operator new(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    ++heapAllocations;
+    return std::malloc(size > 0 ? size : 1);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &t) noexcept { return operator new(size, t); }
+void *operator new(std::size_t size, std::align_val_t align) {
+    ++heapAllocations;
+    void *const p(alignedAllocate(size, static_cast<std::size_t>(align)));
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+void *operator new[](std::size_t size, std::align_val_t align) { return operator new(size, align); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { alignedFree(p); }
+
+// 一度にまとめて処理する要素の数
+static const std::size_t batch(4096);
+
+int main(int argc, char **argv)
+{
+    Bench bench(argc, argv);
+    if (!bench.isValid()) return 1;
+    bench.header();
+
+    // 入力はいつも同じ乱数列から作る
+    std::mt19937 rng(20240601u);
+    std::uniform_real_distribution<GLfloat> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<GLfloat> angle(-6.283185f, 6.283185f);
+
+    // 行列
+    const Matrix ma(Matrix::rotateAxis(0.3f, 1.0f, 2.0f, 3.0f) * Matrix::translate(1.0f, 2.0f, 3.0f));
+    const Matrix mb(Matrix::perspective(1.0f, 1.5f, 0.1f, 100.0f));
+    bench.run("matrix.multiply", [&] {
+        const Matrix m(ma * mb);
+        keep(m);
+    });
+    bench.run("matrix.translate", [&] {
+        const Matrix m(Matrix::translate(ma[0], ma[1], ma[2]));
+        keep(m);
+    });
+    bench.run("matrix.rotateAxis", [&] {
+        const Matrix m(Matrix::rotateAxis(ma[0], ma[1], ma[2], ma[3]));
+        keep(m);
+    });
+    bench.run("matrix.perspective", [&] {
+        const Matrix m(Matrix::perspective(ma[0], 1.5f, 0.1f, 100.0f));
+        keep(m);
+    });
+    bench.run("matrix.lookat", [&] {
+        const Matrix m(Matrix::lookat(ma[0], ma[1], ma[2], 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+        keep(m);
+    });
+    bench.run("matrix.getNormalMatrix", [&] {
+        GLfloat n[9];
+        ma.getNormalMatrix(n);
+        keep(n);
+    });
+
+    // まとめて作る回転の変換行列
+    std::vector<GLfloat> a(batch), axis(batch * 3);
+    for (GLfloat &v : a) v = angle(rng);
+    for (GLfloat &v : axis) v = unit(rng);
+    std::vector<Matrix> rotation(batch);
+    bench.run("matrix.rotateAxis.scalar x4096", [&] {
+        for (std::size_t i = 0; i < batch; ++i) {
+            rotation[i] = Matrix::rotateAxis(a[i], axis[i * 3], axis[i * 3 + 1], axis[i * 3 + 2]);
+        }
+        keep(rotation[0]);
+    });
+    bench.run("matrix.rotateAxis.batch x4096", [&] {
+        Matrix::rotateAxis(batch, a.data(), axis.data(), rotation.data());
+        keep(rotation[0]);
+    });
+    bench.run("matrix.rotate.batch x4096", [&] {
+        Matrix::rotate(2, batch, a.data(), rotation.data());
+        keep(rotation[0]);
+    });
+
+    // ベクトルの変換
+    std::vector<Vector> vector(batch);
+    for (Vector &v : vector) v = { unit(rng), unit(rng), unit(rng), 1.0f };
+    bench.run("vector.transform x4096", [&] {
+        for (Vector &v : vector) v = ma * v;
+        keep(vector[0]);
+    });
+
+    // 四元数
+    std::vector<Quaternion> qa(batch), qb(batch), qc(batch);
+    for (std::size_t i = 0; i < batch; ++i) {
+        qa[i] = Quaternion::rotateAxis(a[i], axis[i * 3], axis[i * 3 + 1], axis[i * 3 + 2]);
+        qb[i] = Quaternion::rotateAxis(a[batch - 1 - i], axis[i * 3 + 2], axis[i * 3], axis[i * 3 + 1]);
+    }
+    std::vector<GLfloat> t(batch);
+    for (GLfloat &v : t) v = unit(rng) * 0.5f + 0.5f;
+    bench.run("quaternion.getNormalMatrix", [&] {
+        GLfloat n[9];
+        qa[0].getNormalMatrix(n);
+        keep(n);
+    });
+    bench.run("quaternion.slerp.scalar x4096", [&] {
+        for (std::size_t i = 0; i < batch; ++i) qc[i] = Quaternion::slerp(qa[i], qb[i], t[i]);
+        keep(qc[0]);
+    });
+    bench.run("quaternion.slerp.batch x4096", [&] {
+        Quaternion::slerp(batch, qa.data(), qb.data(), t.data(), qc.data());
+        keep(qc[0]);
+    });
+
+    // 三角関数
+    std::vector<GLfloat> x(batch), s(batch), c(batch);
+    for (std::size_t i = 0; i < batch; ++i) x[i] = angle(rng) * 100.0f;
+    bench.run("libm.sincos x4096", [&] {
+        for (std::size_t i = 0; i < batch; ++i) {
+            s[i] = std::sin(x[i]);
+            c[i] = std::cos(x[i]);
+        }
+        keep(s[0]);
+        keep(c[0]);
+    });
+    bench.run("simd.sincos x4096", [&] {
+        for (std::size_t i = 0; i < batch; i += 4) {
+            float4 vs, vc;
+            sincos(float4::load(&x[i]), vs, vc);
+            vs.store(&s[i]);
+            vc.store(&c[i]);
+        }
+        keep(s[0]);
+        keep(c[0]);
+    });
+
+    // 三角関数の libm との差と, まとめて作った回転の変換行列と一つずつ作ったものとの差
+    {
+        double sinError(0.0), cosError(0.0), tanError(0.0);
+        for (int i = -(1 << 20); i < (1 << 20); i += 4) {
+            GLfloat v[4], vs[4], vc[4], vt[4];
+            for (int k = 0; k < 4; ++k) v[k] = static_cast<GLfloat>(i + k) * (8192.0f / (1 << 20));
+            float4 fs, fc;
+            sincos(float4::load(v), fs, fc);
+            fs.store(vs);
+            fc.store(vc);
+            tan(float4::load(v)).store(vt);
+            for (int k = 0; k < 4; ++k) {
+                const double d(v[k]);
+                sinError = std::max(sinError, std::fabs(static_cast<double>(vs[k]) - std::sin(d)));
+                cosError = std::max(cosError, std::fabs(static_cast<double>(vc[k]) - std::cos(d)));
+
+                // tan は |cos x| > 0.1 の範囲で比べる
+                if (std::fabs(std::cos(d)) > 0.1) {
+                    tanError = std::max(tanError, std::fabs(static_cast<double>(vt[k]) - std::tan(d)));
+                }
+            }
+        }
+        bench.metric("simd.sincos x4096", "max_sin_error", sinError);
+        bench.metric("simd.sincos x4096", "max_cos_error", cosError);
+        bench.metric("simd.sincos x4096", "max_tan_error", tanError);
+
+        // 端数の処理も通るように 4 の倍数でない数を作る
+        const std::size_t count(batch - 3);
+        const auto difference = [](const Matrix &p, const Matrix &q) {
+            double d(0.0);
+            for (int k = 0; k < 16; ++k) d = std::max(d, std::fabs(static_cast<double>(p[k]) - q[k]));
+            return d;
+        };
+        double axisError(0.0);
+        Matrix::rotateAxis(count, a.data(), axis.data(), rotation.data());
+        for (std::size_t i = 0; i < count; ++i) {
+            axisError = std::max(axisError, difference(rotation[i],
+                Matrix::rotateAxis(a[i], axis[i * 3], axis[i * 3 + 1], axis[i * 3 + 2])));
+        }
+        double modeError(0.0);
+        for (int mode = 1; mode <= 3; ++mode) {
+            Matrix::rotate(mode, count, a.data(), rotation.data());
+            for (std::size_t i = 0; i < count; ++i) {
+                modeError = std::max(modeError, difference(rotation[i], Matrix::rotate(mode, a[i])));
+            }
+        }
+        bench.metric("matrix.rotateAxis.batch x4096", "max_scalar_difference", axisError);
+        bench.metric("matrix.rotate.batch x4096", "max_scalar_difference", modeError);
+    }
+
+    // 球の生成と溶接
+    std::vector<Object::Vertex> sphereVertex;
+    std::vector<GLuint> sphereIndex;
+    bench.run("sphere.create 32x16", [&] {
+        createSphere(32, 16, sphereVertex, sphereIndex);
+        keep(sphereIndex[0]);
+    });
+    bench.run("sphere.create 256x128", [&] {
+        createSphere(256, 128, sphereVertex, sphereIndex);
+        keep(sphereIndex[0]);
+    });
+    bench.run("weld.sphere 256x128", [&] {
+        const Weld::Mesh mesh(Weld::weld(
+            static_cast<GLsizei>(sphereVertex.size()), sphereVertex.data(),
+            static_cast<GLsizei>(sphereIndex.size()), sphereIndex.data()));
+        keep(mesh.index[0]);
+    });
+
+    // メッシュレットへの分割と判定
+    createSphere(256, 128, sphereVertex, sphereIndex);
+    const Weld::Mesh welded(Weld::weld(
+        static_cast<GLsizei>(sphereVertex.size()), sphereVertex.data(),
+        static_cast<GLsizei>(sphereIndex.size()), sphereIndex.data(), 1.0e-5f, 1.0e-5f));
+    bench.run("edge.extract sphere 256x128", [&] {
+        const std::vector<GLuint> line(Edge::extract(
+            static_cast<GLsizei>(welded.vertex.size()), welded.vertex.data(),
+            static_cast<GLsizei>(welded.index.size()), welded.index.data()));
+        keep(line[0]);
+    });
+    bench.run("edge.feature sphere 256x128", [&] {
+        const std::vector<GLuint> line(Edge::extract(
+            static_cast<GLsizei>(welded.vertex.size()), welded.vertex.data(),
+            static_cast<GLsizei>(welded.index.size()), welded.index.data(), 30.0f));
+        keep(line.size());
+    });
+
+    // 200 万三角形の平らな格子の辺 (基数ソートが何桁も回る大きさ)
+    //  辺の数は 3n^2 + 2n, 特徴辺は境界の 4n 本だけになる
+    {
+        const std::size_t n(1024);
+        std::vector<Object::Vertex> gridVertex;
+        std::vector<GLuint> gridIndex;
+        const bool gridEnabled(bench.enabled("edge.extract grid 2M") || bench.enabled("edge.feature grid 2M"));
+        if (gridEnabled) {
+            gridVertex.resize((n + 1) * (n + 1));
+            for (std::size_t j = 0; j <= n; ++j) {
+                for (std::size_t i = 0; i <= n; ++i) {
+                    const Object::Vertex v = {
+                        { static_cast<GLfloat>(i) / n, 0.0f, static_cast<GLfloat>(j) / n }, { 0.0f, 1.0f, 0.0f }
+                    };
+                    gridVertex[j * (n + 1) + i] = v;
+                }
+            }
+            gridIndex.reserve(n * n * 6);
+            for (std::size_t j = 0; j < n; ++j) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    const GLuint k0(static_cast<GLuint>(j * (n + 1) + i)), k1(k0 + 1);
+                    const GLuint k2(static_cast<GLuint>(k0 + n + 1)), k3(k2 + 1);
+                    gridIndex.insert(gridIndex.end(), { k0, k2, k3, k0, k3, k1 });
+                }
+            }
+        }
+        std::size_t gridEdges(0), gridFeatures(0);
+        bench.run("edge.extract grid 2M", [&] {
+            const std::vector<GLuint> line(Edge::extract(
+                static_cast<GLsizei>(gridVertex.size()), gridVertex.data(),
+                static_cast<GLsizei>(gridIndex.size()), gridIndex.data()));
+            gridEdges = line.size() / 2;
+            keep(line[0]);
+        });
+        bench.run("edge.feature grid 2M", [&] {
+            const std::vector<GLuint> line(Edge::extract(
+                static_cast<GLsizei>(gridVertex.size()), gridVertex.data(),
+                static_cast<GLsizei>(gridIndex.size()), gridIndex.data(), 30.0f));
+            gridFeatures = line.size() / 2;
+            keep(line.size());
+        });
+        const double extractTime(bench.getMedian("edge.extract grid 2M"));
+        if (extractTime > 0.0) {
+            bench.metric("edge.extract grid 2M", "triangles_per_ms", gridIndex.size() / 3 / (extractTime * 1.0e-6));
+            bench.metric("edge.extract grid 2M", "edges", static_cast<double>(gridEdges));
+        }
+        const double featureTime(bench.getMedian("edge.feature grid 2M"));
+        if (featureTime > 0.0) {
+            bench.metric("edge.feature grid 2M", "triangles_per_ms", gridIndex.size() / 3 / (featureTime * 1.0e-6));
+            bench.metric("edge.feature grid 2M", "edges", static_cast<double>(gridFeatures));
+        }
+    }
+    bench.run("meshlet.build sphere 256x128", [&] {
+        const Meshlets meshlets(
+            static_cast<GLsizei>(welded.vertex.size()), welded.vertex.data(),
+            static_cast<GLsizei>(welded.index.size()), welded.index.data());
+        keep(meshlets.getMeshlets()[0]);
+    });
+    const Meshlets meshlets(
+        static_cast<GLsizei>(welded.vertex.size()), welded.vertex.data(),
+        static_cast<GLsizei>(welded.index.size()), welded.index.data());
+    const Matrix meshletView(Matrix::lookat(0.0f, 1.0f, 3.0f, 0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+    std::vector<GLuint> visibleMeshlet;
+    std::size_t rejected(0);
+    bench.run("meshlet.cull sphere 256x128", [&] {
+        rejected = meshlets.cull(mb, meshletView, visibleMeshlet);
+        keep(rejected);
+    });
+    bench.metric("meshlet.cull sphere 256x128", "meshlets", static_cast<double>(meshlets.getMeshlets().size()));
+    bench.metric("meshlet.cull sphere 256x128", "rejected_percent", 100.0 * rejected / meshlets.getTriangleCount());
+
+    // 境界ボリューム階層の作成と選択
+    bench.run("bvh.build sphere 256x128", [&] {
+        const MeshBvh bvh(
+            static_cast<GLsizei>(sphereVertex.size()), sphereVertex.data(),
+            static_cast<GLsizei>(sphereIndex.size()), sphereIndex.data());
+        keep(bvh.getBvh().getNodes()[0]);
+    });
+    const MeshBvh sphereBvh(
+        static_cast<GLsizei>(sphereVertex.size()), sphereVertex.data(),
+        static_cast<GLsizei>(sphereIndex.size()), sphereIndex.data());
+    SceneBvh scene;
+    for (int i = 0; i < 64; ++i) {
+        scene.add(sphereBvh, Matrix::translate(static_cast<GLfloat>(i % 8) * 2.5f - 8.75f, static_cast<GLfloat>(i / 8) * 2.5f - 8.75f, 0.0f));
+    }
+    scene.update();
+    const Matrix pickView(Matrix::lookat(0.0f, 0.0f, 20.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+    std::vector<Ray> ray(batch);
+    for (Ray &r : ray) r = Ray::unproject(mb, pickView, unit(rng), unit(rng));
+    std::size_t next(0);
+    bench.run("scene.pick 64x65k", [&] {
+        SceneBvh::Hit hit;
+        keep(scene.pick(ray[next++ % batch], hit));
+    });
+    bench.run("scene.refit 64", [&] {
+        scene.setTransform(0, Matrix::translate(-8.75f, -8.75f, static_cast<GLfloat>(next++ & 1)));
+        scene.update();
+        keep(scene.getInstanceCount());
+    });
+
+    // 遮蔽物のラスタライズと境界ボックスの判定
+    createSphere(32, 16, sphereVertex, sphereIndex);
+    OcclusionCuller culler;
+    const GLuint occluder(culler.addMesh(
+        static_cast<GLsizei>(sphereVertex.size()), sphereVertex.data(),
+        static_cast<GLsizei>(sphereIndex.size()), sphereIndex.data()));
+    const Bvh::Bounds box = { { -0.2f, -0.2f, -0.2f }, { 0.2f, 0.2f, 0.2f } };
+    bench.run("occlusion.cull 64x4096", [&] {
+        culler.setCamera(mb, pickView);
+        for (int i = 0; i < 64; ++i) {
+            culler.addOccluder(occluder, Matrix::translate(static_cast<GLfloat>(i % 8) * 1.5f - 5.25f, static_cast<GLfloat>(i / 8) * 1.5f - 5.25f, 0.0f));
+        }
+        for (std::size_t i = 0; i < batch; ++i) {
+            culler.addInstance(box, Matrix::translate(static_cast<GLfloat>(i % 64) * 0.15f - 4.8f, static_cast<GLfloat>(i / 64) * 0.15f - 4.8f, (i & 1) ? -3.0f : 2.0f));
+        }
+        culler.submit();
+        culler.collect();
+        keep(culler.getCulled());
+    });
+    bench.metric("occlusion.cull 64x4096", "culled_percent", 100.0 * culler.getCulled() / culler.getTested());
+
+    // 粒子の更新 (定常状態まで進めてから計る)
+    const std::size_t particleCount(8u << 20);
+    Particles particles(particleCount);
+    const Particles::Emitter emitter = {
+        { 0.0f, 0.0f, 0.0f }, { 0.0f, 4.0f, 0.0f }, 1.5f, 2.0f, static_cast<GLfloat>(particleCount) / 1.5f
+    };
+    particles.setEmitter(emitter);
+    for (int i = 0; i < 120; ++i) particles.update(1.0f / 60.0f);
+    bench.run("particles.update 8M", [&] {
+        particles.update(1.0f / 60.0f);
+        keep(particles.size());
+    });
+    bench.metric("particles.update 8M", "alive", static_cast<double>(particles.size()));
+    std::vector<GLfloat> particleBuffer(particles.getCapacity() * 4);
+    bench.run("particles.write 8M", [&] {
+        particles.write(particleBuffer.data());
+        keep(particleBuffer[0]);
+    });
+
+    // 関節の動きの補間とスキニング
+    const int joints(64);
+    Skeleton skeleton;
+    for (int j = 0; j < joints; ++j) skeleton.addJoint(j - 1, Matrix::translate(0.0f, 2.0f * j / joints, 0.0f));
+    Animation animation(joints, 31, 1.0f);
+    for (int k = 0; k < 31; ++k) {
+        for (int j = 0; j < joints; ++j) {
+            animation.setKey(k, j, Quaternion::rotateAxis(0.05f * std::sin(0.2f * k + 0.1f * j), 0.0f, 0.0f, 1.0f),
+                0.0f, j > 0 ? 2.0f / joints : 0.0f, 0.0f);
+        }
+    }
+    std::vector<Quaternion> jointRotation(joints);
+    std::vector<GLfloat> jointTranslation(joints * 3);
+    std::vector<Matrix> skinMatrix(joints);
+    animation.sample(0.0, jointRotation.data(), jointTranslation.data());
+    skeleton.pose(jointRotation.data(), jointTranslation.data(), skinMatrix.data());
+    double clock(0.0);
+    bench.run("animation.sample 64 joints", [&] {
+        animation.sample(clock += 0.001, jointRotation.data(), jointTranslation.data());
+        skeleton.pose(jointRotation.data(), jointTranslation.data(), skinMatrix.data());
+        keep(skinMatrix[joints - 1][12]);
+    });
+    std::vector<Skeleton::Vertex> tubeVertex;
+    std::vector<GLuint> tubeIndex;
+    createTube(1023, 1023, joints, 0.2f, 2.0f, tubeVertex, tubeIndex);
+    std::vector<Object::Vertex> skinned(tubeVertex.size());
+    bench.run("skinning.lbs 1M", [&] {
+        Skeleton::skin(tubeVertex.size(), tubeVertex.data(), skinMatrix.data(), skinned.data());
+        keep(skinned[0].position[0]);
+    });
+    const double skinningTime(bench.getMedian("skinning.lbs 1M"));
+    if (skinningTime > 0.0) bench.metric("skinning.lbs 1M", "vertices_per_ms", tubeVertex.size() / (skinningTime * 1.0e-6));
+
+    // シェーダのソースファイルの読み込み
+    const std::string source(std::string(GLFWDRAFT_SOURCE_DIR) + "/point.frag");
+    std::vector<GLchar> buffer;
+    if (readShaderSource(source.c_str(), buffer).empty()) {
+        printf("Error : Skipped shader.readShaderSource\n");
+    }
+    else {
+        bench.run("shader.readShaderSource", [&] {
+            const std::vector<GLchar> text(readShaderSource(source.c_str(), buffer));
+            keep(text[0]);
+        });
+    }
+
+    // ユニフォームブロックの詰め込み
+    std::vector<Material> material(64);
+    for (Material &m : material) {
+        m.ambient = { unit(rng), unit(rng), unit(rng) };
+        m.diffuse = { unit(rng), unit(rng), unit(rng) };
+        m.specular = { unit(rng), unit(rng), unit(rng) };
+        m.shininess = 30.0f;
+    }
+    std::vector<GLubyte> packed;
+    const GLsizeiptr blocksize(Uniform<Material>::getBlockSize(256));
+    bench.run("uniform.pack x64", [&] {
+        Uniform<Material>::pack(material.data(), static_cast<unsigned int>(material.size()), blocksize, packed);
+        keep(packed[0]);
+    });
+
+    // 光源のクラスタへの割り当て
+    std::vector<Light> light(1024);
+    for (Light &l : light) {
+        l.position = { unit(rng) * 20.0f, unit(rng) * 20.0f, unit(rng) * 50.0f - 50.0f, 1.0f };
+        l.radius = 2.0f + unit(rng);
+    }
+    Cluster cluster;
+    cluster.setProjection(mb);
+    bench.run("cluster.bin x1024", [&] {
+        cluster.bin(light.data(), light.size());
+        keep(cluster.getIndex());
+    });
+
+    // GL を使わない描画 (ウィンドウと同じ球二つと六面体の場面, と 100 万三角形の球)
+    //  カラーバッファのハッシュを記録するので結果の画像が変わればわかる
+    //  環境変数 GLFWDRAFT_RASTER_PPM にファイル名があれば場面の画像を PPM 形式で保存する
+    {
+        static constexpr auto sceneSphere(Primitive::sphere<32, 16>());
+        static constexpr auto sceneCube(Primitive::cube());
+        static constexpr Light sceneLight[] = {
+            {0.0f, 0.0f, 5.0f, 1.0f, 0.2f, 0.1f, 0.1f, 0.0f, 1.0f, 0.5f, 0.5f, 1.0f, 0.5f, 0.5f},
+            {0.0f, 5.0f, 0.0f, 1.0f, 0.1f, 0.1f, 0.1f, 0.0f, 0.9f, 0.2f, 0.6f, 0.9f, 0.9f, 0.9f}
+        };
+        static constexpr Material sceneMaterial[] = {
+            {0.6f, 0.6f, 0.2f, 0.6f, 0.6f, 0.2f, 0.3f, 0.3f, 0.3f, 30.0f},
+            {0.1f, 0.1f, 0.5f, 0.1f, 0.1f, 0.5f, 0.4f, 0.4f, 0.4f, 60.0f}
+        };
+        const Matrix view(Matrix::lookat(3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+        const Matrix model(Matrix::rotateAxis(0.5f, 0.0f, 1.0f, 0.0f));
+        Rasterizer raster(1920, 1080);
+        raster.setProjection(Matrix::perspective(1.0f, 1920.0f / 1080.0f, 1.0f, 10.0f));
+        raster.setLight(sceneLight, std::size(sceneLight), view);
+
+        // カラーバッファの FNV-1a ハッシュ
+        const auto hash = [&raster] {
+            std::uint32_t h(2166136261u);
+            const GLubyte *const c(raster.getColor());
+            const std::size_t n(static_cast<std::size_t>(raster.getWidth()) * raster.getHeight() * 4);
+            for (std::size_t i = 0; i < n; ++i) h = (h ^ c[i]) * 16777619u;
+            return static_cast<double>(h);
+        };
+
+        bench.run("rasterizer.scene 1920x1080", [&] {
+            raster.add(static_cast<GLsizei>(sceneSphere.vertex.size()), sceneSphere.vertex.data(),
+                static_cast<GLsizei>(sceneSphere.index.size()), sceneSphere.index.data(), view * model, sceneMaterial[0]);
+            raster.add(static_cast<GLsizei>(sceneSphere.vertex.size()), sceneSphere.vertex.data(),
+                static_cast<GLsizei>(sceneSphere.index.size()), sceneSphere.index.data(),
+                view * model * Matrix::translate(0.0f, 0.0f, 3.0f), sceneMaterial[1]);
+            raster.add(static_cast<GLsizei>(sceneCube.vertex.size()), sceneCube.vertex.data(),
+                static_cast<GLsizei>(sceneCube.index.size()), sceneCube.index.data(),
+                view * model * Matrix::translate(0.0f, 0.0f, -3.0f), sceneMaterial[0]);
+            raster.render();
+            keep(raster.getColor()[0]);
+        });
+        if (bench.enabled("rasterizer.scene 1920x1080")) {
+            bench.metric("rasterizer.scene 1920x1080", "color_hash", hash());
+            if (const char *const ppm = getenv("GLFWDRAFT_RASTER_PPM")) raster.save(ppm);
+        }
+
+        std::vector<Object::Vertex> denseVertex;
+        std::vector<GLuint> denseIndex;
+        if (bench.enabled("rasterizer.sphere 1M 1920x1080")) createSphere(1024, 512, denseVertex, denseIndex);
+        bench.run("rasterizer.sphere 1M 1920x1080", [&] {
+            raster.add(static_cast<GLsizei>(denseVertex.size()), denseVertex.data(),
+                static_cast<GLsizei>(denseIndex.size()), denseIndex.data(),
+                view * model, sceneMaterial[0]);
+            raster.render();
+            keep(raster.getColor()[0]);
+        });
+        const double rasterTime(bench.getMedian("rasterizer.sphere 1M 1920x1080"));
+        if (rasterTime > 0.0) {
+            bench.metric("rasterizer.sphere 1M 1920x1080", "triangles_per_ms", denseIndex.size() / 3 / (rasterTime * 1.0e-6));
+            bench.metric("rasterizer.sphere 1M 1920x1080", "color_hash", hash());
+        }
+    }
+
+    // フレームアリーナに一フレーム分の描画項目を積む (定常状態ではヒープを確保しない)
+    FrameArena arena;
+    std::size_t frameAllocations(0);
+    bench.run("frameArena.frame x4096", [&] {
+        arena.beginFrame();
+        const std::size_t before(heapAllocations);
+        FrameVector<Matrix> item{ ArenaAllocator<Matrix>(arena) };
+        for (std::size_t i = 0; i < batch; ++i) item.push_back(rotation[i]);
+        keep(item.data());
+        frameAllocations = heapAllocations - before;
+    });
+    bench.metric("frameArena.frame x4096", "heap_allocations", static_cast<double>(frameAllocations));
+    bench.metric("frameArena.frame x4096", "arena_bytes", static_cast<double>(arena.getUsed()));
+
+    // 領域の割り当てと解放
+    std::vector<GLuint> size(batch);
+    for (GLuint &v : size) v = 1 + static_cast<GLuint>(rng() % 256);
+    std::vector<GLuint> offset(batch);
+    bench.run("rangeAllocator.churn x4096", [&] {
+        RangeAllocator allocator(1 << 24);
+        for (std::size_t i = 0; i < batch; ++i) offset[i] = allocator.allocate(size[i]);
+        for (std::size_t i = 0; i < batch; i += 2) allocator.free(offset[i], size[i]);
+        for (std::size_t i = 1; i < batch; i += 2) allocator.free(offset[i], size[i]);
+        keep(allocator.getFreeCount());
+    });
+
+    // 大きさの混ざった割り当てと解放を繰り返して断片化を調べる
+    //  小さな割り当てが多く, ときどき大きな割り当てが混ざる. 生きている領域が 1024 個を超えたらランダムに一つ解放する
+    std::vector<GLuint> mixedSize(batch * 4), victim(batch * 4);
+    for (GLuint &v : mixedSize) v = rng() % 16 ? 1 + static_cast<GLuint>(rng() % 64) : 1024 + static_cast<GLuint>(rng() % 65536);
+    for (GLuint &v : victim) v = static_cast<GLuint>(rng());
+    std::vector<std::pair<GLuint, GLuint>> live;
+    live.reserve(mixedSize.size());
+    double fragmentation(0.0);
+    std::size_t freeRanges(0), failed(0);
+    bench.run("rangeAllocator.mixed x16384", [&] {
+        RangeAllocator allocator(1 << 22);
+        live.clear();
+        failed = 0;
+        for (std::size_t i = 0; i < mixedSize.size(); ++i) {
+            // 全体の半分ほどが使われた状態を保つ
+            if (live.size() >= 1024) {
+                const std::size_t k(victim[i] % live.size());
+                allocator.free(live[k].first, live[k].second);
+                live[k] = live.back();
+                live.pop_back();
+            }
+            const GLuint offset(allocator.allocate(mixedSize[i]));
+            if (offset == RangeAllocator::invalid) ++failed;
+            else live.emplace_back(offset, mixedSize[i]);
+        }
+        fragmentation = allocator.getFragmentation();
+        freeRanges = allocator.getFreeCount();
+        keep(fragmentation);
+    });
+    bench.metric("rangeAllocator.mixed x16384", "fragmentation", fragmentation);
+    bench.metric("rangeAllocator.mixed x16384", "free_ranges", static_cast<double>(freeRanges));
+    bench.metric("rangeAllocator.mixed x16384", "failed", static_cast<double>(failed));
+
+    return bench.finish();
+}
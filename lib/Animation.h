@@ -0,0 +1,103 @@
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <GL/glew.h>
+
+// 四元数による回転
+#include "Quaternion.h"
+
+// SIMD 演算
+#include "Simd.h"
+
+// 関節の動きのキーフレーム
+//  全ての関節のキーフレームを等間隔の同じ時刻に揃えて, キーフレームごとに全関節の回転と平行移動量を並べる
+//  ある時刻の姿勢は前後のキーフレームの全関節を Quaternion::nlerp と float4 でまとめて補間して求める
+class Animation {
+    // 関節の数とキーフレームの数
+    const std::size_t joints, keys;
+
+    // 一巡りの時間 (秒)
+    const GLfloat duration;
+
+    // キーフレームごとの関節の回転
+    std::vector<Quaternion> rotation;
+
+    // キーフレームごとの関節の平行移動量 (3 要素ずつ)
+    std::vector<GLfloat> translation;
+
+    // 補間の割合 (関節の数だけ同じ値を並べる)
+    std::vector<GLfloat> weight;
+
+public:
+
+    // コンストラクタ
+    //  joints: 関節の数
+    //  keys: キーフレームの数 (最後のキーフレームは一巡りの終わりの時刻になる)
+    //  duration: 一巡りの時間 (秒)
+    Animation(std::size_t joints, std::size_t keys, GLfloat duration)
+        : joints(joints), keys(std::max<std::size_t>(keys, 2)), duration(duration)
+        , rotation(this->keys * joints, Quaternion::identity())
+        , translation(this->keys * joints * 3, 0.0f)
+        , weight(joints, 0.0f)
+    {}
+
+    // デストラクタ
+    virtual ~Animation() {}
+
+    // キーフレームの関節の姿勢を設定する
+    //  key: キーフレームの番号
+    //  joint: 関節の番号
+    //  r: 親に対する回転
+    //  x, y, z: 親に対する平行移動量
+    void setKey(std::size_t key, std::size_t joint, const Quaternion &r, GLfloat x, GLfloat y, GLfloat z) {
+        if (key >= keys || joint >= joints) {
+            printf("Error : Key frame out of range: %zu, %zu\n", key, joint);
+            return;
+        }
+        const std::size_t i(key * joints + joint);
+        rotation[i] = r;
+        translation[i * 3 + 0] = x;
+        translation[i * 3 + 1] = y;
+        translation[i * 3 + 2] = z;
+    }
+
+    // ある時刻の全関節の姿勢を求める (一巡りの時間で繰り返す)
+    //  time: 時刻 (秒)
+    //  r: 関節ごとの回転の格納先
+    //  t: 関節ごとの平行移動量の格納先 (3 要素ずつ)
+    void sample(double time, Quaternion *r, GLfloat *t) {
+        const double phase(duration > 0.0f ? time / duration - std::floor(time / duration) : 0.0);
+        const double position(phase * static_cast<double>(keys - 1));
+        const std::size_t k(std::min(static_cast<std::size_t>(position), keys - 2));
+        const GLfloat u(static_cast<GLfloat>(position - static_cast<double>(k)));
+
+        // 回転は四元数の配列のまとめた補間を使う
+        std::fill(weight.begin(), weight.end(), u);
+        Quaternion::nlerp(joints, rotation.data() + k * joints, rotation.data() + (k + 1) * joints, weight.data(), r);
+
+        // 平行移動量は 4 要素ずつ線形補間する
+        const GLfloat *const a(translation.data() + k * joints * 3);
+        const GLfloat *const b(a + joints * 3);
+        const std::size_t n(joints * 3);
+        const float4 wa(1.0f - u), wb(u);
+        std::size_t i(0);
+        for (; i + 4 <= n; i += 4) (float4::load(a + i) * wa + float4::load(b + i) * wb).store(t + i);
+        for (; i < n; ++i) t[i] = a[i] * (1.0f - u) + b[i] * u;
+    }
+
+    // 関節の数
+    std::size_t getJointCount() const { return joints; }
+
+    // 一巡りの時間
+    GLfloat getDuration() const { return duration; }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    Animation(const Animation &a);
+
+    // 代入によるコピー禁止
+    Animation &operator=(const Animation &a);
+};
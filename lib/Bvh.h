@@ -0,0 +1,518 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include <GL/glew.h>
+
+// 4要素のベクトル演算
+#include "Simd.h"
+
+// ワーカースレッドによる並列処理
+#include "ThreadPool.h"
+
+// 境界ボリューム階層 (軸に平行な境界ボックスの二分木)
+//  プリミティブの境界ボックスから binned SAH で作り、葉のプリミティブは呼び出し元が調べる
+//  上の階層は分割ごとに並列に集計し、十分小さくなった部分木はワーカースレッドで別々に作る
+class Bvh {
+public:
+
+    // 軸に平行な境界ボックス
+    struct Bounds {
+        GLfloat min[3], max[3];
+
+        // 空にする
+        void clear() {
+            for (int k = 0; k < 3; ++k) {
+                min[k] = std::numeric_limits<GLfloat>::max();
+                max[k] = -std::numeric_limits<GLfloat>::max();
+            }
+        }
+
+        // 境界ボックスを含むように広げる
+        void grow(const Bounds &b) {
+            for (int k = 0; k < 3; ++k) {
+                min[k] = std::min(min[k], b.min[k]);
+                max[k] = std::max(max[k], b.max[k]);
+            }
+        }
+
+        // 点を含むように広げる
+        void grow(const GLfloat *p) {
+            for (int k = 0; k < 3; ++k) {
+                min[k] = std::min(min[k], p[k]);
+                max[k] = std::max(max[k], p[k]);
+            }
+        }
+
+        // 表面積の半分 (空なら 0)
+        GLfloat area() const {
+            const GLfloat x(max[0] - min[0]), y(max[1] - min[1]), z(max[2] - min[2]);
+            return x < 0.0f ? 0.0f : x * y + y * z + z * x;
+        }
+    };
+
+    // 節点 (count が 0 なら first と first + 1 が子、そうでなければ order[first] から count 個の葉)
+    struct Node {
+        Bounds bounds;
+        GLuint first, count;
+    };
+
+private:
+
+    // 分割の候補の数
+    static const int binCount = 16;
+
+    // これ以下のプリミティブの数なら SAH を評価せずに葉にする
+    static const std::size_t minLeaf = 2;
+
+    // SAH が分割しない方が良いとしても葉にしないプリミティブの数
+    static const std::size_t maxLeaf = 16;
+
+    // 木の深さの上限 (これより深い節点は大きさにかかわらず葉にする)
+    static const int maxDepth = 96;
+
+    // 節点
+    std::vector<Node> node;
+
+    // 葉の順に並べたプリミティブの番号
+    std::vector<GLuint> order;
+
+    // 作成中のプリミティブ (並べ替えながら連続に読めるように境界ボックスと番号をまとめる)
+    //  4 要素目は 0 にしておき float4 でそのまま読む
+    struct Primitive {
+        GLfloat min[4], max[4];
+        GLuint id;
+    };
+
+    // 境界ボックスと重心 (min + max) の範囲
+    struct Extent {
+        float4 lo, hi, clo, chi;
+
+        // 空にする
+        void clear() {
+            lo = clo = float4(std::numeric_limits<GLfloat>::max());
+            hi = chi = float4(-std::numeric_limits<GLfloat>::max());
+        }
+
+        // プリミティブを含むように広げる
+        void grow(float4 l, float4 h, float4 c) {
+            lo = min(lo, l);
+            hi = max(hi, h);
+            clo = min(clo, c);
+            chi = max(chi, c);
+        }
+
+        // 範囲を含むように広げる
+        void grow(const Extent &e) {
+            lo = min(lo, e.lo);
+            hi = max(hi, e.hi);
+            clo = min(clo, e.clo);
+            chi = max(chi, e.chi);
+        }
+
+    };
+
+    // 分割の候補 (境界ボックスとプリミティブの数)
+    struct Bin {
+        float4 lo, hi;
+        std::size_t count;
+
+        // 空にする
+        void clear() {
+            lo = float4(std::numeric_limits<GLfloat>::max());
+            hi = float4(-std::numeric_limits<GLfloat>::max());
+            count = 0;
+        }
+
+        // 分割の候補を含むように広げる
+        void grow(const Bin &b) {
+            lo = min(lo, b.lo);
+            hi = max(hi, b.hi);
+            count += b.count;
+        }
+    };
+
+    // 境界ボックスの表面積の半分
+    static GLfloat area(float4 lo, float4 hi)
+    {
+        GLfloat d[4];
+        (hi - lo).store(d);
+        return d[0] < 0.0f ? 0.0f : d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+    }
+
+    // 分割する範囲
+    struct Range {
+        // 節点の番号
+        GLuint node;
+
+        // order の範囲
+        std::size_t begin, end;
+
+        // 深さ
+        int depth;
+
+        // 範囲のプリミティブの境界ボックスと重心の範囲
+        Extent extent;
+    };
+
+    // 範囲のプリミティブの境界ボックスと重心の範囲を求める
+    static void measure(const Primitive *prim, std::size_t begin, std::size_t end, Extent &extent)
+    {
+        extent.clear();
+        for (std::size_t i = begin; i < end; ++i) {
+            const float4 lo(float4::load(prim[i].min)), hi(float4::load(prim[i].max));
+            extent.grow(lo, hi, lo + hi);
+        }
+    }
+
+    // 重心から分割の候補の番号を求める (振り分けと並べ替えで同じ計算をする)
+    //  k: 軸
+    static int binIndex(const Primitive &p, int k, const GLfloat *origin, const GLfloat *scale)
+    {
+        const int b(static_cast<int>((p.min[k] + p.max[k] - origin[k]) * scale[k]));
+        return std::max(0, std::min(binCount - 1, b));
+    }
+
+    // 重心の位置で分割の候補に振り分ける
+    //  bin: 軸ごとの候補 (3 * binCount 要素)
+    static void fill(const Primitive *prim, std::size_t begin, std::size_t end,
+        const GLfloat *origin, const GLfloat *scale, Bin *bin)
+    {
+        for (int i = 0; i < 3 * binCount; ++i) bin[i].clear();
+        for (std::size_t i = begin; i < end; ++i) {
+            const float4 lo(float4::load(prim[i].min)), hi(float4::load(prim[i].max));
+            for (int k = 0; k < 3; ++k) {
+                Bin &x(bin[k * binCount + binIndex(prim[i], k, origin, scale)]);
+                x.lo = min(x.lo, lo);
+                x.hi = max(x.hi, hi);
+                ++x.count;
+            }
+        }
+    }
+
+    // 境界ボックスを取り出す
+    static void store(const Extent &e, Bounds &b)
+    {
+        GLfloat lo[4], hi[4];
+        e.lo.store(lo);
+        e.hi.store(hi);
+        for (int k = 0; k < 3; ++k) {
+            b.min[k] = lo[k];
+            b.max[k] = hi[k];
+        }
+    }
+
+    // 節点の境界ボックスを設定して二つに分ける
+    //  子の境界ボックスは分割の候補の集計から、重心の範囲は並べ替えながら求める
+    //  parallel: ワーカースレッドで集計するなら true
+    //  戻り値: 分けたら true (葉にしたら false)
+    bool split(const Range &r, Primitive *prim, std::atomic<GLuint> &used, Range &left, Range &right, bool parallel)
+    {
+        const std::size_t n(r.end - r.begin);
+        Node &parent(node[r.node]);
+        store(r.extent, parent.bounds);
+        parent.first = static_cast<GLuint>(r.begin);
+        parent.count = static_cast<GLuint>(n);
+        if (n <= minLeaf || r.depth >= maxDepth) return false;
+
+        // 重心の範囲を分割の候補に振り分ける
+        GLfloat origin[4], c1[4], scale[3] = { 0.0f, 0.0f, 0.0f };
+        r.extent.clo.store(origin);
+        r.extent.chi.store(c1);
+        for (int k = 0; k < 3; ++k) {
+            const GLfloat extent(c1[k] - origin[k]);
+            if (extent > 0.0f) scale[k] = binCount / extent;
+        }
+
+        const std::size_t grain(std::size_t(1) << 14);
+        const std::size_t chunks(parallel ? (n + grain - 1) / grain : 1);
+        Bin bin[3 * binCount];
+        if (chunks > 1) {
+            std::vector<Bin> part(chunks * 3 * binCount);
+            ThreadPool::instance().parallelFor(n, grain, [&](std::size_t begin, std::size_t end) {
+                const std::size_t c(begin / grain);
+                fill(prim, r.begin + begin, r.begin + end, origin, scale, &part[c * 3 * binCount]);
+            });
+            for (int i = 0; i < 3 * binCount; ++i) {
+                bin[i] = part[i];
+                for (std::size_t c = 1; c < chunks; ++c) bin[i].grow(part[c * 3 * binCount + i]);
+            }
+        }
+        else {
+            fill(prim, r.begin, r.end, origin, scale, bin);
+        }
+
+        // 分割の費用が最小になる軸と位置を探す (節点をたどる費用と三角形を調べる費用を 1 とする)
+        int axis(-1), plane(0);
+        GLfloat best(std::numeric_limits<GLfloat>::max());
+        for (int k = 0; k < 3; ++k) {
+            if (scale[k] == 0.0f) continue;
+            const Bin *const b(bin + k * binCount);
+
+            // 左から累積した表面積とプリミティブ数
+            GLfloat leftArea[binCount];
+            std::size_t leftCount[binCount];
+            Bin acc;
+            acc.clear();
+            for (int i = 0; i < binCount - 1; ++i) {
+                acc.grow(b[i]);
+                leftArea[i] = area(acc.lo, acc.hi);
+                leftCount[i] = acc.count;
+            }
+
+            // 右から累積しながら費用を求める
+            acc.clear();
+            for (int i = binCount - 1; i > 0; --i) {
+                acc.grow(b[i]);
+                if (acc.count == 0 || leftCount[i - 1] == 0) continue;
+                const GLfloat cost(leftArea[i - 1] * leftCount[i - 1] + area(acc.lo, acc.hi) * acc.count);
+                if (cost < best) {
+                    best = cost;
+                    axis = k;
+                    plane = i;
+                }
+            }
+        }
+
+        // 分割しても安くならなければ葉にする
+        const GLfloat parentArea(area(r.extent.lo, r.extent.hi));
+        const GLfloat leafCost(static_cast<GLfloat>(n));
+        const GLfloat splitCost(parentArea > 0.0f ? 1.0f + best / parentArea : leafCost);
+        if (n <= maxLeaf && (axis < 0 || splitCost >= leafCost)) return false;
+
+        // 子の節点を確保する
+        const GLuint child(used.fetch_add(2));
+        parent.first = child;
+        parent.count = 0;
+        left.node = child;
+        right.node = child + 1;
+        left.depth = right.depth = r.depth + 1;
+        left.begin = r.begin;
+        right.end = r.end;
+
+        if (axis >= 0) {
+            // 子の境界ボックスは分割の候補の集計から求める
+            Bin l, h;
+            l.clear();
+            h.clear();
+            for (int i = 0; i < binCount; ++i) (i < plane ? l : h).grow(bin[axis * binCount + i]);
+
+            // 重心の範囲を求めながらプリミティブを並べ替える
+            left.extent.clear();
+            right.extent.clear();
+            std::size_t i(r.begin), j(r.end);
+            while (i < j) {
+                const float4 lo(float4::load(prim[i].min)), hi(float4::load(prim[i].max)), c(lo + hi);
+                if (binIndex(prim[i], axis, origin, scale) < plane) {
+                    left.extent.grow(lo, hi, c);
+                    ++i;
+                }
+                else {
+                    right.extent.grow(lo, hi, c);
+                    std::swap(prim[i], prim[--j]);
+                }
+            }
+            left.end = right.begin = i;
+            left.extent.lo = l.lo;
+            left.extent.hi = l.hi;
+            right.extent.lo = h.lo;
+            right.extent.hi = h.hi;
+        }
+        else {
+            // 重心が一点に集まっていれば半分に分ける
+            left.end = right.begin = r.begin + n / 2;
+            measure(prim, left.begin, left.end, left.extent);
+            measure(prim, right.begin, right.end, right.extent);
+        }
+        return true;
+    }
+
+    // 部分木を作る
+    void subtree(const Range &root, Primitive *prim, std::atomic<GLuint> &used)
+    {
+        std::vector<Range> stack(1, root);
+        while (!stack.empty()) {
+            const Range r(stack.back());
+            stack.pop_back();
+            Range left, right;
+            if (split(r, prim, used, left, right, false)) {
+                stack.push_back(right);
+                stack.push_back(left);
+            }
+        }
+    }
+
+    // 半直線と境界ボックスの交差判定
+    //  inverse: 半直線の方向の逆数
+    //  distance: 調べる距離の上限
+    //  t: 境界ボックスに入る距離の格納先
+    static bool hit(const Bounds &b, const GLfloat *origin, const GLfloat *inverse, GLfloat distance, GLfloat &t)
+    {
+        GLfloat tmin(0.0f), tmax(distance);
+        for (int k = 0; k < 3; ++k) {
+            GLfloat t0((b.min[k] - origin[k]) * inverse[k]);
+            GLfloat t1((b.max[k] - origin[k]) * inverse[k]);
+            if (t0 > t1) std::swap(t0, t1);
+            tmin = std::max(tmin, t0);
+            tmax = std::min(tmax, t1);
+        }
+        t = tmin;
+        return tmin <= tmax;
+    }
+
+public:
+
+    // コンストラクタ
+    Bvh() {}
+
+    // 作り直す
+    //  count: プリミティブの数
+    //  bounds: プリミティブの境界ボックス
+    void build(std::size_t count, const Bounds *bounds)
+    {
+        node.clear();
+        order.resize(count);
+        if (count == 0) return;
+
+        // プリミティブを並べ替え用の配列に写す
+        ThreadPool &pool(ThreadPool::instance());
+        std::vector<Primitive> prim(count);
+        pool.parallelFor(count, 1 << 16, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                for (int k = 0; k < 3; ++k) {
+                    prim[i].min[k] = bounds[i].min[k];
+                    prim[i].max[k] = bounds[i].max[k];
+                }
+                prim[i].min[3] = prim[i].max[3] = 0.0f;
+                prim[i].id = static_cast<GLuint>(i);
+            }
+        });
+
+        // 全体の境界ボックスと重心の範囲を求める
+        const std::size_t grain(1 << 16), chunks((count + grain - 1) / grain);
+        std::vector<Extent> part(chunks);
+        pool.parallelFor(count, grain, [&](std::size_t begin, std::size_t end) {
+            measure(prim.data(), begin, end, part[begin / grain]);
+        });
+        Range root = { 0, 0, count, 0, part[0] };
+        for (std::size_t c = 1; c < chunks; ++c) root.extent.grow(part[c]);
+
+        // 節点の数は 2 * count - 1 を超えない
+        node.resize(2 * count - 1);
+        std::atomic<GLuint> used(1);
+
+        // 上の階層は集計を並列にしながら部分木の数が並列度に見合うまで分ける
+        const std::size_t threshold(std::max<std::size_t>(count / (pool.size() * 8), 1 << 12));
+        std::vector<Range> pending(1, root), task;
+        while (!pending.empty()) {
+            const Range r(pending.back());
+            pending.pop_back();
+            if (r.end - r.begin <= threshold) {
+                task.push_back(r);
+                continue;
+            }
+            Range left, right;
+            if (split(r, prim.data(), used, left, right, true)) {
+                pending.push_back(left);
+                pending.push_back(right);
+            }
+        }
+
+        // 残りの部分木はワーカースレッドで別々に作る
+        pool.parallelFor(task.size(), 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) subtree(task[i], prim.data(), used);
+        });
+        for (std::size_t i = 0; i < count; ++i) order[i] = prim[i].id;
+
+        node.resize(used.load());
+        node.shrink_to_fit();
+    }
+
+    // プリミティブが動いたときに木の形を変えずに境界ボックスだけ求め直す
+    //  bounds: プリミティブの境界ボックス (build と同じ並び)
+    void refit(const Bounds *bounds)
+    {
+        // 子の節点は親より後ろにあるので後ろから求める
+        for (std::size_t i = node.size(); i-- > 0;) {
+            Node &n(node[i]);
+            if (n.count > 0) {
+                n.bounds.clear();
+                for (GLuint j = n.first; j < n.first + n.count; ++j) n.bounds.grow(bounds[order[j]]);
+            }
+            else {
+                n.bounds = node[n.first].bounds;
+                n.bounds.grow(node[n.first + 1].bounds);
+            }
+        }
+    }
+
+    // 半直線が通る葉を近い順にたどる
+    //  origin: 半直線の始点
+    //  direction: 半直線の方向
+    //  distance: 調べる距離の上限 (leaf が交点を見つけたら縮める)
+    //  leaf: 葉を調べる関数 leaf(first, count, distance)
+    template<typename Func>
+    void traverse(const GLfloat *origin, const GLfloat *direction, GLfloat &distance, Func leaf) const
+    {
+        if (node.empty()) return;
+
+        GLfloat inverse[3];
+        for (int k = 0; k < 3; ++k) inverse[k] = 1.0f / direction[k];
+
+        // 節点の番号と境界ボックスに入る距離のスタック
+        GLuint stack[maxDepth + 2];
+        GLfloat entry[maxDepth + 2];
+        int top(0);
+        GLfloat t;
+        if (!hit(node[0].bounds, origin, inverse, distance, t)) return;
+        stack[top] = 0;
+        entry[top++] = t;
+
+        while (top > 0) {
+            --top;
+            if (entry[top] > distance) continue;
+            const Node &n(node[stack[top]]);
+            if (n.count > 0) {
+                leaf(n.first, n.count, distance);
+                continue;
+            }
+
+            // 近い方の子を先に調べる
+            GLfloat t0, t1;
+            const bool h0(hit(node[n.first].bounds, origin, inverse, distance, t0));
+            const bool h1(hit(node[n.first + 1].bounds, origin, inverse, distance, t1));
+            if (h0 && h1) {
+                const bool near0(t0 <= t1);
+                stack[top] = near0 ? n.first + 1 : n.first;
+                entry[top++] = near0 ? t1 : t0;
+                stack[top] = near0 ? n.first : n.first + 1;
+                entry[top++] = near0 ? t0 : t1;
+            }
+            else if (h0) {
+                stack[top] = n.first;
+                entry[top++] = t0;
+            }
+            else if (h1) {
+                stack[top] = n.first + 1;
+                entry[top++] = t1;
+            }
+        }
+    }
+
+    // 全体の境界ボックス (空なら空の境界ボックス)
+    Bounds getBounds() const
+    {
+        Bounds b;
+        if (node.empty()) b.clear();
+        else b = node[0].bounds;
+        return b;
+    }
+
+    // 節点
+    const std::vector<Node> &getNodes() const { return node; }
+
+    // 葉の順に並べたプリミティブの番号
+    const std::vector<GLuint> &getOrder() const { return order; }
+};
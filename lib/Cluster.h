@@ -0,0 +1,225 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <GL/glew.h>
+
+// 変換行列
+#include "Matrix.h"
+
+// 光源データ
+#include "Light.h"
+
+// ベクトル演算
+#include "Simd.h"
+
+// 並列処理
+#include "ThreadPool.h"
+
+// 視錐台を分割したクラスタへの光源の割り当て
+//  GL の関数を呼ばないので CPU だけで試験や計測ができる
+class Cluster {
+    // 画面の横と縦のタイル数、奥行きの分割数
+    int tilesX, tilesY, slices;
+
+    // 前方面と後方面の距離
+    GLfloat zNear, zFar;
+
+    // 画角の半分の正接
+    GLfloat tanX, tanY;
+
+    // 視点座標系の光源の位置と影響半径 (4 の倍数に詰めた SoA)
+    std::vector<GLfloat> lx, ly, lz, lr;
+
+    // 奥行きの分割ごとの作業領域
+    struct Slice {
+        // 奥行き方向に重なる光源の番号と位置
+        std::vector<GLuint> candidate;
+        std::vector<GLfloat> cx, cy, cz, cr;
+
+        // タイルごとの光源の数と光源の番号
+        std::vector<GLuint> count, index;
+    };
+    std::vector<Slice> work;
+
+    // クラスタごとの光源リストの先頭と数
+    std::vector<GLuint> grid;
+
+    // 光源の番号
+    std::vector<GLuint> index;
+
+    // 奥行きの分割の境界の距離
+    GLfloat depth(int s) const {
+        return zNear * std::pow(zFar / zNear, static_cast<GLfloat>(s) / slices);
+    }
+
+    // 一つの奥行きの分割に光源を割り当てる
+    void binSlice(int s, std::size_t lights) {
+        Slice &w(work[s]);
+        const GLfloat dn(depth(s)), df(depth(s + 1));
+
+        // 奥行き方向に重なる光源を 4 個ずつ選ぶ
+        w.candidate.clear();
+        const float4 vdn(dn), vdf(df);
+        for (std::size_t i = 0; i < lights; i += 4) {
+            const float4 z(-float4::load(&lz[i])), r(float4::load(&lr[i]));
+            const int mask(movemask((z - r <= vdf) & (z + r >= vdn)));
+            for (int k = 0; k < 4; k++) {
+                if (mask & (1 << k) && i + k < lights) w.candidate.push_back(static_cast<GLuint>(i + k));
+            }
+        }
+
+        // 候補の位置を SoA に集める
+        const std::size_t n(w.candidate.size()), padded((n + 3) & ~std::size_t(3));
+        w.cx.assign(padded, 0.0f);
+        w.cy.assign(padded, 0.0f);
+        w.cz.assign(padded, 0.0f);
+        w.cr.assign(padded, -1.0f);
+        for (std::size_t c = 0; c < n; c++) {
+            const GLuint i(w.candidate[c]);
+            w.cx[c] = lx[i];
+            w.cy[c] = ly[i];
+            w.cz[c] = lz[i];
+            w.cr[c] = lr[i];
+        }
+
+        // タイルごとに軸平行境界箱と球の交差を調べる
+        w.count.assign(tilesX * tilesY, 0);
+        w.index.clear();
+        const float4 zmin(-df), zmax(-dn);
+        for (int ty = 0; ty < tilesY; ty++) {
+            const GLfloat y0(2.0f * ty / tilesY - 1.0f), y1(2.0f * (ty + 1) / tilesY - 1.0f);
+            const float4 ymin(std::min(y0 * tanY * dn, y0 * tanY * df));
+            const float4 ymax(std::max(y1 * tanY * dn, y1 * tanY * df));
+
+            for (int tx = 0; tx < tilesX; tx++) {
+                const GLfloat x0(2.0f * tx / tilesX - 1.0f), x1(2.0f * (tx + 1) / tilesX - 1.0f);
+                const float4 xmin(std::min(x0 * tanX * dn, x0 * tanX * df));
+                const float4 xmax(std::max(x1 * tanX * dn, x1 * tanX * df));
+                const float4 zero(0.0f);
+
+                GLuint &count(w.count[ty * tilesX + tx]);
+                for (std::size_t c = 0; c < padded; c += 4) {
+                    const float4 x(float4::load(&w.cx[c])), y(float4::load(&w.cy[c]));
+                    const float4 z(float4::load(&w.cz[c])), r(float4::load(&w.cr[c]));
+                    const float4 dx(max(max(xmin - x, x - xmax), zero));
+                    const float4 dy(max(max(ymin - y, y - ymax), zero));
+                    const float4 dz(max(max(zmin - z, z - zmax), zero));
+                    const int mask(movemask((dx * dx + dy * dy + dz * dz <= r * r) & (r >= zero)));
+                    for (int k = 0; k < 4; k++) {
+                        if (mask & (1 << k)) {
+                            w.index.push_back(w.candidate[c + k]);
+                            ++count;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+public:
+
+    // コンストラクタ
+    //  tilesX: 画面の横の分割数
+    //  tilesY: 画面の縦の分割数
+    //  slices: 奥行きの分割数
+    Cluster(int tilesX = 16, int tilesY = 9, int slices = 24)
+        : tilesX(tilesX), tilesY(tilesY), slices(slices)
+        , zNear(1.0f), zFar(10.0f), tanX(1.0f), tanY(1.0f)
+        , work(slices)
+        , grid(tilesX * tilesY * slices * 2, 0)
+    {}
+
+    // 画角などからクラスタの形を決める
+    //  fovy: 縦の画角
+    //  aspect: 縦横比
+    //  zNear: 前方面の距離
+    //  zFar: 後方面の距離
+    void setProjection(GLfloat fovy, GLfloat aspect, GLfloat zNear, GLfloat zFar) {
+        tanY = tan(fovy * 0.5f);
+        tanX = tanY * aspect;
+        this->zNear = zNear;
+        this->zFar = zFar;
+    }
+
+    // Matrix::perspective で作った透視投影変換行列からクラスタの形を決める
+    //  projection: 透視投影変換行列
+    //  戻り値: 透視投影でなければ false
+    bool setProjection(const Matrix &projection) {
+        if (projection[11] != -1.0f || projection[0] == 0.0f || projection[5] == 0.0f) return false;
+
+        tanX = 1.0f / projection[0];
+        tanY = 1.0f / projection[5];
+        zNear = projection[14] / (projection[10] - 1.0f);
+        zFar = projection[14] / (projection[10] + 1.0f);
+        return true;
+    }
+
+    // 光源をクラスタに割り当てる
+    //  light: 視点座標系の光源を格納した配列
+    //  count: 光源の数
+    void bin(const Light *light, std::size_t count) {
+        // 光源の位置と影響半径を SoA に並べ替える
+        const std::size_t padded((count + 3) & ~std::size_t(3));
+        lx.resize(padded);
+        ly.resize(padded);
+        lz.resize(padded);
+        lr.resize(padded);
+        for (std::size_t i = 0; i < count; i++) {
+            const Light &l(light[i]);
+            const bool bounded(l.radius > 0.0f && l.position[3] != 0.0f);
+            const GLfloat w(bounded ? 1.0f / l.position[3] : 0.0f);
+            lx[i] = l.position[0] * w;
+            ly[i] = l.position[1] * w;
+            lz[i] = l.position[2] * w;
+            lr[i] = bounded ? l.radius : std::numeric_limits<GLfloat>::infinity();
+        }
+        for (std::size_t i = count; i < padded; i++) {
+            lx[i] = ly[i] = lz[i] = 0.0f;
+            lr[i] = -1.0f;
+        }
+
+        // 奥行きの分割ごとに並列に割り当てる
+        ThreadPool::instance().parallelFor(slices, 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t s = begin; s < end; s++) binSlice(static_cast<int>(s), count);
+        });
+
+        // 光源リストを一つにまとめる
+        std::size_t total(0);
+        for (const Slice &w : work) total += w.index.size();
+        index.resize(total);
+
+        GLuint offset(0);
+        for (int s = 0; s < slices; s++) {
+            const Slice &w(work[s]);
+            std::copy(w.index.begin(), w.index.end(), index.begin() + offset);
+            for (int t = 0; t < tilesX * tilesY; t++) {
+                GLuint *const g(&grid[2 * (s * tilesX * tilesY + t)]);
+                g[0] = offset;
+                g[1] = w.count[t];
+                offset += w.count[t];
+            }
+        }
+    }
+
+    // クラスタごとの光源リストの先頭と数 (2 要素ずつ)
+    const std::vector<GLuint> &getGrid() const { return grid; }
+
+    // クラスタに割り当てた光源の番号
+    const std::vector<GLuint> &getIndex() const { return index; }
+
+    // クラスタの数を取り出す
+    void getCount(GLuint *count) const {
+        count[0] = tilesX;
+        count[1] = tilesY;
+        count[2] = slices;
+    }
+
+    // 視点からの距離から奥行きの分割の番号を求める係数 (slice = log(d) * scale + bias)
+    void getDepthScale(GLfloat *scaleBias) const {
+        const GLfloat scale(slices / std::log(zFar / zNear));
+        scaleBias[0] = scale;
+        scaleBias[1] = -std::log(zNear) * scale;
+    }
+};
@@ -0,0 +1,109 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <GL/glew.h>
+
+// GL のオブジェクトの削除を GPU が使い終わるまで遅らせる
+//  描画ループで毎フレーム collect() を呼び, 描画を終えてコンテキストを手放す前に flush() を呼ぶ
+class DeletionQueue {
+    // 削除するオブジェクト
+    struct Entry {
+        // true なら頂点配列オブジェクト、false ならバッファオブジェクト
+        bool vertexArray;
+
+        // オブジェクト名
+        GLuint name;
+    };
+
+    // このフレームで削除を要求されたオブジェクト
+    std::vector<Entry> pending;
+
+    // フェンスを待っているオブジェクト
+    struct Batch {
+        GLsync fence;
+        std::vector<Entry> entry;
+    };
+    std::deque<Batch> batch;
+
+    // オブジェクトを削除する
+    static void destroy(const std::vector<Entry> &entry) {
+        for (const Entry &e : entry) {
+            if (e.vertexArray) glDeleteVertexArrays(1, &e.name);
+            else glDeleteBuffers(1, &e.name);
+        }
+    }
+
+public:
+
+    // コンストラクタ
+    DeletionQueue() {}
+
+    // デストラクタ
+    virtual ~DeletionQueue() {}
+
+    // 頂点配列オブジェクトの削除を予約する
+    void vertexArray(GLuint name) {
+        const Entry e = { true, name };
+        pending.push_back(e);
+    }
+
+    // バッファオブジェクトの削除を予約する
+    void buffer(GLuint name) {
+        const Entry e = { false, name };
+        pending.push_back(e);
+    }
+
+    // このフレームの予約にフェンスを置き、GPU が使い終わったオブジェクトを削除する
+    //  フェンスが合図を済ませた予約は並びの途中にあっても取り除く
+    void collect() {
+        for (auto b = batch.begin(); b != batch.end();) {
+            const GLenum status(glClientWaitSync(b->fence, 0, 0));
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+                ++b;
+                continue;
+            }
+            glDeleteSync(b->fence);
+            destroy(b->entry);
+            b = batch.erase(b);
+        }
+
+        if (!pending.empty()) {
+            Batch b;
+            b.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            b.entry.swap(pending);
+            batch.push_back(std::move(b));
+        }
+    }
+
+    // 予約した全てのオブジェクトとフェンスをすぐに削除する (コンテキストを手放す前に呼ぶ)
+    void flush() {
+        for (const Batch &b : batch) {
+            glDeleteSync(b.fence);
+            destroy(b.entry);
+        }
+        batch.clear();
+        destroy(pending);
+        pending.clear();
+    }
+
+    // 予約中のオブジェクトの数
+    std::size_t size() const {
+        std::size_t n(pending.size());
+        for (const Batch &b : batch) n += b.entry.size();
+        return n;
+    }
+
+    // アプリケーション全体で共有する削除の待ち行列
+    static DeletionQueue &instance() {
+        static DeletionQueue queue;
+        return queue;
+    }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    DeletionQueue(const DeletionQueue &q);
+
+    // 代入によるコピー禁止
+    DeletionQueue &operator=(const DeletionQueue &q);
+};
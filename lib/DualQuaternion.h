@@ -0,0 +1,122 @@
+#pragma once
+#include <cmath>
+#include <GL/glew.h>
+
+// 変換行列
+#include "Matrix.h"
+
+// 四元数による回転
+#include "Quaternion.h"
+
+// 双対四元数による回転と平行移動
+//  剛体変換を 8 要素で表し、積み重ねても正規化し直せばゆがまない
+class DualQuaternion {
+    // 回転を表す実部
+    Quaternion real;
+
+    // 平行移動を表す双対部 (t r / 2)
+    Quaternion dual;
+
+public:
+
+    // コンストラクタ
+    DualQuaternion() {}
+
+    // 実部と双対部を指定して初期化するコンストラクタ
+    DualQuaternion(const Quaternion &real, const Quaternion &dual)
+        : real(real), dual(dual)
+    {}
+
+    // 回転してから平行移動する双対四元数を作成
+    //  r: 回転
+    //  x, y, z: 平行移動量
+    static DualQuaternion rotateTranslate(const Quaternion &r, GLfloat x, GLfloat y, GLfloat z)
+    {
+        return DualQuaternion(r, Quaternion(x * 0.5f, y * 0.5f, z * 0.5f, 0.0f) * r);
+    }
+
+    // 単位双対四元数を作成
+    static DualQuaternion identity()
+    {
+        return DualQuaternion(Quaternion::identity(), Quaternion(0.0f, 0.0f, 0.0f, 0.0f));
+    }
+
+    // (x, y, z) だけ平行移動する双対四元数を作成
+    static DualQuaternion translate(GLfloat x, GLfloat y, GLfloat z)
+    {
+        return rotateTranslate(Quaternion::identity(), x, y, z);
+    }
+
+    // 回転する双対四元数を作成
+    static DualQuaternion rotate(const Quaternion &r)
+    {
+        return DualQuaternion(r, Quaternion(0.0f, 0.0f, 0.0f, 0.0f));
+    }
+
+    // 剛体変換の変換行列から双対四元数を作成
+    static DualQuaternion fromMatrix(const Matrix &m)
+    {
+        return rotateTranslate(Quaternion::fromMatrix(m), m[12], m[13], m[14]);
+    }
+
+    // 回転
+    const Quaternion &getReal() const { return real; }
+
+    // 平行移動を表す双対部
+    const Quaternion &getDual() const { return dual; }
+
+    // 平行移動量を求める
+    //  t: 平行移動量の格納先 (3要素)
+    void getTranslation(GLfloat *t) const
+    {
+        const Quaternion q(dual * real.conjugate());
+        for (int i = 0; i < 3; ++i) t[i] = 2.0f * q[i];
+    }
+
+    // 変換行列を求める
+    Matrix getMatrix() const
+    {
+        Matrix m(real.getMatrix());
+        getTranslation(&m[12]);
+        return m;
+    }
+
+    // 法線ベクトルの変換行列を求める (回転の部分だけ)
+    //  m: 3x3 行列の格納先 (Matrix::getNormalMatrix と同じ並び)
+    void getNormalMatrix(GLfloat *m) const
+    {
+        real.getNormalMatrix(m);
+    }
+
+    // 点を変換する
+    //  p: 変換する点 (3要素, 結果で上書きする)
+    void transformPoint(GLfloat *p) const
+    {
+        GLfloat t[3];
+        getTranslation(t);
+        real.rotateVector(p);
+        for (int i = 0; i < 3; ++i) p[i] += t[i];
+    }
+
+    // 正規化する
+    DualQuaternion normalize() const
+    {
+        const GLfloat l(std::sqrt(real.dot(real)));
+        if (l == 0.0f) return identity();
+
+        // 実部を単位にして双対部の実部と直交する成分を取り除く
+        const Quaternion r(real[0] / l, real[1] / l, real[2] / l, real[3] / l);
+        Quaternion d(dual[0] / l, dual[1] / l, dual[2] / l, dual[3] / l);
+        const GLfloat c(r.dot(d));
+        for (int i = 0; i < 4; ++i) d[i] -= r[i] * c;
+        return DualQuaternion(r, d);
+    }
+
+    // 乗算 (右の変換を先に行う)
+    DualQuaternion operator*(const DualQuaternion &q) const
+    {
+        const Quaternion a(real * q.dual), b(dual * q.real);
+        return DualQuaternion(real * q.real,
+            Quaternion(a[0] + b[0], a[1] + b[1], a[2] + b[2], a[3] + b[3]));
+    }
+};
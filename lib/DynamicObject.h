@@ -0,0 +1,253 @@
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <GL/glew.h>
+
+// 図形データ
+#include "Object.h"
+
+// GL のオブジェクトの遅延削除
+#include "DeletionQueue.h"
+
+// 毎フレーム頂点を書き換える図形データ
+//  Persistent: 一つのバッファオブジェクトを永続マップして regions 個の領域に分け, フレームごとに順に使う
+//      領域ごとに頂点配列オブジェクトを作っておき, 描画する領域の頂点配列オブジェクトを結合するだけで切り替える
+//      書き換えた範囲は領域ごとに覚えておき, その領域の番が来たときに手元の写しからその範囲だけを書き込む
+//      領域を書き込む前にはその領域を最後に描いたときのフェンスを待つ
+//  Orphan: 比較のためのバッファの孤立化 (glBufferData(NULL) で確保し直してから全体を転送する)
+class DynamicObject {
+public:
+
+    // 転送の方法
+    enum Mode {
+        Persistent,
+        Orphan
+    };
+
+private:
+
+    // 頂点の範囲
+    struct Span {
+        GLsizei first, count;
+    };
+
+    // 領域ごとのデータ
+    struct Region {
+        // 頂点配列オブジェクト名
+        GLuint vao;
+
+        // この領域を最後に描いたときのフェンス
+        GLsync fence;
+
+        // この領域にまだ書き込んでいない範囲
+        std::vector<Span> dirty;
+    };
+
+    // 転送の方法
+    const Mode mode;
+
+    // 基本図形の種類
+    const GLenum primitive;
+
+    // 頂点の数とインデックスの数
+    const GLsizei vertexcount, indexcount;
+
+    // 頂点バッファオブジェクトとインデックスのバッファオブジェクト
+    GLuint vbo, ibo;
+
+    // 頂点の手元の写し
+    std::vector<Object::Vertex> vertex;
+
+    // 領域
+    std::vector<Region> region;
+
+    // 永続マップしたバッファの先頭 (Orphan では NULL)
+    Object::Vertex *mapped;
+
+    // 描画する領域
+    std::size_t current;
+
+    // 頂点属性の指定
+    //  offset: バッファオブジェクトの先頭からの頂点の位置
+    void attribute(GLint size, std::size_t offset) const {
+        const Object::Vertex *const base(static_cast<const Object::Vertex *>(0) + offset);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glVertexAttribPointer(0, size, GL_FLOAT, GL_FALSE, sizeof (Object::Vertex), base->position);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof (Object::Vertex), base->normal);
+        glEnableVertexAttribArray(1);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    }
+
+public:
+
+    // コンストラクタ
+    //  mode: 転送の方法
+    //  primitive: 基本図形の種類
+    //  size: 頂点の位置の次元
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列 (最初の内容)
+    //  indexcount: 頂点のインデックスの要素数
+    //  index: 頂点のインデックスを格納した配列
+    //  regions: Persistent で使う領域の数
+    DynamicObject(Mode mode, GLenum primitive,
+        GLint size, GLsizei vertexcount, const Object::Vertex *vertex,
+        GLsizei indexcount, const GLuint *index, int regions = 3)
+        : mode(mode), primitive(primitive), vertexcount(vertexcount), indexcount(indexcount)
+        , vertex(vertex, vertex + vertexcount), region(mode == Persistent ? std::max(regions, 1) : 1)
+        , mapped(NULL), current(0)
+    {
+        const GLsizeiptr bytes(vertexcount * sizeof (Object::Vertex));
+
+        // インデックスは変わらない
+        glGenBuffers(1, &ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexcount * sizeof (GLuint), index, GL_STATIC_DRAW);
+
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        if (mode == Persistent) {
+            // 明示的に書き込んだ範囲を知らせるので一貫性は要らない
+            const GLbitfield flags(GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+            glBufferStorage(GL_ARRAY_BUFFER, bytes * region.size(), NULL, flags);
+            mapped = static_cast<Object::Vertex *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes * region.size(), flags));
+            if (mapped == NULL) printf("Error : Can't map the dynamic vertex buffer.\n");
+        }
+        else {
+            glBufferData(GL_ARRAY_BUFFER, bytes, vertex, GL_STREAM_DRAW);
+        }
+
+        // 領域ごとに頂点配列オブジェクトを作る (最初は全体が書き込まれていない)
+        for (std::size_t i = 0; i < region.size(); ++i) {
+            Region &r(region[i]);
+            r.fence = 0;
+            glGenVertexArrays(1, &r.vao);
+            glBindVertexArray(r.vao);
+            attribute(size, i * vertexcount);
+            if (mode == Persistent) r.dirty.push_back(Span{ 0, vertexcount });
+        }
+        glBindVertexArray(0);
+    }
+
+    // デストラクタ
+    //  GPU が使い終わってから削除するように DeletionQueue に預ける
+    virtual ~DynamicObject() {
+        DeletionQueue &queue(DeletionQueue::instance());
+        for (Region &r : region) {
+            if (r.fence) glDeleteSync(r.fence);
+            queue.vertexArray(r.vao);
+        }
+        if (mapped) {
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        queue.buffer(vbo);
+        queue.buffer(ibo);
+    }
+
+    // 頂点の範囲を書き換えるために手元の写しを取り出す
+    //  書き換えた範囲は次の commit から各領域に順に書き込まれる
+    //  first: 先頭の頂点の番号
+    //  count: 頂点の数
+    //  戻り値: 手元の写しの first 番目の頂点 (count 個まで書き込んで良い)
+    Object::Vertex *edit(GLsizei first, GLsizei count) {
+        first = std::min(std::max(first, 0), vertexcount);
+        count = std::min(std::max(count, 0), vertexcount - first);
+        if (count > 0 && mode == Persistent) {
+            for (Region &r : region) r.dirty.push_back(Span{ first, count });
+        }
+        return vertex.data() + first;
+    }
+
+    // 頂点の範囲を書き換える
+    //  first: 先頭の頂点の番号
+    //  count: 頂点の数
+    //  v: 新しい頂点属性
+    void update(GLsizei first, GLsizei count, const Object::Vertex *v) {
+        if (first < 0 || count <= 0 || first + count > vertexcount) {
+            printf("Error : Vertex range out of bounds: %d + %d\n", first, count);
+            return;
+        }
+        std::memcpy(edit(first, count), v, count * sizeof (Object::Vertex));
+    }
+
+    // 書き換えた頂点を次の領域に転送してそれを描画に使う (フレームに一度, 描画の前に呼ぶ)
+    //  戻り値: 転送したバイト数
+    GLsizeiptr commit() {
+        if (mode == Orphan) {
+            // 確保し直して全体を転送する
+            const GLsizeiptr bytes(vertexcount * sizeof (Object::Vertex));
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, vertex.data());
+            return bytes;
+        }
+        if (mapped == NULL) return 0;
+
+        // 次の領域の GPU の読み出しの終わりを待つ
+        current = (current + 1) % region.size();
+        Region &r(region[current]);
+        if (r.fence) {
+            while (glClientWaitSync(r.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+            glDeleteSync(r.fence);
+            r.fence = 0;
+        }
+        if (r.dirty.empty()) return 0;
+
+        // 重なったり接したりする範囲をまとめて書き込む
+        std::sort(r.dirty.begin(), r.dirty.end(), [](const Span &a, const Span &b) { return a.first < b.first; });
+        Object::Vertex *const base(mapped + current * vertexcount);
+        const GLintptr offset(static_cast<GLintptr>(current * vertexcount * sizeof (Object::Vertex)));
+        GLsizeiptr written(0);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        for (std::size_t i = 0; i < r.dirty.size();) {
+            const GLsizei first(r.dirty[i].first);
+            GLsizei last(first + r.dirty[i].count);
+            std::size_t j(i + 1);
+            for (; j < r.dirty.size() && r.dirty[j].first <= last; ++j) {
+                last = std::max(last, r.dirty[j].first + r.dirty[j].count);
+            }
+            const GLsizeiptr bytes((last - first) * sizeof (Object::Vertex));
+            std::memcpy(base + first, vertex.data() + first, bytes);
+            glFlushMappedBufferRange(GL_ARRAY_BUFFER, offset + first * sizeof (Object::Vertex), bytes);
+            written += bytes;
+            i = j;
+        }
+        r.dirty.clear();
+        return written;
+    }
+
+    // 描画
+    //  material: 材質番号 (シェーダには gl_BaseInstance で渡る)
+    void draw(GLuint material = 0) {
+        Region &r(region[current]);
+        glBindVertexArray(r.vao);
+        glDrawElementsInstancedBaseInstance(primitive, indexcount, GL_UNSIGNED_INT, 0, 1, material);
+        glBindVertexArray(0);
+
+        // この領域を次に書き込むときに待つフェンス
+        if (mode == Persistent) {
+            if (r.fence) glDeleteSync(r.fence);
+            r.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+    }
+
+    // 転送の方法
+    Mode getMode() const { return mode; }
+
+    // 頂点の数
+    GLsizei getVertexCount() const { return vertexcount; }
+
+    // 頂点の手元の写し
+    const Object::Vertex *getVertex() const { return vertex.data(); }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    DynamicObject(const DynamicObject &o);
+
+    // 代入によるコピー禁止
+    DynamicObject &operator=(const DynamicObject &o);
+};
@@ -0,0 +1,207 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+
+// 図形データ
+#include "Object.h"
+
+// インデックスを使った図形の描画
+#include "ShapeIndex.h"
+
+// 並列処理
+#include "ThreadPool.h"
+
+// 三角形の辺の抽出
+//  三角形の各辺を小さい方と大きい方の頂点番号を並べた 64 ビットのキーにして基数ソートし,
+//  同じキーの並びを一つにまとめて線分のインデックスにする
+//  辺は頂点番号で比べるので, 位置が同じで法線の違う頂点を持つ図形は先に Weld で位置だけを溶接しておく
+class Edge {
+    // 基数ソートの一桁のビット数 (頂点番号が 24 ビットに収まれば 4 回で並べ終わる)
+    static const int radixBits = 12;
+
+    // 一桁の値の数
+    static const std::size_t radix = std::size_t(1) << radixBits;
+
+    // 並列処理の分割の大きさ
+    static const std::size_t grain = std::size_t(1) << 16;
+
+    // 基数ソートの分割の大きさ (分割ごとの度数分布が大きいので粗く分ける)
+    static const std::size_t sortGrain = std::size_t(1) << 18;
+
+    // キーを安定に基数ソートする (payload が空でなければ一緒に並べ替える)
+    //  key: キー
+    //  payload: キーに付随する値
+    //  bits: キーの有効なビット数
+    static void sort(std::vector<std::uint64_t> &key, std::vector<GLuint> &payload, int bits) {
+        ThreadPool &pool(ThreadPool::instance());
+        const std::size_t count(key.size());
+        const std::size_t chunks((count + sortGrain - 1) / sortGrain);
+        const bool carry(!payload.empty());
+        std::vector<std::uint64_t> keyTemp(count);
+        std::vector<GLuint> payloadTemp(carry ? count : 0);
+        std::vector<std::size_t> histogram(chunks * radix);
+
+        for (int shift = 0; shift < bits; shift += radixBits) {
+            // 分割ごとに桁の値を数える
+            std::fill(histogram.begin(), histogram.end(), std::size_t(0));
+            pool.parallelFor(count, sortGrain, [&](std::size_t begin, std::size_t end) {
+                std::size_t *const h(histogram.data() + begin / sortGrain * radix);
+                for (std::size_t i = begin; i < end; ++i) ++h[(key[i] >> shift) & (radix - 1)];
+            });
+
+            // 桁の値ごと, その中で分割ごとの書き込み位置を決める
+            //  全てのキーがこの桁で同じ値なら並べ替えを省く
+            std::size_t sum(0);
+            bool same(false);
+            for (std::size_t d = 0; d < radix; ++d) {
+                std::size_t total(0);
+                for (std::size_t c = 0; c < chunks; ++c) {
+                    const std::size_t n(histogram[c * radix + d]);
+                    histogram[c * radix + d] = sum;
+                    sum += n;
+                    total += n;
+                }
+                if (total == count) same = true;
+            }
+            if (same) continue;
+
+            // 分割ごとに順に書き込むので並べ替えは安定になる
+            pool.parallelFor(count, sortGrain, [&](std::size_t begin, std::size_t end) {
+                std::size_t *const h(histogram.data() + begin / sortGrain * radix);
+                for (std::size_t i = begin; i < end; ++i) {
+                    const std::size_t at(h[(key[i] >> shift) & (radix - 1)]++);
+                    keyTemp[at] = key[i];
+                    if (carry) payloadTemp[at] = payload[i];
+                }
+            });
+            key.swap(keyTemp);
+            payload.swap(payloadTemp);
+        }
+    }
+
+    // 三角形の単位法線ベクトルを求める (面積がなければ 0)
+    //  vertex: 頂点属性を格納した配列
+    //  index: 三角形の頂点のインデックス
+    //  n: 法線ベクトル
+    static void faceNormal(const Object::Vertex *vertex, const GLuint *index, GLfloat *n) {
+        const GLfloat *const a(vertex[index[0]].position);
+        const GLfloat *const b(vertex[index[1]].position);
+        const GLfloat *const c(vertex[index[2]].position);
+        const GLfloat u[] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        const GLfloat v[] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        n[0] = u[1] * v[2] - u[2] * v[1];
+        n[1] = u[2] * v[0] - u[0] * v[2];
+        n[2] = u[0] * v[1] - u[1] * v[0];
+        const GLfloat l(std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]));
+        const GLfloat s(l > 0.0f ? 1.0f / l : 0.0f);
+        n[0] *= s;
+        n[1] *= s;
+        n[2] *= s;
+    }
+
+public:
+
+    // 三角形の辺を重複なく取り出す
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列 (featureAngle が負なら参照しない)
+    //  indexcount: 三角形の頂点のインデックスの要素数
+    //  index: 三角形の頂点のインデックスを格納した配列
+    //  featureAngle: 負なら全ての辺, 0 以上なら隣り合う二つの三角形の法線のなす角がこれ (度) を超える辺と,
+    //      三角形が一つしかない境界の辺, 三つ以上ある非多様体の辺だけを残す
+    //  戻り値: GL_LINES で描く線分のインデックス
+    static std::vector<GLuint> extract(
+        GLsizei vertexcount, const Object::Vertex *vertex,
+        GLsizei indexcount, const GLuint *index,
+        GLfloat featureAngle = -1.0f) {
+        std::vector<GLuint> line;
+        const std::size_t triangles(indexcount > 0 && index != NULL ? indexcount / 3 : 0);
+        if (vertexcount <= 0 || triangles == 0) return line;
+
+        ThreadPool &pool(ThreadPool::instance());
+        const bool feature(featureAngle >= 0.0f && vertex != NULL);
+
+        // 頂点番号のビット数 (キーはその二倍のビット数に収まる)
+        int bits(1);
+        while (bits < 32 && (static_cast<std::uint64_t>(vertexcount - 1) >> bits) != 0) ++bits;
+
+        // 各辺のキーと, 特徴辺を選ぶときは辺を含む三角形の番号を作る
+        const std::size_t count(triangles * 3);
+        std::vector<std::uint64_t> key(count);
+        std::vector<GLuint> face(feature ? count : 0);
+        pool.parallelFor(triangles, grain / 3, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t t = begin; t < end; ++t) {
+                const GLuint *const f(index + t * 3);
+                for (int k = 0; k < 3; ++k) {
+                    const std::uint64_t a(f[k]), b(f[k == 2 ? 0 : k + 1]);
+                    key[t * 3 + k] = a < b ? a << bits | b : b << bits | a;
+                    if (feature) face[t * 3 + k] = static_cast<GLuint>(t);
+                }
+            }
+        });
+        sort(key, face, bits * 2);
+
+        // 隣り合う三角形の法線のなす角の余弦がこれより小さければ特徴辺
+        const GLfloat threshold(std::cos(featureAngle * 3.14159265f / 180.0f));
+
+        // 同じキーの並びの先頭を代表とし, 残すかどうかを決める
+        //  並びは分割の境界をまたいでも先頭のある分割が最後まで調べる
+        const std::size_t chunks((count + grain - 1) / grain);
+        std::vector<std::size_t> offset(chunks + 1, 0);
+        std::vector<unsigned char> keep(count, 0);
+        pool.parallelFor(count, grain, [&](std::size_t begin, std::size_t end) {
+            std::size_t n(0);
+            for (std::size_t i = begin; i < end; ++i) {
+                if (i > 0 && key[i] == key[i - 1]) continue;
+                bool k(true);
+                if (feature) {
+                    std::size_t j(i + 1);
+                    while (j < count && key[j] == key[i]) ++j;
+                    if (j - i == 2) {
+                        GLfloat a[3], b[3];
+                        faceNormal(vertex, index + face[i] * 3, a);
+                        faceNormal(vertex, index + face[i + 1] * 3, b);
+                        k = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] < threshold;
+                    }
+                }
+                keep[i] = k;
+                n += k;
+            }
+            offset[begin / grain + 1] = n;
+        });
+        for (std::size_t c = 0; c < chunks; ++c) offset[c + 1] += offset[c];
+
+        // 残す辺を詰めて線分のインデックスにする
+        const std::uint64_t mask((std::uint64_t(1) << bits) - 1);
+        line.resize(offset[chunks] * 2);
+        pool.parallelFor(count, grain, [&](std::size_t begin, std::size_t end) {
+            std::size_t n(offset[begin / grain] * 2);
+            for (std::size_t i = begin; i < end; ++i) {
+                if (!keep[i]) continue;
+                line[n++] = static_cast<GLuint>(key[i] >> bits);
+                line[n++] = static_cast<GLuint>(key[i] & mask);
+            }
+        });
+
+        return line;
+    }
+
+    // 三角形の図形の辺を線分で描く図形を作る
+    //  size: 頂点の位置の次元
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列
+    //  indexcount: 三角形の頂点のインデックスの要素数
+    //  index: 三角形の頂点のインデックスを格納した配列
+    //  featureAngle: 負なら全ての辺, 0 以上ならこの角度 (度) を超えて折れ曲がる辺と境界の辺だけ
+    static std::unique_ptr<ShapeIndex> shapeIndex(
+        GLint size, GLsizei vertexcount, const Object::Vertex *vertex,
+        GLsizei indexcount, const GLuint *index,
+        GLfloat featureAngle = -1.0f) {
+        const std::vector<GLuint> line(extract(vertexcount, vertex, indexcount, index, featureAngle));
+
+        return std::unique_ptr<ShapeIndex>(new ShapeIndex(size, vertexcount, vertex,
+            static_cast<GLsizei>(line.size()), line.data()));
+    }
+};
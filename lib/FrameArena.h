@@ -0,0 +1,170 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// フレームごとに使い捨てるデータの線形アロケータ
+//  N フレーム分の領域を持ち、あるフレームで確保した領域は N - 1 フレーム後まで使える
+class FrameArena {
+    // 確保したメモリの塊
+    struct Block {
+        char *data;
+        std::size_t size;
+    };
+
+    // 1 フレーム分の領域
+    struct Frame {
+        // 確保したメモリの塊 (末尾が使用中)
+        std::vector<Block> block;
+
+        // 末尾の塊の使用量
+        std::size_t used;
+
+        // このフレームで使った量の合計
+        std::size_t total;
+    };
+
+    // フレームごとの領域
+    std::vector<Frame> frame;
+
+    // 現在のフレーム
+    std::size_t current;
+
+    // 新しく確保する塊の最小の大きさ
+    const std::size_t blockSize;
+
+    // このフレームで塊を確保した回数
+    std::size_t heapAllocations;
+
+    // メモリの塊を確保して末尾に追加する
+    void grow(Frame &f, std::size_t size) {
+        Block b;
+        b.size = size;
+        b.data = new char[size];
+        f.block.push_back(b);
+        f.used = 0;
+        ++heapAllocations;
+    }
+
+    // 領域を空にする
+    //  溢れて塊をつないだ場合は一つの大きな塊にまとめ、次から溢れないようにする
+    void reset(Frame &f) {
+        if (f.block.size() > 1) {
+            std::size_t size(0);
+            for (const Block &b : f.block) {
+                size += b.size;
+                delete[] b.data;
+            }
+            f.block.clear();
+            grow(f, size);
+        }
+        f.used = 0;
+        f.total = 0;
+    }
+
+public:
+
+    // コンストラクタ
+    //  blockSize: 1 フレーム分の最初の領域の大きさ
+    //  frames: 同時に保持するフレームの数
+    FrameArena(std::size_t blockSize = 1 << 20, unsigned int frames = 2)
+        : frame(frames > 0 ? frames : 1), current(0), blockSize(blockSize), heapAllocations(0)
+    {
+        for (Frame &f : frame) {
+            f.block.reserve(16);
+            grow(f, blockSize);
+            f.total = 0;
+        }
+    }
+
+    // デストラクタ
+    virtual ~FrameArena() {
+        for (Frame &f : frame) {
+            for (const Block &b : f.block) delete[] b.data;
+        }
+    }
+
+    // 次のフレームに切り替えて、その領域を O(1) で解放する
+    void beginFrame() {
+        current = (current + 1) % frame.size();
+        heapAllocations = 0;
+        reset(frame[current]);
+    }
+
+    // 領域を確保する
+    //  size: 大きさ
+    //  align: アラインメント (2 のべき乗)
+    void *allocate(std::size_t size, std::size_t align = alignof(std::max_align_t)) {
+        Frame &f(frame[current]);
+        Block *b(&f.block.back());
+        std::uintptr_t base(reinterpret_cast<std::uintptr_t>(b->data));
+        std::size_t offset(((base + f.used + align - 1) & ~(align - 1)) - base);
+
+        // 溢れたら新しい塊をつなぐ
+        if (offset + size > b->size) {
+            grow(f, std::max(blockSize, size + align));
+            b = &f.block.back();
+            base = reinterpret_cast<std::uintptr_t>(b->data);
+            offset = ((base + align - 1) & ~(align - 1)) - base;
+        }
+
+        f.total += offset - f.used + size;
+        f.used = offset + size;
+        return b->data + offset;
+    }
+
+    // 型を指定して領域を確保する
+    //  count: 要素数
+    template<typename T>
+    T *allocate(std::size_t count) {
+        return static_cast<T *>(allocate(count * sizeof (T), alignof(T)));
+    }
+
+    // このフレームで使った量
+    std::size_t getUsed() const { return frame[current].total; }
+
+    // このフレームでメモリの塊を確保した回数
+    std::size_t getHeapAllocations() const { return heapAllocations; }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    FrameArena(const FrameArena &a);
+
+    // 代入によるコピー禁止
+    FrameArena &operator=(const FrameArena &a);
+};
+
+// FrameArena から確保する STL 互換のアロケータ
+//  解放は何もせず、フレームの切り替えでまとめて解放する
+template<typename T>
+class ArenaAllocator {
+    template<typename U> friend class ArenaAllocator;
+
+    // 確保に使うアリーナ
+    FrameArena *arena;
+
+public:
+    using value_type = T;
+
+    // コンストラクタ
+    //  arena: 確保に使うアリーナ
+    ArenaAllocator(FrameArena &arena) : arena(&arena) {}
+
+    // 別の型のアロケータからの変換
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &a) : arena(a.arena) {}
+
+    T *allocate(std::size_t n) { return arena->allocate<T>(n); }
+    void deallocate(T *, std::size_t) {}
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U> &a) const { return arena == a.arena; }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U> &a) const { return arena != a.arena; }
+};
+
+// フレームの間だけ使う可変長配列
+template<typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,417 @@
+#pragma once
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <condition_variable>
+#include <GL/glew.h>
+
+// ワーカースレッドによる並列処理
+#include "ThreadPool.h"
+
+// 描いたフレームの画像の書き出し
+//  glReadPixels をピクセルバッファオブジェクトに行わせてフェンスで完了を待たずに戻り、
+//  読み出しが終わったものをワーカースレッドで画像ファイルか Y4M のストリームにする
+//  ピクセルバッファオブジェクトは永続的にマップしておき、ワーカースレッドが直接読む
+//  全てのスロットが使用中のときは policy にしたがってフレームを捨てるか空くまで待つ
+class FrameExport {
+public:
+
+    // 書き出す形式
+    enum Format {
+        Ppm,    // 連番の PPM (P6)
+        Png,    // 連番の PNG (圧縮しない)
+        Y4m     // 一つの YUV4MPEG2 (4:2:0) のストリーム
+    };
+
+    // スロットが空いていないときの扱い
+    enum Policy {
+        Drop,   // フレームを捨てる
+        Block   // 空くまで待つ
+    };
+
+private:
+
+    // 読み出しのスロット
+    struct Slot {
+        // ピクセルバッファオブジェクト名と永続的にマップした領域
+        GLuint pbo;
+        const GLubyte *pixels;
+
+        // 読み出しの完了を待つフェンス (待っていなければ 0)
+        GLsync fence;
+
+        // フレーム番号
+        GLuint frame;
+
+        // ワーカースレッドが書き出し中なら true
+        std::atomic<bool> busy;
+    };
+    std::vector<Slot> slot;
+
+    // 次に使うスロット
+    std::size_t next;
+
+    // 書き出し先 (連番のファイル名の前半か Y4M のファイル名) と形式
+    const std::string path;
+    const Format format;
+    const Policy policy;
+
+    // フレームレート (Y4M のヘッダに書く)
+    const GLuint fps;
+
+    // ピクセルバッファオブジェクトを確保した画像の大きさ
+    GLsizei width, height;
+
+    // Y4M のストリームと次に書き出すフレーム番号
+    FILE *stream;
+    GLuint turn;
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    // 読み出したフレーム、捨てたフレーム、書き出したフレームの数
+    GLuint captured, dropped;
+    std::atomic<GLuint> written;
+
+    // CRC-32 の表
+    static const std::uint32_t *crcTable() {
+        struct Table {
+            std::uint32_t value[256];
+            Table() {
+                for (std::uint32_t n = 0; n < 256; ++n) {
+                    std::uint32_t c(n);
+                    for (int k = 0; k < 8; ++k) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                    value[n] = c;
+                }
+            }
+        };
+        static const Table table;
+        return table.value;
+    }
+
+    // CRC-32 を更新する
+    static std::uint32_t crc(std::uint32_t c, const GLubyte *p, std::size_t n) {
+        const std::uint32_t *const table(crcTable());
+        c = ~c;
+        for (std::size_t i = 0; i < n; ++i) c = table[(c ^ p[i]) & 0xff] ^ (c >> 8);
+        return ~c;
+    }
+
+    // 32 ビットをビッグエンディアンで追加する
+    static void putBig(std::vector<GLubyte> &b, std::uint32_t v) {
+        const GLubyte bytes[] = {
+            static_cast<GLubyte>(v >> 24), static_cast<GLubyte>(v >> 16),
+            static_cast<GLubyte>(v >> 8), static_cast<GLubyte>(v)
+        };
+        b.insert(b.end(), bytes, bytes + 4);
+    }
+
+    // PNG のチャンクを追加する
+    static void chunk(std::vector<GLubyte> &b, const char *type, const GLubyte *data, std::size_t n) {
+        putBig(b, static_cast<std::uint32_t>(n));
+        const std::size_t start(b.size());
+        b.insert(b.end(), type, type + 4);
+        b.insert(b.end(), data, data + n);
+        putBig(b, crc(0, &b[start], n + 4));
+    }
+
+    // 上下を反転して RGB の行を取り出す (glReadPixels は下の行から並ぶ)
+    void row(const GLubyte *pixels, GLsizei y, GLubyte *rgb) const {
+        const GLubyte *const src(pixels + static_cast<std::size_t>(height - 1 - y) * width * 4);
+        for (GLsizei x = 0; x < width; ++x) {
+            rgb[3 * x] = src[4 * x];
+            rgb[3 * x + 1] = src[4 * x + 1];
+            rgb[3 * x + 2] = src[4 * x + 2];
+        }
+    }
+
+    // PPM 形式にする
+    void encodePpm(const GLubyte *pixels, std::vector<GLubyte> &out) const {
+        char header[64];
+        const int n(snprintf(header, sizeof header, "P6\n%d %d\n255\n", width, height));
+        out.assign(header, header + n);
+        out.resize(n + static_cast<std::size_t>(width) * height * 3);
+        for (GLsizei y = 0; y < height; ++y) row(pixels, y, &out[n + static_cast<std::size_t>(y) * width * 3]);
+    }
+
+    // PNG 形式にする (zlib の無圧縮ブロックを使う)
+    void encodePng(const GLubyte *pixels, std::vector<GLubyte> &out) const {
+        // 各行の先頭にフィルタの種類 (0) を置いた画像データ
+        const std::size_t stride(static_cast<std::size_t>(width) * 3 + 1);
+        std::vector<GLubyte> raw(stride * height);
+        for (GLsizei y = 0; y < height; ++y) {
+            raw[y * stride] = 0;
+            row(pixels, y, &raw[y * stride + 1]);
+        }
+
+        // 65535 バイトずつの無圧縮ブロックと Adler-32
+        std::vector<GLubyte> z = { 0x78, 0x01 };
+        z.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+        for (std::size_t i = 0; i < raw.size(); i += 65535) {
+            const std::size_t n(std::min<std::size_t>(65535, raw.size() - i));
+            z.push_back(i + n == raw.size() ? 1 : 0);
+            z.push_back(static_cast<GLubyte>(n));
+            z.push_back(static_cast<GLubyte>(n >> 8));
+            z.push_back(static_cast<GLubyte>(~n));
+            z.push_back(static_cast<GLubyte>(~n >> 8));
+            z.insert(z.end(), raw.begin() + i, raw.begin() + i + n);
+        }
+        std::uint32_t a(1), b(0);
+        for (std::size_t i = 0; i < raw.size();) {
+            // 5552 バイトまではあふれない
+            const std::size_t end(std::min(raw.size(), i + 5552));
+            for (; i < end; ++i) {
+                a += raw[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        putBig(z, b << 16 | a);
+
+        static const GLubyte signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        out.assign(signature, signature + sizeof signature);
+        std::vector<GLubyte> ihdr;
+        putBig(ihdr, width);
+        putBig(ihdr, height);
+        const GLubyte format[] = { 8, 2, 0, 0, 0 };
+        ihdr.insert(ihdr.end(), format, format + sizeof format);
+        chunk(out, "IHDR", ihdr.data(), ihdr.size());
+        chunk(out, "IDAT", z.data(), z.size());
+        chunk(out, "IEND", NULL, 0);
+    }
+
+    // Y4M の 1 フレーム (BT.601 の 4:2:0) にする
+    void encodeY4m(const GLubyte *pixels, std::vector<GLubyte> &out) const {
+        static const char header[] = "FRAME\n";
+        const std::size_t n(sizeof header - 1);
+        const GLsizei cw((width + 1) / 2), ch((height + 1) / 2);
+        const std::size_t luma(static_cast<std::size_t>(width) * height), chroma(static_cast<std::size_t>(cw) * ch);
+        out.assign(header, header + n);
+        out.resize(n + luma + 2 * chroma);
+        GLubyte *const py(&out[n]), *const pu(py + luma), *const pv(pu + chroma);
+        for (GLsizei y = 0; y < height; ++y) {
+            const GLubyte *const src(pixels + static_cast<std::size_t>(height - 1 - y) * width * 4);
+            for (GLsizei x = 0; x < width; ++x) {
+                const int r(src[4 * x]), g(src[4 * x + 1]), b(src[4 * x + 2]);
+                py[static_cast<std::size_t>(y) * width + x] = static_cast<GLubyte>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            }
+        }
+
+        // 色差は 2x2 画素の平均から求める
+        for (GLsizei y = 0; y < ch; ++y) {
+            for (GLsizei x = 0; x < cw; ++x) {
+                int r(0), g(0), b(0);
+                for (int k = 0; k < 4; ++k) {
+                    const GLsizei sx(std::min(width - 1, 2 * x + (k & 1)));
+                    const GLsizei sy(std::min(height - 1, 2 * y + (k >> 1)));
+                    const GLubyte *const p(pixels + (static_cast<std::size_t>(height - 1 - sy) * width + sx) * 4);
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                }
+                r /= 4;
+                g /= 4;
+                b /= 4;
+                pu[static_cast<std::size_t>(y) * cw + x] = static_cast<GLubyte>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                pv[static_cast<std::size_t>(y) * cw + x] = static_cast<GLubyte>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+            }
+        }
+    }
+
+    // ワーカースレッドでスロットの画像を書き出す
+    void write(Slot &s) {
+        std::vector<GLubyte> out;
+        switch (format) {
+        case Ppm:
+            encodePpm(s.pixels, out);
+            break;
+        case Png:
+            encodePng(s.pixels, out);
+            break;
+        case Y4m:
+            encodeY4m(s.pixels, out);
+            break;
+        }
+        const GLuint frame(s.frame);
+        s.busy.store(false, std::memory_order_release);
+
+        if (format == Y4m) {
+            // ストリームにはフレームの順に書く
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&] { return turn == frame; });
+            fwrite(out.data(), 1, out.size(), stream);
+            ++turn;
+            condition.notify_all();
+        }
+        else {
+            char name[32];
+            snprintf(name, sizeof name, "%06u.%s", frame, format == Png ? "png" : "ppm");
+            const std::string filename(path + name);
+            FILE *const file(fopen(filename.c_str(), "wb"));
+            if (file == NULL) {
+                printf("Error : Can't open %s\n", filename.c_str());
+                return;
+            }
+            fwrite(out.data(), 1, out.size(), file);
+            fclose(file);
+        }
+        written.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // 読み出しの終わったスロットをワーカースレッドに渡す
+    //  wait: 読み出しが終わるまで待つなら true
+    //  戻り値: 読み出し中でなければ true
+    bool poll(Slot &s, bool wait) {
+        if (s.fence == 0) return true;
+        const GLenum status(glClientWaitSync(s.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+            wait ? GL_TIMEOUT_IGNORED : 0));
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+        glDeleteSync(s.fence);
+        s.fence = 0;
+        s.busy.store(true, std::memory_order_release);
+        Slot *const p(&s);
+        ThreadPool::instance().submit([this, p] { write(*p); });
+        return true;
+    }
+
+    // 古いスロットから順に渡す (Y4M はフレームの順に書くので追い越さない)
+    //  wait: 読み出しが終わるまで待つなら true
+    void pollAll(bool wait) {
+        for (std::size_t i = 0; i < slot.size(); ++i) {
+            if (!poll(slot[(next + i) % slot.size()], wait)) break;
+        }
+    }
+
+    // スロットが空くまで待つ
+    void drain(Slot &s) {
+        poll(s, true);
+        while (s.busy.load(std::memory_order_acquire)) std::this_thread::yield();
+    }
+
+    // ピクセルバッファオブジェクトを確保し直す
+    void allocate(GLsizei w, GLsizei h) {
+        release();
+        width = w;
+        height = h;
+        const GLbitfield flags(GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+        const GLsizeiptr size(static_cast<GLsizeiptr>(w) * h * 4);
+        for (Slot &s : slot) {
+            glGenBuffers(1, &s.pbo);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+            glBufferStorage(GL_PIXEL_PACK_BUFFER, size, NULL, flags);
+            s.pixels = static_cast<const GLubyte *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, flags));
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        if (format == Y4m && stream == NULL) {
+            stream = fopen(path.c_str(), "wb");
+            if (stream == NULL) {
+                printf("Error : Can't open %s\n", path.c_str());
+                return;
+            }
+            fprintf(stream, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C420jpeg\n", w, h, fps);
+        }
+    }
+
+    // 全てのスロットの書き出しを待ってピクセルバッファオブジェクトを削除する
+    void release() {
+        pollAll(true);
+        for (Slot &s : slot) {
+            drain(s);
+            if (s.pbo == 0) continue;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glDeleteBuffers(1, &s.pbo);
+            s.pbo = 0;
+            s.pixels = NULL;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+public:
+
+    // コンストラクタ
+    //  path: Ppm と Png なら連番のファイル名の前半、Y4m ならファイル名
+    //  format: 書き出す形式
+    //  policy: スロットが空いていないときの扱い
+    //  slots: 読み出しのスロットの数 (2 か 3 くらい)
+    //  fps: Y4M に書くフレームレート
+    FrameExport(const std::string &path, Format format, Policy policy = Drop, GLuint slots = 3, GLuint fps = 60)
+        : slot(slots > 0 ? slots : 1), next(0), path(path), format(format), policy(policy), fps(fps)
+        , width(0), height(0), stream(NULL), turn(0), captured(0), dropped(0), written(0)
+    {
+        for (Slot &s : slot) {
+            s.pbo = 0;
+            s.pixels = NULL;
+            s.fence = 0;
+            s.frame = 0;
+            s.busy.store(false);
+        }
+    }
+
+    // デストラクタ
+    //  読み出し中と書き出し中のフレームを全て書き出してから終わる
+    virtual ~FrameExport() {
+        release();
+        if (stream) fclose(stream);
+        printf("export: %u captured, %u written, %u dropped\n", captured, written.load(), dropped);
+    }
+
+    // 今のフレームバッファのビューポートの範囲を読み出す (バッファを入れ替える前に呼ぶ)
+    void capture() {
+        // 読み出しの終わったスロットを先に渡しておく
+        pollAll(false);
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        if (viewport[2] <= 0 || viewport[3] <= 0) return;
+        if (viewport[2] != width || viewport[3] != height) {
+            // Y4M のストリームの途中では大きさを変えられない
+            if (format == Y4m && stream) {
+                ++dropped;
+                return;
+            }
+            allocate(viewport[2], viewport[3]);
+        }
+
+        // 空いていなければ捨てるか待つ
+        Slot &s(slot[next]);
+        if (s.fence || s.busy.load(std::memory_order_acquire)) {
+            if (policy == Drop) {
+                ++dropped;
+                return;
+            }
+            drain(s);
+        }
+        next = (next + 1) % slot.size();
+
+        // ピクセルバッファオブジェクトに読み出してフェンスを置く
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+        glReadPixels(viewport[0], viewport[1], width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        s.frame = captured++;
+    }
+
+    // 読み出したフレームの数
+    GLuint getCaptured() const { return captured; }
+
+    // 捨てたフレームの数
+    GLuint getDropped() const { return dropped; }
+
+    // 書き出したフレームの数
+    GLuint getWritten() const { return written.load(std::memory_order_relaxed); }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    FrameExport(const FrameExport &e);
+
+    // 代入によるコピー禁止
+    FrameExport &operator=(const FrameExport &e);
+};
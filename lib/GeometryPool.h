@@ -0,0 +1,199 @@
+#pragma once
+#include <stdio.h>
+#include <GL/glew.h>
+
+// 図形データ
+#include "Object.h"
+
+// 連続した領域の部分割り当て
+#include "RangeAllocator.h"
+
+// 複数の図形で共有する頂点バッファとインデックスバッファ
+//  頂点配列オブジェクトは一つだけなので図形を切り替えても結合し直さなくてよい
+class GeometryPool {
+    // 頂点配列オブジェクト名
+    GLuint vao;
+
+    // 頂点バッファオブジェクト名
+    GLuint vbo;
+
+    // インデックスの頂点バッファオブジェクト
+    GLuint ibo;
+
+    // 頂点の位置の次元
+    const GLint size;
+
+    // 頂点とインデックスの割り当て
+    RangeAllocator vertexRange, indexRange;
+
+    // 頂点バッファオブジェクトを in 変数から参照できるようにする
+    void attach() const {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glVertexAttribPointer(
+            0, size, GL_FLOAT, GL_FALSE,
+            sizeof (Object::Vertex), static_cast<Object::Vertex *>(0)->position
+        );
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(
+            1, 3, GL_FLOAT, GL_FALSE,
+            sizeof (Object::Vertex), static_cast<Object::Vertex *>(0)->normal
+        );
+        glEnableVertexAttribArray(1);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    }
+
+    // バッファオブジェクトを広げて内容を写す
+    //  buffer: バッファオブジェクト名
+    //  oldSize: 今の大きさ
+    //  newSize: 新しい大きさ
+    static void resize(GLuint &buffer, GLsizeiptr oldSize, GLsizeiptr newSize) {
+        GLuint grown;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+        glDeleteBuffers(1, &buffer);
+        buffer = grown;
+    }
+
+    // 割り当てに失敗したら全体を倍々に広げてやり直す
+    //  range: 割り当て
+    //  buffer: バッファオブジェクト名
+    //  stride: 要素の大きさ
+    //  count: 要素数
+    GLuint allocate(RangeAllocator &range, GLuint &buffer, GLsizeiptr stride, GLuint count) {
+        if (count == 0) return RangeAllocator::invalid;
+        const GLuint offset(range.allocate(count));
+        if (offset != RangeAllocator::invalid) return offset;
+
+        const GLuint oldCapacity(range.getCapacity());
+        GLuint newCapacity(oldCapacity > 0 ? oldCapacity : 1);
+        while (newCapacity - oldCapacity < count) newCapacity *= 2;
+        resize(buffer, oldCapacity * stride, newCapacity * stride);
+        range.grow(newCapacity);
+        attach();
+
+        return range.allocate(count);
+    }
+
+public:
+
+    // 共有バッファ内の図形の位置
+    struct Mesh {
+        // 頂点の先頭位置
+        GLint baseVertex;
+
+        // インデックスの先頭位置
+        GLuint firstIndex;
+
+        // インデックスの数
+        GLsizei count;
+
+        // 頂点の数
+        GLsizei vertexcount;
+    };
+
+    // コンストラクタ
+    //  size: 頂点の位置の次元
+    //  vertexCapacity: 最初に確保する頂点の数
+    //  indexCapacity: 最初に確保するインデックスの数
+    GeometryPool(GLint size = 3, GLuint vertexCapacity = 1 << 16, GLuint indexCapacity = 1 << 18)
+        : size(size), vertexRange(vertexCapacity), indexRange(indexCapacity)
+    {
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertexCapacity * sizeof (Object::Vertex), NULL, GL_STATIC_DRAW);
+        glGenBuffers(1, &ibo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+        glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity * sizeof (GLuint), NULL, GL_STATIC_DRAW);
+        attach();
+    }
+
+    // デストラクタ
+    virtual ~GeometryPool() {
+        // 頂点配列オブジェクトを削除
+        glDeleteVertexArrays(1, &vao);
+
+        // 頂点バッファオブジェクトを削除
+        glDeleteBuffers(1, &vbo);
+
+        // インデックスの頂点バッファオブジェクトを削除
+        glDeleteBuffers(1, &ibo);
+    }
+
+    // 図形の領域を確保する (内容は後から書き込む)
+    //  vertexcount: 頂点の数
+    //  indexcount: 頂点のインデックスの要素数
+    //  戻り値: 確保した図形の位置 (失敗したら count が 0)
+    Mesh reserve(GLsizei vertexcount, GLsizei indexcount) {
+        Mesh mesh = { 0, 0, 0, 0 };
+        const GLuint v(allocate(vertexRange, vbo, sizeof (Object::Vertex), vertexcount));
+        const GLuint i(allocate(indexRange, ibo, sizeof (GLuint), indexcount));
+        if (v == RangeAllocator::invalid || i == RangeAllocator::invalid) {
+            printf("Error : Could not allocate geometry pool.\n");
+            vertexRange.free(v, vertexcount);
+            indexRange.free(i, indexcount);
+            return mesh;
+        }
+
+        mesh.baseVertex = static_cast<GLint>(v);
+        mesh.firstIndex = i;
+        mesh.count = indexcount;
+        mesh.vertexcount = vertexcount;
+        return mesh;
+    }
+
+    // 図形を追加する
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列
+    //  indexcount: 頂点のインデックスの要素数
+    //  index: 頂点のインデックスを格納した配列 (図形の先頭の頂点からの番号)
+    Mesh add(GLsizei vertexcount, const Object::Vertex *vertex, GLsizei indexcount, const GLuint *index) {
+        const Mesh mesh(reserve(vertexcount, indexcount));
+        if (mesh.count == 0) return mesh;
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, mesh.baseVertex * sizeof (Object::Vertex),
+            vertexcount * sizeof (Object::Vertex), vertex);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, mesh.firstIndex * sizeof (GLuint),
+            indexcount * sizeof (GLuint), index);
+        return mesh;
+    }
+
+    // 図形を取り除いて領域を空ける
+    //  mesh: add で得た図形の位置
+    void remove(const Mesh &mesh) {
+        if (mesh.count == 0) return;
+        vertexRange.free(static_cast<GLuint>(mesh.baseVertex), mesh.vertexcount);
+        indexRange.free(mesh.firstIndex, mesh.count);
+    }
+
+    // 頂点配列オブジェクトの結合
+    void bind() const {
+        glBindVertexArray(vao);
+    }
+
+    // 頂点バッファオブジェクト名 (広げると変わる)
+    GLuint getVertexBuffer() const { return vbo; }
+
+    // インデックスのバッファオブジェクト名 (広げると変わる)
+    GLuint getIndexBuffer() const { return ibo; }
+
+    // 頂点の割り当て
+    const RangeAllocator &getVertexRange() const { return vertexRange; }
+
+    // インデックスの割り当て
+    const RangeAllocator &getIndexRange() const { return indexRange; }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    GeometryPool(const GeometryPool &o);
+
+    // 代入によるコピー禁止
+    GeometryPool &operator=(const GeometryPool &o);
+};
@@ -0,0 +1,715 @@
+#pragma once
+#include <stdio.h>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <GL/glew.h>
+
+// 記録する GL の関数 (GLEW の関数ポインタを差し替える)
+#define GLCAPTURE_FUNCTIONS(X) \
+    X(GenBuffers) X(DeleteBuffers) X(BindBuffer) X(BufferData) X(BufferSubData) X(BufferStorage) \
+    X(MapBufferRange) X(UnmapBuffer) X(CopyBufferSubData) X(BindBufferBase) X(BindBufferRange) \
+    X(GenVertexArrays) X(DeleteVertexArrays) X(BindVertexArray) \
+    X(VertexAttribPointer) X(EnableVertexAttribArray) \
+    X(CreateShader) X(ShaderSource) X(CompileShader) X(DeleteShader) \
+    X(CreateProgram) X(AttachShader) X(DetachShader) X(BindAttribLocation) X(BindFragDataLocation) \
+    X(LinkProgram) X(DeleteProgram) X(UseProgram) X(GetUniformLocation) \
+    X(UniformMatrix4fv) X(Uniform3uiv) X(Uniform2fv) \
+    X(DrawArraysInstancedBaseInstance) X(DrawElementsInstancedBaseInstance) X(MultiDrawElementsIndirect) \
+    X(FenceSync) X(ClientWaitSync) X(DeleteSync) X(FlushMappedBufferRange)
+
+// GL のコマンド列の記録
+//  begin の後に GLEW の関数ポインタを通して呼んだ GL の関数を、引数とデータごとファイルに書き出す
+//  バッファオブジェクトに転送するデータはハッシュ値で重複を除き、一度だけ書き出す
+//  GL 1.1 の関数は GLEW を通らないので、glClear は clear を使い、
+//  それ以外の固定機能の状態 (ビューポートや背面カリングなど) は clear のたびに調べて変わっていれば書き出す
+//  記録したファイルは replay/ の glfwdraft_replay で再生する
+class GlCapture {
+public:
+
+    // コマンドの種類
+    enum Op : std::uint8_t {
+        Blob, Frame, State, Clear,
+        GenBuffers, DeleteBuffers, BindBuffer, BufferData, BufferSubData, BufferStorage,
+        MapBufferRange, UnmapBuffer, MappedWrite, CopyBufferSubData, BindBufferBase, BindBufferRange,
+        GenVertexArrays, DeleteVertexArrays, BindVertexArray,
+        VertexAttribPointer, EnableVertexAttribArray,
+        CreateShader, ShaderSource, CompileShader, DeleteShader,
+        CreateProgram, AttachShader, DetachShader, BindAttribLocation, BindFragDataLocation,
+        LinkProgram, DeleteProgram, UseProgram, GetUniformLocation,
+        UniformMatrix4fv, Uniform3uiv, Uniform2fv,
+        DrawArraysInstancedBaseInstance, DrawElementsInstancedBaseInstance, MultiDrawElementsIndirect,
+        FenceSync, ClientWaitSync, DeleteSync, FlushMappedBufferRange
+    };
+
+    // ファイルの先頭の識別子と版
+    static constexpr char magic[8] = { 'G', 'L', 'C', 'A', 'P', 'T', 'U', 'R' };
+    static const std::uint32_t version = 1;
+
+    // データのない Blob の番号
+    static const std::uint32_t none = ~0u;
+
+    // 固定機能の状態
+    struct Fixed {
+        std::int32_t viewport[4];
+        float clearColor[4], clearDepth;
+        std::uint32_t depthTest, cullFace, cullFaceMode, frontFace, depthFunc;
+    };
+
+private:
+
+    // 差し替える前の関数ポインタ
+    struct Original {
+#define GLCAPTURE_DECLARE(name) decltype(__glew##name) name;
+        GLCAPTURE_FUNCTIONS(GLCAPTURE_DECLARE)
+#undef GLCAPTURE_DECLARE
+    } original;
+
+    // 書き出し先
+    FILE *file;
+
+    // 記録中なら true
+    bool active;
+
+    // 書き出し前のコマンド
+    std::vector<char> out;
+
+    // 書き出した Blob の番号とファイル中の位置
+    //  内容はメモリに残さず、ハッシュ値が一致したときにファイルから読み戻して比べる
+    struct Stored {
+        std::uint32_t id;
+        std::uint64_t offset, size;
+    };
+    std::unordered_multimap<std::uint64_t, Stored> blobIndex;
+    std::uint32_t blobs;
+
+    // ファイルに書き出したバイト数
+    std::uint64_t written;
+
+    // 読み戻した内容を置く作業領域
+    std::vector<char> scratch;
+
+    // 直前に書き出した固定機能の状態
+    Fixed fixed;
+    bool fixedValid;
+
+    // ターゲットに結合しているバッファオブジェクト
+    std::unordered_map<GLenum, GLuint> binding;
+
+    // マップしているバッファオブジェクトの領域
+    struct Mapping {
+        char *pointer;
+        GLintptr offset;
+        GLsizeiptr length;
+        GLbitfield access;
+    };
+    std::unordered_map<GLuint, Mapping> mapping;
+
+    // 記録したフレームとコマンドの数、データの量
+    std::uint32_t frames;
+    std::size_t commands, payload, deduplicated;
+
+    // コンストラクタ
+    GlCapture()
+        : file(NULL), active(false), blobs(0), written(0), fixedValid(false)
+        , frames(0), commands(0), payload(0), deduplicated(0)
+    {}
+
+    // デストラクタ
+    ~GlCapture() {
+        end();
+    }
+
+    // 値を書き出す
+    template<typename T>
+    void put(T value) {
+        const char *const p(reinterpret_cast<const char *>(&value));
+        out.insert(out.end(), p, p + sizeof value);
+    }
+
+    // コマンドの種類を書き出す
+    void op(Op o) {
+        put(static_cast<std::uint8_t>(o));
+        ++commands;
+    }
+
+    // データを Blob として書き出して番号を返す (同じ内容なら前の番号を返す)
+    //  data: データ (NULL なら none)
+    //  size: データのバイト数
+    std::uint32_t store(const void *data, std::size_t size) {
+        if (data == NULL) return none;
+        const char *const p(static_cast<const char *>(data));
+
+        // FNV-1a
+        std::uint64_t h(0xcbf29ce484222325ull);
+        for (std::size_t i = 0; i < size; ++i) {
+            h ^= static_cast<std::uint8_t>(p[i]);
+            h *= 0x100000001b3ull;
+        }
+        payload += size;
+        const auto range(blobIndex.equal_range(h));
+        for (auto i = range.first; i != range.second; ++i) {
+            if (i->second.size == size && same(i->second.offset, p, size)) {
+                deduplicated += size;
+                return i->second.id;
+            }
+        }
+
+        put(static_cast<std::uint8_t>(Blob));
+        const std::uint32_t id(blobs++);
+        put(id);
+        put(static_cast<std::uint64_t>(size));
+        const Stored b = { id, written + out.size(), size };
+        blobIndex.emplace(h, b);
+        out.insert(out.end(), p, p + size);
+        return id;
+    }
+
+    // 書き出した Blob の内容がデータと同じか調べる
+    //  offset: Blob の内容のファイル中の位置
+    //  p: データ
+    //  size: データのバイト数
+    bool same(std::uint64_t offset, const char *p, std::size_t size) {
+        // まだファイルに書き出していなければ書き出し前のコマンドと比べる
+        if (offset >= written)
+            return std::memcmp(out.data() + (offset - written), p, size) == 0;
+
+        // ファイルから少しずつ読み戻して比べる
+        fflush(file);
+        scratch.resize(65536);
+        bool result(fseek(file, static_cast<long>(offset), SEEK_SET) == 0);
+        for (std::size_t done = 0; result && done < size;) {
+            const std::size_t n(std::min(size - done, scratch.size()));
+            result = fread(scratch.data(), 1, n, file) == n
+                && std::memcmp(scratch.data(), p + done, n) == 0;
+            done += n;
+        }
+
+        // 続きを書き出せるように末尾に戻す
+        fseek(file, 0, SEEK_END);
+        return result;
+    }
+
+    // 名前の並びを書き出す
+    void names(GLsizei n, const GLuint *name) {
+        put(static_cast<std::uint32_t>(n));
+        for (GLsizei i = 0; i < n; ++i) put(static_cast<std::uint32_t>(name[i]));
+    }
+
+    // マップしている領域の内容を書き出す
+    //  buffer: バッファオブジェクト名
+    //  offset: バッファオブジェクトの先頭からの位置
+    //  size: バイト数
+    void mappedWrite(GLuint buffer, GLintptr offset, GLsizeiptr size) {
+        const auto m(mapping.find(buffer));
+        if (m == mapping.end() || !(m->second.access & GL_MAP_WRITE_BIT)) return;
+        const std::uint32_t id(store(m->second.pointer + (offset - m->second.offset), size));
+        op(MappedWrite);
+        put(static_cast<std::uint32_t>(buffer));
+        put(static_cast<std::uint64_t>(offset));
+        put(id);
+    }
+
+    // 固定機能の状態を調べて変わっていれば書き出す
+    void state() {
+        Fixed f;
+        GLint v[4];
+        glGetIntegerv(GL_VIEWPORT, v);
+        for (int i = 0; i < 4; ++i) f.viewport[i] = v[i];
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, f.clearColor);
+        glGetFloatv(GL_DEPTH_CLEAR_VALUE, &f.clearDepth);
+        f.depthTest = glIsEnabled(GL_DEPTH_TEST);
+        f.cullFace = glIsEnabled(GL_CULL_FACE);
+        glGetIntegerv(GL_CULL_FACE_MODE, v);
+        f.cullFaceMode = v[0];
+        glGetIntegerv(GL_FRONT_FACE, v);
+        f.frontFace = v[0];
+        glGetIntegerv(GL_DEPTH_FUNC, v);
+        f.depthFunc = v[0];
+        if (fixedValid && std::memcmp(&f, &fixed, sizeof f) == 0) return;
+
+        fixed = f;
+        fixedValid = true;
+        op(State);
+        put(f);
+    }
+
+    // 書き出し前のコマンドをファイルに書き出す
+    void flush() {
+        if (!out.empty()) fwrite(out.data(), 1, out.size(), file);
+        written += out.size();
+        out.clear();
+    }
+
+    // 差し替える関数
+    static void GLAPIENTRY hookGenBuffers(GLsizei n, GLuint *buffers) {
+        GlCapture &c(instance());
+        c.original.GenBuffers(n, buffers);
+        c.op(GenBuffers);
+        c.names(n, buffers);
+    }
+
+    static void GLAPIENTRY hookDeleteBuffers(GLsizei n, const GLuint *buffers) {
+        GlCapture &c(instance());
+        c.op(DeleteBuffers);
+        c.names(n, buffers);
+        for (GLsizei i = 0; i < n; ++i) c.mapping.erase(buffers[i]);
+        c.original.DeleteBuffers(n, buffers);
+    }
+
+    static void GLAPIENTRY hookBindBuffer(GLenum target, GLuint buffer) {
+        GlCapture &c(instance());
+        c.op(BindBuffer);
+        c.put(static_cast<std::uint32_t>(target));
+        c.put(static_cast<std::uint32_t>(buffer));
+        c.binding[target] = buffer;
+        c.original.BindBuffer(target, buffer);
+    }
+
+    static void GLAPIENTRY hookBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage) {
+        GlCapture &c(instance());
+        const std::uint32_t id(c.store(data, size));
+        c.op(BufferData);
+        c.put(static_cast<std::uint32_t>(target));
+        c.put(static_cast<std::uint64_t>(size));
+        c.put(id);
+        c.put(static_cast<std::uint32_t>(usage));
+        c.original.BufferData(target, size, data, usage);
+    }
+
+    static void GLAPIENTRY hookBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data) {
+        GlCapture &c(instance());
+        const std::uint32_t id(c.store(data, size));
+        c.op(BufferSubData);
+        c.put(static_cast<std::uint32_t>(target));
+        c.put(static_cast<std::uint64_t>(offset));
+        c.put(id);
+        c.original.BufferSubData(target, offset, size, data);
+    }
+
+    static void GLAPIENTRY hookBufferStorage(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags) {
+        GlCapture &c(instance());
+        const std::uint32_t id(c.store(data, size));
+        c.op(BufferStorage);
+        c.put(static_cast<std::uint32_t>(target));
+        c.put(static_cast<std::uint64_t>(size));
+        c.put(id);
+        c.put(static_cast<std::uint32_t>(flags));
+        c.original.BufferStorage(target, size, data, flags);
+    }
+
+    static void *GLAPIENTRY hookMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+        GlCapture &c(instance());
+        void *const pointer(c.original.MapBufferRange(target, offset, length, access));
+        c.op(MapBufferRange);
+        c.put(static_cast<std::uint32_t>(target));
+        c.put(static_cast<std::uint64_t>(offset));
+        c.put(static_cast<std::uint64_t>(length));
+        c.put(static_cast<std::uint32_t>(access));
+        if (pointer) {
+            const Mapping m = { static_cast<char *>(pointer), offset, length, access };
+            c.mapping[c.binding[target]] = m;
+        }
+        return pointer;
+    }
+
+    static GLboolean GLAPIENTRY hookUnmapBuffer(GLenum target) {
+        GlCapture &c(instance());
+
+        // 永続的でなければ書き込んだ内容は外すときに書き出す
+        const GLuint buffer(c.binding[target]);
+        const auto m(c.mapping.find(buffer));
+        if (m != c.mapping.end()) {
+            if (!(m->second.access & GL_MAP_PERSISTENT_BIT)) c.mappedWrite(buffer, m->second.offset, m->second.length);
+            c.mapping.erase(m);
+        }
+        c.op(UnmapBuffer);
+        c.put(static_cast<std::uint32_t>(target));
+        return c.original.UnmapBuffer(target);
+    }
+
+    static void GLAPIENTRY hookCopyBufferSubData(GLenum readTarget, GLenum writeTarget,
+        GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size) {
+        GlCapture &c(instance());
+
+        // 永続的にマップした領域からの転送ならその時点の内容を書き出す
+        c.mappedWrite(c.binding[readTarget], readOffset, size);
+        c.op(CopyBufferSubData);
+        c.put(static_cast<std::uint32_t>(readTarget));
+        c.put(static_cast<std::uint32_t>(writeTarget));
+        c.put(static_cast<std::uint64_t>(readOffset));
+        c.put(static_cast<std::uint64_t>(writeOffset));
+        c.put(static_cast<std::uint64_t>(size));
+        c.original.CopyBufferSubData(readTarget, writeTarget, readOffset, writeOffset, size);
+    }
+
+    static void GLAPIENTRY hookFlushMappedBufferRange(GLenum target, GLintptr offset, GLsizeiptr length) {
+        GlCapture &c(instance());
+
+        // 明示的に知らせた範囲はその時点の内容を書き出す (offset はマップした範囲の先頭から)
+        const GLuint buffer(c.binding[target]);
+        const auto m(c.mapping.find(buffer));
+        if (m != c.mapping.end()) c.mappedWrite(buffer, m->second.offset + offset, length);
+        c.op(FlushMappedBufferRange);
+        c.put(static_cast<std::uint32_t>(target));
+        c.put(static_cast<std::uint64_t>(offset));
+        c.put(static_cast<std::uint64_t>(length));
+        c.original.FlushMappedBufferRange(target, offset, length);
+    }
+
+    static void GLAPIENTRY hookBindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+        GlCapture &c(instance());
+        c.op(BindBufferBase);
+        c.put(static_cast<std::uint32_t>(target));
+        c.put(static_cast<std::uint32_t>(index));
+        c.put(static_cast<std::uint32_t>(buffer));
+        c.binding[target] = buffer;
+        c.original.BindBufferBase(target, index, buffer);
+    }
+
+    static void GLAPIENTRY hookBindBufferRange(GLenum target, GLuint index, GLuint buffer,
+        GLintptr offset, GLsizeiptr size) {
+        GlCapture &c(instance());
+        c.op(BindBufferRange);
+        c.put(static_cast<std::uint32_t>(target));
+        c.put(static_cast<std::uint32_t>(index));
+        c.put(static_cast<std::uint32_t>(buffer));
+        c.put(static_cast<std::uint64_t>(offset));
+        c.put(static_cast<std::uint64_t>(size));
+        c.binding[target] = buffer;
+        c.original.BindBufferRange(target, index, buffer, offset, size);
+    }
+
+    static void GLAPIENTRY hookGenVertexArrays(GLsizei n, GLuint *arrays) {
+        GlCapture &c(instance());
+        c.original.GenVertexArrays(n, arrays);
+        c.op(GenVertexArrays);
+        c.names(n, arrays);
+    }
+
+    static void GLAPIENTRY hookDeleteVertexArrays(GLsizei n, const GLuint *arrays) {
+        GlCapture &c(instance());
+        c.op(DeleteVertexArrays);
+        c.names(n, arrays);
+        c.original.DeleteVertexArrays(n, arrays);
+    }
+
+    static void GLAPIENTRY hookBindVertexArray(GLuint array) {
+        GlCapture &c(instance());
+        c.op(BindVertexArray);
+        c.put(static_cast<std::uint32_t>(array));
+        c.original.BindVertexArray(array);
+    }
+
+    static void GLAPIENTRY hookVertexAttribPointer(GLuint index, GLint size, GLenum type,
+        GLboolean normalized, GLsizei stride, const void *pointer) {
+        GlCapture &c(instance());
+        c.op(VertexAttribPointer);
+        c.put(static_cast<std::uint32_t>(index));
+        c.put(static_cast<std::int32_t>(size));
+        c.put(static_cast<std::uint32_t>(type));
+        c.put(static_cast<std::uint32_t>(normalized));
+        c.put(static_cast<std::int32_t>(stride));
+        c.put(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(pointer)));
+        c.original.VertexAttribPointer(index, size, type, normalized, stride, pointer);
+    }
+
+    static void GLAPIENTRY hookEnableVertexAttribArray(GLuint index) {
+        GlCapture &c(instance());
+        c.op(EnableVertexAttribArray);
+        c.put(static_cast<std::uint32_t>(index));
+        c.original.EnableVertexAttribArray(index);
+    }
+
+    static GLuint GLAPIENTRY hookCreateShader(GLenum type) {
+        GlCapture &c(instance());
+        const GLuint shader(c.original.CreateShader(type));
+        c.op(CreateShader);
+        c.put(static_cast<std::uint32_t>(type));
+        c.put(static_cast<std::uint32_t>(shader));
+        return shader;
+    }
+
+    static void GLAPIENTRY hookShaderSource(GLuint shader, GLsizei count,
+        const GLchar *const *string, const GLint *length) {
+        GlCapture &c(instance());
+
+        // 一つの文字列につなげて書き出す
+        std::string source;
+        for (GLsizei i = 0; i < count; ++i) {
+            if (length && length[i] >= 0) source.append(string[i], length[i]);
+            else source.append(string[i]);
+        }
+        const std::uint32_t id(c.store(source.data(), source.size()));
+        c.op(ShaderSource);
+        c.put(static_cast<std::uint32_t>(shader));
+        c.put(id);
+        c.original.ShaderSource(shader, count, string, length);
+    }
+
+    static void GLAPIENTRY hookCompileShader(GLuint shader) {
+        GlCapture &c(instance());
+        c.op(CompileShader);
+        c.put(static_cast<std::uint32_t>(shader));
+        c.original.CompileShader(shader);
+    }
+
+    static void GLAPIENTRY hookDeleteShader(GLuint shader) {
+        GlCapture &c(instance());
+        c.op(DeleteShader);
+        c.put(static_cast<std::uint32_t>(shader));
+        c.original.DeleteShader(shader);
+    }
+
+    static GLuint GLAPIENTRY hookCreateProgram() {
+        GlCapture &c(instance());
+        const GLuint program(c.original.CreateProgram());
+        c.op(CreateProgram);
+        c.put(static_cast<std::uint32_t>(program));
+        return program;
+    }
+
+    static void GLAPIENTRY hookAttachShader(GLuint program, GLuint shader) {
+        GlCapture &c(instance());
+        c.op(AttachShader);
+        c.put(static_cast<std::uint32_t>(program));
+        c.put(static_cast<std::uint32_t>(shader));
+        c.original.AttachShader(program, shader);
+    }
+
+    static void GLAPIENTRY hookDetachShader(GLuint program, GLuint shader) {
+        GlCapture &c(instance());
+        c.op(DetachShader);
+        c.put(static_cast<std::uint32_t>(program));
+        c.put(static_cast<std::uint32_t>(shader));
+        c.original.DetachShader(program, shader);
+    }
+
+    static void GLAPIENTRY hookBindAttribLocation(GLuint program, GLuint index, const GLchar *name) {
+        GlCapture &c(instance());
+        const std::uint32_t id(c.store(name, std::strlen(name) + 1));
+        c.op(BindAttribLocation);
+        c.put(static_cast<std::uint32_t>(program));
+        c.put(static_cast<std::uint32_t>(index));
+        c.put(id);
+        c.original.BindAttribLocation(program, index, name);
+    }
+
+    static void GLAPIENTRY hookBindFragDataLocation(GLuint program, GLuint color, const GLchar *name) {
+        GlCapture &c(instance());
+        const std::uint32_t id(c.store(name, std::strlen(name) + 1));
+        c.op(BindFragDataLocation);
+        c.put(static_cast<std::uint32_t>(program));
+        c.put(static_cast<std::uint32_t>(color));
+        c.put(id);
+        c.original.BindFragDataLocation(program, color, name);
+    }
+
+    static void GLAPIENTRY hookLinkProgram(GLuint program) {
+        GlCapture &c(instance());
+        c.op(LinkProgram);
+        c.put(static_cast<std::uint32_t>(program));
+        c.original.LinkProgram(program);
+    }
+
+    static void GLAPIENTRY hookDeleteProgram(GLuint program) {
+        GlCapture &c(instance());
+        c.op(DeleteProgram);
+        c.put(static_cast<std::uint32_t>(program));
+        c.original.DeleteProgram(program);
+    }
+
+    static void GLAPIENTRY hookUseProgram(GLuint program) {
+        GlCapture &c(instance());
+        c.op(UseProgram);
+        c.put(static_cast<std::uint32_t>(program));
+        c.original.UseProgram(program);
+    }
+
+    static GLint GLAPIENTRY hookGetUniformLocation(GLuint program, const GLchar *name) {
+        GlCapture &c(instance());
+        const GLint location(c.original.GetUniformLocation(program, name));
+        const std::uint32_t id(c.store(name, std::strlen(name) + 1));
+        c.op(GetUniformLocation);
+        c.put(static_cast<std::uint32_t>(program));
+        c.put(id);
+        c.put(static_cast<std::int32_t>(location));
+        return location;
+    }
+
+    static void GLAPIENTRY hookUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
+        GlCapture &c(instance());
+        c.op(UniformMatrix4fv);
+        c.put(static_cast<std::int32_t>(location));
+        c.put(static_cast<std::uint32_t>(count));
+        c.put(static_cast<std::uint32_t>(transpose));
+        for (GLsizei i = 0; i < 16 * count; ++i) c.put(static_cast<float>(value[i]));
+        c.original.UniformMatrix4fv(location, count, transpose, value);
+    }
+
+    static void GLAPIENTRY hookUniform3uiv(GLint location, GLsizei count, const GLuint *value) {
+        GlCapture &c(instance());
+        c.op(Uniform3uiv);
+        c.put(static_cast<std::int32_t>(location));
+        c.put(static_cast<std::uint32_t>(count));
+        for (GLsizei i = 0; i < 3 * count; ++i) c.put(static_cast<std::uint32_t>(value[i]));
+        c.original.Uniform3uiv(location, count, value);
+    }
+
+    static void GLAPIENTRY hookUniform2fv(GLint location, GLsizei count, const GLfloat *value) {
+        GlCapture &c(instance());
+        c.op(Uniform2fv);
+        c.put(static_cast<std::int32_t>(location));
+        c.put(static_cast<std::uint32_t>(count));
+        for (GLsizei i = 0; i < 2 * count; ++i) c.put(static_cast<float>(value[i]));
+        c.original.Uniform2fv(location, count, value);
+    }
+
+    static void GLAPIENTRY hookDrawArraysInstancedBaseInstance(GLenum mode, GLint first, GLsizei count,
+        GLsizei instancecount, GLuint baseinstance) {
+        GlCapture &c(instance());
+        c.op(DrawArraysInstancedBaseInstance);
+        c.put(static_cast<std::uint32_t>(mode));
+        c.put(static_cast<std::int32_t>(first));
+        c.put(static_cast<std::int32_t>(count));
+        c.put(static_cast<std::int32_t>(instancecount));
+        c.put(static_cast<std::uint32_t>(baseinstance));
+        c.original.DrawArraysInstancedBaseInstance(mode, first, count, instancecount, baseinstance);
+    }
+
+    static void GLAPIENTRY hookDrawElementsInstancedBaseInstance(GLenum mode, GLsizei count, GLenum type,
+        const void *indices, GLsizei instancecount, GLuint baseinstance) {
+        GlCapture &c(instance());
+        c.op(DrawElementsInstancedBaseInstance);
+        c.put(static_cast<std::uint32_t>(mode));
+        c.put(static_cast<std::int32_t>(count));
+        c.put(static_cast<std::uint32_t>(type));
+        c.put(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(indices)));
+        c.put(static_cast<std::int32_t>(instancecount));
+        c.put(static_cast<std::uint32_t>(baseinstance));
+        c.original.DrawElementsInstancedBaseInstance(mode, count, type, indices, instancecount, baseinstance);
+    }
+
+    static void GLAPIENTRY hookMultiDrawElementsIndirect(GLenum mode, GLenum type, const void *indirect,
+        GLsizei drawcount, GLsizei stride) {
+        GlCapture &c(instance());
+        c.op(MultiDrawElementsIndirect);
+        c.put(static_cast<std::uint32_t>(mode));
+        c.put(static_cast<std::uint32_t>(type));
+        c.put(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(indirect)));
+        c.put(static_cast<std::int32_t>(drawcount));
+        c.put(static_cast<std::int32_t>(stride));
+        c.original.MultiDrawElementsIndirect(mode, type, indirect, drawcount, stride);
+    }
+
+    static GLsync GLAPIENTRY hookFenceSync(GLenum condition, GLbitfield flags) {
+        GlCapture &c(instance());
+        const GLsync sync(c.original.FenceSync(condition, flags));
+        c.op(FenceSync);
+        c.put(static_cast<std::uint32_t>(condition));
+        c.put(static_cast<std::uint32_t>(flags));
+        c.put(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(sync)));
+        return sync;
+    }
+
+    static GLenum GLAPIENTRY hookClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+        GlCapture &c(instance());
+        c.op(ClientWaitSync);
+        c.put(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(sync)));
+        c.put(static_cast<std::uint32_t>(flags));
+        c.put(static_cast<std::uint64_t>(timeout));
+        return c.original.ClientWaitSync(sync, flags, timeout);
+    }
+
+    static void GLAPIENTRY hookDeleteSync(GLsync sync) {
+        GlCapture &c(instance());
+        c.op(DeleteSync);
+        c.put(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(sync)));
+        c.original.DeleteSync(sync);
+    }
+
+public:
+
+    // 唯一のインスタンス
+    static GlCapture &instance() {
+        static GlCapture capture;
+        return capture;
+    }
+
+    // 記録を始める (glewInit の後で、GL のオブジェクトを作る前に呼ぶ)
+    //  filename: 書き出すファイル名
+    //  戻り値: 始められたら true
+    bool begin(const char *filename) {
+        if (active) return true;
+        file = fopen(filename, "w+b");
+        if (file == NULL) {
+            printf("Error : Can't open capture file: %s\n", filename);
+            return false;
+        }
+
+        // ファイルの先頭にビューポートの大きさを書いておく
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        out.insert(out.end(), magic, magic + sizeof magic);
+        put(version);
+        put(static_cast<std::int32_t>(viewport[2]));
+        put(static_cast<std::int32_t>(viewport[3]));
+
+        // GLEW の関数ポインタを差し替える
+#define GLCAPTURE_HOOK(name) original.name = __glew##name; __glew##name = hook##name;
+        GLCAPTURE_FUNCTIONS(GLCAPTURE_HOOK)
+#undef GLCAPTURE_HOOK
+        active = true;
+        state();
+        flush();
+        return true;
+    }
+
+    // フレームの終わりを記録する (バッファを入れ替える前に呼ぶ)
+    void frame() {
+        if (!active) return;
+        op(Frame);
+        ++frames;
+        flush();
+    }
+
+    // 記録を終えてファイルを閉じる
+    void end() {
+        if (!active) return;
+#define GLCAPTURE_RESTORE(name) __glew##name = original.name;
+        GLCAPTURE_FUNCTIONS(GLCAPTURE_RESTORE)
+#undef GLCAPTURE_RESTORE
+        active = false;
+        flush();
+        fclose(file);
+        file = NULL;
+        printf("capture: %u frames, %zu commands, %zu payload bytes (%zu deduplicated)\n",
+            frames, commands, payload, deduplicated);
+    }
+
+    // 記録中かどうか
+    bool isActive() const { return active; }
+
+    // 画面を消去する (記録中なら固定機能の状態と一緒に記録する)
+    //  mask: 消去するバッファ
+    static void clear(GLbitfield mask) {
+        GlCapture &c(instance());
+        if (c.active) {
+            c.state();
+            c.op(Clear);
+            c.put(static_cast<std::uint32_t>(mask));
+        }
+        glClear(mask);
+    }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    GlCapture(const GlCapture &c);
+
+    // 代入によるコピー禁止
+    GlCapture &operator=(const GlCapture &c);
+};
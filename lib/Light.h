@@ -0,0 +1,23 @@
+#pragma once
+#include <array>
+#include <GL/glew.h>
+
+// 光源データ (std430 のシェーダストレージブロックと同じ配置)
+struct Light {
+    // 位置 (w = 0 なら平行光源)
+    alignas(16) std::array<GLfloat, 4> position;
+
+    // 環境光成分
+    alignas(16) std::array<GLfloat, 3> ambient;
+
+    // 影響半径 (0 以下なら減衰せずどこまでも届く)
+    GLfloat radius;
+
+    // 拡散反射光成分
+    alignas(16) std::array<GLfloat, 3> diffuse;
+
+    // 鏡面反射光成分
+    alignas(16) std::array<GLfloat, 3> specular;
+};
+
+static_assert(sizeof (Light) == 64, "Light must match the std430 layout");
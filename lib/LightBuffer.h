@@ -0,0 +1,157 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <GL/glew.h>
+
+// 変換行列
+#include "Matrix.h"
+
+// ベクトル
+#include "Vector.h"
+
+// 光源データ
+#include "Light.h"
+
+// クラスタへの光源の割り当て
+#include "Cluster.h"
+
+// シェーダストレージバッファオブジェクトに格納した光源の管理
+class LightBuffer {
+    // 光源、クラスタ、光源の番号のシェーダストレージバッファオブジェクト名
+    GLuint ssbo[3];
+
+    // 確保したバッファオブジェクトのサイズ
+    GLsizeiptr capacity[3];
+
+    // ワールド座標系の光源
+    std::vector<Light> light;
+
+    // 視点座標系の光源
+    std::vector<Light> viewLight;
+
+    // 光源のクラスタへの割り当て
+    Cluster cluster;
+
+    // 最後に update したときのビュー変換行列と透視投影変換行列
+    Matrix lastView, lastProjection;
+
+    // 光源が変更されて update が必要なら true
+    bool dirty;
+
+    // バッファオブジェクトにデータを格納する
+    //  i: バッファオブジェクトの番号
+    //  data: 格納するデータ
+    //  size: 格納するデータのサイズ
+    void upload(int i, const void *data, GLsizeiptr size) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo[i]);
+
+        // 足りなければ倍々に確保し直す
+        if (size > capacity[i]) {
+            while (capacity[i] < size) capacity[i] *= 2;
+            glBufferData(GL_SHADER_STORAGE_BUFFER, capacity[i], NULL, GL_DYNAMIC_DRAW);
+        }
+        if (size > 0) glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+    }
+
+public:
+
+    // コンストラクタ
+    //  tilesX: 画面の横の分割数
+    //  tilesY: 画面の縦の分割数
+    //  slices: 奥行きの分割数
+    LightBuffer(int tilesX = 16, int tilesY = 9, int slices = 24)
+        : cluster(tilesX, tilesY, slices), dirty(true)
+    {
+        glGenBuffers(3, ssbo);
+        for (int i = 0; i < 3; i++) {
+            capacity[i] = 256;
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo[i]);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, capacity[i], NULL, GL_DYNAMIC_DRAW);
+        }
+    }
+
+    // デストラクタ
+    virtual ~LightBuffer() {
+        // シェーダストレージバッファオブジェクトを削除
+        glDeleteBuffers(3, ssbo);
+    }
+
+    // 光源を追加する
+    //  l: ワールド座標系の光源
+    //  戻り値: 光源の番号
+    GLuint add(const Light &l) {
+        dirty = true;
+        light.push_back(l);
+        return static_cast<GLuint>(light.size() - 1);
+    }
+
+    // 光源を全て削除する
+    void clear() {
+        dirty = true;
+        light.clear();
+    }
+
+    // 光源の数
+    std::size_t size() const { return light.size(); }
+
+    // 光源を左辺値として参照する (変更するものとして update が必要になる)
+    Light &operator[](std::size_t i) { dirty = true; return light[i]; }
+
+    // 光源を右辺値として参照する
+    const Light &operator[](std::size_t i) const { return light[i]; }
+
+    // クラスタへの割り当てを参照する
+    const Cluster &getCluster() const { return cluster; }
+
+    // update が必要なら true
+    bool isDirty() const { return dirty; }
+
+    // 光源を視点座標系に変換してクラスタに割り当て、バッファオブジェクトに格納する
+    //  光源も行列も前回から変わっていなければ何もしない
+    //  view: ビュー変換行列
+    //  projection: 透視投影変換行列
+    //  戻り値: 格納し直したら true
+    bool update(const Matrix &view, const Matrix &projection) {
+        if (!dirty && std::equal(view.data(), view.data() + 16, lastView.data())
+            && std::equal(projection.data(), projection.data() + 16, lastProjection.data())) return false;
+        lastView = view;
+        lastProjection = projection;
+        dirty = false;
+
+        // 光源の位置を視点座標系に変換する
+        viewLight.resize(light.size());
+        ThreadPool::instance().parallelFor(light.size(), 4096, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                viewLight[i] = light[i];
+                const Vector p(view * Vector(light[i].position));
+                std::copy(p.begin(), p.end(), viewLight[i].position.begin());
+            }
+        });
+
+        // 光源をクラスタに割り当てる
+        cluster.setProjection(projection);
+        cluster.bin(viewLight.data(), viewLight.size());
+
+        // バッファオブジェクトに格納する
+        upload(0, viewLight.data(), viewLight.size() * sizeof (Light));
+        upload(1, cluster.getGrid().data(), cluster.getGrid().size() * sizeof (GLuint));
+        upload(2, cluster.getIndex().data(), cluster.getIndex().size() * sizeof (GLuint));
+        return true;
+    }
+
+    // このシェーダストレージバッファオブジェクトを使用
+    //  bp: 光源、クラスタ、光源の番号を結合する最初の結合ポイント
+    void select(GLuint bp = 1) const {
+        for (GLuint i = 0; i < 3; i++) {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bp + i, ssbo[i]);
+        }
+    }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    LightBuffer(const LightBuffer &o);
+
+    // 代入によるコピー禁止
+    LightBuffer &operator=(const LightBuffer &o);
+};
@@ -16,3 +16,5 @@ struct Material {
     // 輝き係数
     alignas(4) GLfloat shininess;
 };
+
+static_assert(sizeof (Material) == 48, "Material must match the std430 layout");
@@ -0,0 +1,174 @@
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <GL/glew.h>
+
+// 材質データ
+#include "Material.h"
+
+// シェーダストレージバッファオブジェクトに詰めて格納した材質の表
+//  同じ値の材質は一つにまとめ、シェーダは 32 ビットの材質番号で直接参照する
+class MaterialTable {
+    // シェーダストレージバッファオブジェクト名
+    GLuint ssbo;
+
+    // 確保した材質の数
+    std::size_t capacity;
+
+    // 登録した材質
+    std::vector<Material> material;
+
+    // バッファオブジェクトへの転送が必要な材質番号
+    std::vector<GLuint> dirty;
+
+    // 材質の値のハッシュ値
+    struct Hash {
+        static std::uint32_t bits(GLfloat v) {
+            // -0 を +0 にそろえる
+            const GLfloat z(v + 0.0f);
+            std::uint32_t b;
+            std::memcpy(&b, &z, sizeof b);
+            return b;
+        }
+
+        std::size_t operator()(const Material &m) const {
+            std::uint64_t h(0xcbf29ce484222325ull);
+            const auto mix = [&h](GLfloat v) { h = (h ^ bits(v)) * 0x100000001b3ull; };
+            for (GLfloat v : m.ambient) mix(v);
+            for (GLfloat v : m.diffuse) mix(v);
+            for (GLfloat v : m.specular) mix(v);
+            mix(m.shininess);
+            return static_cast<std::size_t>(h ^ (h >> 32));
+        }
+    };
+
+    // 材質の値の比較 (パディングは比較しない)
+    struct Equal {
+        bool operator()(const Material &a, const Material &b) const {
+            return a.ambient == b.ambient && a.diffuse == b.diffuse
+                && a.specular == b.specular && a.shininess == b.shininess;
+        }
+    };
+
+    // 材質の値から材質番号への対応
+    std::unordered_map<Material, GLuint, Hash, Equal> lookup;
+
+public:
+
+    // コンストラクタ
+    //  count: 最初に確保する材質の数
+    MaterialTable(std::size_t count = 64)
+        : capacity(std::max<std::size_t>(count, 1))
+    {
+        glGenBuffers(1, &ssbo);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof (Material), NULL, GL_DYNAMIC_DRAW);
+    }
+
+    // デストラクタ
+    virtual ~MaterialTable() {
+        // シェーダストレージバッファオブジェクトを削除
+        glDeleteBuffers(1, &ssbo);
+    }
+
+    // 材質を登録する
+    //  m: 材質
+    //  戻り値: 材質番号 (同じ値が登録済みならその番号)
+    GLuint add(const Material &m) {
+        const auto found(lookup.find(m));
+        if (found != lookup.end()) return found->second;
+
+        const GLuint id(static_cast<GLuint>(material.size()));
+        material.push_back(m);
+        lookup.emplace(m, id);
+        dirty.push_back(id);
+        return id;
+    }
+
+    // 材質番号の材質の値を変更する
+    //  同じ値で登録した全ての図形の材質が変わる
+    //  id: 材質番号
+    //  m: 新しい材質
+    //  戻り値: 材質番号が登録済みなら true
+    bool set(GLuint id, const Material &m) {
+        if (id >= material.size()) {
+            printf("Error : Unknown material id: %u\n", id);
+            return false;
+        }
+
+        // 元の値の対応がこの番号を指していれば, 同じ値を持つほかの番号に付け替える
+        const auto found(lookup.find(material[id]));
+        if (found != lookup.end() && found->second == id) {
+            const Equal equal;
+            GLuint other(id);
+            for (GLuint i = 0; i < material.size(); ++i) {
+                if (i != id && equal(material[i], material[id])) {
+                    other = i;
+                    break;
+                }
+            }
+            if (other != id) found->second = other;
+            else lookup.erase(found);
+        }
+
+        // 新しい値の対応がまだなければこの番号にする
+        material[id] = m;
+        if (lookup.find(m) == lookup.end()) lookup.emplace(m, id);
+        dirty.push_back(id);
+        return true;
+    }
+
+    // 材質を参照する
+    const Material &operator[](GLuint id) const { return material[id]; }
+
+    // 登録した材質の数
+    std::size_t size() const { return material.size(); }
+
+    // 転送していない変更があれば true
+    bool isDirty() const { return !dirty.empty(); }
+
+    // 変更された材質だけをバッファオブジェクトに転送する
+    void update() {
+        if (dirty.empty()) return;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+
+        // 足りなければ倍々に確保し直して全体を転送する
+        if (material.size() > capacity) {
+            while (capacity < material.size()) capacity *= 2;
+            glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof (Material), NULL, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, material.size() * sizeof (Material), material.data());
+            dirty.clear();
+            return;
+        }
+
+        // 連続した材質番号をまとめて転送する
+        std::sort(dirty.begin(), dirty.end());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+        for (std::size_t i = 0; i < dirty.size();) {
+            std::size_t j(i + 1);
+            while (j < dirty.size() && dirty[j] == dirty[j - 1] + 1) ++j;
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                dirty[i] * sizeof (Material), (j - i) * sizeof (Material), &material[dirty[i]]);
+            i = j;
+        }
+        dirty.clear();
+    }
+
+    // このシェーダストレージバッファオブジェクトを使用
+    //  bp: 結合ポイント
+    void select(GLuint bp) const {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bp, ssbo);
+    }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    MaterialTable(const MaterialTable &o);
+
+    // 代入によるコピー禁止
+    MaterialTable &operator=(const MaterialTable &o);
+};
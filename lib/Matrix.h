@@ -3,6 +3,9 @@
 #include <algorithm>
 #include <GL/glew.h>
 
+// 4要素の三角関数
+#include "SimdMath.h"
+
 // 変換行列
 class Matrix
 {
@@ -161,8 +164,8 @@ public:
         t.loadIdentity();
         if (!(mode == 1 || mode == 2 || mode == 3)) return t;
 
-        GLfloat fcos(cos(a));
-        GLfloat fsin(sin(a));
+        GLfloat fcos(std::cos(a));
+        GLfloat fsin(std::sin(a));
 
         switch (mode)
         {
@@ -205,7 +208,7 @@ public:
             const GLfloat l(x / d), m(y / d), n(z / d);
             const GLfloat l2(l * l), m2(m * m), n2(n * n);
             const GLfloat lm(l * m), mn(m * n), nl(n * l);
-            const GLfloat c(cos(a)), c1(1.0f - c), s(sin(a));
+            const GLfloat c(std::cos(a)), c1(1.0f - c), s(std::sin(a));
 
             t.loadIdentity();
             t[ 0] = (1.0f - l2) * c + l2;
@@ -222,6 +225,105 @@ public:
         return t;
     }
 
+    // 座標軸(mode)を軸に回転する変換行列を 4 個ずつまとめて作成
+    //  mode: rotate と同じ
+    //  count: 変換行列の数
+    //  a: 回転角の配列
+    //  m: 変換行列の格納先
+    static void rotate(int mode, std::size_t count, const GLfloat *a, Matrix *m)
+    {
+        for (std::size_t i = 0; i < count; i += 4) {
+            const std::size_t n(std::min<std::size_t>(count - i, 4));
+            alignas(16) GLfloat angle[4] = {}, c[4], s[4];
+            std::copy(a + i, a + i + n, angle);
+            float4 vs, vc;
+            sincos(float4::load(angle), vs, vc);
+            vs.store(s);
+            vc.store(c);
+
+            for (std::size_t k = 0; k < n; ++k) {
+                Matrix &t(m[i + k]);
+                t.loadIdentity();
+                switch (mode)
+                {
+                case 1:
+                    t[ 5] = c[k];
+                    t[ 6] = s[k];
+                    t[ 9] = -s[k];
+                    t[10] = c[k];
+                    break;
+                case 2:
+                    t[ 0] = c[k];
+                    t[ 2] = -s[k];
+                    t[ 8] = s[k];
+                    t[10] = c[k];
+                    break;
+                case 3:
+                    t[0] = c[k];
+                    t[1] = s[k];
+                    t[4] = -s[k];
+                    t[5] = c[k];
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+    }
+
+    // (x, y, z)を軸に回転する変換行列を 4 個ずつまとめて作成
+    //  count: 変換行列の数
+    //  a: 回転角の配列
+    //  axis: 回転軸の配列 (変換行列ごとに 3 要素, 長さ 0 なら単位行列)
+    //  m: 変換行列の格納先
+    static void rotateAxis(std::size_t count, const GLfloat *a, const GLfloat *axis, Matrix *m)
+    {
+        for (std::size_t i = 0; i < count; i += 4) {
+            // 端数は回転しない要素で埋める
+            const std::size_t n(std::min<std::size_t>(count - i, 4));
+            alignas(16) GLfloat angle[4] = {}, x[4] = {}, y[4] = {}, z[4] = {};
+            for (std::size_t k = 0; k < n; ++k) {
+                angle[k] = a[i + k];
+                x[k] = axis[(i + k) * 3 + 0];
+                y[k] = axis[(i + k) * 3 + 1];
+                z[k] = axis[(i + k) * 3 + 2];
+            }
+
+            // 回転軸を正規化する
+            const float4 vx(float4::load(x)), vy(float4::load(y)), vz(float4::load(z));
+            const float4 d2(vx * vx + vy * vy + vz * vz), zero(0.0f), one(1.0f);
+            const float4 valid(d2 > zero);
+            const float4 r(select(valid, one / sqrt(select(valid, d2, one)), zero));
+            const float4 l(vx * r), mm(vy * r), nn(vz * r);
+
+            // 回転軸がなければ単位行列になるように cos = 1, sin = 0 にする
+            float4 s, c;
+            sincos(float4::load(angle), s, c);
+            s = select(valid, s, zero);
+            c = select(valid, c, one);
+            const float4 c1(one - c);
+
+            // 4 個の行列の列ごとに転置して書き出す (端数は作業領域に書いてから写す)
+            Matrix work[4];
+            Matrix *const t(n == 4 ? m + i : work);
+            float4 e0(c + l * l * c1), e1(l * mm * c1 + nn * s), e2(nn * l * c1 - mm * s), w0(zero);
+            float4 e3(l * mm * c1 - nn * s), e4(c + mm * mm * c1), e5(mm * nn * c1 + l * s), w1(zero);
+            float4 e6(nn * l * c1 + mm * s), e7(mm * nn * c1 - l * s), e8(c + nn * nn * c1), w2(zero);
+            float4::transpose(e0, e1, e2, w0);
+            float4::transpose(e3, e4, e5, w1);
+            float4::transpose(e6, e7, e8, w2);
+            const float4 column[3][4] = { { e0, e1, e2, w0 }, { e3, e4, e5, w1 }, { e6, e7, e8, w2 } };
+            const float4 origin(0.0f, 0.0f, 0.0f, 1.0f);
+            for (int k = 0; k < 4; ++k) {
+                column[0][k].store(t[k].matrix);
+                column[1][k].store(t[k].matrix + 4);
+                column[2][k].store(t[k].matrix + 8);
+                origin.store(t[k].matrix + 12);
+            }
+            if (n < 4) std::copy(work, work + n, m + i);
+        }
+    }
+
     // ローカル座標系を回転する変換行列を作成
     static Matrix localRotate(GLfloat p, GLfloat h, GLfloat r) {
         Matrix rx, ry, rz;
@@ -367,7 +469,7 @@ public:
 
         if (dz != 0.0f) {
             t.loadIdentity();
-            t[ 5] = 1.0f / tan(fovy * 0.5f);
+            t[ 5] = 1.0f / std::tan(fovy * 0.5f);
             t[ 0] = t[5] / aspect;
             t[10] = -(zFar + zNear) / dz;
             t[11] = -1.0f;
@@ -392,6 +494,50 @@ public:
         return t;
     }
 
+    // 逆行列を求める (特異なら零行列を返す)
+    static Matrix inverse(const Matrix &m) {
+        // 2x2 の小行列式
+        const GLfloat s0(m[0] * m[5] - m[4] * m[1]);
+        const GLfloat s1(m[0] * m[6] - m[4] * m[2]);
+        const GLfloat s2(m[0] * m[7] - m[4] * m[3]);
+        const GLfloat s3(m[1] * m[6] - m[5] * m[2]);
+        const GLfloat s4(m[1] * m[7] - m[5] * m[3]);
+        const GLfloat s5(m[2] * m[7] - m[6] * m[3]);
+        const GLfloat c5(m[10] * m[15] - m[14] * m[11]);
+        const GLfloat c4(m[ 9] * m[15] - m[13] * m[11]);
+        const GLfloat c3(m[ 9] * m[14] - m[13] * m[10]);
+        const GLfloat c2(m[ 8] * m[15] - m[12] * m[11]);
+        const GLfloat c1(m[ 8] * m[14] - m[12] * m[10]);
+        const GLfloat c0(m[ 8] * m[13] - m[12] * m[ 9]);
+
+        Matrix t;
+        const GLfloat det(s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+        if (det == 0.0f) {
+            std::fill(t.matrix, t.matrix + 16, 0.0f);
+            return t;
+        }
+        const GLfloat d(1.0f / det);
+
+        t[ 0] = ( m[ 5] * c5 - m[ 6] * c4 + m[ 7] * c3) * d;
+        t[ 1] = (-m[ 1] * c5 + m[ 2] * c4 - m[ 3] * c3) * d;
+        t[ 2] = ( m[13] * s5 - m[14] * s4 + m[15] * s3) * d;
+        t[ 3] = (-m[ 9] * s5 + m[10] * s4 - m[11] * s3) * d;
+        t[ 4] = (-m[ 4] * c5 + m[ 6] * c2 - m[ 7] * c1) * d;
+        t[ 5] = ( m[ 0] * c5 - m[ 2] * c2 + m[ 3] * c1) * d;
+        t[ 6] = (-m[12] * s5 + m[14] * s2 - m[15] * s1) * d;
+        t[ 7] = ( m[ 8] * s5 - m[10] * s2 + m[11] * s1) * d;
+        t[ 8] = ( m[ 4] * c4 - m[ 5] * c2 + m[ 7] * c0) * d;
+        t[ 9] = (-m[ 0] * c4 + m[ 1] * c2 - m[ 3] * c0) * d;
+        t[10] = ( m[12] * s4 - m[13] * s2 + m[15] * s0) * d;
+        t[11] = (-m[ 8] * s4 + m[ 9] * s2 - m[11] * s0) * d;
+        t[12] = (-m[ 4] * c3 + m[ 5] * c1 - m[ 6] * c0) * d;
+        t[13] = ( m[ 0] * c3 - m[ 1] * c1 + m[ 2] * c0) * d;
+        t[14] = (-m[12] * s3 + m[13] * s1 - m[14] * s0) * d;
+        t[15] = ( m[ 8] * s3 - m[ 9] * s1 + m[10] * s0) * d;
+
+        return t;
+    }
+
     // 乗算
     Matrix operator*(const Matrix &m) const
     {
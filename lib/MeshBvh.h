@@ -0,0 +1,152 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <GL/glew.h>
+
+// 図形データ
+#include "Object.h"
+
+// 境界ボリューム階層
+#include "Bvh.h"
+
+// 三角形の境界ボリューム階層
+//  図形の座標系で作るので、インスタンスが動いても作り直さなくてよい
+class MeshBvh {
+    // 境界ボリューム階層
+    Bvh bvh;
+
+    // 頂点の位置 (3 要素ずつ)
+    std::vector<GLfloat> position;
+
+    // 葉の順に並べた三角形の頂点のインデックス (3 要素ずつ)
+    std::vector<GLuint> triangle;
+
+    // 三角形と半直線の交差判定 (Möller–Trumbore)
+    //  i: 葉の順の三角形の番号
+    //  distance: 交点の距離の上限
+    //  t: 交点の距離の格納先
+    bool intersectTriangle(GLuint i, const GLfloat *origin, const GLfloat *direction,
+        GLfloat distance, GLfloat &t) const
+    {
+        const GLfloat *const p0(&position[3 * triangle[3 * i]]);
+        const GLfloat *const p1(&position[3 * triangle[3 * i + 1]]);
+        const GLfloat *const p2(&position[3 * triangle[3 * i + 2]]);
+        const GLfloat e1[] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        const GLfloat e2[] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+        // 裏面にも当たるものとする
+        const GLfloat p[] = {
+            direction[1] * e2[2] - direction[2] * e2[1],
+            direction[2] * e2[0] - direction[0] * e2[2],
+            direction[0] * e2[1] - direction[1] * e2[0]
+        };
+        const GLfloat det(e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2]);
+        if (std::fabs(det) < 1.0e-12f) return false;
+        const GLfloat inv(1.0f / det);
+
+        const GLfloat s[] = { origin[0] - p0[0], origin[1] - p0[1], origin[2] - p0[2] };
+        const GLfloat u((s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv);
+        if (u < 0.0f || u > 1.0f) return false;
+
+        const GLfloat q[] = {
+            s[1] * e1[2] - s[2] * e1[1],
+            s[2] * e1[0] - s[0] * e1[2],
+            s[0] * e1[1] - s[1] * e1[0]
+        };
+        const GLfloat v((direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inv);
+        if (v < 0.0f || u + v > 1.0f) return false;
+
+        t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+        return t > 0.0f && t < distance;
+    }
+
+public:
+
+    // コンストラクタ
+    MeshBvh() {}
+
+    // 図形データから作るコンストラクタ
+    //  引数は build と同じ
+    MeshBvh(GLsizei vertexcount, const Object::Vertex *vertex,
+        GLsizei indexcount = 0, const GLuint *index = NULL)
+    {
+        build(vertexcount, vertex, indexcount, index);
+    }
+
+    // 作り直す
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列
+    //  indexcount: 頂点のインデックスの要素数 (0 なら vertex を三角形の羅列とみなす)
+    //  index: 頂点のインデックスを格納した配列
+    void build(GLsizei vertexcount, const Object::Vertex *vertex,
+        GLsizei indexcount = 0, const GLuint *index = NULL)
+    {
+        ThreadPool &pool(ThreadPool::instance());
+        const std::size_t vertices(vertexcount > 0 ? vertexcount : 0);
+        const std::size_t count((indexcount > 0 ? indexcount : vertices) / 3);
+
+        // 頂点の位置を取り出す
+        position.resize(3 * vertices);
+        pool.parallelFor(vertices, 1 << 16, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                for (int k = 0; k < 3; ++k) position[3 * i + k] = vertex[i].position[k];
+            }
+        });
+
+        // 三角形の境界ボックスを求める
+        std::vector<GLuint> source(3 * count);
+        std::vector<Bvh::Bounds> bounds(count);
+        pool.parallelFor(count, 1 << 16, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                bounds[i].clear();
+                for (int k = 0; k < 3; ++k) {
+                    const GLuint v(indexcount > 0 ? index[3 * i + k] : static_cast<GLuint>(3 * i + k));
+                    source[3 * i + k] = v;
+                    bounds[i].grow(&position[3 * v]);
+                }
+            }
+        });
+        bvh.build(count, bounds.data());
+
+        // 三角形を葉の順に並べ替える
+        const std::vector<GLuint> &order(bvh.getOrder());
+        triangle.resize(3 * count);
+        pool.parallelFor(count, 1 << 16, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                for (int k = 0; k < 3; ++k) triangle[3 * i + k] = source[3 * order[i] + k];
+            }
+        });
+    }
+
+    // 半直線と最も近い三角形の交点を求める
+    //  origin: 半直線の始点 (図形の座標系)
+    //  direction: 半直線の方向 (図形の座標系)
+    //  distance: 調べる距離の上限 (交点が見つかればその距離で上書きする)
+    //  id: 交わった三角形の番号 (インデックスの並びの順) の格納先
+    //  戻り値: distance より近い交点が見つかったら true
+    bool intersect(const GLfloat *origin, const GLfloat *direction, GLfloat &distance, GLuint &id) const
+    {
+        bool found(false);
+        const std::vector<GLuint> &order(bvh.getOrder());
+        bvh.traverse(origin, direction, distance, [&](GLuint first, GLuint count, GLfloat &d) {
+            for (GLuint i = first; i < first + count; ++i) {
+                GLfloat t;
+                if (intersectTriangle(i, origin, direction, d, t)) {
+                    d = t;
+                    id = order[i];
+                    found = true;
+                }
+            }
+        });
+        return found;
+    }
+
+    // 図形の座標系の境界ボックス
+    Bvh::Bounds getBounds() const { return bvh.getBounds(); }
+
+    // 三角形の数
+    std::size_t getTriangleCount() const { return triangle.size() / 3; }
+
+    // 境界ボリューム階層
+    const Bvh &getBvh() const { return bvh; }
+};
@@ -0,0 +1,290 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <cstring>
+#include <functional>
+#include <algorithm>
+#include <GL/glew.h>
+
+// 図形データ
+#include "Object.h"
+
+// 共有の頂点バッファとインデックスバッファ
+#include "GeometryPool.h"
+
+// 並列処理
+#include "ThreadPool.h"
+
+// 図形データの非同期読み込み
+//  ワーカースレッドで作った図形データを、永続マップしたステージングバッファのリングから
+//  フレームごとの転送量の上限まで GeometryPool に写す
+class MeshStream {
+public:
+
+    // ワーカースレッドで作る図形データ
+    struct Data {
+        std::vector<Object::Vertex> vertex;
+        std::vector<GLuint> index;
+    };
+
+    // 図形データの状態
+    enum State {
+        // ワーカースレッドで作成中
+        Loading,
+
+        // ステージングバッファから転送中
+        Uploading,
+
+        // 描画できる
+        Ready,
+
+        // 失敗した
+        Failed
+    };
+
+    // 読み込み要求の番号
+    using Ticket = unsigned int;
+
+private:
+
+    // 読み込み要求
+    struct Entry {
+        // 状態
+        State state;
+
+        // ワーカースレッドで作った図形データ
+        Data data;
+
+        // 共有バッファ内の図形の位置
+        GeometryPool::Mesh mesh;
+
+        // 転送済みのバイト数
+        GLsizeiptr copied;
+
+        // 転送を終えたリングの位置 (ここまで回収されたら描画できる)
+        unsigned long long fencePosition;
+    };
+
+    // 図形の転送先
+    GeometryPool &pool;
+
+    // 読み込み要求 (追加しても要素は移動しない)
+    std::deque<Entry> entry;
+
+    // ワーカースレッドで作り終えた読み込み要求
+    std::vector<Ticket> completed;
+    std::mutex mutex;
+
+    // 作成中の読み込み要求の数
+    std::atomic<unsigned int> inflight;
+
+    // 転送待ちの読み込み要求
+    std::deque<Ticket> queue;
+
+    // 転送を終えてフェンスを待っている読み込み要求
+    std::vector<Ticket> fencing;
+
+    // ステージングバッファ
+    GLuint staging;
+
+    // ステージングバッファのマップした先頭
+    char *mapped;
+
+    // リングの大きさと 1 フレームの転送量の上限
+    const GLsizeiptr ringSize, budget;
+
+    // リングに書き込んだ位置と回収した位置 (単調増加)
+    unsigned long long head, tail;
+
+    // フレームごとの書き込みの終わりとフェンス
+    struct Segment {
+        GLsync fence;
+        unsigned long long end;
+    };
+    std::deque<Segment> segment;
+
+    // GPU が読み終えたリングの領域を回収する
+    void reclaim() {
+        while (!segment.empty()) {
+            const GLenum status(glClientWaitSync(segment.front().fence, 0, 0));
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+            glDeleteSync(segment.front().fence);
+            tail = segment.front().end;
+            segment.pop_front();
+        }
+    }
+
+    // ステージングバッファから共有バッファに写す
+    //  e: 読み込み要求
+    //  offset: 図形データの先頭からの位置
+    //  size: 大きさ
+    //  ring: ステージングバッファ内の位置
+    void copy(const Entry &e, GLsizeiptr offset, GLsizeiptr size, GLsizeiptr ring) {
+        const GLsizeiptr vbytes(e.data.vertex.size() * sizeof (Object::Vertex));
+        glBindBuffer(GL_COPY_READ_BUFFER, staging);
+
+        // 頂点の部分
+        if (offset < vbytes) {
+            const GLsizeiptr n(std::min(size, vbytes - offset));
+            const char *const src(reinterpret_cast<const char *>(e.data.vertex.data()) + offset);
+            std::memcpy(mapped + ring, src, n);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, pool.getVertexBuffer());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, ring,
+                e.mesh.baseVertex * sizeof (Object::Vertex) + offset, n);
+            offset += n;
+            size -= n;
+            ring += n;
+        }
+
+        // インデックスの部分
+        if (size > 0) {
+            const char *const src(reinterpret_cast<const char *>(e.data.index.data()) + offset - vbytes);
+            std::memcpy(mapped + ring, src, size);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, pool.getIndexBuffer());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, ring,
+                e.mesh.firstIndex * sizeof (GLuint) + offset - vbytes, size);
+        }
+    }
+
+public:
+
+    // コンストラクタ
+    //  pool: 図形の転送先
+    //  ringSize: ステージングバッファの大きさ
+    //  budget: 1 フレームに転送するバイト数の上限
+    MeshStream(GeometryPool &pool, GLsizeiptr ringSize = 8 << 20, GLsizeiptr budget = 1 << 20)
+        : pool(pool), inflight(0), ringSize(ringSize), budget(budget), head(0), tail(0)
+    {
+        const GLbitfield flags(GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+        glGenBuffers(1, &staging);
+        glBindBuffer(GL_COPY_READ_BUFFER, staging);
+        glBufferStorage(GL_COPY_READ_BUFFER, ringSize, NULL, flags);
+        mapped = static_cast<char *>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, ringSize, flags));
+    }
+
+    // デストラクタ
+    virtual ~MeshStream() {
+        // ワーカースレッドが作成中の図形データを待つ
+        while (inflight.load() > 0) std::this_thread::yield();
+
+        for (const Segment &s : segment) glDeleteSync(s.fence);
+        glBindBuffer(GL_COPY_READ_BUFFER, staging);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        glDeleteBuffers(1, &staging);
+    }
+
+    // 図形データの読み込みを要求する
+    //  generate: ワーカースレッドで図形データを作る関数 (失敗したら false を返す)
+    //  戻り値: 読み込み要求の番号
+    Ticket request(const std::function<bool(Data &)> &generate) {
+        const Ticket ticket(static_cast<Ticket>(entry.size()));
+        entry.emplace_back();
+        Entry *const e(&entry.back());
+        e->state = Loading;
+        e->mesh = GeometryPool::Mesh{ 0, 0, 0, 0 };
+        e->copied = 0;
+        e->fencePosition = 0;
+
+        ++inflight;
+        ThreadPool::instance().submit([this, e, ticket, generate] {
+            const bool ok(generate(e->data));
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!ok) e->data.vertex.clear();
+                completed.push_back(ticket);
+            }
+            --inflight;
+        });
+
+        return ticket;
+    }
+
+    // 1 フレーム分の転送を行う (描画ループで毎フレーム呼ぶ)
+    void update() {
+        reclaim();
+
+        // フェンスを通過した図形を描画できるようにする
+        for (std::size_t i = 0; i < fencing.size();) {
+            Entry &e(entry[fencing[i]]);
+            if (tail >= e.fencePosition) {
+                e.state = Ready;
+                fencing[i] = fencing.back();
+                fencing.pop_back();
+            } else {
+                ++i;
+            }
+        }
+
+        // ワーカースレッドで作り終えたものを転送待ちにする
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (Ticket t : completed) {
+                Entry &e(entry[t]);
+                if (e.data.vertex.empty() || e.data.index.empty()) {
+                    e.state = Failed;
+                    continue;
+                }
+                e.mesh = pool.reserve(static_cast<GLsizei>(e.data.vertex.size()),
+                    static_cast<GLsizei>(e.data.index.size()));
+                e.state = e.mesh.count > 0 ? Uploading : Failed;
+                if (e.state == Uploading) queue.push_back(t);
+            }
+            completed.clear();
+        }
+
+        // 上限までリングに書き込んで共有バッファに写す
+        GLsizeiptr left(budget);
+        while (!queue.empty() && left > 0) {
+            Entry &e(entry[queue.front()]);
+            const GLsizeiptr total(e.data.vertex.size() * sizeof (Object::Vertex)
+                + e.data.index.size() * sizeof (GLuint));
+
+            // リングの空きのうち折り返さずに使える大きさ
+            const GLsizeiptr position(static_cast<GLsizeiptr>(head % ringSize));
+            const GLsizeiptr free(ringSize - static_cast<GLsizeiptr>(head - tail));
+            const GLsizeiptr n(std::min({ total - e.copied, left, free, ringSize - position }));
+            if (n <= 0) break;
+
+            copy(e, e.copied, n, position);
+            e.copied += n;
+            head += n;
+            left -= n;
+
+            // 全て写したらフェンスを待つ
+            if (e.copied == total) {
+                e.fencePosition = head;
+                std::vector<Object::Vertex>().swap(e.data.vertex);
+                std::vector<GLuint>().swap(e.data.index);
+                fencing.push_back(queue.front());
+                queue.pop_front();
+            }
+        }
+
+        // このフレームの書き込みにフェンスを置く
+        if (left < budget) {
+            const Segment s = { glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), head };
+            segment.push_back(s);
+        }
+    }
+
+    // 読み込み要求の状態
+    State getState(Ticket ticket) const { return entry[ticket].state; }
+
+    // 描画できるかどうか
+    bool ready(Ticket ticket) const { return entry[ticket].state == Ready; }
+
+    // 共有バッファ内の図形の位置 (Ready になってから使う)
+    const GeometryPool::Mesh &getMesh(Ticket ticket) const { return entry[ticket].mesh; }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    MeshStream(const MeshStream &o);
+
+    // 代入によるコピー禁止
+    MeshStream &operator=(const MeshStream &o);
+};
@@ -0,0 +1,320 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <GL/glew.h>
+
+// 変換行列
+#include "Matrix.h"
+
+// 図形データ
+#include "Object.h"
+
+// 4要素のベクトル演算
+#include "Simd.h"
+
+// 図形を小さな三角形の集まり (メッシュレット) に分けたもの
+//  メッシュレットごとの境界球と法線の円錐で、視錐台の外にあるものと
+//  全ての三角形が裏を向いているものを頂点の処理の前にまとめて捨てる
+class Meshlets {
+public:
+
+    // 一つのメッシュレットの頂点と三角形の上限
+    static const GLuint maxVertices = 64, maxTriangles = 124;
+
+    // メッシュレット
+    struct Meshlet {
+        // 並べ替えたインデックスの中の先頭位置とインデックスの数
+        GLuint firstIndex, count;
+
+        // 頂点の数
+        GLuint vertexcount;
+
+        // 境界球の中心と半径
+        GLfloat center[3], radius;
+
+        // 法線の円錐の軸と打ち切りの値 (1 なら円錐による判定をしない)
+        GLfloat axis[3], cutoff;
+
+        // 法線の円錐の頂点
+        GLfloat apex[3];
+    };
+
+private:
+
+    // メッシュレット
+    std::vector<Meshlet> meshlet;
+
+    // メッシュレットの順に並べ替えた三角形の頂点のインデックス
+    std::vector<GLuint> index;
+
+    // 判定用に 4 つずつ並べたメッシュレットの境界球と法線の円錐
+    std::vector<GLfloat> cx, cy, cz, cr, ax, ay, az, ac, px, py, pz;
+
+    // メッシュレットの境界球と法線の円錐を求める
+    //  m: メッシュレット
+    //  triangle: メッシュレットの三角形の頂点のインデックス
+    //  position: 頂点の位置 (3 要素ずつ)
+    static void bound(Meshlet &m, const GLuint *triangle, const std::vector<GLfloat> &position) {
+        const GLuint count(m.count / 3);
+
+        // 頂点を囲む箱の中心を境界球の中心にする
+        GLfloat lo[3], hi[3];
+        std::copy(&position[3 * triangle[0]], &position[3 * triangle[0]] + 3, lo);
+        std::copy(lo, lo + 3, hi);
+        for (GLuint i = 0; i < m.count; ++i) {
+            const GLfloat *const p(&position[3 * triangle[i]]);
+            for (int k = 0; k < 3; ++k) {
+                lo[k] = std::min(lo[k], p[k]);
+                hi[k] = std::max(hi[k], p[k]);
+            }
+        }
+        GLfloat radius(0.0f);
+        for (int k = 0; k < 3; ++k) m.center[k] = (lo[k] + hi[k]) * 0.5f;
+        for (GLuint i = 0; i < m.count; ++i) {
+            const GLfloat *const p(&position[3 * triangle[i]]);
+            const GLfloat d[] = { p[0] - m.center[0], p[1] - m.center[1], p[2] - m.center[2] };
+            radius = std::max(radius, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        }
+        m.radius = std::sqrt(radius);
+
+        // 三角形の単位法線 (面積のない三角形は使わない)
+        std::vector<GLfloat> normal;
+        normal.reserve(3 * count);
+        std::vector<GLuint> used;
+        used.reserve(count);
+        GLfloat sum[] = { 0.0f, 0.0f, 0.0f };
+        for (GLuint t = 0; t < count; ++t) {
+            const GLfloat *const p0(&position[3 * triangle[3 * t]]);
+            const GLfloat *const p1(&position[3 * triangle[3 * t + 1]]);
+            const GLfloat *const p2(&position[3 * triangle[3 * t + 2]]);
+            const GLfloat e1[] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            const GLfloat e2[] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            GLfloat n[] = {
+                e1[1] * e2[2] - e1[2] * e2[1],
+                e1[2] * e2[0] - e1[0] * e2[2],
+                e1[0] * e2[1] - e1[1] * e2[0]
+            };
+            const GLfloat l(std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]));
+            if (l <= 0.0f) continue;
+            for (int k = 0; k < 3; ++k) {
+                n[k] /= l;
+                sum[k] += n[k];
+            }
+            normal.insert(normal.end(), n, n + 3);
+            used.push_back(t);
+        }
+
+        // 法線の平均を円錐の軸にする
+        m.cutoff = 1.0f;
+        std::fill(m.axis, m.axis + 3, 0.0f);
+        std::copy(m.center, m.center + 3, m.apex);
+        const GLfloat l(std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]));
+        if (l <= 0.0f) return;
+        for (int k = 0; k < 3; ++k) m.axis[k] = sum[k] / l;
+
+        // 軸から最も離れた法線との角度で円錐を開く (半球近くまで開くなら判定しない)
+        GLfloat mindp(1.0f);
+        for (std::size_t i = 0; i < used.size(); ++i) {
+            const GLfloat *const n(&normal[3 * i]);
+            mindp = std::min(mindp, n[0] * m.axis[0] + n[1] * m.axis[1] + n[2] * m.axis[2]);
+        }
+        if (mindp <= 0.1f) return;
+
+        // 全ての三角形の平面の裏側になるように円錐の頂点を軸に沿って下げる
+        GLfloat maxt(0.0f);
+        for (std::size_t i = 0; i < used.size(); ++i) {
+            const GLfloat *const n(&normal[3 * i]);
+            const GLfloat *const p(&position[3 * triangle[3 * used[i]]]);
+            const GLfloat dc((m.center[0] - p[0]) * n[0] + (m.center[1] - p[1]) * n[1] + (m.center[2] - p[2]) * n[2]);
+            const GLfloat dn(n[0] * m.axis[0] + n[1] * m.axis[1] + n[2] * m.axis[2]);
+            maxt = std::max(maxt, dc / dn);
+        }
+        for (int k = 0; k < 3; ++k) m.apex[k] = m.center[k] - m.axis[k] * maxt;
+        m.cutoff = std::sqrt(1.0f - mindp * mindp);
+    }
+
+public:
+
+    // コンストラクタ
+    Meshlets() {}
+
+    // 図形データから作るコンストラクタ
+    //  引数は build と同じ
+    Meshlets(GLsizei vertexcount, const Object::Vertex *vertex,
+        GLsizei indexcount = 0, const GLuint *index = NULL)
+    {
+        build(vertexcount, vertex, indexcount, index);
+    }
+
+    // 作り直す
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列
+    //  indexcount: 頂点のインデックスの要素数 (0 なら vertex を三角形の羅列とみなす)
+    //  index: 頂点のインデックスを格納した配列
+    void build(GLsizei vertexcount, const Object::Vertex *vertex,
+        GLsizei indexcount = 0, const GLuint *index = NULL)
+    {
+        const std::size_t vertices(vertexcount > 0 ? vertexcount : 0);
+        const std::size_t count((indexcount > 0 ? indexcount : vertices) / 3);
+        meshlet.clear();
+        this->index.clear();
+        this->index.reserve(3 * count);
+
+        std::vector<GLfloat> position(3 * vertices);
+        for (std::size_t i = 0; i < vertices; ++i) {
+            for (int k = 0; k < 3; ++k) position[3 * i + k] = vertex[i].position[k];
+        }
+        std::vector<GLuint> source(3 * count);
+        for (std::size_t i = 0; i < 3 * count; ++i) {
+            source[i] = indexcount > 0 ? index[i] : static_cast<GLuint>(i);
+        }
+
+        // 頂点を共有する三角形の一覧
+        std::vector<GLuint> first(vertices + 1, 0), adjacent(3 * count);
+        for (GLuint v : source) ++first[v + 1];
+        for (std::size_t i = 0; i < vertices; ++i) first[i + 1] += first[i];
+        std::vector<GLuint> fill(first.begin(), first.end() - 1);
+        for (std::size_t i = 0; i < 3 * count; ++i) adjacent[fill[source[i]]++] = static_cast<GLuint>(i / 3);
+
+        // 使った三角形と今のメッシュレットに含まれる頂点
+        std::vector<bool> done(count, false);
+        std::vector<GLuint> stamp(vertices, 0);
+        std::vector<GLuint> live;
+        live.reserve(maxVertices);
+        std::size_t cursor(0);
+
+        // 今のメッシュレットの頂点を共有する三角形のうち新しい頂点の最も少ないものを加えていく
+        Meshlet m = {};
+        for (std::size_t added = 0; added < count; ++added) {
+            const GLuint id(static_cast<GLuint>(meshlet.size() + 1));
+            std::size_t best(count);
+            GLuint fewest(4);
+            for (GLuint v : live) {
+                for (GLuint j = first[v]; j < first[v + 1] && fewest > 0; ++j) {
+                    const GLuint t(adjacent[j]);
+                    if (done[t]) continue;
+                    GLuint extra(0);
+                    for (int k = 0; k < 3; ++k) if (stamp[source[3 * t + k]] != id) ++extra;
+                    if (extra < fewest) {
+                        fewest = extra;
+                        best = t;
+                    }
+                }
+                if (fewest == 0) break;
+            }
+
+            // つながった三角形がないか上限を超えるならメッシュレットを閉じる
+            if (best == count || m.vertexcount + fewest > maxVertices || m.count / 3 >= maxTriangles) {
+                if (m.count > 0) {
+                    bound(m, &this->index[m.firstIndex], position);
+                    meshlet.push_back(m);
+                }
+                m = Meshlet();
+                m.firstIndex = static_cast<GLuint>(this->index.size());
+                live.clear();
+                while (done[cursor]) ++cursor;
+                best = cursor;
+            }
+
+            // 三角形をメッシュレットに加える
+            const GLuint current(static_cast<GLuint>(meshlet.size() + 1));
+            done[best] = true;
+            for (int k = 0; k < 3; ++k) {
+                const GLuint v(source[3 * best + k]);
+                this->index.push_back(v);
+                if (stamp[v] != current) {
+                    stamp[v] = current;
+                    live.push_back(v);
+                    ++m.vertexcount;
+                }
+            }
+            m.count += 3;
+        }
+        if (m.count > 0) {
+            bound(m, &this->index[m.firstIndex], position);
+            meshlet.push_back(m);
+        }
+
+        // 判定用に 4 つずつ並べる (余りは境界球の半径を負にして常に視錐台の外にする)
+        const std::size_t padded((meshlet.size() + 3) & ~std::size_t(3));
+        std::vector<GLfloat> *const soa[] = { &cx, &cy, &cz, &cr, &ax, &ay, &az, &ac, &px, &py, &pz };
+        for (std::vector<GLfloat> *a : soa) a->assign(padded, 0.0f);
+        std::fill(cr.begin() + meshlet.size(), cr.end(), -1.0f);
+        for (std::size_t i = 0; i < meshlet.size(); ++i) {
+            const Meshlet &b(meshlet[i]);
+            cx[i] = b.center[0];
+            cy[i] = b.center[1];
+            cz[i] = b.center[2];
+            cr[i] = b.radius;
+            ax[i] = b.axis[0];
+            ay[i] = b.axis[1];
+            az[i] = b.axis[2];
+            ac[i] = b.cutoff;
+            px[i] = b.apex[0];
+            py[i] = b.apex[1];
+            pz[i] = b.apex[2];
+        }
+    }
+
+    // 視錐台の外にあるメッシュレットと全ての三角形が裏を向いているメッシュレットを捨てる
+    //  法線の円錐の角度が変わらないように modelview は一様でない拡大縮小を含まないこと
+    //  projection: 投影変換行列
+    //  modelview: モデルビュー変換行列
+    //  visible: 残ったメッシュレットの番号の格納先
+    //  戻り値: 捨てたメッシュレットに含まれる三角形の数
+    std::size_t cull(const Matrix &projection, const Matrix &modelview, std::vector<GLuint> &visible) const {
+        visible.clear();
+
+        // 図形の座標系の視錐台の 6 つの平面 (法線は内向きで正規化する)
+        const Matrix m(projection * modelview);
+        float4 plane[6][4];
+        for (int i = 0; i < 6; ++i) {
+            const int row(i / 2);
+            const GLfloat sign(i & 1 ? -1.0f : 1.0f);
+            GLfloat p[4];
+            for (int k = 0; k < 4; ++k) p[k] = m[4 * k + 3] + sign * m[4 * k + row];
+            const GLfloat l(std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]));
+            for (int k = 0; k < 4; ++k) plane[i][k] = float4(l > 0.0f ? p[k] / l : 0.0f);
+        }
+
+        // 図形の座標系の視点の位置
+        const Matrix inverse(Matrix::inverse(modelview));
+        const float4 ex(inverse[12]), ey(inverse[13]), ez(inverse[14]);
+
+        // 4 つずつ調べる
+        std::size_t culled(0);
+        const float4 zero(0.0f);
+        for (std::size_t i = 0; i < cr.size(); i += 4) {
+            const float4 x(float4::load(&cx[i])), y(float4::load(&cy[i])), z(float4::load(&cz[i]));
+            const float4 r(float4::load(&cr[i]));
+
+            // 境界球がどれかの平面の外側にあれば捨てる
+            float4 outside(r < zero);
+            for (int p = 0; p < 6; ++p) {
+                outside = outside | (plane[p][0] * x + plane[p][1] * y + plane[p][2] * z + plane[p][3] < -r);
+            }
+
+            // 視点から円錐の頂点への向きが円錐の内側なら全ての三角形が裏を向いている
+            const float4 dx(float4::load(&px[i]) - ex), dy(float4::load(&py[i]) - ey), dz(float4::load(&pz[i]) - ez);
+            const float4 d(dx * float4::load(&ax[i]) + dy * float4::load(&ay[i]) + dz * float4::load(&az[i]));
+            const float4 back(d >= float4::load(&ac[i]) * sqrt(dx * dx + dy * dy + dz * dz));
+
+            const int mask(movemask(outside | back));
+            for (int k = 0; k < 4 && i + k < meshlet.size(); ++k) {
+                if (mask & (1 << k)) culled += meshlet[i + k].count / 3;
+                else visible.push_back(static_cast<GLuint>(i + k));
+            }
+        }
+        return culled;
+    }
+
+    // メッシュレット
+    const std::vector<Meshlet> &getMeshlets() const { return meshlet; }
+
+    // メッシュレットの順に並べ替えた三角形の頂点のインデックス
+    const std::vector<GLuint> &getIndex() const { return index; }
+
+    // 三角形の数
+    std::size_t getTriangleCount() const { return index.size() / 3; }
+};
@@ -0,0 +1,122 @@
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+
+// 変換行列
+#include "Matrix.h"
+
+// 共有の頂点バッファとインデックスバッファ
+#include "GeometryPool.h"
+
+// glMultiDrawElementsIndirect の描画コマンド
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// 共有バッファ内の図形をまとめて一度の呼び出しで描画する
+//  モデルビュー変換行列は gl_DrawID で、材質番号は gl_BaseInstance で参照する
+class MultiDraw {
+    // 間接描画バッファとモデルビュー変換行列のシェーダストレージバッファオブジェクト名
+    GLuint buffer[2];
+
+    // 確保したバッファオブジェクトの描画コマンドの数
+    std::size_t capacity;
+
+    // 描画コマンド
+    std::vector<DrawElementsIndirectCommand> command;
+
+    // 描画コマンドごとのモデルビュー変換行列
+    std::vector<Matrix> modelview;
+
+public:
+
+    // コンストラクタ
+    //  count: 最初に確保する描画コマンドの数
+    MultiDraw(std::size_t count = 256)
+        : capacity(count > 0 ? count : 1)
+    {
+        glGenBuffers(2, buffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer[0]);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity * sizeof (DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer[1]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof (Matrix), NULL, GL_DYNAMIC_DRAW);
+        command.reserve(capacity);
+        modelview.reserve(capacity);
+    }
+
+    // デストラクタ
+    virtual ~MultiDraw() {
+        glDeleteBuffers(2, buffer);
+    }
+
+    // 描画コマンドを全て取り除く
+    void clear() {
+        command.clear();
+        modelview.clear();
+    }
+
+    // 描画コマンドを追加する
+    //  mesh: 共有バッファ内の図形の位置
+    //  m: モデルビュー変換行列
+    //  material: 材質番号
+    void add(const GeometryPool::Mesh &mesh, const Matrix &m, GLuint material) {
+        const DrawElementsIndirectCommand c = {
+            static_cast<GLuint>(mesh.count), 1, mesh.firstIndex, mesh.baseVertex, material
+        };
+        command.push_back(c);
+        modelview.push_back(m);
+    }
+
+    // 図形の一部のインデックスを描く描画コマンドを追加する
+    //  mesh: 共有バッファ内の図形の位置
+    //  first: 図形の中のインデックスの先頭位置
+    //  count: インデックスの数
+    //  m: モデルビュー変換行列
+    //  material: 材質番号
+    void add(const GeometryPool::Mesh &mesh, GLuint first, GLuint count, const Matrix &m, GLuint material) {
+        const DrawElementsIndirectCommand c = {
+            count, 1, mesh.firstIndex + first, mesh.baseVertex, material
+        };
+        command.push_back(c);
+        modelview.push_back(m);
+    }
+
+    // 描画コマンドの数
+    std::size_t size() const { return command.size(); }
+
+    // 描画コマンドを転送して一度に描画する
+    //  pool: 図形を格納した共有バッファ
+    //  mode: 描画する基本図形の種類
+    //  bp: モデルビュー変換行列を結合するシェーダストレージブロックの結合ポイント
+    void draw(const GeometryPool &pool, GLenum mode = GL_TRIANGLES, GLuint bp = 5) {
+        if (command.empty()) return;
+
+        // 足りなければ倍々に確保し直す
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer[0]);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer[1]);
+        if (command.size() > capacity) {
+            while (capacity < command.size()) capacity *= 2;
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity * sizeof (DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof (Matrix), NULL, GL_DYNAMIC_DRAW);
+        }
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, command.size() * sizeof (DrawElementsIndirectCommand), command.data());
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, modelview.size() * sizeof (Matrix), modelview.data());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bp, buffer[1]);
+
+        // 一度の呼び出しで全ての図形を描画する
+        pool.bind();
+        glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(command.size()), 0);
+    }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    MultiDraw(const MultiDraw &o);
+
+    // 代入によるコピー禁止
+    MultiDraw &operator=(const MultiDraw &o);
+};
@@ -1,6 +1,9 @@
 #pragma once
 #include <GL/glew.h>
 
+// GL のオブジェクトの遅延削除
+#include "DeletionQueue.h"
+
 // 図形データ
 class Object {
     // 頂点配列オブジェクト名
@@ -69,15 +72,18 @@ public:
     }
 
     // デストラクタ
+    //  GPU が使い終わってから削除するように DeletionQueue に預ける
     virtual ~Object() {
+        DeletionQueue &queue(DeletionQueue::instance());
+
         // 頂点配列オブジェクトを削除
-        glDeleteVertexArrays(1,&vao);
+        queue.vertexArray(vao);
 
         // 頂点バッファオブジェクトを削除
-        glDeleteBuffers(1, &vbo);
+        queue.buffer(vbo);
 
         // インデックスの頂点バッファオブジェクトを削除
-        glDeleteBuffers(1, &ibo);
+        queue.buffer(ibo);
     }
 
 private:
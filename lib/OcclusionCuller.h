@@ -0,0 +1,437 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <GL/glew.h>
+
+// 変換行列
+#include "Matrix.h"
+
+// 図形データ
+#include "Object.h"
+
+// 境界ボックス
+#include "Bvh.h"
+
+// 4要素のベクトル演算
+#include "Simd.h"
+
+// ワーカースレッドによる並列処理
+#include "ThreadPool.h"
+
+// CPU による遮蔽カリング
+//  遮蔽物 (中身に収まるように簡略化した図形) を低解像度の画面にラスタライズし、
+//  インスタンスの境界ボックスがその後ろに隠れていれば描かない
+//
+//  画面は 8x4 画素のタイルに分け、画素ごとのデプスバッファの代わりにタイルごとに
+//  全体を覆っている深度 (zMax0) と、覆いかけの画素のマスクとその深度 (mask, zMax1) を持つ
+//  (Hasselgren et al. "Masked Software Occlusion Culling" の二層の方式)
+//
+//  submit でワーカースレッドに渡した判定の結果は次のフレームの collect の後で使う
+//  インスタンスの番号は毎フレーム同じ順に addInstance すること
+class OcclusionCuller {
+    // タイルの大きさ (一つのタイルの画素のマスクが 32 ビットに収まる)
+    static const GLint tileWidth = 8, tileHeight = 4;
+
+    // 遮蔽物の図形
+    struct Mesh {
+        // 頂点の位置 (3 要素ずつ)
+        std::vector<GLfloat> position;
+
+        // 三角形の頂点のインデックス
+        std::vector<GLuint> index;
+    };
+    std::vector<Mesh> mesh;
+
+    // 遮蔽物の描画要求
+    struct Occluder {
+        GLuint mesh;
+        Matrix model;
+    };
+
+    // 判定するインスタンス
+    struct Instance {
+        Bvh::Bounds bounds;
+        Matrix model;
+    };
+
+    // 1 フレーム分の判定の要求と結果
+    struct Frame {
+        // 投影変換行列とビュー変換行列の積
+        Matrix viewProjection;
+
+        // 遮蔽物とインスタンス
+        std::vector<Occluder> occluder;
+        std::vector<Instance> instance;
+
+        // インスタンスが見えるかどうか
+        std::vector<GLubyte> visible;
+
+        // 隠れていたインスタンスの数
+        GLuint culled;
+
+        // 判定にかかった時間 (ミリ秒)
+        double milliseconds;
+    };
+
+    // 記録中のフレームと結果を出すフレーム
+    Frame frame[2];
+    int record, ready;
+
+    // 判定中なら true
+    std::atomic<bool> busy;
+
+    // 画面の大きさとタイルの数
+    const GLint width, height, tilesX, tilesY;
+
+    // タイルごとの全体を覆う深度、覆いかけの深度と画素のマスク
+    std::vector<GLfloat> zMax0, zMax1;
+    std::vector<std::uint32_t> mask;
+
+    // 変換後の遮蔽物の頂点 (クリップ座標)
+    std::vector<GLfloat> clip;
+
+    // タイルに三角形の覆う画素を重ねる
+    //  tile: タイルの番号
+    //  coverage: 三角形の覆う画素のマスク
+    //  z: タイルの中の三角形の最も遠い深度
+    void update(std::size_t tile, std::uint32_t coverage, GLfloat z) {
+        // 三角形が覆いかけの層より十分手前にあれば覆いかけの層を捨てる
+        if (zMax1[tile] - z > zMax0[tile] - zMax1[tile]) {
+            zMax1[tile] = 0.0f;
+            mask[tile] = 0;
+        }
+
+        // 覆いかけの層に加え、タイル全体を覆ったら全体を覆う深度にする
+        zMax1[tile] = std::max(zMax1[tile], z);
+        mask[tile] |= coverage;
+        if (mask[tile] == ~std::uint32_t(0)) {
+            zMax0[tile] = std::min(zMax0[tile], zMax1[tile]);
+            zMax1[tile] = 0.0f;
+            mask[tile] = 0;
+        }
+    }
+
+    // 前方クリップ面の内側にある三角形をラスタライズする
+    //  c0, c1, c2: 頂点のクリップ座標
+    void rasterize(const GLfloat *c0, const GLfloat *c1, const GLfloat *c2) {
+        const GLfloat *const c[] = { c0, c1, c2 };
+        GLfloat x[3], y[3], z[3];
+        for (int k = 0; k < 3; ++k) {
+            const GLfloat w(1.0f / c[k][3]);
+            x[k] = (c[k][0] * w * 0.5f + 0.5f) * width;
+            y[k] = (0.5f - c[k][1] * w * 0.5f) * height;
+            z[k] = c[k][2] * w * 0.5f + 0.5f;
+        }
+
+        // 画面の y 軸は下向きなので反時計回りの表面は面積が負になる (裏面は捨てる)
+        GLfloat area((x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]));
+        if (!(area < 0.0f)) return;
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        area = -area;
+
+        // 重なるタイルの範囲
+        const GLint tx0(std::max(0, static_cast<GLint>(std::min({ x[0], x[1], x[2] })) / tileWidth));
+        const GLint ty0(std::max(0, static_cast<GLint>(std::min({ y[0], y[1], y[2] })) / tileHeight));
+        const GLint tx1(std::min(tilesX - 1, static_cast<GLint>(std::max({ x[0], x[1], x[2] })) / tileWidth));
+        const GLint ty1(std::min(tilesY - 1, static_cast<GLint>(std::max({ y[0], y[1], y[2] })) / tileHeight));
+        if (tx0 > tx1 || ty0 > ty1) return;
+
+        // 辺関数 (a x + b y + c >= 0 が内側) と深度の平面
+        GLfloat edge[3][3], depth[3];
+        for (int k = 0; k < 3; ++k) {
+            const int i((k + 1) % 3), j((k + 2) % 3);
+            const GLfloat dx(x[j] - x[i]), dy(y[j] - y[i]);
+            edge[k][0] = -dy;
+            edge[k][1] = dx;
+            edge[k][2] = dy * x[i] - dx * y[i];
+        }
+        for (int n = 0; n < 3; ++n) {
+            depth[n] = (z[0] * edge[0][n] + z[1] * edge[1][n] + z[2] * edge[2][n]) / area;
+        }
+        const GLfloat zmax(std::max({ z[0], z[1], z[2] }));
+
+        const float4 a0(edge[0][0]), a1(edge[1][0]), a2(edge[2][0]);
+        const float4 offset(0.5f, 1.5f, 2.5f, 3.5f), zero(0.0f);
+        for (GLint ty = ty0; ty <= ty1; ++ty) {
+            for (GLint tx = tx0; tx <= tx1; ++tx) {
+                const GLint px(tx * tileWidth), py(ty * tileHeight);
+
+                // 4 画素ずつ辺関数を求めて覆う画素のマスクを作る
+                std::uint32_t coverage(0);
+                for (GLint r = 0; r < tileHeight; ++r) {
+                    const GLfloat cy(py + r + 0.5f);
+                    const float4 r0(edge[0][1] * cy + edge[0][2]);
+                    const float4 r1(edge[1][1] * cy + edge[1][2]);
+                    const float4 r2(edge[2][1] * cy + edge[2][2]);
+                    for (GLint h = 0; h < tileWidth; h += 4) {
+                        const float4 cx(float4(static_cast<GLfloat>(px + h)) + offset);
+                        const float4 inside((a0 * cx + r0 >= zero) & (a1 * cx + r1 >= zero) & (a2 * cx + r2 >= zero));
+                        coverage |= static_cast<std::uint32_t>(movemask(inside)) << (r * tileWidth + h);
+                    }
+                }
+                if (coverage == 0) continue;
+
+                // タイルの隅の画素の中心で深度の平面が最も遠くなるところ
+                const GLfloat cx(depth[0] > 0.0f ? px + tileWidth - 0.5f : px + 0.5f);
+                const GLfloat cy(depth[1] > 0.0f ? py + tileHeight - 0.5f : py + 0.5f);
+                update(ty * tilesX + tx, coverage, std::min(zmax, depth[0] * cx + depth[1] * cy + depth[2]));
+            }
+        }
+    }
+
+    // 前方クリップ面で切り取ってからラスタライズする
+    void clipTriangle(const GLfloat *c0, const GLfloat *c1, const GLfloat *c2) {
+        const GLfloat *const c[] = { c0, c1, c2 };
+
+        // 全ての頂点が同じクリップ面の外にあれば捨てる
+        for (int k = 0; k < 3; ++k) {
+            if (c0[k] > c0[3] && c1[k] > c1[3] && c2[k] > c2[3]) return;
+            if (c0[k] < -c0[3] && c1[k] < -c1[3] && c2[k] < -c2[3]) return;
+        }
+
+        // 前方クリップ面 (z + w >= 0) からの距離
+        GLfloat d[3];
+        int inside(0);
+        for (int k = 0; k < 3; ++k) {
+            d[k] = c[k][2] + c[k][3];
+            if (d[k] >= 0.0f) ++inside;
+        }
+        if (inside == 3) {
+            rasterize(c0, c1, c2);
+            return;
+        }
+
+        // 内側の頂点と辺の交点で多角形を作る
+        GLfloat polygon[4][4];
+        int count(0);
+        for (int k = 0; k < 3; ++k) {
+            const int j((k + 1) % 3);
+            if (d[k] >= 0.0f) std::copy(c[k], c[k] + 4, polygon[count++]);
+            if ((d[k] >= 0.0f) != (d[j] >= 0.0f)) {
+                const GLfloat s(d[k] / (d[k] - d[j]));
+                for (int i = 0; i < 4; ++i) polygon[count][i] = c[k][i] + (c[j][i] - c[k][i]) * s;
+                ++count;
+            }
+        }
+        for (int k = 2; k < count; ++k) rasterize(polygon[0], polygon[k - 1], polygon[k]);
+    }
+
+    // 境界ボックスが見えるかどうか調べる
+    //  b: 図形の座標系の境界ボックス
+    //  m: モデル変換行列と投影変換行列とビュー変換行列の積
+    bool test(const Bvh::Bounds &b, const Matrix &m) const {
+        if (b.min[0] > b.max[0]) return false;
+
+        // 8 つの隅を 4 つずつ変換して画面上の範囲と最も近い深度を求める
+        const float4 bx(b.min[0], b.max[0], b.min[0], b.max[0]);
+        const float4 by(b.min[1], b.min[1], b.max[1], b.max[1]);
+        float4 xmin(std::numeric_limits<GLfloat>::max()), xmax(-std::numeric_limits<GLfloat>::max());
+        float4 ymin(xmin), ymax(xmax), zmin(xmin);
+        for (int i = 0; i < 2; ++i) {
+            const float4 bz(b.min[2] + (b.max[2] - b.min[2]) * i);
+            const float4 cx(float4(m[0]) * bx + float4(m[4]) * by + float4(m[ 8]) * bz + float4(m[12]));
+            const float4 cy(float4(m[1]) * bx + float4(m[5]) * by + float4(m[ 9]) * bz + float4(m[13]));
+            const float4 cz(float4(m[2]) * bx + float4(m[6]) * by + float4(m[10]) * bz + float4(m[14]));
+            const float4 cw(float4(m[3]) * bx + float4(m[7]) * by + float4(m[11]) * bz + float4(m[15]));
+
+            // 前方クリップ面にかかっていれば見えるものとする
+            if (movemask(cz + cw <= float4(0.0f))) return true;
+            const float4 w(float4(1.0f) / cw);
+            const float4 sx((cx * w * float4(0.5f) + float4(0.5f)) * float4(static_cast<GLfloat>(width)));
+            const float4 sy((float4(0.5f) - cy * w * float4(0.5f)) * float4(static_cast<GLfloat>(height)));
+            xmin = min(xmin, sx);
+            xmax = max(xmax, sx);
+            ymin = min(ymin, sy);
+            ymax = max(ymax, sy);
+            zmin = min(zmin, cz * w * float4(0.5f) + float4(0.5f));
+        }
+        GLfloat r[4][4], z[4];
+        xmin.store(r[0]);
+        ymin.store(r[1]);
+        xmax.store(r[2]);
+        ymax.store(r[3]);
+        zmin.store(z);
+        const GLfloat x0(std::min({ r[0][0], r[0][1], r[0][2], r[0][3] }));
+        const GLfloat y0(std::min({ r[1][0], r[1][1], r[1][2], r[1][3] }));
+        const GLfloat x1(std::max({ r[2][0], r[2][1], r[2][2], r[2][3] }));
+        const GLfloat y1(std::max({ r[3][0], r[3][1], r[3][2], r[3][3] }));
+        const GLfloat nearest(std::min({ z[0], z[1], z[2], z[3] }));
+
+        // 画面の外や後方クリップ面より遠ければ見えない
+        if (x1 < 0.0f || y1 < 0.0f || x0 >= width || y0 >= height || nearest > 1.0f) return false;
+
+        // 重なるタイルのどれかで全体を覆う深度より手前なら見える
+        const GLint tx0(std::max(0, static_cast<GLint>(x0) / tileWidth));
+        const GLint ty0(std::max(0, static_cast<GLint>(y0) / tileHeight));
+        const GLint tx1(std::min(tilesX - 1, static_cast<GLint>(x1) / tileWidth));
+        const GLint ty1(std::min(tilesY - 1, static_cast<GLint>(y1) / tileHeight));
+        const float4 zn(nearest);
+        for (GLint ty = ty0; ty <= ty1; ++ty) {
+            const GLfloat *const row(&zMax0[ty * tilesX]);
+            GLint tx(tx0);
+            for (; tx + 4 <= tx1 + 1; tx += 4) {
+                if (movemask(zn <= float4::load(row + tx))) return true;
+            }
+            for (; tx <= tx1; ++tx) {
+                if (nearest <= row[tx]) return true;
+            }
+        }
+        return false;
+    }
+
+    // 1 フレーム分の判定を行う
+    void run(Frame &f) {
+        const std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+
+        // タイルを消去する
+        std::fill(zMax0.begin(), zMax0.end(), 1.0f);
+        std::fill(zMax1.begin(), zMax1.end(), 0.0f);
+        std::fill(mask.begin(), mask.end(), 0u);
+
+        // 遮蔽物をラスタライズする
+        for (const Occluder &o : f.occluder) {
+            const Mesh &m(mesh[o.mesh]);
+            const Matrix mvp(f.viewProjection * o.model);
+            const std::size_t vertices(m.position.size() / 3);
+            clip.resize(vertices * 4);
+            for (std::size_t v = 0; v < vertices; ++v) {
+                const GLfloat *const p(&m.position[v * 3]);
+                for (int k = 0; k < 4; ++k) {
+                    clip[v * 4 + k] = mvp[k] * p[0] + mvp[4 + k] * p[1] + mvp[8 + k] * p[2] + mvp[12 + k];
+                }
+            }
+            for (std::size_t i = 0; i + 2 < m.index.size(); i += 3) {
+                clipTriangle(&clip[m.index[i] * 4], &clip[m.index[i + 1] * 4], &clip[m.index[i + 2] * 4]);
+            }
+        }
+
+        // インスタンスの境界ボックスを並列に調べる
+        f.visible.resize(f.instance.size());
+        ThreadPool::instance().parallelFor(f.instance.size(), 256, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                const Instance &n(f.instance[i]);
+                f.visible[i] = test(n.bounds, f.viewProjection * n.model) ? 1 : 0;
+            }
+        });
+        f.culled = static_cast<GLuint>(std::count(f.visible.begin(), f.visible.end(), 0));
+        f.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+public:
+
+    // コンストラクタ
+    //  width, height: 遮蔽物をラスタライズする画面の大きさ (8 と 4 の倍数に切り上げる)
+    OcclusionCuller(GLint width = 256, GLint height = 128)
+        : record(0), ready(1), busy(false)
+        , width((width + tileWidth - 1) / tileWidth * tileWidth)
+        , height((height + tileHeight - 1) / tileHeight * tileHeight)
+        , tilesX(this->width / tileWidth), tilesY(this->height / tileHeight)
+        , zMax0(static_cast<std::size_t>(tilesX) * tilesY)
+        , zMax1(zMax0.size()), mask(zMax0.size())
+    {
+        for (Frame &f : frame) {
+            f.culled = 0;
+            f.milliseconds = 0.0;
+        }
+    }
+
+    // デストラクタ
+    virtual ~OcclusionCuller() {
+        collect();
+    }
+
+    // 遮蔽物の図形を登録する
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列
+    //  indexcount: 頂点のインデックスの要素数 (0 なら vertex を三角形の羅列とみなす)
+    //  index: 頂点のインデックスを格納した配列
+    //  戻り値: 遮蔽物の図形の番号
+    GLuint addMesh(GLsizei vertexcount, const Object::Vertex *vertex,
+        GLsizei indexcount = 0, const GLuint *index = NULL) {
+        collect();
+        mesh.emplace_back();
+        Mesh &m(mesh.back());
+        for (GLsizei i = 0; i < vertexcount; ++i) {
+            m.position.insert(m.position.end(), vertex[i].position, vertex[i].position + 3);
+        }
+        if (indexcount > 0) m.index.assign(index, index + indexcount);
+        else for (GLsizei i = 0; i < vertexcount; ++i) m.index.push_back(static_cast<GLuint>(i));
+        return static_cast<GLuint>(mesh.size() - 1);
+    }
+
+    // 記録を始める
+    //  projection: 投影変換行列
+    //  view: ビュー変換行列
+    void setCamera(const Matrix &projection, const Matrix &view) {
+        Frame &f(frame[record]);
+        f.viewProjection = projection * view;
+        f.occluder.clear();
+        f.instance.clear();
+    }
+
+    // 遮蔽物を加える
+    //  mesh: addMesh で得た遮蔽物の図形の番号
+    //  model: モデル変換行列
+    void addOccluder(GLuint mesh, const Matrix &model) {
+        const Occluder o = { mesh, model };
+        frame[record].occluder.push_back(o);
+    }
+
+    // 判定するインスタンスを加える
+    //  bounds: 図形の座標系の境界ボックス
+    //  model: モデル変換行列
+    //  戻り値: インスタンスの番号
+    GLuint addInstance(const Bvh::Bounds &bounds, const Matrix &model) {
+        const Instance i = { bounds, model };
+        frame[record].instance.push_back(i);
+        return static_cast<GLuint>(frame[record].instance.size() - 1);
+    }
+
+    // 記録したフレームの判定をワーカースレッドで始める
+    void submit() {
+        collect();
+        ready = record;
+        record ^= 1;
+        busy.store(true, std::memory_order_release);
+        ThreadPool::instance().submit([this] {
+            run(frame[ready]);
+            busy.store(false, std::memory_order_release);
+        });
+    }
+
+    // 判定が終わるまで待つ
+    void collect() const {
+        while (busy.load(std::memory_order_acquire)) std::this_thread::yield();
+    }
+
+    // インスタンスが見えるかどうか (前に submit したフレームの結果, collect の後で呼ぶ)
+    //  instance: インスタンスの番号 (結果がなければ見えるものとする)
+    bool isVisible(GLuint instance) const {
+        const Frame &f(frame[ready]);
+        return instance >= f.visible.size() || f.visible[instance] != 0;
+    }
+
+    // 判定したインスタンスの数
+    std::size_t getTested() const { return frame[ready].visible.size(); }
+
+    // 隠れていたインスタンスの数
+    GLuint getCulled() const { return frame[ready].culled; }
+
+    // 判定にかかった時間 (ミリ秒)
+    double getMilliseconds() const { return frame[ready].milliseconds; }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    OcclusionCuller(const OcclusionCuller &c);
+
+    // 代入によるコピー禁止
+    OcclusionCuller &operator=(const OcclusionCuller &c);
+};
@@ -0,0 +1,116 @@
+#pragma once
+#include <stdio.h>
+#include <GL/glew.h>
+
+// 粒子のシミュレーション
+#include "Particles.h"
+
+// 粒子を描画するための転送用バッファ
+//  永続マップしたバッファを三つの領域に分けてフレームごとに順に使い, フェンスで GPU が読み終えたのを確かめて書き込む
+//  シェーダは gl_VertexID / 6 番目の粒子をシェーダストレージバッファから読んで正方形を作るので,
+//  頂点属性を使わず一度の描画で全ての粒子を描く
+class ParticleStream {
+
+    // 領域の数
+    static const int regions = 3;
+
+    // 転送用バッファと空の頂点配列オブジェクト
+    GLuint buffer, vao;
+
+    // 一つの領域に入る粒子数
+    std::size_t capacity;
+
+    // マップしたバッファの先頭
+    GLfloat *mapped;
+
+    // 領域ごとの GPU の読み出しの終わりを示すフェンス
+    GLsync fence[regions];
+
+    // 次に書き込む領域
+    int region;
+
+    // 最後に書き込んだ領域と粒子数
+    int current;
+    std::size_t count;
+
+public:
+
+    // コンストラクタ
+    //  capacity: 一度に描く粒子数の上限 (領域の境界を揃えるために Particles::blockSize の倍数に切り上げる)
+    ParticleStream(std::size_t capacity)
+        : capacity((capacity + Particles::blockSize - 1) / Particles::blockSize * Particles::blockSize), fence{}, region(0), current(0), count(0)
+    {
+        // 明示的に書き込んだ範囲を知らせるので一貫性は要らない
+        const GLsizeiptr size(static_cast<GLsizeiptr>(this->capacity * regions * 4 * sizeof (GLfloat)));
+        const GLbitfield flags(GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, size, NULL, flags);
+        mapped = static_cast<GLfloat *>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, size, flags));
+        if (mapped == NULL) printf("Error : Can't map the particle buffer.\n");
+        glGenVertexArrays(1, &vao);
+    }
+
+    // デストラクタ
+    virtual ~ParticleStream() {
+        for (GLsync f : fence) if (f) glDeleteSync(f);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+        glDeleteBuffers(1, &buffer);
+        glDeleteVertexArrays(1, &vao);
+    }
+
+    // 粒子を次の領域に書き込む
+    //  particles: 書き込む粒子
+    void update(const Particles &particles) {
+        if (mapped == NULL) return;
+
+        // GPU がこの領域を読み終えるのを待つ
+        if (fence[region]) {
+            while (glClientWaitSync(fence[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+            glDeleteSync(fence[region]);
+            fence[region] = 0;
+        }
+
+        if (particles.size() > capacity) {
+            printf("Error : Too many particles: %zu\n", particles.size());
+            count = 0;
+            return;
+        }
+        count = particles.size();
+        GLfloat *const dst(mapped + region * capacity * 4);
+        particles.write(dst);
+
+        const GLintptr at(static_cast<GLintptr>(region * capacity * 4 * sizeof (GLfloat)));
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glFlushMappedBufferRange(GL_SHADER_STORAGE_BUFFER, at, static_cast<GLsizeiptr>(count * 4 * sizeof (GLfloat)));
+        current = region;
+        region = (region + 1) % regions;
+    }
+
+    // 最後に書き込んだ粒子を描く
+    //  bp: 粒子を結合するシェーダストレージブロックの結合ポイント
+    void draw(GLuint bp = 6) {
+        if (count == 0) return;
+        const GLintptr at(static_cast<GLintptr>(current * capacity * 4 * sizeof (GLfloat)));
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, bp, buffer, at, static_cast<GLsizeiptr>(count * 4 * sizeof (GLfloat)));
+        glBindVertexArray(vao);
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, static_cast<GLsizei>(count * 6), 1, 0);
+        glBindVertexArray(0);
+
+        // この領域を次に書き込むときに待つフェンス
+        if (fence[current]) glDeleteSync(fence[current]);
+        fence[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // 描く粒子数
+    std::size_t size() const { return count; }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    ParticleStream(const ParticleStream &p);
+
+    // 代入によるコピー禁止
+    ParticleStream &operator=(const ParticleStream &p);
+};
@@ -0,0 +1,253 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <GL/glew.h>
+
+// SIMD 演算
+#include "Simd.h"
+
+// 並列処理
+#include "ThreadPool.h"
+
+// 大量の粒子のシミュレーション
+//  位置, 速度, 残り寿命を要素ごとの配列 (SoA) に持ち, float4 で 4 個ずつ積分する
+//  配列は blockSize 個ずつのブロックに分け, ブロックごとに並列に積分, 寿命の尽きた粒子の詰め直し,
+//  放出を行うので, 更新中に確保し直したりブロックをまたいで移動したりすることはない
+//  ブロックの間の隙間は write で描画用の配列に書き出すときに詰める
+class Particles {
+public:
+
+    // 一つのブロックの粒子数 (4 の倍数)
+    static const std::size_t blockSize = 4096;
+
+    // 放出源
+    struct Emitter {
+        // 位置
+        GLfloat position[3];
+
+        // 初速の平均
+        GLfloat velocity[3];
+
+        // 初速のばらつき (各成分に ±spread の一様乱数を加える)
+        GLfloat spread;
+
+        // 寿命 (秒, 個々の粒子は 0.5 倍から 1 倍)
+        GLfloat lifetime;
+
+        // 1 秒あたりに放出する粒子数
+        GLfloat rate;
+    };
+
+private:
+
+    // 粒子の位置, 速度, 残り寿命
+    std::vector<GLfloat> px, py, pz, vx, vy, vz, life;
+
+    // ブロックごとの生きている粒子数
+    std::vector<GLuint> count;
+
+    // ブロックごとにこのステップで放出する粒子数
+    std::vector<GLuint> quota;
+
+    // ブロックごとの write での書き出し位置
+    std::vector<std::size_t> offset;
+
+    // 生きている粒子の総数
+    std::size_t alive;
+
+    // 放出源
+    Emitter emitter;
+
+    // 重力加速度と空気抵抗の係数
+    GLfloat gravity[3], drag;
+
+    // まだ放出していない端数
+    double pending;
+
+    // 次に放出を始めるブロック
+    std::size_t cursor;
+
+    // 乱数の種に使うステップ数
+    std::uint32_t steps;
+
+    // ブロックごとの乱数 (xorshift32)
+    static GLfloat random(std::uint32_t &s) {
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        return static_cast<GLfloat>(s >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // 一つのブロックの積分, 詰め直し, 放出
+    //  b: ブロック番号
+    //  dt: 時間刻み
+    void step(std::size_t b, GLfloat dt) {
+        const std::size_t base(b * blockSize);
+        GLfloat *const x(px.data() + base), *const y(py.data() + base), *const z(pz.data() + base);
+        GLfloat *const u(vx.data() + base), *const v(vy.data() + base), *const w(vz.data() + base);
+        GLfloat *const l(life.data() + base);
+        const std::size_t n(count[b]);
+
+        // 半陰的オイラー法で積分する
+        const float4 t(dt), zero(0.0f);
+        const float4 gx(gravity[0] * dt), gy(gravity[1] * dt), gz(gravity[2] * dt);
+        const float4 damping(1.0f / (1.0f + drag * dt));
+        std::size_t kept(0);
+        for (std::size_t i = 0; i < n; i += 4) {
+            const float4 nu((float4::load(u + i) + gx) * damping);
+            const float4 nv((float4::load(v + i) + gy) * damping);
+            const float4 nw((float4::load(w + i) + gz) * damping);
+            const float4 nx(float4::load(x + i) + nu * t);
+            const float4 ny(float4::load(y + i) + nv * t);
+            const float4 nz(float4::load(z + i) + nw * t);
+            const float4 nl(float4::load(l + i) - t);
+
+            // 寿命が残っていて末尾より前にあるものだけを残す
+            const int valid(n - i >= 4 ? 0xf : (1 << (n - i)) - 1);
+            const int live(movemask(nl > zero) & valid);
+            if (live == 0xf && kept == i) {
+                nu.store(u + i); nv.store(v + i); nw.store(w + i);
+                nx.store(x + i); ny.store(y + i); nz.store(z + i);
+                nl.store(l + i);
+                kept += 4;
+            }
+            else if (live != 0) {
+                // 4 個とも読み込み済みなので前に詰めて書いても壊さない
+                alignas(16) GLfloat e[7][4];
+                nu.store(e[0]); nv.store(e[1]); nw.store(e[2]);
+                nx.store(e[3]); ny.store(e[4]); nz.store(e[5]);
+                nl.store(e[6]);
+                for (int k = 0; k < 4; ++k) {
+                    if (!(live & (1 << k))) continue;
+                    u[kept] = e[0][k]; v[kept] = e[1][k]; w[kept] = e[2][k];
+                    x[kept] = e[3][k]; y[kept] = e[4][k]; z[kept] = e[5][k];
+                    l[kept] = e[6][k];
+                    ++kept;
+                }
+            }
+        }
+
+        // 空いたところに放出する
+        std::uint32_t s(static_cast<std::uint32_t>(b) * 0x9e3779b9u ^ (steps * 0x85ebca6bu + 1u));
+        for (GLuint k = 0; k < quota[b]; ++k, ++kept) {
+            x[kept] = emitter.position[0];
+            y[kept] = emitter.position[1];
+            z[kept] = emitter.position[2];
+            u[kept] = emitter.velocity[0] + (random(s) * 2.0f - 1.0f) * emitter.spread;
+            v[kept] = emitter.velocity[1] + (random(s) * 2.0f - 1.0f) * emitter.spread;
+            w[kept] = emitter.velocity[2] + (random(s) * 2.0f - 1.0f) * emitter.spread;
+            l[kept] = emitter.lifetime * (0.5f + 0.5f * random(s));
+        }
+        count[b] = static_cast<GLuint>(kept);
+    }
+
+public:
+
+    // コンストラクタ
+    //  capacity: 粒子数の上限 (blockSize の倍数に切り上げる)
+    Particles(std::size_t capacity)
+        : alive(0), emitter{ { 0.0f, 0.0f, 0.0f }, { 0.0f, 4.0f, 0.0f }, 1.0f, 2.0f, 0.0f }
+        , gravity{ 0.0f, -9.8f, 0.0f }, drag(0.1f), pending(0.0), cursor(0), steps(0)
+    {
+        const std::size_t blocks((std::max<std::size_t>(capacity, 1) + blockSize - 1) / blockSize);
+        for (std::vector<GLfloat> *a : { &px, &py, &pz, &vx, &vy, &vz, &life }) a->resize(blocks * blockSize);
+        count.resize(blocks, 0);
+        quota.resize(blocks, 0);
+        offset.resize(blocks, 0);
+    }
+
+    // デストラクタ
+    virtual ~Particles() {}
+
+    // 放出源を設定する
+    void setEmitter(const Emitter &e) { emitter = e; }
+
+    // 重力加速度と空気抵抗の係数を設定する
+    void setForces(GLfloat gx, GLfloat gy, GLfloat gz, GLfloat d) {
+        gravity[0] = gx;
+        gravity[1] = gy;
+        gravity[2] = gz;
+        drag = d;
+    }
+
+    // 時間を進める
+    //  dt: 時間刻み (秒)
+    void update(GLfloat dt) {
+        const std::size_t blocks(count.size());
+
+        // このステップで放出する数を空いているブロックに順に割り当てる
+        //  詰め直しでブロックの空きは増えるだけなので更新前の空きで割り当てて良い
+        pending += static_cast<double>(emitter.rate) * dt;
+        std::size_t emit(std::min(static_cast<std::size_t>(pending), getCapacity() - alive));
+        pending -= static_cast<double>(emit);
+        if (alive + emit == getCapacity()) pending = 0.0;
+        std::fill(quota.begin(), quota.end(), 0u);
+        for (std::size_t i = 0; i < blocks && emit > 0; ++i) {
+            const std::size_t b((cursor + i) % blocks);
+            const std::size_t q(std::min(emit, blockSize - count[b]));
+            quota[b] = static_cast<GLuint>(q);
+            emit -= q;
+            if (q > 0) cursor = b;
+        }
+        ++steps;
+
+        // ブロックごとに並列に処理する
+        ThreadPool::instance().parallelFor(blocks, 4, [this, dt](std::size_t begin, std::size_t end) {
+            for (std::size_t b = begin; b < end; ++b) step(b, dt);
+        });
+
+        // 書き出し位置を求める
+        alive = 0;
+        for (std::size_t b = 0; b < blocks; ++b) {
+            offset[b] = alive;
+            alive += count[b];
+        }
+    }
+
+    // 生きている粒子を描画用に書き出す
+    //  dst: 粒子ごとに位置と寿命の残りの割合 (x, y, z, 0〜1) を詰めて書く配列 (size() * 4 要素)
+    void write(GLfloat *dst) const {
+        const float4 scale(emitter.lifetime > 0.0f ? 1.0f / emitter.lifetime : 0.0f);
+        ThreadPool::instance().parallelFor(count.size(), 4, [this, dst, scale](std::size_t begin, std::size_t end) {
+            for (std::size_t b = begin; b < end; ++b) {
+                const std::size_t base(b * blockSize), n(count[b]);
+                GLfloat *d(dst + offset[b] * 4);
+                std::size_t i(0);
+
+                // 4 個ずつ SoA から AoS に転置する
+                for (; i + 4 <= n; i += 4, d += 16) {
+                    float4 x(float4::load(px.data() + base + i));
+                    float4 y(float4::load(py.data() + base + i));
+                    float4 z(float4::load(pz.data() + base + i));
+                    float4 l(float4::load(life.data() + base + i) * scale);
+                    float4::transpose(x, y, z, l);
+                    x.store(d);
+                    y.store(d + 4);
+                    z.store(d + 8);
+                    l.store(d + 12);
+                }
+                for (; i < n; ++i, d += 4) {
+                    d[0] = px[base + i];
+                    d[1] = py[base + i];
+                    d[2] = pz[base + i];
+                    d[3] = life[base + i] * scale[0];
+                }
+            }
+        });
+    }
+
+    // 生きている粒子数
+    std::size_t size() const { return alive; }
+
+    // 粒子数の上限
+    std::size_t getCapacity() const { return count.size() * blockSize; }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    Particles(const Particles &p);
+
+    // 代入によるコピー禁止
+    Particles &operator=(const Particles &p);
+};
@@ -0,0 +1,309 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <GL/glew.h>
+
+// 図形データ
+#include "Object.h"
+
+// コンパイル時に作る基本図形
+//  分割数をテンプレート引数にして頂点属性とインデックスを std::array に作るので,
+//  constexpr の変数に入れれば起動時の計算もヒープの確保もない
+//  三角形は外から見て反時計回りで, 球・円環・円柱の継ぎ目の頂点は createSphere と同じく重ねて持つ
+class Primitive {
+    // 円周率
+    static constexpr double pi = 3.14159265358979323846;
+
+    // constexpr の正弦 (-π/2 〜 π/2 に畳んでからテイラー級数で求める)
+    //  x: 角度 (ラジアン)
+    static constexpr double sine(double x) {
+        const double turns(x / (2.0 * pi));
+        long long n(static_cast<long long>(turns));
+        if (turns - static_cast<double>(n) > 0.5) ++n;
+        if (turns - static_cast<double>(n) < -0.5) --n;
+        x -= 2.0 * pi * static_cast<double>(n);
+        if (x > 0.5 * pi) x = pi - x;
+        if (x < -0.5 * pi) x = -pi - x;
+
+        double term(x), sum(x);
+        for (int k = 1; k < 12; ++k) {
+            term *= -x * x / static_cast<double>((2 * k) * (2 * k + 1));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // constexpr の余弦
+    //  x: 角度 (ラジアン)
+    static constexpr double cosine(double x) {
+        return sine(x + 0.5 * pi);
+    }
+
+    // 頂点属性を作る
+    static constexpr Object::Vertex vertex(double x, double y, double z, double nx, double ny, double nz) {
+        return Object::Vertex{
+            { static_cast<GLfloat>(x), static_cast<GLfloat>(y), static_cast<GLfloat>(z) },
+            { static_cast<GLfloat>(nx), static_cast<GLfloat>(ny), static_cast<GLfloat>(nz) }
+        };
+    }
+
+    // 格子状に並べた頂点を二つずつの三角形でつなぐ (createSphere と同じ並び)
+    //  index: インデックスの格納先
+    //  at: 書き込む位置 (書き込んだ後の位置になる)
+    //  base: 格子の先頭の頂点の番号
+    //  slices: 横方向の分割数
+    //  stacks: 縦方向の分割数
+    template <std::size_t count>
+    static constexpr void grid(std::array<GLuint, count> &index, std::size_t &at,
+        GLuint base, std::size_t slices, std::size_t stacks) {
+        for (std::size_t j = 0; j < stacks; ++j) {
+            const GLuint k(static_cast<GLuint>(base + (slices + 1) * j));
+
+            for (std::size_t i = 0; i < slices; ++i) {
+                // 頂点のインデックス
+                const GLuint k0(static_cast<GLuint>(k + i));
+                const GLuint k1(k0 + 1);
+                const GLuint k2(static_cast<GLuint>(k1 + slices));
+                const GLuint k3(k2 + 1);
+
+                // 左下の三角形
+                index[at++] = k0;
+                index[at++] = k2;
+                index[at++] = k3;
+
+                // 右上の三角形
+                index[at++] = k0;
+                index[at++] = k3;
+                index[at++] = k1;
+            }
+        }
+    }
+
+public:
+
+    // 頂点属性とインデックス
+    template <std::size_t vertexCount, std::size_t indexCount>
+    struct Mesh {
+        // 頂点属性
+        std::array<Object::Vertex, vertexCount> vertex;
+
+        // 三角形の頂点のインデックス
+        std::array<GLuint, indexCount> index;
+    };
+
+    // 球 (createSphere と同じ頂点の並び)
+    //  slices: 経度方向の分割数
+    //  stacks: 緯度方向の分割数
+    //  radius: 半径
+    template <std::size_t slices, std::size_t stacks>
+    static constexpr Mesh<(slices + 1) * (stacks + 1), slices * stacks * 6> sphere(double radius = 1.0) {
+        static_assert(slices >= 3 && stacks >= 2, "Too few sphere divisions");
+        Mesh<(slices + 1) * (stacks + 1), slices * stacks * 6> mesh{};
+
+        std::size_t v(0);
+        for (std::size_t j = 0; j <= stacks; ++j) {
+            const double t(static_cast<double>(j) / static_cast<double>(stacks));
+            const double y(cosine(pi * t)), r(sine(pi * t));
+
+            for (std::size_t i = 0; i <= slices; ++i) {
+                const double s(static_cast<double>(i) / static_cast<double>(slices));
+                const double z(r * cosine(2.0 * pi * s)), x(r * sine(2.0 * pi * s));
+                mesh.vertex[v++] = vertex(x * radius, y * radius, z * radius, x, y, z);
+            }
+        }
+
+        std::size_t at(0);
+        grid(mesh.index, at, 0, slices, stacks);
+        return mesh;
+    }
+
+    // 面ごとに法線を変えた六面体 (中心が原点で一辺が 2)
+    //  divisions: 一辺の分割数
+    template <std::size_t divisions = 1>
+    static constexpr Mesh<6 * (divisions + 1) * (divisions + 1), 6 * divisions * divisions * 6> cube() {
+        static_assert(divisions >= 1, "Too few cube divisions");
+        Mesh<6 * (divisions + 1) * (divisions + 1), 6 * divisions * divisions * 6> mesh{};
+
+        // 面の法線と面に沿った二つの軸 (u × w = 法線), 並びは左, 裏, 下, 右, 上, 前
+        constexpr double face[6][3][3] = {
+            { { -1.0,  0.0,  0.0 }, {  0.0,  0.0,  1.0 }, {  0.0,  1.0,  0.0 } },
+            { {  0.0,  0.0, -1.0 }, {  0.0,  1.0,  0.0 }, {  1.0,  0.0,  0.0 } },
+            { {  0.0, -1.0,  0.0 }, {  1.0,  0.0,  0.0 }, {  0.0,  0.0,  1.0 } },
+            { {  1.0,  0.0,  0.0 }, {  0.0,  1.0,  0.0 }, {  0.0,  0.0,  1.0 } },
+            { {  0.0,  1.0,  0.0 }, {  0.0,  0.0,  1.0 }, {  1.0,  0.0,  0.0 } },
+            { {  0.0,  0.0,  1.0 }, {  1.0,  0.0,  0.0 }, {  0.0,  1.0,  0.0 } }
+        };
+
+        std::size_t v(0), at(0);
+        for (std::size_t f = 0; f < 6; ++f) {
+            const double *const n(face[f][0]), *const u(face[f][1]), *const w(face[f][2]);
+            const GLuint base(static_cast<GLuint>(v));
+
+            // 面の格子の頂点は u の向きに並べて w の向きに重ねる
+            for (std::size_t j = 0; j <= divisions; ++j) {
+                const double b(2.0 * static_cast<double>(j) / static_cast<double>(divisions) - 1.0);
+
+                for (std::size_t i = 0; i <= divisions; ++i) {
+                    const double a(2.0 * static_cast<double>(i) / static_cast<double>(divisions) - 1.0);
+                    mesh.vertex[v++] = vertex(
+                        n[0] + u[0] * a + w[0] * b,
+                        n[1] + u[1] * a + w[1] * b,
+                        n[2] + u[2] * a + w[2] * b,
+                        n[0], n[1], n[2]);
+                }
+            }
+
+            // u から w に回る向きが表になるように三角形をつなぐ
+            for (std::size_t j = 0; j < divisions; ++j) {
+                const GLuint k(static_cast<GLuint>(base + (divisions + 1) * j));
+
+                for (std::size_t i = 0; i < divisions; ++i) {
+                    const GLuint k0(static_cast<GLuint>(k + i));
+                    const GLuint k1(k0 + 1);
+                    const GLuint k2(static_cast<GLuint>(k1 + divisions));
+                    const GLuint k3(k2 + 1);
+
+                    mesh.index[at++] = k0;
+                    mesh.index[at++] = k1;
+                    mesh.index[at++] = k3;
+
+                    mesh.index[at++] = k0;
+                    mesh.index[at++] = k3;
+                    mesh.index[at++] = k2;
+                }
+            }
+        }
+        return mesh;
+    }
+
+    // 面ごとに法線を変えた八面体 (頂点が各軸の ±1)
+    //  divisions: 三角形の一辺の分割数
+    template <std::size_t divisions = 1>
+    static constexpr Mesh<8 * (divisions + 1) * (divisions + 2) / 2, 8 * divisions * divisions * 3> octahedron() {
+        static_assert(divisions >= 1, "Too few octahedron divisions");
+        Mesh<8 * (divisions + 1) * (divisions + 2) / 2, 8 * divisions * divisions * 3> mesh{};
+
+        // 面の中での格子点 (i, j) の番号
+        constexpr auto point = [](std::size_t i, std::size_t j) {
+            return j * (divisions + 1) - j * (j - 1) / 2 + i;
+        };
+
+        // 単位法線ベクトルの成分の大きさ (1 / √3)
+        constexpr double d(0.57735026918962576451);
+
+        std::size_t v(0), at(0);
+        for (int f = 0; f < 8; ++f) {
+            const double sx(f & 1 ? -1.0 : 1.0), sy(f & 2 ? -1.0 : 1.0), sz(f & 4 ? -1.0 : 1.0);
+
+            // 三角形の角 (外から見て反時計回りになるように b と c を選ぶ)
+            const double a[3] = { sx, 0.0, 0.0 };
+            double b[3] = { 0.0, sy, 0.0 }, c[3] = { 0.0, 0.0, sz };
+            if (sx * sy * sz < 0.0) {
+                b[1] = 0.0; b[2] = sz;
+                c[1] = sy; c[2] = 0.0;
+            }
+            const GLuint base(static_cast<GLuint>(v));
+
+            for (std::size_t j = 0; j <= divisions; ++j) {
+                const double q(static_cast<double>(j) / static_cast<double>(divisions));
+
+                for (std::size_t i = 0; i + j <= divisions; ++i) {
+                    const double p(static_cast<double>(i) / static_cast<double>(divisions));
+                    mesh.vertex[v++] = vertex(
+                        a[0] + (b[0] - a[0]) * p + (c[0] - a[0]) * q,
+                        a[1] + (b[1] - a[1]) * p + (c[1] - a[1]) * q,
+                        a[2] + (b[2] - a[2]) * p + (c[2] - a[2]) * q,
+                        sx * d, sy * d, sz * d);
+                }
+            }
+
+            for (std::size_t j = 0; j < divisions; ++j) {
+                for (std::size_t i = 0; i + j < divisions; ++i) {
+                    mesh.index[at++] = static_cast<GLuint>(base + point(i, j));
+                    mesh.index[at++] = static_cast<GLuint>(base + point(i + 1, j));
+                    mesh.index[at++] = static_cast<GLuint>(base + point(i, j + 1));
+                    if (i + j + 1 < divisions) {
+                        mesh.index[at++] = static_cast<GLuint>(base + point(i + 1, j));
+                        mesh.index[at++] = static_cast<GLuint>(base + point(i + 1, j + 1));
+                        mesh.index[at++] = static_cast<GLuint>(base + point(i, j + 1));
+                    }
+                }
+            }
+        }
+        return mesh;
+    }
+
+    // y 軸を囲む円環
+    //  slices: y 軸のまわりの分割数
+    //  stacks: 管のまわりの分割数
+    //  major: 中心から管の中心までの距離
+    //  minor: 管の半径
+    template <std::size_t slices, std::size_t stacks>
+    static constexpr Mesh<(slices + 1) * (stacks + 1), slices * stacks * 6> torus(double major = 1.0, double minor = 0.25) {
+        static_assert(slices >= 3 && stacks >= 3, "Too few torus divisions");
+        Mesh<(slices + 1) * (stacks + 1), slices * stacks * 6> mesh{};
+
+        // 管のまわりは球の緯度と同じく上から回る
+        std::size_t v(0);
+        for (std::size_t j = 0; j <= stacks; ++j) {
+            const double t(static_cast<double>(j) / static_cast<double>(stacks));
+            const double y(cosine(2.0 * pi * t)), r(sine(2.0 * pi * t));
+
+            for (std::size_t i = 0; i <= slices; ++i) {
+                const double s(static_cast<double>(i) / static_cast<double>(slices));
+                const double cz(cosine(2.0 * pi * s)), cx(sine(2.0 * pi * s));
+                const double l(major + minor * r);
+                mesh.vertex[v++] = vertex(cx * l, y * minor, cz * l, cx * r, y, cz * r);
+            }
+        }
+
+        std::size_t at(0);
+        grid(mesh.index, at, 0, slices, stacks);
+        return mesh;
+    }
+
+    // y 軸に沿って中心が原点にある蓋つきの円柱
+    //  slices: 円周方向の分割数
+    //  stacks: 高さ方向の分割数
+    //  radius: 半径
+    //  height: 高さ
+    template <std::size_t slices, std::size_t stacks = 1>
+    static constexpr Mesh<(slices + 1) * (stacks + 1) + 2 * (slices + 2), slices * stacks * 6 + slices * 6>
+        cylinder(double radius = 1.0, double height = 2.0) {
+        static_assert(slices >= 3 && stacks >= 1, "Too few cylinder divisions");
+        Mesh<(slices + 1) * (stacks + 1) + 2 * (slices + 2), slices * stacks * 6 + slices * 6> mesh{};
+
+        // 側面は上から下に並べる
+        std::size_t v(0);
+        for (std::size_t j = 0; j <= stacks; ++j) {
+            const double y(height * (0.5 - static_cast<double>(j) / static_cast<double>(stacks)));
+
+            for (std::size_t i = 0; i <= slices; ++i) {
+                const double s(static_cast<double>(i) / static_cast<double>(slices));
+                const double z(cosine(2.0 * pi * s)), x(sine(2.0 * pi * s));
+                mesh.vertex[v++] = vertex(x * radius, y, z * radius, x, 0.0, z);
+            }
+        }
+        std::size_t at(0);
+        grid(mesh.index, at, 0, slices, stacks);
+
+        // 上と下の蓋は中心と縁の頂点で扇形に塗る
+        for (int cap = 0; cap < 2; ++cap) {
+            const double ny(cap == 0 ? 1.0 : -1.0);
+            const GLuint center(static_cast<GLuint>(v));
+            mesh.vertex[v++] = vertex(0.0, 0.5 * height * ny, 0.0, 0.0, ny, 0.0);
+            for (std::size_t i = 0; i <= slices; ++i) {
+                const double s(static_cast<double>(i) / static_cast<double>(slices));
+                const double z(cosine(2.0 * pi * s)), x(sine(2.0 * pi * s));
+                mesh.vertex[v++] = vertex(x * radius, 0.5 * height * ny, z * radius, 0.0, ny, 0.0);
+            }
+            for (std::size_t i = 0; i < slices; ++i) {
+                const GLuint k0(static_cast<GLuint>(center + 1 + i)), k1(k0 + 1);
+                mesh.index[at++] = center;
+                mesh.index[at++] = cap == 0 ? k0 : k1;
+                mesh.index[at++] = cap == 0 ? k1 : k0;
+            }
+        }
+        return mesh;
+    }
+};
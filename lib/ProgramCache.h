@@ -0,0 +1,288 @@
+#pragma once
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <algorithm>
+#include <GL/glew.h>
+
+// シェーダの読み込みとコンパイル
+#include "Shader.h"
+
+// GL のオブジェクトの登録簿
+#include "Resources.h"
+
+// シェーダの機能の切り替え (#define で埋め込むマクロ)
+//  LIGHT_COUNT: uniform 配列で渡す光源の数
+//  CLUSTERED: クラスタに割り当てた光源だけを処理する
+//  MATERIAL_TABLE: 材質を材質の表から材質番号で参照する
+//  SPECULAR: 鏡面反射光を計算する
+//  INSTANCING: モデルビュー変換行列をインスタンスごとに参照する
+//  MULTI_DRAW: モデルビュー変換行列を描画コマンドごとに参照する
+//  VERTEX_NORMAL: 頂点属性に法線を持つ
+class ShaderVariant {
+    // マクロ名と値
+    std::map<std::string, std::string> define;
+
+public:
+
+    // マクロを定義する
+    //  name: マクロ名
+    //  value: 値
+    ShaderVariant &set(const std::string &name, const std::string &value) {
+        define[name] = value;
+        return *this;
+    }
+
+    // 整数値のマクロを定義する
+    //  name: マクロ名
+    //  value: 値
+    ShaderVariant &set(const std::string &name, int value = 1) {
+        return set(name, std::to_string(value));
+    }
+
+    // 組み合わせを識別する文字列
+    std::string key() const {
+        std::string k;
+        for (const auto &d : define) k += d.first + '=' + d.second + ';';
+        return k;
+    }
+
+    // ソースプログラムに埋め込む #define
+    std::string header() const {
+        std::string h;
+        for (const auto &d : define) h += "#define " + d.first + ' ' + d.second + '\n';
+        return h;
+    }
+};
+
+// 機能の組み合わせごとにシェーダを一度だけコンパイルするプログラムオブジェクトの表
+class ProgramCache {
+    // シェーダのソースファイルのディレクトリ
+    const std::string directory;
+
+    // 読み込んだソースファイル
+    std::unordered_map<std::string, std::string> source;
+
+    // 前処理だけ済ませたソースプログラム (コンパイルしたら捨てる)
+    std::unordered_map<std::string, std::string> prepared;
+
+    // コンパイルしたシェーダオブジェクト
+    std::unordered_map<std::string, GLuint> shader;
+
+    // リンクしたプログラムオブジェクト (Resources に登録したハンドル)
+    std::unordered_map<std::string, Resources::ProgramHandle> program;
+
+    // ソースファイルを読み込む (読み込み済みならそれを使う)
+    //  name: ソースファイル名
+    //  text: 読み込んだテキスト
+    bool read(const std::string &name, std::string &text) {
+        const auto found(source.find(name));
+        if (found == source.end()) {
+            std::vector<GLchar> buffer;
+            buffer = readShaderSource((directory + name).c_str(), buffer);
+            if (buffer.empty()) return false;
+            source.emplace(name, std::string(buffer.data()));
+            text = buffer.data();
+            return true;
+        }
+        text = found->second;
+        return true;
+    }
+
+    // #include を展開する
+    //  name: ソースファイル名
+    //  out: 展開したテキストの格納先
+    //  included: 展開済みのファイル名
+    bool expand(const std::string &name, std::string &out, std::set<std::string> &included) {
+        if (!included.insert(name).second) return true;
+
+        std::string text;
+        if (!read(name, text)) return false;
+
+        int line(0);
+        for (std::size_t begin = 0; begin < text.size();) {
+            std::size_t end(text.find('\n', begin));
+            if (end == std::string::npos) end = text.size();
+            const std::string l(text, begin, end - begin);
+            begin = end + 1;
+            ++line;
+
+            // #include "ファイル名" をファイルの内容に置き換える
+            const std::size_t directive(l.find("#include"));
+            if (directive != std::string::npos && l.find_first_not_of(" \t") == directive) {
+                const std::size_t q0(l.find('"', directive)), q1(l.find('"', q0 + 1));
+                if (q0 == std::string::npos || q1 == std::string::npos) {
+                    printf("Error : Malformed #include in %s(%d)\n", name.c_str(), line);
+                    return false;
+                }
+                out += "#line 1\n";
+                if (!expand(l.substr(q0 + 1, q1 - q0 - 1), out, included)) return false;
+                out += "#line " + std::to_string(line + 1) + '\n';
+                continue;
+            }
+            out += l;
+            out += '\n';
+        }
+        return true;
+    }
+
+    // 機能の組み合わせを埋め込んだソースプログラムを作る
+    //  name: ソースファイル名
+    //  variant: 機能の組み合わせ
+    bool preprocess(const std::string &name, const ShaderVariant &variant, std::string &out) {
+        std::string body;
+        std::set<std::string> included;
+        if (!expand(name, body, included)) return false;
+
+        // #version の行の直後に #define を差し込む
+        std::size_t after(0);
+        const std::size_t version(body.find("#version"));
+        if (version != std::string::npos) {
+            after = body.find('\n', version);
+            after = after == std::string::npos ? body.size() : after + 1;
+        }
+        const int line(1 + static_cast<int>(std::count(body.begin(), body.begin() + after, '\n')));
+        out = body.substr(0, after) + variant.header()
+            + "#line " + std::to_string(line) + '\n' + body.substr(after);
+        return true;
+    }
+
+    // シェーダオブジェクトを作る (コンパイル済みならそれを使う)
+    //  type: シェーダの種類
+    //  name: ソースファイル名
+    //  variant: 機能の組み合わせ
+    GLuint compile(GLenum type, const std::string &name, const ShaderVariant &variant) {
+        const std::string key(name + '|' + variant.key());
+        const auto found(shader.find(key));
+        if (found != shader.end()) return found->second;
+
+        std::string text;
+        const auto ready(prepared.find(key));
+        if (ready != prepared.end()) {
+            text.swap(ready->second);
+            prepared.erase(ready);
+        }
+        else if (!preprocess(name, variant, text)) return 0;
+
+        const GLuint obj(glCreateShader(type));
+        const GLchar *const src(text.c_str());
+        glShaderSource(obj, 1, &src, NULL);
+        glCompileShader(obj);
+        if (!printShaderInfoLog(obj, (name + " [" + variant.key() + "]").c_str())) {
+            glDeleteShader(obj);
+            return 0;
+        }
+
+        shader.emplace(key, obj);
+        return obj;
+    }
+
+public:
+
+    // 読み込むシェーダと機能の組み合わせ
+    struct Request {
+        std::string vert, frag;
+        ShaderVariant variant;
+    };
+
+    // コンストラクタ
+    //  directory: シェーダのソースファイルのディレクトリ (末尾に / を付ける)
+    ProgramCache(const std::string &directory = "")
+        : directory(directory)
+    {}
+
+    // デストラクタ
+    virtual ~ProgramCache() {
+        for (const auto &p : program) Resources::instance().removeProgram(p.second);
+        for (const auto &s : shader) glDeleteShader(s.second);
+    }
+
+    // 機能の組み合わせに対応するプログラムオブジェクトを返す
+    //  vert: バーテックスシェーダのソースファイル名
+    //  frag: フラグメントシェーダのソースファイル名
+    //  variant: 機能の組み合わせ
+    //  戻り値: プログラムオブジェクト名 (失敗したら 0)
+    GLuint loadProgram(const std::string &vert, const std::string &frag,
+        const ShaderVariant &variant = ShaderVariant()) {
+        const std::string key(vert + '|' + frag + '|' + variant.key());
+        const auto found(program.find(key));
+        if (found != program.end()) return Resources::instance().getProgram(found->second);
+
+        const GLuint vobj(compile(GL_VERTEX_SHADER, vert, variant));
+        const GLuint fobj(compile(GL_FRAGMENT_SHADER, frag, variant));
+        if (vobj == 0 || fobj == 0) return 0;
+
+        // プログラムオブジェクトをリンクする
+        const GLuint p(glCreateProgram());
+        glAttachShader(p, vobj);
+        glAttachShader(p, fobj);
+        glBindAttribLocation(p, 0, "position");
+        glBindAttribLocation(p, 1, "normal");
+        glBindFragDataLocation(p, 0, "fragment");
+        glLinkProgram(p);
+        glDetachShader(p, vobj);
+        glDetachShader(p, fobj);
+
+        if (!printProgramInfoLog(p)) {
+            glDeleteProgram(p);
+            return 0;
+        }
+
+        program.emplace(key, Resources::instance().addProgram(p));
+        return p;
+    }
+
+    // 機能の組み合わせに対応するプログラムオブジェクトのハンドルを返す
+    //  vert: バーテックスシェーダのソースファイル名
+    //  frag: フラグメントシェーダのソースファイル名
+    //  variant: 機能の組み合わせ
+    //  戻り値: プログラムオブジェクトのハンドル (失敗したら値が 0 のハンドル)
+    Resources::ProgramHandle getHandle(const std::string &vert, const std::string &frag,
+        const ShaderVariant &variant = ShaderVariant()) {
+        if (loadProgram(vert, frag, variant) == 0) return Resources::ProgramHandle{ 0 };
+        return program.find(vert + '|' + frag + '|' + variant.key())->second;
+    }
+
+    // 使う組み合わせを起動時にまとめてコンパイルしておく
+    //  request: 読み込むシェーダと機能の組み合わせ
+    //  戻り値: 全て成功したら true
+    bool precompile(const std::vector<Request> &request) {
+        bool ok(true);
+        for (const Request &r : request) {
+            if (loadProgram(r.vert, r.frag, r.variant) == 0) ok = false;
+        }
+        return ok;
+    }
+
+    // 使う組み合わせのソースファイルを読み込んで前処理だけしておく
+    //  GL を使わないのでワーカースレッドで呼んでよいが, その間は他のメンバ関数を呼ばない
+    //  request: 読み込むシェーダと機能の組み合わせ
+    //  戻り値: 全て成功したら true
+    bool preload(const std::vector<Request> &request) {
+        bool ok(true);
+        for (const Request &r : request) {
+            for (const std::string *name : { &r.vert, &r.frag }) {
+                const std::string key(*name + '|' + r.variant.key());
+                if (prepared.count(key) || shader.count(key)) continue;
+                std::string text;
+                if (preprocess(*name, r.variant, text)) prepared.emplace(key, text);
+                else ok = false;
+            }
+        }
+        return ok;
+    }
+
+    // コンパイル済みのプログラムオブジェクトの数
+    std::size_t size() const { return program.size(); }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    ProgramCache(const ProgramCache &o);
+
+    // 代入によるコピー禁止
+    ProgramCache &operator=(const ProgramCache &o);
+};
@@ -0,0 +1,357 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <GL/glew.h>
+
+// 変換行列
+#include "Matrix.h"
+
+// 4要素の三角関数
+#include "SimdMath.h"
+
+// 四元数による回転
+//  回転を積み重ねても正規化し直せば誤差でゆがまない
+class Quaternion {
+    // 四元数の要素 (x, y, z, w)
+    GLfloat quaternion[4];
+
+    // [0, 1] の acos の多項式近似 (Abramowitz and Stegun 4.4.46, 誤差 2e-8)
+    static float4 acosUnit(float4 x) {
+        float4 p(float4(-0.0012624911f));
+        p = p * x + float4(0.0066700901f);
+        p = p * x + float4(-0.0170881256f);
+        p = p * x + float4(0.0308918810f);
+        p = p * x + float4(-0.0501743046f);
+        p = p * x + float4(0.0889789874f);
+        p = p * x + float4(-0.2145988016f);
+        p = p * x + float4(1.5707963050f);
+        return sqrt(max(float4(1.0f) - x, float4(0.0f))) * p;
+    }
+
+    // 4 個の四元数を要素ごとのベクトルに読み込む
+    static void load(const Quaternion *q, float4 &x, float4 &y, float4 &z, float4 &w) {
+        x = float4::load(q[0].quaternion);
+        y = float4::load(q[1].quaternion);
+        z = float4::load(q[2].quaternion);
+        w = float4::load(q[3].quaternion);
+        float4::transpose(x, y, z, w);
+    }
+
+    // 要素ごとのベクトルを 4 個の四元数に書き出す
+    static void store(float4 x, float4 y, float4 z, float4 w, Quaternion *q) {
+        float4::transpose(x, y, z, w);
+        x.store(q[0].quaternion);
+        y.store(q[1].quaternion);
+        z.store(q[2].quaternion);
+        w.store(q[3].quaternion);
+    }
+
+    // 4 個ずつ補間する
+    //  count: 四元数の数
+    //  a, b: 補間する四元数
+    //  t: 補間の割合
+    //  q: 補間した四元数の格納先
+    //  spherical: 球面線形補間なら true
+    static void interpolate(std::size_t count, const Quaternion *a, const Quaternion *b,
+        const GLfloat *t, Quaternion *q, bool spherical) {
+        const float4 zero(0.0f), one(1.0f);
+        std::size_t i(0);
+        for (; i + 4 <= count; i += 4) {
+            float4 ax, ay, az, aw, bx, by, bz, bw;
+            load(a + i, ax, ay, az, aw);
+            load(b + i, bx, by, bz, bw);
+            const float4 u(float4::load(t + i));
+
+            // 近い方の回りで補間する
+            float4 d(ax * bx + ay * by + az * bz + aw * bw);
+            const float4 sign(select(d < zero, float4(-1.0f), one));
+            d = min(d * sign, one);
+
+            float4 wa(one - u), wb(u * sign);
+            if (spherical) {
+                // 角度が小さいところは線形補間にする
+                const float4 theta(acosUnit(d));
+                const float4 s(sin(theta));
+                const float4 small(s < float4(1.0e-4f));
+                const float4 r(one / select(small, one, s));
+                wa = select(small, wa, sin((one - u) * theta) * r);
+                wb = select(small, wb, sin(u * theta) * r * sign);
+            }
+
+            const float4 x(wa * ax + wb * bx), y(wa * ay + wb * by);
+            const float4 z(wa * az + wb * bz), w(wa * aw + wb * bw);
+            const float4 l(one / sqrt(x * x + y * y + z * z + w * w));
+            store(x * l, y * l, z * l, w * l, q + i);
+        }
+
+        // 端数は一つずつ補間する
+        for (; i < count; ++i) {
+            q[i] = spherical ? slerp(a[i], b[i], t[i]) : nlerp(a[i], b[i], t[i]);
+        }
+    }
+
+public:
+
+    // コンストラクタ
+    Quaternion() {}
+
+    // 要素を指定して初期化するコンストラクタ
+    Quaternion(GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+        : quaternion{ x, y, z, w }
+    {}
+
+    // 要素を右辺値として参照する
+    const GLfloat &operator[](std::size_t i) const
+    {
+        return quaternion[i];
+    }
+
+    // 要素を左辺値として参照する
+    GLfloat &operator[](std::size_t i)
+    {
+        return quaternion[i];
+    }
+
+    // 要素の配列を返す
+    const GLfloat *data() const
+    {
+        return quaternion;
+    }
+
+    // 単位四元数を作成
+    static Quaternion identity()
+    {
+        return Quaternion(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    // (x, y, z) を軸に a 回転する四元数を作成 (Matrix::rotateAxis と同じ回転)
+    static Quaternion rotateAxis(GLfloat a, GLfloat x, GLfloat y, GLfloat z)
+    {
+        const GLfloat d(std::sqrt(x * x + y * y + z * z));
+        if (d == 0.0f) return identity();
+
+        const GLfloat s(std::sin(a * 0.5f) / d);
+        return Quaternion(x * s, y * s, z * s, std::cos(a * 0.5f));
+    }
+
+    // 座標軸 (mode) を軸に a 回転する四元数を作成 (Matrix::rotate と同じ回転)
+    //  mode {
+    //      1: x軸
+    //      2: y軸
+    //      3: z軸
+    //  }
+    static Quaternion rotate(int mode, GLfloat a)
+    {
+        if (!(mode == 1 || mode == 2 || mode == 3)) return identity();
+
+        Quaternion q(0.0f, 0.0f, 0.0f, std::cos(a * 0.5f));
+        q[mode - 1] = std::sin(a * 0.5f);
+        return q;
+    }
+
+    // ローカル座標系を回転する四元数を作成 (Matrix::localRotate と同じ x, y, z 軸の順)
+    //  p: ピッチ (x軸)
+    //  h: ヘディング (y軸)
+    //  r: ロール (z軸)
+    static Quaternion localRotate(GLfloat p, GLfloat h, GLfloat r)
+    {
+        return rotate(1, p) * rotate(2, h) * rotate(3, r);
+    }
+
+    // 回転の変換行列から四元数を作成
+    static Quaternion fromMatrix(const Matrix &m)
+    {
+        // 対角成分の最も大きなところから求めて桁落ちを防ぐ
+        const GLfloat trace(m[0] + m[5] + m[10]);
+        Quaternion q;
+        if (trace > 0.0f) {
+            const GLfloat s(std::sqrt(trace + 1.0f) * 2.0f);
+            q[0] = (m[6] - m[9]) / s;
+            q[1] = (m[8] - m[2]) / s;
+            q[2] = (m[1] - m[4]) / s;
+            q[3] = 0.25f * s;
+        } else if (m[0] > m[5] && m[0] > m[10]) {
+            const GLfloat s(std::sqrt(1.0f + m[0] - m[5] - m[10]) * 2.0f);
+            q[0] = 0.25f * s;
+            q[1] = (m[4] + m[1]) / s;
+            q[2] = (m[8] + m[2]) / s;
+            q[3] = (m[6] - m[9]) / s;
+        } else if (m[5] > m[10]) {
+            const GLfloat s(std::sqrt(1.0f + m[5] - m[0] - m[10]) * 2.0f);
+            q[0] = (m[4] + m[1]) / s;
+            q[1] = 0.25f * s;
+            q[2] = (m[9] + m[6]) / s;
+            q[3] = (m[8] - m[2]) / s;
+        } else {
+            const GLfloat s(std::sqrt(1.0f + m[10] - m[0] - m[5]) * 2.0f);
+            q[0] = (m[8] + m[2]) / s;
+            q[1] = (m[9] + m[6]) / s;
+            q[2] = 0.25f * s;
+            q[3] = (m[1] - m[4]) / s;
+        }
+        return q.normalize();
+    }
+
+    // 回転軸と回転角を求める
+    //  a: 回転角の格納先
+    //  axis: 回転軸の格納先 (3要素)
+    void getAxisAngle(GLfloat &a, GLfloat *axis) const
+    {
+        const GLfloat w(std::min(std::max(quaternion[3], -1.0f), 1.0f));
+        const GLfloat s(std::sqrt(1.0f - w * w));
+        a = 2.0f * std::acos(w);
+        if (s > 1.0e-6f) {
+            for (int i = 0; i < 3; ++i) axis[i] = quaternion[i] / s;
+        } else {
+            axis[0] = 1.0f;
+            axis[1] = axis[2] = 0.0f;
+        }
+    }
+
+    // localRotate の角度を求める
+    //  p: ピッチ (x軸) の格納先
+    //  h: ヘディング (y軸) の格納先
+    //  r: ロール (z軸) の格納先
+    void getEuler(GLfloat &p, GLfloat &h, GLfloat &r) const
+    {
+        const GLfloat x(quaternion[0]), y(quaternion[1]), z(quaternion[2]), w(quaternion[3]);
+
+        // 回転行列 Rx(p) Ry(h) Rz(r) の (0, 2), (0, 0), (0, 1), (1, 2), (2, 2) 成分から求める
+        const GLfloat m02(2.0f * (x * z + y * w));
+        h = std::asin(std::min(std::max(m02, -1.0f), 1.0f));
+        r = std::atan2(-2.0f * (x * y - z * w), 1.0f - 2.0f * (y * y + z * z));
+        p = std::atan2(-2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y));
+    }
+
+    // 回転の変換行列を求める
+    Matrix getMatrix() const
+    {
+        Matrix t;
+        GLfloat n[9];
+        getNormalMatrix(n);
+        t.loadIdentity();
+        for (int i = 0; i < 3; ++i) {
+            t[i * 4 + 0] = n[i * 3 + 0];
+            t[i * 4 + 1] = n[i * 3 + 1];
+            t[i * 4 + 2] = n[i * 3 + 2];
+        }
+        return t;
+    }
+
+    // 法線ベクトルの変換行列を求める (回転なので回転行列そのもの)
+    //  m: 3x3 行列の格納先 (Matrix::getNormalMatrix と同じ並び)
+    void getNormalMatrix(GLfloat *m) const
+    {
+        const GLfloat x(quaternion[0]), y(quaternion[1]), z(quaternion[2]), w(quaternion[3]);
+        const GLfloat xx(x * x), yy(y * y), zz(z * z);
+        const GLfloat xy(x * y), yz(y * z), zx(z * x);
+        const GLfloat xw(x * w), yw(y * w), zw(z * w);
+
+        m[0] = 1.0f - 2.0f * (yy + zz);
+        m[1] = 2.0f * (xy + zw);
+        m[2] = 2.0f * (zx - yw);
+        m[3] = 2.0f * (xy - zw);
+        m[4] = 1.0f - 2.0f * (zz + xx);
+        m[5] = 2.0f * (yz + xw);
+        m[6] = 2.0f * (zx + yw);
+        m[7] = 2.0f * (yz - xw);
+        m[8] = 1.0f - 2.0f * (xx + yy);
+    }
+
+    // ベクトルを回転する
+    //  v: 回転するベクトル (3要素, 結果で上書きする)
+    void rotateVector(GLfloat *v) const
+    {
+        // v' = v + 2 q × (q × v + w v)
+        const GLfloat x(quaternion[0]), y(quaternion[1]), z(quaternion[2]), w(quaternion[3]);
+        const GLfloat cx(y * v[2] - z * v[1] + w * v[0]);
+        const GLfloat cy(z * v[0] - x * v[2] + w * v[1]);
+        const GLfloat cz(x * v[1] - y * v[0] + w * v[2]);
+        v[0] += 2.0f * (y * cz - z * cy);
+        v[1] += 2.0f * (z * cx - x * cz);
+        v[2] += 2.0f * (x * cy - y * cx);
+    }
+
+    // 内積
+    GLfloat dot(const Quaternion &q) const
+    {
+        return quaternion[0] * q[0] + quaternion[1] * q[1] + quaternion[2] * q[2] + quaternion[3] * q[3];
+    }
+
+    // 共役 (単位四元数なら逆回転)
+    Quaternion conjugate() const
+    {
+        return Quaternion(-quaternion[0], -quaternion[1], -quaternion[2], quaternion[3]);
+    }
+
+    // 正規化する
+    Quaternion normalize() const
+    {
+        const GLfloat l(std::sqrt(dot(*this)));
+        if (l == 0.0f) return identity();
+        return Quaternion(quaternion[0] / l, quaternion[1] / l, quaternion[2] / l, quaternion[3] / l);
+    }
+
+    // 乗算 (右の回転を先に行う)
+    Quaternion operator*(const Quaternion &q) const
+    {
+        const GLfloat x(quaternion[0]), y(quaternion[1]), z(quaternion[2]), w(quaternion[3]);
+        return Quaternion(
+            w * q[0] + x * q[3] + y * q[2] - z * q[1],
+            w * q[1] - x * q[2] + y * q[3] + z * q[0],
+            w * q[2] + x * q[1] - y * q[0] + z * q[3],
+            w * q[3] - x * q[0] - y * q[1] - z * q[2]);
+    }
+
+    // 正規化線形補間
+    //  a, b: 補間する四元数
+    //  t: 補間の割合
+    static Quaternion nlerp(const Quaternion &a, const Quaternion &b, GLfloat t)
+    {
+        const GLfloat s(a.dot(b) < 0.0f ? -t : t), u(1.0f - t);
+        return Quaternion(u * a[0] + s * b[0], u * a[1] + s * b[1],
+            u * a[2] + s * b[2], u * a[3] + s * b[3]).normalize();
+    }
+
+    // 球面線形補間
+    //  a, b: 補間する四元数
+    //  t: 補間の割合 (0 〜 1)
+    static Quaternion slerp(const Quaternion &a, const Quaternion &b, GLfloat t)
+    {
+        GLfloat d(a.dot(b));
+        const GLfloat sign(d < 0.0f ? -1.0f : 1.0f);
+        d = std::min(d * sign, 1.0f);
+
+        GLfloat wa(1.0f - t), wb(t * sign);
+        const GLfloat theta(std::acos(d)), s(std::sin(theta));
+        if (s >= 1.0e-4f) {
+            wa = std::sin((1.0f - t) * theta) / s;
+            wb = std::sin(t * theta) / s * sign;
+        }
+        return Quaternion(wa * a[0] + wb * b[0], wa * a[1] + wb * b[1],
+            wa * a[2] + wb * b[2], wa * a[3] + wb * b[3]).normalize();
+    }
+
+    // 配列の四元数をまとめて正規化線形補間する
+    //  count: 四元数の数
+    //  a, b: 補間する四元数の配列
+    //  t: 補間の割合の配列
+    //  q: 補間した四元数の格納先 (a や b と同じでもよい)
+    static void nlerp(std::size_t count, const Quaternion *a, const Quaternion *b,
+        const GLfloat *t, Quaternion *q)
+    {
+        interpolate(count, a, b, t, q, false);
+    }
+
+    // 配列の四元数をまとめて球面線形補間する
+    //  count: 四元数の数
+    //  a, b: 補間する四元数の配列
+    //  t: 補間の割合の配列 (0 〜 1)
+    //  q: 補間した四元数の格納先 (a や b と同じでもよい)
+    static void slerp(std::size_t count, const Quaternion *a, const Quaternion *b,
+        const GLfloat *t, Quaternion *q)
+    {
+        interpolate(count, a, b, t, q, true);
+    }
+};
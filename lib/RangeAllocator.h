@@ -0,0 +1,127 @@
+#pragma once
+#include <map>
+#include <iterator>
+#include <GL/glew.h>
+
+// 連続した領域の部分割り当て (空き領域のリストを隣接する空きと結合する)
+//  GL の関数を呼ばないので CPU だけで試験や計測ができる
+class RangeAllocator {
+    // 先頭位置から大きさへの空き領域の表
+    std::map<GLuint, GLuint> byOffset;
+
+    // 大きさから先頭位置への空き領域の表 (最良適合の検索に使う)
+    std::multimap<GLuint, GLuint> bySize;
+
+    // 全体の大きさと割り当て済みの大きさ
+    GLuint capacity, used;
+
+    // 空き領域を大きさの表から取り除く
+    void eraseSize(GLuint offset, GLuint size) {
+        for (auto i = bySize.lower_bound(size); i != bySize.end() && i->first == size; ++i) {
+            if (i->second == offset) {
+                bySize.erase(i);
+                return;
+            }
+        }
+    }
+
+    // 空き領域を追加して前後の空き領域と結合する
+    void insert(GLuint offset, GLuint size) {
+        auto next(byOffset.lower_bound(offset));
+
+        // 直後の空き領域と結合する
+        if (next != byOffset.end() && offset + size == next->first) {
+            size += next->second;
+            eraseSize(next->first, next->second);
+            next = byOffset.erase(next);
+        }
+
+        // 直前の空き領域と結合する
+        if (next != byOffset.begin()) {
+            const auto prev(std::prev(next));
+            if (prev->first + prev->second == offset) {
+                offset = prev->first;
+                size += prev->second;
+                eraseSize(prev->first, prev->second);
+                byOffset.erase(prev);
+            }
+        }
+
+        byOffset.emplace(offset, size);
+        bySize.emplace(size, offset);
+    }
+
+public:
+
+    // 割り当てに失敗したときの値
+    static const GLuint invalid = ~0u;
+
+    // コンストラクタ
+    //  capacity: 全体の大きさ
+    RangeAllocator(GLuint capacity = 0)
+        : capacity(0), used(0)
+    {
+        grow(capacity);
+    }
+
+    // 領域を割り当てる
+    //  size: 大きさ
+    //  戻り値: 先頭位置 (割り当てられなければ invalid)
+    GLuint allocate(GLuint size) {
+        if (size == 0) return invalid;
+
+        // 要求を満たす最も小さな空き領域を選ぶ
+        const auto fit(bySize.lower_bound(size));
+        if (fit == bySize.end()) return invalid;
+
+        const GLuint offset(fit->second), free(fit->first);
+        bySize.erase(fit);
+        byOffset.erase(offset);
+
+        // 余りを空き領域に戻す
+        if (free > size) {
+            byOffset.emplace(offset + size, free - size);
+            bySize.emplace(free - size, offset + size);
+        }
+
+        used += size;
+        return offset;
+    }
+
+    // 領域を解放する
+    //  offset: 先頭位置
+    //  size: 大きさ
+    void free(GLuint offset, GLuint size) {
+        if (offset == invalid || size == 0) return;
+        insert(offset, size);
+        used -= size;
+    }
+
+    // 全体を広げる
+    //  newCapacity: 新しい全体の大きさ
+    void grow(GLuint newCapacity) {
+        if (newCapacity <= capacity) return;
+        insert(capacity, newCapacity - capacity);
+        capacity = newCapacity;
+    }
+
+    // 全体の大きさ
+    GLuint getCapacity() const { return capacity; }
+
+    // 割り当て済みの大きさ
+    GLuint getUsed() const { return used; }
+
+    // 最大の空き領域の大きさ
+    GLuint getLargestFree() const {
+        return bySize.empty() ? 0 : bySize.rbegin()->first;
+    }
+
+    // 空き領域の数
+    std::size_t getFreeCount() const { return byOffset.size(); }
+
+    // 断片化の度合い (0: 空きが一つにまとまっている, 1 に近いほど細切れ)
+    double getFragmentation() const {
+        const GLuint free(capacity - used);
+        return free == 0 ? 0.0 : 1.0 - static_cast<double>(getLargestFree()) / free;
+    }
+};
@@ -0,0 +1,620 @@
+#pragma once
+#include <stdio.h>
+#include <cmath>
+#include <deque>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <GL/glew.h>
+
+// 変換行列
+#include "Matrix.h"
+
+// 図形データ
+#include "Object.h"
+
+// 材質
+#include "Material.h"
+
+// 光源
+#include "Light.h"
+
+// 4要素のベクトル演算
+#include "Simd.h"
+
+// 並列処理
+#include "ThreadPool.h"
+
+// GL を使わない三角形の描画
+//  頂点を Matrix で変換して三角形を画面のタイルに振り分け、タイルごとに並列にラスタライズする
+//  デプスバッファで見えている三角形を決めてから point.frag と同じ Blinn-Phong で陰影を付ける
+class Rasterizer {
+    // 変換後の頂点
+    struct Transformed {
+        // クリップ座標
+        GLfloat clip[4];
+
+        // 視点座標系の位置
+        GLfloat position[4];
+
+        // 視点座標系の法線
+        GLfloat normal[3];
+    };
+
+    // 画面上の三角形
+    struct Triangle {
+        // 各頂点に向かい合う辺の辺関数 (a x + b y + c)
+        GLfloat edge[3][3];
+
+        // 辺関数を重心座標にする係数 (面積の逆数)
+        GLfloat scale;
+
+        // 辺上の画素を含めるかどうか (左上規則)
+        bool inclusive[3];
+
+        // 深度の平面 (a x + b y + c)
+        GLfloat depth[3];
+
+        // 各頂点のクリップ座標の w の逆数 (透視補正に使う)
+        GLfloat invw[3];
+
+        // 頂点
+        const Transformed *vertex[3];
+
+        // 画素の範囲 (xmin, ymin, xmax, ymax)
+        GLint bounds[4];
+
+        // 描画要求の番号
+        GLuint draw;
+    };
+
+    // 描画要求
+    struct Draw {
+        GLsizei vertexcount;
+        const Object::Vertex *vertex;
+        GLsizei indexcount;
+        const GLuint *index;
+        Matrix modelview;
+        Material material;
+
+        // 変換後の頂点と三角形の通し番号の先頭
+        std::size_t firstVertex, firstTriangle;
+    };
+
+    // 三角形の設定を分担する単位ごとの振り分け結果
+    struct Bin {
+        // 設定した三角形
+        std::vector<Triangle> triangle;
+
+        // クリッピングで作った頂点 (追加しても要素は移動しない)
+        std::deque<Transformed> clipped;
+
+        // タイルごとの三角形の番号
+        std::vector<std::vector<GLuint>> tile;
+    };
+
+    // 一つの分担で設定する三角形の数
+    static const std::size_t grain = 4096;
+
+    // 画面の大きさとタイルの大きさ
+    const GLsizei width, height, tileSize;
+
+    // 横と縦のタイルの数
+    const GLsizei tilesX, tilesY;
+
+    // タイル単位に切り上げた横幅 (デプスバッファの行の間隔)
+    const GLsizei stride;
+
+    // 投影変換行列
+    Matrix projection;
+
+    // 視点座標系の光源
+    std::vector<Light> light;
+
+    // 背景色
+    GLfloat background[4];
+
+    // 裏面を描かない
+    bool cull;
+
+    // 描画要求
+    std::vector<Draw> draw;
+
+    // 変換後の頂点
+    std::vector<Transformed> vertex;
+
+    // 振り分け結果 (前のフレームより減っても領域を使い回す)
+    std::vector<Bin> bin;
+
+    // このフレームで使う振り分け結果の数
+    std::size_t binCount;
+
+    // デプスバッファ
+    std::vector<GLfloat> depth;
+
+    // 各画素に見えている三角形
+    std::vector<const Triangle *> visible;
+
+    // カラーバッファ (RGBA, 上の行から)
+    std::vector<GLubyte> color;
+
+    // 描画要求の頂点を変換する
+    void transform(const Draw &d) {
+        const GLfloat *const m(d.modelview.data());
+        const GLfloat *const p(projection.data());
+        GLfloat n[9];
+        d.modelview.getNormalMatrix(n);
+
+        ThreadPool::instance().parallelFor(d.vertexcount, grain,
+            [this, &d, m, p, &n](std::size_t begin, std::size_t end) {
+                for (std::size_t i = begin; i < end; ++i) {
+                    const GLfloat *const v(d.vertex[i].position);
+                    const GLfloat *const u(d.vertex[i].normal);
+                    Transformed &t(vertex[d.firstVertex + i]);
+
+                    // P = modelview * position
+                    for (int k = 0; k < 4; ++k) {
+                        t.position[k] = m[k] * v[0] + m[4 + k] * v[1] + m[8 + k] * v[2] + m[12 + k];
+                    }
+
+                    // gl_Position = projection * P
+                    for (int k = 0; k < 4; ++k) {
+                        t.clip[k] = p[k] * t.position[0] + p[4 + k] * t.position[1]
+                            + p[8 + k] * t.position[2] + p[12 + k] * t.position[3];
+                    }
+
+                    // N = normalize(normalMatrix * normal)
+                    GLfloat l(0.0f);
+                    for (int k = 0; k < 3; ++k) {
+                        t.normal[k] = n[k] * u[0] + n[3 + k] * u[1] + n[6 + k] * u[2];
+                        l += t.normal[k] * t.normal[k];
+                    }
+                    if (l > 0.0f) {
+                        l = 1.0f / std::sqrt(l);
+                        for (int k = 0; k < 3; ++k) t.normal[k] *= l;
+                    }
+                }
+            });
+    }
+
+    // 画面上の三角形を設定してタイルに振り分ける
+    //  b: 振り分け先
+    //  v0, v1, v2: 頂点
+    //  draw: 描画要求の番号
+    void emit(Bin &b, const Transformed *v0, const Transformed *v1, const Transformed *v2, GLuint draw) {
+        const Transformed *v[] = { v0, v1, v2 };
+        GLfloat x[3], y[3], z[3], invw[3];
+        for (int k = 0; k < 3; ++k) {
+            invw[k] = 1.0f / v[k]->clip[3];
+            x[k] = (v[k]->clip[0] * invw[k] * 0.5f + 0.5f) * width;
+            y[k] = (0.5f - v[k]->clip[1] * invw[k] * 0.5f) * height;
+            z[k] = v[k]->clip[2] * invw[k] * 0.5f + 0.5f;
+        }
+
+        // 画面の y 軸は下向きなので反時計回りの表面は面積が負になる
+        GLfloat area((x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]));
+        if (!(area != 0.0f) || !std::isfinite(area)) return;
+        if (cull && area > 0.0f) return;
+        if (area < 0.0f) {
+            std::swap(v[1], v[2]);
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+            std::swap(z[1], z[2]);
+            std::swap(invw[1], invw[2]);
+            area = -area;
+        }
+
+        // 画素の中心を含む範囲
+        Triangle t;
+        t.bounds[0] = std::max(0, static_cast<GLint>(std::ceil(std::min({ x[0], x[1], x[2] }) - 0.5f)));
+        t.bounds[1] = std::max(0, static_cast<GLint>(std::ceil(std::min({ y[0], y[1], y[2] }) - 0.5f)));
+        t.bounds[2] = std::min(width - 1, static_cast<GLint>(std::floor(std::max({ x[0], x[1], x[2] }) - 0.5f)));
+        t.bounds[3] = std::min(height - 1, static_cast<GLint>(std::floor(std::max({ y[0], y[1], y[2] }) - 0.5f)));
+        if (t.bounds[0] > t.bounds[2] || t.bounds[1] > t.bounds[3]) return;
+
+        // 頂点 k の重心座標は向かい合う辺の辺関数を面積で割ったもの
+        //  隣り合う三角形で辺関数がちょうど符号反転になるように、辺の端点を決まった順にして求める
+        t.scale = 1.0f / area;
+        for (int k = 0; k < 3; ++k) {
+            int i((k + 1) % 3), j((k + 2) % 3);
+            const bool flip(y[j] < y[i] || (y[j] == y[i] && x[j] < x[i]));
+            if (flip) std::swap(i, j);
+            const GLfloat dx(x[j] - x[i]), dy(y[j] - y[i]);
+            const GLfloat sign(flip ? -1.0f : 1.0f);
+            t.edge[k][0] = -dy * sign;
+            t.edge[k][1] = dx * sign;
+            t.edge[k][2] = (dy * x[i] - dx * y[i]) * sign;
+            t.inclusive[k] = t.edge[k][0] > 0.0f || (t.edge[k][0] == 0.0f && t.edge[k][1] > 0.0f);
+            t.invw[k] = invw[k];
+            t.vertex[k] = v[k];
+        }
+        for (int c = 0; c < 3; ++c) {
+            t.depth[c] = (z[0] * t.edge[0][c] + z[1] * t.edge[1][c] + z[2] * t.edge[2][c]) * t.scale;
+        }
+        t.draw = draw;
+
+        // 重なるタイルに振り分ける (大きな三角形はタイルの四隅で外れを判定する)
+        const GLuint number(static_cast<GLuint>(b.triangle.size()));
+        b.triangle.push_back(t);
+        const GLint tx0(t.bounds[0] / tileSize), tx1(t.bounds[2] / tileSize);
+        const GLint ty0(t.bounds[1] / tileSize), ty1(t.bounds[3] / tileSize);
+        for (GLint ty = ty0; ty <= ty1; ++ty) {
+            for (GLint tx = tx0; tx <= tx1; ++tx) {
+                if (tx0 != tx1 || ty0 != ty1) {
+                    const GLfloat left(tx * tileSize + 0.5f), right(left + tileSize - 1.0f);
+                    const GLfloat top(ty * tileSize + 0.5f), bottom(top + tileSize - 1.0f);
+                    bool outside(false);
+                    for (int k = 0; k < 3 && !outside; ++k) {
+                        const GLfloat *const e(t.edge[k]);
+                        outside = e[0] * (e[0] > 0.0f ? right : left)
+                            + e[1] * (e[1] > 0.0f ? bottom : top) + e[2] < 0.0f;
+                    }
+                    if (outside) continue;
+                }
+                b.tile[ty * tilesX + tx].push_back(number);
+            }
+        }
+    }
+
+    // 前方クリップ面で切り取ってから三角形を設定する
+    //  b: 振り分け先
+    //  v0, v1, v2: 頂点
+    //  draw: 描画要求の番号
+    void setup(Bin &b, const Transformed *v0, const Transformed *v1, const Transformed *v2, GLuint draw) {
+        const Transformed *const v[] = { v0, v1, v2 };
+
+        // 全ての頂点が同じクリップ面の外にあれば捨てる
+        for (int k = 0; k < 3; ++k) {
+            if (v0->clip[k] > v0->clip[3] && v1->clip[k] > v1->clip[3] && v2->clip[k] > v2->clip[3]) return;
+            if (v0->clip[k] < -v0->clip[3] && v1->clip[k] < -v1->clip[3] && v2->clip[k] < -v2->clip[3]) return;
+        }
+
+        // 前方クリップ面 (z + w >= 0) からの距離
+        GLfloat d[3];
+        int inside(0);
+        for (int k = 0; k < 3; ++k) {
+            d[k] = v[k]->clip[2] + v[k]->clip[3];
+            if (d[k] >= 0.0f) ++inside;
+        }
+        if (inside == 3) {
+            emit(b, v0, v1, v2, draw);
+            return;
+        }
+
+        // 内側の頂点と辺の交点で多角形を作る
+        const Transformed *polygon[4];
+        int count(0);
+        for (int k = 0; k < 3; ++k) {
+            const int j((k + 1) % 3);
+            if (d[k] >= 0.0f) polygon[count++] = v[k];
+            if ((d[k] >= 0.0f) != (d[j] >= 0.0f)) {
+                const GLfloat s(d[k] / (d[k] - d[j]));
+                b.clipped.emplace_back();
+                Transformed &c(b.clipped.back());
+                for (int i = 0; i < 4; ++i) {
+                    c.clip[i] = v[k]->clip[i] + (v[j]->clip[i] - v[k]->clip[i]) * s;
+                    c.position[i] = v[k]->position[i] + (v[j]->position[i] - v[k]->position[i]) * s;
+                }
+                for (int i = 0; i < 3; ++i) {
+                    c.normal[i] = v[k]->normal[i] + (v[j]->normal[i] - v[k]->normal[i]) * s;
+                }
+                polygon[count++] = &c;
+            }
+        }
+        for (int k = 2; k < count; ++k) emit(b, polygon[0], polygon[k - 1], polygon[k], draw);
+    }
+
+    // 三角形をタイルの範囲でラスタライズしてデプステストを行う
+    //  t: 三角形
+    //  x0, y0, x1, y1: タイルの範囲 (x1, y1 は含まない)
+    void rasterize(const Triangle &t, GLint x0, GLint y0, GLint x1, GLint y1) {
+        // 4 画素ずつ処理するので左端を 4 の倍数にそろえる
+        const GLint xmin(std::max(t.bounds[0], x0) & ~3), xmax(std::min(t.bounds[2], x1 - 1));
+        const GLint ymin(std::max(t.bounds[1], y0)), ymax(std::min(t.bounds[3], y1 - 1));
+
+        const float4 a0(t.edge[0][0]), a1(t.edge[1][0]), a2(t.edge[2][0]);
+        const float4 za(t.depth[0]), zb(t.depth[1]), zc(t.depth[2]);
+        const float4 offset(0.5f, 1.5f, 2.5f, 3.5f), zero(0.0f);
+
+        // 辺上の画素は左上規則で含めるかどうかを決める
+        const auto test = [&zero](float4 e, bool inclusive) {
+            return inclusive ? e >= zero : e > zero;
+        };
+
+        for (GLint y = ymin; y <= ymax; ++y) {
+            // 辺関数は画素ごとに同じ式で求めて隣の三角形との隙間や重なりを作らない
+            const GLfloat py(y + 0.5f);
+            const float4 r0(t.edge[0][1] * py + t.edge[0][2]);
+            const float4 r1(t.edge[1][1] * py + t.edge[1][2]);
+            const float4 r2(t.edge[2][1] * py + t.edge[2][2]);
+            const float4 rz(zb * float4(py) + zc);
+            GLfloat *const row(&depth[y * stride]);
+            const Triangle **const seen(&visible[y * stride]);
+
+            for (GLint x = xmin; x <= xmax; x += 4) {
+                const float4 px(float4(static_cast<GLfloat>(x)) + offset);
+                const float4 e0(a0 * px + r0), e1(a1 * px + r1), e2(a2 * px + r2);
+                const float4 z(za * px + rz);
+                const float4 inside(test(e0, t.inclusive[0]) & test(e1, t.inclusive[1]) & test(e2, t.inclusive[2]));
+                if (movemask(inside)) {
+                    const float4 d(float4::load(row + x));
+                    const float4 pass(inside & (z < d));
+                    const int m(movemask(pass));
+                    if (m) {
+                        select(pass, z, d).store(row + x);
+                        for (int i = 0; i < 4; ++i) {
+                            if (m & (1 << i)) seen[x + i] = &t;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // 画素に見えている三角形の陰影を point.frag と同じ式で求める
+    //  t: 三角形
+    //  px, py: 画素の中心
+    //  rgba: 色
+    void shade(const Triangle &t, GLfloat px, GLfloat py, GLfloat *rgba) const {
+        // 透視補正した重心座標
+        GLfloat w[3], s(0.0f);
+        for (int k = 0; k < 3; ++k) {
+            w[k] = (t.edge[k][0] * px + t.edge[k][1] * py + t.edge[k][2]) * t.scale * t.invw[k];
+            s += w[k];
+        }
+        for (int k = 0; k < 3; ++k) w[k] /= s;
+
+        // 補間した位置と法線
+        GLfloat P[4], N[3];
+        for (int i = 0; i < 4; ++i) {
+            P[i] = w[0] * t.vertex[0]->position[i] + w[1] * t.vertex[1]->position[i] + w[2] * t.vertex[2]->position[i];
+        }
+        for (int i = 0; i < 3; ++i) {
+            N[i] = w[0] * t.vertex[0]->normal[i] + w[1] * t.vertex[1]->normal[i] + w[2] * t.vertex[2]->normal[i];
+        }
+        const GLfloat nl(std::sqrt(N[0] * N[0] + N[1] * N[1] + N[2] * N[2]));
+        const GLfloat Nn[] = { N[0] / nl, N[1] / nl, N[2] / nl };
+
+        // V = -normalize(P.xyz)
+        const GLfloat pl(std::sqrt(P[0] * P[0] + P[1] * P[1] + P[2] * P[2]));
+        const GLfloat V[] = { -P[0] / pl, -P[1] / pl, -P[2] / pl };
+
+        const Material &m(draw[t.draw].material);
+        GLfloat Idiff[] = { 0.0f, 0.0f, 0.0f }, Ispec[] = { 0.0f, 0.0f, 0.0f };
+        for (const Light &l : light) {
+            // 光源の影響範囲による減衰
+            GLfloat L[3];
+            for (int i = 0; i < 3; ++i) L[i] = l.position[i] * P[3] - P[i] * l.position[3];
+            const GLfloat ll(std::sqrt(L[0] * L[0] + L[1] * L[1] + L[2] * L[2]));
+            GLfloat a(1.0f);
+            if (l.radius > 0.0f && l.position[3] != 0.0f) {
+                const GLfloat d(ll / l.radius), d2(d * d);
+                a = std::min(std::max(1.0f - d2 * d2, 0.0f), 1.0f);
+                a *= a;
+            }
+            for (int i = 0; i < 3; ++i) L[i] /= ll;
+
+            // 拡散反射光と環境光
+            const GLfloat diffuse(std::max(N[0] * L[0] + N[1] * L[1] + N[2] * L[2], 0.0f));
+            for (int i = 0; i < 3; ++i) {
+                Idiff[i] += diffuse * m.diffuse[i] * l.diffuse[i] * a + m.ambient[i] * l.ambient[i] * a;
+            }
+
+            // 鏡面反射光
+            GLfloat H[] = { L[0] + V[0], L[1] + V[1], L[2] + V[2] };
+            const GLfloat hl(std::sqrt(H[0] * H[0] + H[1] * H[1] + H[2] * H[2]));
+            const GLfloat specular(std::pow(std::max((Nn[0] * H[0] + Nn[1] * H[1] + Nn[2] * H[2]) / hl, 0.0f), m.shininess));
+            for (int i = 0; i < 3; ++i) {
+                Ispec[i] += specular * m.specular[i] * l.specular[i] * a;
+            }
+        }
+
+        for (int i = 0; i < 3; ++i) rgba[i] = Idiff[i] + Ispec[i];
+        rgba[3] = 1.0f;
+    }
+
+    // 色を 8 ビットの整数にする
+    static void quantize(const GLfloat *rgba, GLubyte *c) {
+        for (int i = 0; i < 4; ++i) {
+            c[i] = static_cast<GLubyte>(std::min(std::max(rgba[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+    }
+
+    // タイルを描いて陰影を付ける
+    //  tile: タイルの番号
+    void renderTile(std::size_t tile) {
+        const GLint x0(static_cast<GLint>(tile % tilesX) * tileSize), y0(static_cast<GLint>(tile / tilesX) * tileSize);
+        const GLint x1(std::min(x0 + tileSize, width)), y1(std::min(y0 + tileSize, height));
+
+        // デプスバッファを消去する
+        for (GLint y = y0; y < y0 + tileSize; ++y) {
+            std::fill(&depth[y * stride + x0], &depth[y * stride + x0] + tileSize, 1.0f);
+            std::fill(&visible[y * stride + x0], &visible[y * stride + x0] + tileSize, nullptr);
+        }
+
+        // 描画要求の順にラスタライズする
+        for (std::size_t c = 0; c < binCount; ++c) {
+            const Bin &b(bin[c]);
+            for (GLuint i : b.tile[tile]) rasterize(b.triangle[i], x0, y0, x1, y1);
+        }
+
+        // 見えている三角形だけ陰影を付ける
+        GLubyte clear[4];
+        quantize(background, clear);
+        for (GLint y = y0; y < y1; ++y) {
+            for (GLint x = x0; x < x1; ++x) {
+                GLubyte *const c(&color[(static_cast<std::size_t>(y) * width + x) * 4]);
+                const Triangle *const t(visible[y * stride + x]);
+                if (t) {
+                    GLfloat rgba[4];
+                    shade(*t, x + 0.5f, y + 0.5f, rgba);
+                    quantize(rgba, c);
+                } else {
+                    std::copy(clear, clear + 4, c);
+                }
+            }
+        }
+    }
+
+public:
+
+    // コンストラクタ
+    //  width, height: 画像の大きさ
+    //  tileSize: タイルの大きさ (4 の倍数)
+    Rasterizer(GLsizei width, GLsizei height, GLsizei tileSize = 64)
+        : width(width), height(height), tileSize((std::max(tileSize, 4) + 3) & ~3)
+        , tilesX((width + this->tileSize - 1) / this->tileSize)
+        , tilesY((height + this->tileSize - 1) / this->tileSize)
+        , stride(tilesX * this->tileSize)
+        , projection(Matrix::identity())
+        , background{ 1.0f, 1.0f, 1.0f, 0.0f }
+        , cull(true)
+        , binCount(0)
+        , depth(static_cast<std::size_t>(stride) * tilesY * this->tileSize)
+        , visible(depth.size())
+        , color(static_cast<std::size_t>(width) * height * 4)
+    {}
+
+    // デストラクタ
+    virtual ~Rasterizer() {}
+
+    // 投影変換行列を設定する
+    void setProjection(const Matrix &m) {
+        projection = m;
+    }
+
+    // 光源を設定する
+    //  l: 光源
+    //  count: 光源の数
+    //  view: ビュー変換行列 (光源の位置を視点座標系に移す)
+    void setLight(const Light *l, std::size_t count, const Matrix &view = Matrix::identity()) {
+        light.assign(l, l + count);
+        for (Light &t : light) {
+            GLfloat p[4];
+            for (int k = 0; k < 4; ++k) {
+                p[k] = view[k] * t.position[0] + view[4 + k] * t.position[1]
+                    + view[8 + k] * t.position[2] + view[12 + k] * t.position[3];
+            }
+            std::copy(p, p + 4, t.position.begin());
+        }
+    }
+
+    // 背景色を設定する
+    void setClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+        background[0] = r;
+        background[1] = g;
+        background[2] = b;
+        background[3] = a;
+    }
+
+    // 裏面を描かないかどうかを設定する (glEnable(GL_CULL_FACE) に相当する)
+    void setCullFace(bool enable) {
+        cull = enable;
+    }
+
+    // 三角形による描画を要求する (配列は render() まで保持しておく)
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列
+    //  indexcount: 頂点のインデックスの要素数
+    //  index: 頂点のインデックスを格納した配列 (NULL なら頂点の順に三角形にする)
+    //  modelview: モデルビュー変換行列
+    //  material: 材質
+    void add(GLsizei vertexcount, const Object::Vertex *vertex,
+        GLsizei indexcount, const GLuint *index, const Matrix &modelview, const Material &material) {
+        Draw d;
+        d.vertexcount = vertexcount;
+        d.vertex = vertex;
+        d.indexcount = index ? indexcount : vertexcount;
+        d.index = index;
+        d.modelview = modelview;
+        d.material = material;
+        d.firstVertex = draw.empty() ? 0 : draw.back().firstVertex + draw.back().vertexcount;
+        d.firstTriangle = draw.empty() ? 0 : draw.back().firstTriangle + draw.back().indexcount / 3;
+        draw.push_back(d);
+    }
+
+    // 要求された図形を描画して要求を空にする
+    void render() {
+        if (draw.empty()) {
+            std::fill(depth.begin(), depth.end(), 1.0f);
+            std::fill(visible.begin(), visible.end(), nullptr);
+            GLubyte clear[4];
+            quantize(background, clear);
+            for (std::size_t i = 0; i < color.size(); ++i) color[i] = clear[i & 3];
+            return;
+        }
+
+        // 頂点を変換する
+        vertex.resize(draw.back().firstVertex + draw.back().vertexcount);
+        for (const Draw &d : draw) transform(d);
+
+        // 三角形を分担して設定し、タイルに振り分ける
+        const std::size_t triangles(draw.back().firstTriangle + draw.back().indexcount / 3);
+        binCount = (triangles + grain - 1) / grain;
+        if (bin.size() < binCount) bin.resize(binCount);
+        for (std::size_t c = 0; c < binCount; ++c) {
+            Bin &b(bin[c]);
+            b.triangle.clear();
+            b.clipped.clear();
+            b.tile.resize(static_cast<std::size_t>(tilesX) * tilesY);
+            for (std::vector<GLuint> &t : b.tile) t.clear();
+        }
+        ThreadPool::instance().parallelFor(triangles, grain, [this](std::size_t begin, std::size_t end) {
+            Bin &b(bin[begin / grain]);
+            std::size_t n(0);
+            for (std::size_t i = begin; i < end; ++i) {
+                while (i >= draw[n].firstTriangle + draw[n].indexcount / 3) ++n;
+                const Draw &d(draw[n]);
+                const std::size_t k((i - d.firstTriangle) * 3);
+                const Transformed *const v(&vertex[d.firstVertex]);
+                if (d.index) setup(b, v + d.index[k], v + d.index[k + 1], v + d.index[k + 2], static_cast<GLuint>(n));
+                else setup(b, v + k, v + k + 1, v + k + 2, static_cast<GLuint>(n));
+            }
+        });
+
+        // タイルごとに並列にラスタライズする
+        ThreadPool::instance().parallelFor(static_cast<std::size_t>(tilesX) * tilesY, 1,
+            [this](std::size_t begin, std::size_t end) {
+                for (std::size_t t = begin; t < end; ++t) renderTile(t);
+            });
+
+        draw.clear();
+    }
+
+    // 画像の横幅
+    GLsizei getWidth() const { return width; }
+
+    // 画像の高さ
+    GLsizei getHeight() const { return height; }
+
+    // カラーバッファ (RGBA, 上の行から)
+    const GLubyte *getColor() const { return color.data(); }
+
+    // カラーバッファを PPM 形式で保存する
+    //  name: ファイル名
+    //  戻り値: 保存できたら true
+    bool save(const char *name) const {
+        std::ofstream file(name, std::ios::binary);
+        if (file.fail()) {
+            printf("Error : Can't open image file: %s\n", name);
+            return false;
+        }
+        file << "P6\n" << width << ' ' << height << "\n255\n";
+        for (std::size_t i = 0; i < color.size(); i += 4) {
+            file.write(reinterpret_cast<const char *>(&color[i]), 3);
+        }
+        if (file.fail()) {
+            printf("Error : Could not write image file.\n");
+            return false;
+        }
+        return true;
+    }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    Rasterizer(const Rasterizer &r);
+
+    // 代入によるコピー禁止
+    Rasterizer &operator=(const Rasterizer &r);
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <cmath>
+#include <GL/glew.h>
+
+// 変換行列
+#include "Matrix.h"
+
+// ベクトル
+#include "Vector.h"
+
+// 半直線
+struct Ray {
+    // 始点
+    GLfloat origin[3];
+
+    // 方向 (単位ベクトル)
+    GLfloat direction[3];
+
+    // 正規化デバイス座標系の点を通る視線をワールド座標系で求める
+    //  projection: 投影変換行列
+    //  view: ビュー変換行列
+    //  x, y: 正規化デバイス座標系の位置 (y は上向き)
+    //  戻り値: 前方面上の点から後方面に向かう半直線
+    static Ray unproject(const Matrix &projection, const Matrix &view, GLfloat x, GLfloat y)
+    {
+        const Matrix inverse(Matrix::inverse(projection * view));
+        const Vector n(inverse * Vector{ x, y, -1.0f, 1.0f });
+        const Vector f(inverse * Vector{ x, y, 1.0f, 1.0f });
+
+        Ray ray;
+        GLfloat length(0.0f);
+        for (int i = 0; i < 3; ++i) {
+            ray.origin[i] = n[i] / n[3];
+            ray.direction[i] = f[i] / f[3] - ray.origin[i];
+            length += ray.direction[i] * ray.direction[i];
+        }
+        length = std::sqrt(length);
+        for (int i = 0; i < 3; ++i) {
+            ray.direction[i] = length > 0.0f ? ray.direction[i] / length : 0.0f;
+        }
+        return ray;
+    }
+};
@@ -0,0 +1,225 @@
+#pragma once
+#include <GL/glew.h>
+
+// 世代付きのスロットマップ
+#include "SlotMap.h"
+
+// 図形データ
+#include "Object.h"
+
+// GL のオブジェクトの遅延削除
+#include "DeletionQueue.h"
+
+// GL のオブジェクトの登録簿
+//  図形, ユニフォームバッファ, プログラムオブジェクトをそれぞれスロットマップに隙間なく並べ,
+//  32 ビットのハンドルで参照する
+//  描画は基本図形の種類とインデックスの有無の組で分岐するので仮想関数を通らない
+class Resources {
+public:
+
+    // 描画の方法
+    enum Draw : GLubyte {
+        // glDrawArrays 系
+        Arrays,
+
+        // glDrawElements 系
+        Elements
+    };
+
+    // 図形
+    struct Mesh {
+        // 頂点配列オブジェクト, 頂点バッファオブジェクト, インデックスのバッファオブジェクト
+        GLuint vao, vbo, ibo;
+
+        // 描画する頂点かインデックスの数
+        GLsizei count;
+
+        // 基本図形の種類
+        GLenum mode;
+
+        // 描画の方法
+        Draw draw;
+    };
+
+    // ユニフォームバッファ
+    struct UniformBuffer {
+        // ユニフォームバッファオブジェクト名
+        GLuint ubo;
+
+        // アラインメントに合わせたユニフォームブロックのサイズ
+        GLsizeiptr blocksize;
+    };
+
+    // プログラムオブジェクト
+    struct Program {
+        // プログラムオブジェクト名
+        GLuint program;
+    };
+
+    // ハンドル
+    using MeshHandle = SlotHandle<Mesh>;
+    using UniformHandle = SlotHandle<UniformBuffer>;
+    using ProgramHandle = SlotHandle<Program>;
+
+private:
+
+    // 登録したオブジェクト
+    SlotMap<Mesh> meshes;
+    SlotMap<UniformBuffer> uniforms;
+    SlotMap<Program> programs;
+
+public:
+
+    // コンストラクタ
+    Resources() {}
+
+    // デストラクタ
+    virtual ~Resources() {}
+
+    // 図形を作って登録する
+    //  mode: 基本図形の種類
+    //  draw: 描画の方法 (Elements ならインデックスを使う)
+    //  size: 頂点の位置の次元
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列
+    //  indexcount: 頂点のインデックスの要素数
+    //  index: 頂点のインデックスを格納した配列
+    //  戻り値: 図形のハンドル
+    MeshHandle addMesh(GLenum mode, Draw draw,
+        GLint size, GLsizei vertexcount, const Object::Vertex *vertex,
+        GLsizei indexcount = 0, const GLuint *index = NULL) {
+        Mesh m = { 0, 0, 0, draw == Elements ? indexcount : vertexcount, mode, draw };
+
+        // 頂点配列オブジェクト
+        glGenVertexArrays(1, &m.vao);
+        glBindVertexArray(m.vao);
+
+        // 頂点バッファオブジェクト
+        glGenBuffers(1, &m.vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, m.vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertexcount * sizeof (Object::Vertex), vertex, GL_STATIC_DRAW);
+
+        // 結合されている頂点バッファオブジェクトを in 変数から参照できるようにする
+        glVertexAttribPointer(0, size, GL_FLOAT, GL_FALSE,
+            sizeof (Object::Vertex), static_cast<Object::Vertex *>(0)->position);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
+            sizeof (Object::Vertex), static_cast<Object::Vertex *>(0)->normal);
+        glEnableVertexAttribArray(1);
+
+        // インデックスのバッファオブジェクト
+        glGenBuffers(1, &m.ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexcount * sizeof (GLuint), index, GL_STATIC_DRAW);
+        glBindVertexArray(0);
+
+        return meshes.insert(m);
+    }
+
+    // 図形を削除する (GPU が使い終わってから削除するように DeletionQueue に預ける)
+    //  h: 図形のハンドル
+    void removeMesh(MeshHandle h) {
+        const Mesh *const m(meshes.get(h));
+        if (m == NULL) return;
+        DeletionQueue &queue(DeletionQueue::instance());
+        queue.vertexArray(m->vao);
+        queue.buffer(m->vbo);
+        queue.buffer(m->ibo);
+        meshes.erase(h);
+    }
+
+    // 図形を描画する
+    //  h: 図形のハンドル
+    //  material: 材質番号 (シェーダには gl_BaseInstance で渡る)
+    void draw(MeshHandle h, GLuint material = 0) const {
+        const Mesh *const m(meshes.get(h));
+        if (m == NULL) return;
+        glBindVertexArray(m->vao);
+        switch (m->draw) {
+        case Arrays:
+            glDrawArraysInstancedBaseInstance(m->mode, 0, m->count, 1, material);
+            break;
+        case Elements:
+            glDrawElementsInstancedBaseInstance(m->mode, m->count, GL_UNSIGNED_INT, 0, 1, material);
+            break;
+        }
+    }
+
+    // ユニフォームバッファを作って登録する
+    //  blocksize: アラインメントに合わせたユニフォームブロックのサイズ
+    //  count: 確保するユニフォームブロックの数
+    //  packed: ユニフォームブロックの並びに詰めたデータ (NULL なら確保だけ)
+    //  戻り値: ユニフォームバッファのハンドル
+    UniformHandle addUniformBuffer(GLsizeiptr blocksize, unsigned int count, const void *packed) {
+        UniformBuffer u = { 0, blocksize };
+        glGenBuffers(1, &u.ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, u.ubo);
+        glBufferData(GL_UNIFORM_BUFFER, count * blocksize, packed, GL_STATIC_DRAW);
+        return uniforms.insert(u);
+    }
+
+    // ユニフォームバッファを削除する
+    //  h: ユニフォームバッファのハンドル
+    void removeUniformBuffer(UniformHandle h) {
+        const UniformBuffer *const u(uniforms.get(h));
+        if (u == NULL) return;
+        DeletionQueue::instance().buffer(u->ubo);
+        uniforms.erase(h);
+    }
+
+    // ユニフォームバッファを取り出す
+    //  h: ユニフォームバッファのハンドル
+    //  戻り値: 無効なハンドルなら NULL
+    const UniformBuffer *getUniformBuffer(UniformHandle h) const { return uniforms.get(h); }
+
+    // リンク済みのプログラムオブジェクトを登録する (削除はこの登録簿が行う)
+    //  program: プログラムオブジェクト名
+    //  戻り値: プログラムオブジェクトのハンドル
+    ProgramHandle addProgram(GLuint program) {
+        const Program p = { program };
+        return programs.insert(p);
+    }
+
+    // プログラムオブジェクトを削除する
+    //  h: プログラムオブジェクトのハンドル
+    void removeProgram(ProgramHandle h) {
+        const Program *const p(programs.get(h));
+        if (p == NULL) return;
+        glDeleteProgram(p->program);
+        programs.erase(h);
+    }
+
+    // プログラムオブジェクト名を取り出す
+    //  h: プログラムオブジェクトのハンドル
+    //  戻り値: 無効なハンドルなら 0
+    GLuint getProgram(ProgramHandle h) const {
+        const Program *const p(programs.get(h));
+        return p ? p->program : 0;
+    }
+
+    // プログラムオブジェクトの使用を開始する
+    //  h: プログラムオブジェクトのハンドル
+    void use(ProgramHandle h) const {
+        glUseProgram(getProgram(h));
+    }
+
+    // 登録しているオブジェクトの数
+    std::size_t getMeshCount() const { return meshes.size(); }
+    std::size_t getUniformBufferCount() const { return uniforms.size(); }
+    std::size_t getProgramCount() const { return programs.size(); }
+
+    // アプリケーション全体で共有する登録簿
+    //  GL のコンテキストを持つスレッドから使う
+    static Resources &instance() {
+        static Resources resources;
+        return resources;
+    }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    Resources(const Resources &r);
+
+    // 代入によるコピー禁止
+    Resources &operator=(const Resources &r);
+};
@@ -0,0 +1,150 @@
+#pragma once
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <GL/glew.h>
+
+// 変換行列
+#include "Matrix.h"
+
+// 半直線
+#include "Ray.h"
+
+// 三角形の境界ボリューム階層
+#include "MeshBvh.h"
+
+// インスタンスの境界ボリューム階層 (二段の境界ボリューム階層の上の段)
+//  インスタンスが動いただけなら木の形を変えずに境界ボックスだけ求め直す
+class SceneBvh {
+    // インスタンス
+    struct Instance {
+        // 図形の境界ボリューム階層
+        const MeshBvh *mesh;
+
+        // モデル変換行列とその逆行列
+        Matrix transform, inverse;
+    };
+    std::vector<Instance> instance;
+
+    // インスタンスのワールド座標系の境界ボックス
+    std::vector<Bvh::Bounds> bounds;
+
+    // インスタンスの境界ボリューム階層
+    Bvh bvh;
+
+    // 作り直しと境界ボックスの求め直しが必要なら true
+    bool rebuild, stale;
+
+    // インスタンスのワールド座標系の境界ボックスを求める
+    void updateBounds(GLuint i)
+    {
+        const Bvh::Bounds local(instance[i].mesh->getBounds());
+        const Matrix &m(instance[i].transform);
+        Bvh::Bounds &b(bounds[i]);
+        if (local.min[0] > local.max[0]) {
+            b.clear();
+            return;
+        }
+
+        // 中心を変換し、広がりは行列の要素の絶対値で変換する
+        for (int k = 0; k < 3; ++k) {
+            b.min[k] = b.max[k] = m[12 + k];
+            for (int j = 0; j < 3; ++j) {
+                const GLfloat c((local.min[j] + local.max[j]) * 0.5f);
+                const GLfloat e((local.max[j] - local.min[j]) * 0.5f);
+                const GLfloat a(m[4 * j + k]);
+                b.min[k] += a * c - std::fabs(a) * e;
+                b.max[k] += a * c + std::fabs(a) * e;
+            }
+        }
+    }
+
+public:
+
+    // 交点
+    struct Hit {
+        // インスタンスの番号
+        GLuint instance;
+
+        // 三角形の番号 (インデックスの並びの順)
+        GLuint triangle;
+
+        // 半直線の始点からの距離
+        GLfloat distance;
+    };
+
+    // コンストラクタ
+    SceneBvh()
+        : rebuild(false), stale(false)
+    {}
+
+    // インスタンスを追加する
+    //  mesh: 図形の境界ボリューム階層 (このオブジェクトより長く生存すること)
+    //  transform: モデル変換行列
+    //  戻り値: インスタンスの番号
+    GLuint add(const MeshBvh &mesh, const Matrix &transform)
+    {
+        const Instance i = { &mesh, transform, Matrix::inverse(transform) };
+        instance.push_back(i);
+        bounds.emplace_back();
+        updateBounds(static_cast<GLuint>(instance.size() - 1));
+        rebuild = true;
+        return static_cast<GLuint>(instance.size() - 1);
+    }
+
+    // インスタンスのモデル変換行列を変更する
+    //  i: インスタンスの番号
+    //  transform: モデル変換行列
+    void setTransform(GLuint i, const Matrix &transform)
+    {
+        instance[i].transform = transform;
+        instance[i].inverse = Matrix::inverse(transform);
+        updateBounds(i);
+        stale = true;
+    }
+
+    // インスタンスの追加や移動を反映する
+    //  インスタンスを追加していれば作り直し、動かしただけなら境界ボックスを求め直す
+    void update()
+    {
+        if (rebuild) bvh.build(bounds.size(), bounds.data());
+        else if (stale) bvh.refit(bounds.data());
+        rebuild = stale = false;
+    }
+
+    // 半直線と最も近い交点を求める (update の後で呼ぶ)
+    //  ray: ワールド座標系の半直線
+    //  hit: 交点の格納先
+    //  戻り値: 交点があれば true
+    bool pick(const Ray &ray, Hit &hit) const
+    {
+        bool found(false);
+        GLfloat distance(std::numeric_limits<GLfloat>::max());
+        bvh.traverse(ray.origin, ray.direction, distance, [&](GLuint first, GLuint count, GLfloat &d) {
+            const std::vector<GLuint> &order(bvh.getOrder());
+            for (GLuint j = first; j < first + count; ++j) {
+                const GLuint i(order[j]);
+                const Matrix &m(instance[i].inverse);
+
+                // 半直線を図形の座標系に移す (方向は正規化しないので距離はそのまま使える)
+                GLfloat origin[3], direction[3];
+                for (int k = 0; k < 3; ++k) {
+                    origin[k] = m[k] * ray.origin[0] + m[4 + k] * ray.origin[1] + m[8 + k] * ray.origin[2] + m[12 + k];
+                    direction[k] = m[k] * ray.direction[0] + m[4 + k] * ray.direction[1] + m[8 + k] * ray.direction[2];
+                }
+
+                GLuint triangle;
+                if (instance[i].mesh->intersect(origin, direction, d, triangle)) {
+                    hit.instance = i;
+                    hit.triangle = triangle;
+                    hit.distance = d;
+                    found = true;
+                }
+            }
+        });
+        return found;
+    }
+
+    // インスタンスの数
+    std::size_t getInstanceCount() const { return instance.size(); }
+};
@@ -0,0 +1,218 @@
+#pragma once
+#include <stdio.h>
+#include <fstream>
+#include <vector>
+#include <GL/glew.h>
+
+// シェーダオブジェクトのコンパイル結果を表示する
+//  shader: シェーダオブジェクト名
+//  str: コンパイルエラーが発生した場所を表す文字列
+inline GLboolean printShaderInfoLog(GLuint shader, const char *str)
+{
+    // コンパイル結果を取得
+    GLint status;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    printf("shader status: %s\n", status == GL_TRUE ? "Success" : "Failed");
+    if (status == GL_FALSE)
+    {
+        printf("Error : Compile Error in %s\n", str);
+    }
+
+    // シェーダのコンパイル時のログの長さを取得
+    GLsizei bufSize;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &bufSize);
+
+    if (bufSize > 1)
+    {
+        // シェーダのコンパイル時のログ内容を取得
+        std::vector<GLchar> infoLog(bufSize);
+        GLsizei length;
+        glGetShaderInfoLog(shader, bufSize, &length, &infoLog[0]);
+        printf("printShader: %s", &infoLog[0]);
+    }
+
+    return static_cast<GLboolean>(status);
+}
+
+// プログラムオブジェクトのリンク結果を表示する
+//  program: プログラムオブジェクト名
+inline GLboolean printProgramInfoLog(GLuint program)
+{
+    // リンク結果を取得
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    printf("shader status: %s\n", status == GL_TRUE ? "Success" : "Failed");
+    if (status == GL_FALSE)
+    {
+        printf("Error : Link Error.\n");
+    }
+
+    // シェーダのリンク時のログの長さの取得
+    GLsizei bufSize;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &bufSize);
+
+    if (bufSize > 1)
+    {
+        // シェーダのリンク時のログの内容の取得
+        std::vector<GLchar> infoLog(bufSize);
+        GLsizei length;
+        glGetProgramInfoLog(program, bufSize, &length, &infoLog[0]);
+        printf("printProgram: %s", &infoLog[0]);
+    }
+
+    return static_cast<GLboolean>(status);
+}
+
+// プログラムオブジェクトの作成
+//  vsrc: バーテックスシェーダのソースプログラムの文字列
+//  fsrc: フラグメントシェーダのソースプログラムの文字列
+inline GLuint createProgram(const char *vsrc, const char *fsrc)
+{
+    // 空のプログラムオブジェクトの作成
+    const GLuint program(glCreateProgram());
+
+    if (vsrc != NULL)
+    {
+        // バーテックスシェーダのシェーダオブジェクトの作成
+        const GLuint vobj(glCreateShader(GL_VERTEX_SHADER));
+        glShaderSource(vobj, 1, &vsrc, NULL);
+        glCompileShader(vobj);
+
+        // バーテックスシェーダのコンパイル結果を確認
+        if (printShaderInfoLog(vobj, "Vertex Shader"))
+        {
+            glAttachShader(program, vobj);
+            printf("Attached vertex shader\n");
+        }
+        else
+        {
+            printf("Vertex shader compilation failed\n");
+        }
+        glDeleteShader(vobj);
+    }
+    else
+    {
+        printf("vsrc is null\n");
+    }
+
+    if (fsrc != NULL)
+    {
+        // フラグメントシェーダのシェーダオブジェクトの作成
+        const GLuint fobj(glCreateShader(GL_FRAGMENT_SHADER));
+        glShaderSource(fobj, 1, &fsrc, NULL);
+        glCompileShader(fobj);
+
+        // フラグメントシェーダのコンパイル結果を確認
+        if (printShaderInfoLog(fobj, "Fragment Shader"))
+        {
+            glAttachShader(program, fobj);
+            printf("Attached fragment shader\n");
+        }
+        else
+        {
+            printf("Fragment shader compilation failed\n");
+        }
+        glDeleteShader(fobj);
+    }
+    else
+    {
+        printf("fsrc is null\n");
+    }
+
+    // プログラムオブジェクトをリンクする
+    glBindAttribLocation(program, 0, "position");
+    glBindAttribLocation(program, 1, "normal");
+    glBindFragDataLocation(program, 0, "fragment");
+    glLinkProgram(program);
+
+    // 作成したプログラムオブジェクトを返す
+    if (printProgramInfoLog(program))
+    {
+        return program;
+    }
+
+    // 失敗したら 0 を返す
+    glDeleteProgram(program);
+    return 0;
+}
+
+// シェーダのソースファイルを読み込んだメモリを返す
+//  SHADER_QUIET を定義すると経過のメッセージを表示しない (エラーは表示する)
+//  name: シェーダのソースファイル名
+//  buffer: 読み込んだソースファイルのテキスト
+inline std::vector<GLchar> readShaderSource(const char *name, std::vector<GLchar> &buffer)
+{
+    std::vector<GLchar> nullVec;
+
+    // ファイル名がNULL
+    if (name == NULL)
+        return nullVec;
+
+#ifndef SHADER_QUIET
+    printf("Trying to open source file: %s\n", name); // デバッグメッセージを追加
+#endif
+
+    // ソースファイルを開く
+    std::ifstream file(name, std::ios::binary);
+
+    if (!file.is_open())
+    {
+        printf("Error : Can't open source file: %s\n", name);
+        return nullVec;
+    }
+
+    // ファイルの末尾に移動し現在位置(=ファイルサイズ)を得る
+    file.seekg(0L, std::ios::end);
+    long long int length = file.tellg();
+    file.seekg(0L, std::ios::beg);
+
+#ifndef SHADER_QUIET
+    printf("File length: %lld\n", length); // ファイルサイズを出力
+#endif
+
+    if (length <= 0)
+    {
+        printf("Error: File is empty or could not determine length.\n");
+        return nullVec;
+    }
+
+    // データをchar型に (リサイズ)
+    std::vector<GLchar> data(length + 1); // std::vectorを使用してメモリ管理を簡素化
+
+    // ファイル読み込み
+    file.read(data.data(), length);
+
+    if (file.fail())
+    { // 読み込み失敗をチェック
+        printf("Error : Could not read source file.\n");
+        return nullVec;
+    }
+
+    // NULL終端を追加
+    data[length] = '\0';
+
+#ifndef SHADER_QUIET
+    printf("Done : File read.\n");
+#endif
+
+    return data;
+}
+
+// シェーダのソースファイルを読み込んでプロクラムオブジェクトを作成する
+//  vert: バーテックスシェーダのソースファイル名
+//  frag: フラグメントシェーダのソースファイル名
+inline GLuint loadProgram(const char *vert, const char *frag)
+{
+
+    // シェーダのソースファイルを読み込む
+    std::vector<GLchar> vsrc = readShaderSource(vert, vsrc);
+    std::vector<GLchar> fsrc = readShaderSource(frag, fsrc);
+
+    // 読み込んだ内容を出力
+    printf("Vertex File content: %s\n", vsrc.data());
+    printf("Fragment File content: %s\n", fsrc.data());
+
+    // プログラムオブジェクトを作成
+    printf("create program obj\n");
+    return vsrc.data() != nullptr && fsrc.data() != nullptr ? createProgram(vsrc.data(), fsrc.data()) : 0;
+}
@@ -1,19 +1,39 @@
 #pragma once
-#include <memory>
 
 // 図形データ
 #include "Object.h"
 
+// GL のオブジェクトの登録簿
+#include "Resources.h"
+
 // 図形の描画
+//  図形データは Resources に登録し, ハンドルで参照する
+//  基本図形の種類と描画の方法は派生クラスがコンストラクタで決め, 描画は Resources::draw で分岐する
 class Shape {
-    // 図形データ
-    std::shared_ptr<const Object> object;
-
 protected:
 
+    // 図形データのハンドル
+    const Resources::MeshHandle mesh;
+
     // 描画に使う頂点の数
     const GLsizei vertexcount;
 
+    // コンストラクタ (派生クラス用)
+    //  mode: 基本図形の種類
+    //  draw: 描画の方法
+    //  size: 頂点の位置の次元
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列
+    //  indexcount: 頂点のインデックスの要素数
+    //  index: 頂点のインデックスを格納した配列
+    Shape(GLenum mode, Resources::Draw draw,
+        GLint size, GLsizei vertexcount, const Object::Vertex *vertex,
+        GLsizei indexcount, const GLuint *index)
+        : mesh(Resources::instance().addMesh(mode, draw, size, vertexcount, vertex, indexcount, index))
+        , vertexcount(vertexcount) {
+
+    }
+
 public:
 
     // コンストラクタ
@@ -25,23 +45,29 @@ public:
     Shape(
         GLint size, GLsizei vertexcount, const Object::Vertex *vertex,
         GLsizei indexcount = 0, const GLuint *index = NULL)
-        : object(new Object(size, vertexcount, vertex, indexcount, index))
-        , vertexcount(vertexcount) {
+        : Shape(GL_LINE_LOOP, Resources::Arrays, size, vertexcount, vertex, indexcount, index) {
 
     }
 
-    // 描画
-    void draw() const {
-        // 頂点配列オブジェクトを結合する
-        object->bind();
-
-        // 描画を実行する
-        execute();
+    // デストラクタ
+    virtual ~Shape() {
+        Resources::instance().removeMesh(mesh);
     }
 
-    // 描画の実行
-    virtual void execute() const {
-        // 折れ線で描画する
-        glDrawArrays(GL_LINE_LOOP, 0, vertexcount);
+    // 描画
+    //  material: 材質番号 (シェーダには gl_BaseInstance で渡る)
+    void draw(GLuint material = 0) const {
+        Resources::instance().draw(mesh, material);
     }
-};
\ No newline at end of file
+
+    // 図形データのハンドルを取り出す
+    Resources::MeshHandle getMesh() const { return mesh; }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    Shape(const Shape &s);
+
+    // 代入によるコピー禁止
+    Shape &operator=(const Shape &s);
+};
@@ -7,12 +7,22 @@
 class ShapeIndex : public Shape {
 protected:
 
-    // 描画に使う頂点の数
-    const GLuint indexcount;
+    // コンストラクタ (派生クラス用)
+    //  mode: 基本図形の種類
+    //  size: 頂点の位置の次元
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列
+    //  indexcount: 頂点のインデックスの要素数
+    //  index: 頂点のインデックスを格納した配列
+    ShapeIndex(GLenum mode,
+        GLint size, GLsizei vertexcount, const Object::Vertex *vertex,
+        GLsizei indexcount, const GLuint *index)
+        : Shape(mode, Resources::Elements, size, vertexcount, vertex, indexcount, index)
+    {}
 
 public:
 
-    // コンストラクタ
+    // コンストラクタ (線分群で描画)
     //  size: 頂点の位置の次元
     //  vertexcount: 頂点の数
     //  vertex: 頂点属性を格納した配列
@@ -21,15 +31,6 @@ public:
     ShapeIndex(
         GLint size, GLsizei vertexcount, const Object::Vertex *vertex,
         GLsizei indexcount, const GLuint *index)
-        : Shape(size, vertexcount, vertex, indexcount, index)
-        , indexcount(indexcount)
+        : ShapeIndex(GL_LINES, size, vertexcount, vertex, indexcount, index)
     {}
-
-    // 描画の実行
-
-    virtual void execute() const {
-        // 線分群で描画
-        glDrawElements(GL_LINES, indexcount, GL_UNSIGNED_INT, 0);
-    } 
-
-};
\ No newline at end of file
+};
@@ -0,0 +1,158 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <GL/glew.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define SIMD_SSE2 1
+#endif
+
+// 4要素の単精度浮動小数点数のベクトル演算
+struct float4 {
+#if SIMD_SSE2
+    __m128 v;
+
+    float4() {}
+    float4(__m128 a) : v(a) {}
+
+    // 全要素を同じ値にする
+    explicit float4(GLfloat a) : v(_mm_set1_ps(a)) {}
+
+    // 要素を個別に指定する
+    float4(GLfloat x, GLfloat y, GLfloat z, GLfloat w) : v(_mm_setr_ps(x, y, z, w)) {}
+
+    // 配列から読み込む (アラインメントは不要)
+    static float4 load(const GLfloat *p) { return _mm_loadu_ps(p); }
+
+    // 配列に書き出す (アラインメントは不要)
+    void store(GLfloat *p) const { _mm_storeu_ps(p, v); }
+
+    friend float4 operator+(float4 a, float4 b) { return _mm_add_ps(a.v, b.v); }
+    friend float4 operator-(float4 a, float4 b) { return _mm_sub_ps(a.v, b.v); }
+    friend float4 operator*(float4 a, float4 b) { return _mm_mul_ps(a.v, b.v); }
+    friend float4 operator/(float4 a, float4 b) { return _mm_div_ps(a.v, b.v); }
+    friend float4 operator-(float4 a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+    friend float4 min(float4 a, float4 b) { return _mm_min_ps(a.v, b.v); }
+    friend float4 max(float4 a, float4 b) { return _mm_max_ps(a.v, b.v); }
+    friend float4 sqrt(float4 a) { return _mm_sqrt_ps(a.v); }
+    friend float4 abs(float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+
+    // 比較結果は全ビットが 1 か 0 のマスクになる
+    friend float4 operator<(float4 a, float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+    friend float4 operator<=(float4 a, float4 b) { return _mm_cmple_ps(a.v, b.v); }
+    friend float4 operator>(float4 a, float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+    friend float4 operator>=(float4 a, float4 b) { return _mm_cmpge_ps(a.v, b.v); }
+    friend float4 operator&(float4 a, float4 b) { return _mm_and_ps(a.v, b.v); }
+    friend float4 operator|(float4 a, float4 b) { return _mm_or_ps(a.v, b.v); }
+
+    // マスクが立っている要素は a、そうでなければ b を選ぶ
+    friend float4 select(float4 mask, float4 a, float4 b) {
+        return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+    }
+
+    // マスクの各要素の最上位ビットを 4 ビットの整数にする
+    friend int movemask(float4 mask) { return _mm_movemask_ps(mask.v); }
+
+    // 0 方向への丸め
+    friend float4 truncate(float4 a) { return _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v)); }
+
+    // 要素を取り出す
+    GLfloat operator[](int i) const {
+        alignas(16) GLfloat t[4];
+        _mm_store_ps(t, v);
+        return t[i];
+    }
+
+    // 4 本のベクトルを行列とみなして転置する (AoS と SoA の変換に使う)
+    static void transpose(float4 &a, float4 &b, float4 &c, float4 &d) {
+        _MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v);
+    }
+#else
+    GLfloat v[4];
+
+    float4() {}
+
+    // 全要素を同じ値にする
+    explicit float4(GLfloat a) : v{ a, a, a, a } {}
+
+    // 要素を個別に指定する
+    float4(GLfloat x, GLfloat y, GLfloat z, GLfloat w) : v{ x, y, z, w } {}
+
+    // 配列から読み込む
+    static float4 load(const GLfloat *p) { return float4(p[0], p[1], p[2], p[3]); }
+
+    // 配列に書き出す
+    void store(GLfloat *p) const { std::copy(v, v + 4, p); }
+
+    // 要素ごとの演算
+    template<typename Func>
+    static float4 apply(float4 a, float4 b, Func f) {
+        return float4(f(a.v[0], b.v[0]), f(a.v[1], b.v[1]), f(a.v[2], b.v[2]), f(a.v[3], b.v[3]));
+    }
+
+    // 比較結果をマスクにする
+    static GLfloat mask(bool b) {
+        GLfloat m;
+        const unsigned int bits(b ? 0xffffffffu : 0u);
+        std::memcpy(&m, &bits, sizeof m);
+        return m;
+    }
+
+    // マスクのビット列
+    static unsigned int bits(GLfloat m) {
+        unsigned int b;
+        std::memcpy(&b, &m, sizeof b);
+        return b;
+    }
+
+    friend float4 operator+(float4 a, float4 b) { return apply(a, b, [](GLfloat x, GLfloat y) { return x + y; }); }
+    friend float4 operator-(float4 a, float4 b) { return apply(a, b, [](GLfloat x, GLfloat y) { return x - y; }); }
+    friend float4 operator*(float4 a, float4 b) { return apply(a, b, [](GLfloat x, GLfloat y) { return x * y; }); }
+    friend float4 operator/(float4 a, float4 b) { return apply(a, b, [](GLfloat x, GLfloat y) { return x / y; }); }
+    friend float4 operator-(float4 a) { return float4(-a.v[0], -a.v[1], -a.v[2], -a.v[3]); }
+    friend float4 min(float4 a, float4 b) { return apply(a, b, [](GLfloat x, GLfloat y) { return y < x ? y : x; }); }
+    friend float4 max(float4 a, float4 b) { return apply(a, b, [](GLfloat x, GLfloat y) { return y > x ? y : x; }); }
+    friend float4 sqrt(float4 a) { return float4(std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2]), std::sqrt(a.v[3])); }
+    friend float4 abs(float4 a) { return float4(std::fabs(a.v[0]), std::fabs(a.v[1]), std::fabs(a.v[2]), std::fabs(a.v[3])); }
+
+    // 比較結果は全ビットが 1 か 0 のマスクになる
+    friend float4 operator<(float4 a, float4 b) { return apply(a, b, [](GLfloat x, GLfloat y) { return mask(x < y); }); }
+    friend float4 operator<=(float4 a, float4 b) { return apply(a, b, [](GLfloat x, GLfloat y) { return mask(x <= y); }); }
+    friend float4 operator>(float4 a, float4 b) { return apply(a, b, [](GLfloat x, GLfloat y) { return mask(x > y); }); }
+    friend float4 operator>=(float4 a, float4 b) { return apply(a, b, [](GLfloat x, GLfloat y) { return mask(x >= y); }); }
+    friend float4 operator&(float4 a, float4 b) { return apply(a, b, [](GLfloat x, GLfloat y) { return mask(bits(x) & bits(y)); }); }
+    friend float4 operator|(float4 a, float4 b) { return apply(a, b, [](GLfloat x, GLfloat y) { return mask(bits(x) | bits(y)); }); }
+
+    // マスクが立っている要素は a、そうでなければ b を選ぶ
+    friend float4 select(float4 mask, float4 a, float4 b) {
+        return float4(bits(mask.v[0]) ? a.v[0] : b.v[0], bits(mask.v[1]) ? a.v[1] : b.v[1],
+            bits(mask.v[2]) ? a.v[2] : b.v[2], bits(mask.v[3]) ? a.v[3] : b.v[3]);
+    }
+
+    // マスクの各要素を 4 ビットの整数にする
+    friend int movemask(float4 mask) {
+        return (bits(mask.v[0]) ? 1 : 0) | (bits(mask.v[1]) ? 2 : 0)
+            | (bits(mask.v[2]) ? 4 : 0) | (bits(mask.v[3]) ? 8 : 0);
+    }
+
+    // 0 方向への丸め
+    friend float4 truncate(float4 a) {
+        return float4(std::trunc(a.v[0]), std::trunc(a.v[1]), std::trunc(a.v[2]), std::trunc(a.v[3]));
+    }
+
+    // 要素を取り出す
+    GLfloat operator[](int i) const { return v[i]; }
+
+    // 4 本のベクトルを行列とみなして転置する (AoS と SoA の変換に使う)
+    static void transpose(float4 &a, float4 &b, float4 &c, float4 &d) {
+        std::swap(a.v[1], b.v[0]);
+        std::swap(a.v[2], c.v[0]);
+        std::swap(a.v[3], d.v[0]);
+        std::swap(b.v[2], c.v[1]);
+        std::swap(b.v[3], d.v[1]);
+        std::swap(c.v[3], d.v[2]);
+    }
+#endif
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <GL/glew.h>
+
+// 4要素のベクトル演算
+#include "Simd.h"
+
+// 4要素の三角関数の多項式近似
+//  引数を π/2 の整数倍と [-π/4, π/4] の余りに分けて余りを多項式で求める
+//  |x| <= 8192 で libm の sinf/cosf との差は 1.2e-7 以下
+//  tan は sin / cos なので差はおよそ 1.2e-7 / cos^2 x (|cos x| > 0.1 で 1.2e-5 以下)
+//  sin x が 0 に近いところでは引数の縮約の誤差が残るので相対誤差は小さくならない
+
+// 0 方向ではなく最も近い整数への丸め
+inline float4 round(float4 a) {
+    return truncate(a + select(a < float4(0.0f), float4(-0.5f), float4(0.5f)));
+}
+
+// 小数点以下の切り捨て (負の数は -∞ 方向)
+inline float4 floor(float4 a) {
+    const float4 t(truncate(a));
+    return t - select(a < t, float4(1.0f), float4(0.0f));
+}
+
+// sin と cos を同時に求める
+//  x: 角度 (ラジアン)
+//  s: sin の格納先
+//  c: cos の格納先
+inline void sincos(float4 x, float4 &s, float4 &c) {
+    // x = j π/2 + r (π/2 を 3 つに分けて桁落ちを防ぐ)
+    const float4 j(round(x * float4(0.63661977236758134f)));
+    float4 r(x - j * float4(1.5703125f));
+    r = r - j * float4(4.837512969970703125e-4f);
+    r = r - j * float4(7.54978995489188216e-8f);
+
+    // [-π/4, π/4] の多項式近似
+    const float4 r2(r * r);
+    float4 ps(float4(-1.9515295891e-4f));
+    ps = ps * r2 + float4(8.3321608736e-3f);
+    ps = ps * r2 + float4(-1.6666654611e-1f);
+    ps = r + r * r2 * ps;
+    float4 pc(float4(2.443315711809948e-5f));
+    pc = pc * r2 + float4(-1.388731625493765e-3f);
+    pc = pc * r2 + float4(4.166664568298827e-2f);
+    pc = float4(1.0f) - float4(0.5f) * r2 + r2 * r2 * pc;
+
+    // 象限に応じて入れ替えと符号反転をする
+    const float4 q(j - float4(4.0f) * floor(j * float4(0.25f)));
+    const float4 swap(((q > float4(0.5f)) & (q < float4(1.5f))) | (q > float4(2.5f)));
+    const float4 sinNeg(q > float4(1.5f));
+    const float4 cosNeg((q > float4(0.5f)) & (q < float4(2.5f)));
+    const float4 ss(select(swap, pc, ps)), cc(select(swap, ps, pc));
+    s = select(sinNeg, -ss, ss);
+    c = select(cosNeg, -cc, cc);
+}
+
+// sin
+inline float4 sin(float4 x) {
+    float4 s, c;
+    sincos(x, s, c);
+    return s;
+}
+
+// cos
+inline float4 cos(float4 x) {
+    float4 s, c;
+    sincos(x, s, c);
+    return c;
+}
+
+// tan
+inline float4 tan(float4 x) {
+    float4 s, c;
+    sincos(x, s, c);
+    return s / c;
+}
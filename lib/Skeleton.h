@@ -0,0 +1,143 @@
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include <cmath>
+#include <GL/glew.h>
+
+// 変換行列
+#include "Matrix.h"
+
+// 四元数による回転
+#include "Quaternion.h"
+
+// 図形データ
+#include "Object.h"
+
+// SIMD 演算
+#include "Simd.h"
+
+// 並列処理
+#include "ThreadPool.h"
+
+// 関節の階層と線形ブレンドスキニング
+//  関節は親を子より先に追加するので, 先頭から順に親の変換を掛ければ全ての関節の変換が求まる
+class Skeleton {
+public:
+
+    // 一つの頂点に影響する関節の数
+    static const int influences = 4;
+
+    // スキニングする頂点属性
+    struct Vertex {
+        // 位置
+        GLfloat position[3];
+
+        // 法線
+        GLfloat normal[3];
+
+        // 影響する関節の番号
+        GLubyte joint[influences];
+
+        // 関節の重み (合計が 1)
+        GLfloat weight[influences];
+    };
+
+private:
+
+    // 親の関節の番号 (根は -1)
+    std::vector<int> parent;
+
+    // 基本姿勢の関節の変換の逆行列
+    std::vector<Matrix> inverseBind;
+
+    // 関節の変換 (作業用)
+    std::vector<Matrix> global;
+
+public:
+
+    // コンストラクタ
+    Skeleton() {}
+
+    // デストラクタ
+    virtual ~Skeleton() {}
+
+    // 関節を追加する
+    //  parent: 親の関節の番号 (根なら -1, 先に追加した関節)
+    //  bind: 基本姿勢の関節の変換 (親ではなく全体の座標系)
+    //  戻り値: 関節の番号 (追加できなければ -1)
+    int addJoint(int parent, const Matrix &bind) {
+        const int joint(static_cast<int>(this->parent.size()));
+        if (joint > 255 || parent >= joint) {
+            printf("Error : Can't add joint %d (parent %d)\n", joint, parent);
+            return -1;
+        }
+        this->parent.push_back(parent < 0 ? -1 : parent);
+        inverseBind.push_back(Matrix::inverse(bind));
+        global.push_back(bind);
+        return joint;
+    }
+
+    // 関節の姿勢からスキニングに使う変換行列を求める
+    //  rotation: 関節ごとの親に対する回転
+    //  translation: 関節ごとの親に対する平行移動量 (3 要素ずつ)
+    //  skin: 関節ごとの基本姿勢からの変換行列の格納先
+    void pose(const Quaternion *rotation, const GLfloat *translation, Matrix *skin) {
+        for (std::size_t j = 0; j < parent.size(); ++j) {
+            Matrix local(rotation[j].getMatrix());
+            local[12] = translation[j * 3 + 0];
+            local[13] = translation[j * 3 + 1];
+            local[14] = translation[j * 3 + 2];
+            global[j] = parent[j] < 0 ? local : global[parent[j]] * local;
+            skin[j] = global[j] * inverseBind[j];
+        }
+    }
+
+    // 関節の数
+    std::size_t getJointCount() const { return parent.size(); }
+
+    // 頂点をスキニングする
+    //  変換行列の列を重みで混ぜてから頂点に掛けるので, 頂点ごとに行列を 4 列ぶん float4 で計算する
+    //  法線は混ぜた行列の回転の部分で変換して正規化する (関節の変換に不均一な拡大縮小はないものとする)
+    //  count: 頂点の数
+    //  vertex: スキニングする頂点属性
+    //  matrix: 関節ごとの変換行列 (pose で求めたもの)
+    //  dst: 変換した頂点属性の格納先 (DynamicObject::edit で取り出した写しなど)
+    static void skin(std::size_t count, const Vertex *vertex, const Matrix *matrix, Object::Vertex *dst) {
+        ThreadPool::instance().parallelFor(count, 4096, [vertex, matrix, dst](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                const Vertex &v(vertex[i]);
+                float4 c0(0.0f), c1(0.0f), c2(0.0f), c3(0.0f);
+                for (int k = 0; k < influences; ++k) {
+                    const float4 w(v.weight[k]);
+                    const GLfloat *const m(matrix[v.joint[k]].data());
+                    c0 = c0 + float4::load(m) * w;
+                    c1 = c1 + float4::load(m + 4) * w;
+                    c2 = c2 + float4::load(m + 8) * w;
+                    c3 = c3 + float4::load(m + 12) * w;
+                }
+                const float4 p(c0 * float4(v.position[0]) + c1 * float4(v.position[1]) + c2 * float4(v.position[2]) + c3);
+                const float4 n(c0 * float4(v.normal[0]) + c1 * float4(v.normal[1]) + c2 * float4(v.normal[2]));
+                alignas(16) GLfloat tp[4], tn[4];
+                p.store(tp);
+                n.store(tn);
+                const GLfloat l(std::sqrt(tn[0] * tn[0] + tn[1] * tn[1] + tn[2] * tn[2]));
+                const GLfloat s(l > 0.0f ? 1.0f / l : 0.0f);
+                Object::Vertex &d(dst[i]);
+                d.position[0] = tp[0];
+                d.position[1] = tp[1];
+                d.position[2] = tp[2];
+                d.normal[0] = tn[0] * s;
+                d.normal[1] = tn[1] * s;
+                d.normal[2] = tn[2] * s;
+            }
+        });
+    }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    Skeleton(const Skeleton &s);
+
+    // 代入によるコピー禁止
+    Skeleton &operator=(const Skeleton &s);
+};
@@ -0,0 +1,145 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// スロットマップの要素を指す 32 ビットのハンドル
+//  下位 indexBits ビットがスロットの番号, 上位が世代
+//  世代は 1 から始まるので値が 0 のハンドルはどの要素も指さない
+template <typename T>
+struct SlotHandle {
+    // スロットの番号のビット数
+    static const std::uint32_t indexBits = 20;
+
+    // ハンドルの値
+    std::uint32_t value;
+
+    // スロットの番号
+    std::uint32_t index() const { return value & ((1u << indexBits) - 1u); }
+
+    // 世代
+    std::uint32_t generation() const { return value >> indexBits; }
+
+    // 何かを指していれば true
+    explicit operator bool() const { return value != 0; }
+
+    bool operator==(SlotHandle h) const { return value == h.value; }
+    bool operator!=(SlotHandle h) const { return value != h.value; }
+};
+
+// 世代付きのスロットマップ
+//  要素は常に隙間なく配列に並べ, 削除したら末尾の要素で穴を埋める
+//  ハンドルはスロットを通して要素を指し, スロットを使い回すと世代を進めるので削除済みのハンドルは無効になる
+template <typename T>
+class SlotMap {
+public:
+
+    // ハンドル
+    using Handle = SlotHandle<T>;
+
+private:
+
+    // 世代の上限
+    static const std::uint32_t generationMask = (1u << (32 - Handle::indexBits)) - 1u;
+
+    // 空きスロットのリストの終わり
+    static const std::uint32_t none = ~0u;
+
+    // スロット
+    struct Slot {
+        // 使用中なら要素の位置, 空きなら次の空きスロット
+        std::uint32_t position;
+
+        // 世代
+        std::uint32_t generation;
+    };
+
+    // 隙間なく並べた要素
+    std::vector<T> element;
+
+    // 要素ごとのスロットの番号
+    std::vector<std::uint32_t> owner;
+
+    // スロット
+    std::vector<Slot> slot;
+
+    // 空きスロットのリストの先頭
+    std::uint32_t freeHead;
+
+public:
+
+    // コンストラクタ
+    SlotMap()
+        : freeHead(none)
+    {}
+
+    // デストラクタ
+    virtual ~SlotMap() {}
+
+    // 要素を追加する
+    //  value: 追加する要素
+    //  戻り値: 要素のハンドル (スロットを使い切ったら値が 0 のハンドル)
+    Handle insert(const T &value) {
+        std::uint32_t s;
+        if (freeHead != none) {
+            s = freeHead;
+            freeHead = slot[s].position;
+        }
+        else {
+            if (slot.size() >= (1u << Handle::indexBits)) return Handle{ 0 };
+            s = static_cast<std::uint32_t>(slot.size());
+            slot.push_back(Slot{ none, 1u });
+        }
+        slot[s].position = static_cast<std::uint32_t>(element.size());
+        element.push_back(value);
+        owner.push_back(s);
+        return Handle{ slot[s].generation << Handle::indexBits | s };
+    }
+
+    // 要素を削除する
+    //  h: 削除する要素のハンドル
+    //  戻り値: 削除したら true (無効なハンドルなら false)
+    bool erase(Handle h) {
+        if (get(h) == NULL) return false;
+        const std::uint32_t s(h.index()), p(slot[s].position), last(static_cast<std::uint32_t>(element.size() - 1));
+
+        // 末尾の要素で穴を埋める
+        if (p != last) {
+            element[p] = element[last];
+            owner[p] = owner[last];
+            slot[owner[p]].position = p;
+        }
+        element.pop_back();
+        owner.pop_back();
+
+        // 世代を進めて空きスロットのリストに戻す (0 は飛ばす)
+        slot[s].generation = (slot[s].generation + 1u) & generationMask;
+        if (slot[s].generation == 0u) slot[s].generation = 1u;
+        slot[s].position = freeHead;
+        freeHead = s;
+        return true;
+    }
+
+    // ハンドルの指す要素を取り出す
+    //  h: 要素のハンドル
+    //  戻り値: 要素のポインタ (無効なハンドルなら NULL)
+    T *get(Handle h) {
+        const std::uint32_t s(h.index());
+        if (h.value == 0 || s >= slot.size() || slot[s].generation != h.generation()) return NULL;
+        return &element[slot[s].position];
+    }
+    const T *get(Handle h) const {
+        return const_cast<SlotMap *>(this)->get(h);
+    }
+
+    // 要素の数
+    std::size_t size() const { return element.size(); }
+
+    // 隙間なく並べた要素
+    T *data() { return element.data(); }
+    const T *data() const { return element.data(); }
+    typename std::vector<T>::iterator begin() { return element.begin(); }
+    typename std::vector<T>::iterator end() { return element.end(); }
+    typename std::vector<T>::const_iterator begin() const { return element.begin(); }
+    typename std::vector<T>::const_iterator end() const { return element.end(); }
+};
@@ -12,12 +12,6 @@ public:
     //  vertexcount: 頂点の数
     //  vertex: 頂点属性を格納した配列
     SolidShape(GLint size, GLsizei vertexcount, const Object::Vertex *vertex)
-        : Shape(size, vertexcount, vertex)
+        : Shape(GL_TRIANGLES, Resources::Arrays, size, vertexcount, vertex, 0, NULL)
     {}
-
-    // 描画の実行
-    virtual void execute() const {
-        // 三角形で描画
-        glDrawArrays(GL_TRIANGLES, 0, vertexcount);
-    }
-};
\ No newline at end of file
+};
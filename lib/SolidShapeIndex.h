@@ -16,12 +16,6 @@ public:
     SolidShapeIndex(
         GLint size, GLsizei vertexcount, const Object::Vertex *vertex,
         GLsizei indexcount, const GLuint *index)
-        : ShapeIndex(size, vertexcount, vertex, indexcount, index)
+        : ShapeIndex(GL_TRIANGLES, size, vertexcount, vertex, indexcount, index)
     {}
-
-    // 描画の実行
-    virtual void execute() const {
-        // 三角形で描画
-        glDrawElements(GL_TRIANGLES, indexcount, GL_UNSIGNED_INT, 0);
-    }
-};
\ No newline at end of file
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <GL/glew.h>
+
+// 図形データ
+#include "Object.h"
+
+// 球の頂点属性とインデックスを作る
+//  slices: 経度方向の分割数
+//  stacks: 緯度方向の分割数
+//  vertex: 頂点属性の格納先
+//  index: 三角形の頂点のインデックスの格納先
+inline void createSphere(int slices, int stacks,
+    std::vector<Object::Vertex> &vertex, std::vector<GLuint> &index)
+{
+    // 頂点属性を作る
+    vertex.clear();
+    vertex.reserve(static_cast<std::size_t>(slices + 1) * (stacks + 1));
+    for (int j = 0; j <= stacks; j++) {
+        const float t(static_cast<float>(j) / static_cast<float>(stacks));
+        const float y(std::cos(3.141593f * t)), r(std::sin(3.141593f * t));
+
+        for (int i = 0; i <= slices; i++) {
+            const float s(static_cast<float>(i) / static_cast<float>(slices));
+            const float z(r * std::cos(6.283185f * s)), x(r * std::sin(6.283185f * s));
+
+            // 頂点属性
+            const Object::Vertex v = {x, y, z, x, y, z};
+
+            // 頂点属性を追加
+            vertex.emplace_back(v);
+        }
+    }
+
+    // インデックスを作る
+    index.clear();
+    index.reserve(static_cast<std::size_t>(slices) * stacks * 6);
+    for (int j = 0; j < stacks; j++) {
+        const int k((slices + 1) * j);
+
+        for (int i = 0; i < slices; i++) {
+            // 頂点のインデックス
+            const GLuint k0(k + i);
+            const GLuint k1(k0 + 1);
+            const GLuint k2(k1 + slices);
+            const GLuint k3(k2 + 1);
+
+            // 左下の三角形
+            index.emplace_back(k0);
+            index.emplace_back(k2);
+            index.emplace_back(k3);
+
+            // 右上の三角形
+            index.emplace_back(k0);
+            index.emplace_back(k3);
+            index.emplace_back(k1);
+        }
+    }
+}
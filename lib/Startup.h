@@ -0,0 +1,233 @@
+#pragma once
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <initializer_list>
+
+// 並列処理
+#include "ThreadPool.h"
+
+// 起動処理の依存関係のグラフ
+//  ファイルの読み込みや図形データの作成のような GL を使わない段階を add で登録し, start したら
+//  依存する段階が終わったものからワーカースレッドで実行する (ワーカースレッドがなければ start の中で順に実行する)
+//  GL を使う処理はコンテキストを持つスレッドで wait で必要な段階を待ってから行い, record で時間を記録する
+//  最初のフレームを表示したら firstFrame で各段階の時間と起動から最初のフレームまでの時間を表示する
+class Startup {
+public:
+
+    // 段階の番号
+    using Stage = std::size_t;
+
+    // 段階を実行したスレッド
+    enum Thread {
+        Worker,
+        Main,
+        Context
+    };
+
+private:
+
+    using Clock = std::chrono::steady_clock;
+
+    // 段階
+    struct Entry {
+        // 名前
+        std::string name;
+
+        // 実行したスレッド
+        Thread thread;
+
+        // 処理 (実行したら捨てる)
+        std::function<void()> job;
+
+        // この段階を待っている段階
+        std::vector<Stage> next;
+
+        // まだ終わっていない依存先の数
+        std::size_t pending;
+
+        // 終わっていれば true
+        bool done;
+
+        // 起動からの開始と終了の時刻 (ミリ秒)
+        double begin, end;
+    };
+
+    // 起動した時刻
+    const Clock::time_point origin;
+
+    // ワーカースレッドで実行する段階 (start した後は追加しないので並びは動かない)
+    std::vector<Entry> entry;
+
+    // メインスレッドやコンテキストを持つスレッドで行った処理
+    std::vector<Entry> serial;
+
+    // 段階の状態の排他制御と終了の通知
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    // start したら true
+    bool started;
+
+    // コンテキストを持つスレッドがワーカースレッドを待った時間 (ミリ秒)
+    double waited;
+
+    // 表示したら true
+    bool reported;
+
+    // 段階をワーカースレッドで実行し, 終わったら待っている段階のうち依存先が全て終わったものを続けて実行する
+    //  s: 段階の番号
+    void launch(Stage s) {
+        ThreadPool::instance().submit([this, s] {
+            const double begin(now());
+            entry[s].job();
+            const double end(now());
+            std::vector<Stage> ready;
+            {
+                // 終わったことを知らせてから鍵を放す (放した後ではデストラクタが先に戻って条件変数が消えることがある)
+                std::lock_guard<std::mutex> lock(mutex);
+                Entry &e(entry[s]);
+                e.job = nullptr;
+                e.begin = begin;
+                e.end = end;
+                e.done = true;
+                for (Stage n : e.next) if (--entry[n].pending == 0) ready.push_back(n);
+                condition.notify_all();
+            }
+            for (Stage n : ready) launch(n);
+        });
+    }
+
+public:
+
+    // コンストラクタ (起動の時刻を記録する)
+    Startup()
+        : origin(Clock::now()), started(false), waited(0.0), reported(false)
+    {}
+
+    // デストラクタ (ワーカースレッドで実行中の段階が終わるのを待つ)
+    virtual ~Startup() {
+        if (!started) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this] {
+            for (const Entry &e : entry) if (!e.done) return false;
+            return true;
+        });
+    }
+
+    // 起動からの時間
+    //  戻り値: ミリ秒
+    double now() const {
+        return std::chrono::duration<double, std::milli>(Clock::now() - origin).count();
+    }
+
+    // ワーカースレッドで実行する段階を登録する (start より前に呼ぶ)
+    //  name: 名前
+    //  job: 処理 (GL を使わない)
+    //  after: 先に終わっていなければならない段階
+    //  戻り値: 段階の番号
+    Stage add(const std::string &name, std::function<void()> job, std::initializer_list<Stage> after = {}) {
+        const Stage s(entry.size());
+        Entry e = { name, Worker, job, {}, 0, false, 0.0, 0.0 };
+        if (started) {
+            // 並びが動くと実行中の段階を壊すので, その場で実行して終わったことにする
+            printf("Error : Startup stage added after start: %s\n", name.c_str());
+            e.begin = now();
+            job();
+            e.end = now();
+            e.job = nullptr;
+            e.done = true;
+            std::lock_guard<std::mutex> lock(mutex);
+            serial.push_back(e);
+            return ~Stage(0);
+        }
+        for (Stage a : after) {
+            if (a < s) {
+                entry[a].next.push_back(s);
+                ++e.pending;
+            }
+        }
+        entry.push_back(e);
+        return s;
+    }
+
+    // 依存先のない段階から実行を始める
+    void start() {
+        if (started) return;
+        started = true;
+
+        // 先に実行した段階が終わると依存先の数を減らして続きを実行するので, 始める段階は実行する前に選んでおく
+        std::vector<Stage> ready;
+        for (Stage s = 0; s < entry.size(); ++s) {
+            if (entry[s].pending == 0) ready.push_back(s);
+        }
+        for (Stage s : ready) launch(s);
+    }
+
+    // ワーカースレッドで実行する段階が終わるのを待つ (コンテキストを持つスレッドから呼ぶ)
+    //  s: 段階の番号
+    void wait(Stage s) {
+        if (s >= entry.size()) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        if (entry[s].done) return;
+        const double begin(now());
+        condition.wait(lock, [this, s] { return entry[s].done; });
+        waited += now() - begin;
+    }
+
+    // メインスレッドやコンテキストを持つスレッドで行った処理の時間を記録する
+    //  name: 名前
+    //  thread: 実行したスレッド
+    //  begin: 開始した時刻 (now() の値)
+    void record(const std::string &name, Thread thread, double begin) {
+        const double end(now());
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry e = { name, thread, nullptr, {}, 0, true, begin, end };
+        serial.push_back(e);
+    }
+
+    // 最初のフレームを表示したときに各段階の時間と最初のフレームまでの時間を表示する (二回目からは何もしない)
+    void firstFrame() {
+        if (reported) return;
+        reported = true;
+        const double frame(now());
+
+        std::vector<Entry> sorted;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const std::vector<Entry> *list : { &entry, &serial }) {
+                for (const Entry &e : *list) {
+                    Entry r = { e.name, e.thread, nullptr, {}, 0, e.done, e.begin, e.end };
+                    sorted.push_back(r);
+                }
+            }
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), [](const Entry &a, const Entry &b) { return a.begin < b.begin; });
+
+        static const char *const thread[] = { "worker", "main", "context" };
+        printf("startup: %-24s %-8s %10s %10s %10s\n", "stage", "thread", "begin", "end", "ms");
+        for (const Entry &e : sorted) {
+            if (!e.done) {
+                printf("startup: %-24s %-8s %10s\n", e.name.c_str(), thread[e.thread], "running");
+                continue;
+            }
+            printf("startup: %-24s %-8s %10.3f %10.3f %10.3f\n",
+                e.name.c_str(), thread[e.thread], e.begin, e.end, e.end - e.begin);
+        }
+        printf("startup: context thread waited %.3f ms for workers\n", waited);
+        printf("startup: time to first frame %.3f ms\n", frame);
+    }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    Startup(const Startup &s);
+
+    // 代入によるコピー禁止
+    Startup &operator=(const Startup &s);
+};
@@ -0,0 +1,210 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+
+// ワーカースレッドによる並列処理
+//  定常状態ではジョブの登録や parallelFor でヒープを確保しない
+class ThreadPool {
+    // ワーカースレッド
+    std::vector<std::thread> workers;
+
+    // 実行待ちのジョブのリングバッファ
+    std::vector<std::function<void()>> jobs;
+
+    // リングバッファの先頭と実行待ちのジョブの数
+    std::size_t head, pending;
+
+    // ジョブキューの排他制御
+    std::mutex mutex;
+
+    // ジョブの到着の通知
+    std::condition_variable condition;
+
+    // 終了要求
+    bool quit;
+
+    // parallelFor の共有状態
+    struct Range {
+        // 処理する関数 (呼び出し元のスタックにある関数オブジェクトを型消去して呼ぶ)
+        void (*invoke)(const void *, std::size_t, std::size_t);
+        const void *func;
+
+        // 要素数と分割の大きさ
+        std::size_t count, grain, chunks;
+
+        // 次に取り出す分割の番号
+        std::atomic<std::size_t> next;
+
+        // 処理の終わった分割の数
+        std::atomic<std::size_t> done;
+
+        // この状態を参照しているスレッドの数
+        std::atomic<unsigned int> refs;
+
+        // 分割を取り出せる限り処理する
+        void run() {
+            for (std::size_t c; (c = next.fetch_add(1)) < chunks;) {
+                const std::size_t begin(c * grain);
+                invoke(func, begin, std::min(begin + grain, count));
+                done.fetch_add(1, std::memory_order_release);
+            }
+        }
+    };
+
+    // 使い回す parallelFor の共有状態
+    std::vector<std::unique_ptr<Range>> ranges;
+    std::vector<Range *> freeRanges;
+
+    // 共有状態を取り出す
+    Range *acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freeRanges.empty()) {
+            ranges.emplace_back(new Range);
+            freeRanges.reserve(ranges.size());
+            return ranges.back().get();
+        }
+        Range *const range(freeRanges.back());
+        freeRanges.pop_back();
+        return range;
+    }
+
+    // 共有状態の参照をやめる (最後の参照なら使い回しに戻す)
+    void release(Range *range) {
+        if (range->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeRanges.push_back(range);
+        }
+    }
+
+    // ワーカースレッドの処理
+    void work() {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this] { return quit || pending > 0; });
+                if (pending == 0) return;
+                job.swap(jobs[head]);
+                head = (head + 1) % jobs.size();
+                --pending;
+            }
+            job();
+        }
+    }
+
+public:
+
+    // コンストラクタ
+    //  count: ワーカースレッドの数 (0 なら呼び出し元だけで処理する)
+    ThreadPool(unsigned int count = std::max(1u, std::thread::hardware_concurrency()) - 1)
+        : jobs(64), head(0), pending(0), quit(false)
+    {
+        for (unsigned int i = 0; i < count; i++) {
+            workers.emplace_back(&ThreadPool::work, this);
+        }
+    }
+
+    // デストラクタ
+    virtual ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        condition.notify_all();
+        for (std::thread &t : workers) t.join();
+    }
+
+    // 呼び出し元を含めた並列度
+    unsigned int size() const {
+        return static_cast<unsigned int>(workers.size()) + 1;
+    }
+
+    // ジョブを登録する (ワーカースレッドがなければその場で実行する)
+    //  job: ワーカースレッドで実行する関数
+    void submit(std::function<void()> job) {
+        if (workers.empty()) {
+            job();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            // リングバッファが一杯なら倍に広げて詰め直す
+            if (pending == jobs.size()) {
+                std::vector<std::function<void()>> grown(jobs.size() * 2);
+                for (std::size_t i = 0; i < pending; i++) {
+                    grown[i].swap(jobs[(head + i) % jobs.size()]);
+                }
+                jobs.swap(grown);
+                head = 0;
+            }
+            jobs[(head + pending) % jobs.size()].swap(job);
+            ++pending;
+        }
+        condition.notify_one();
+    }
+
+    // [0, count) を grain 個ずつに分けて並列に処理し、終わるまで待つ
+    //  count: 要素数
+    //  grain: 一つのジョブで処理する要素数
+    //  func: 処理する関数 func(begin, end)
+    template<typename Func>
+    void parallelFor(std::size_t count, std::size_t grain, const Func &func) {
+        if (count == 0) return;
+        if (grain == 0) grain = 1;
+
+        // 分割が一つならその場で処理する
+        const std::size_t chunks((count + grain - 1) / grain);
+        if (chunks == 1 || workers.empty()) {
+            func(std::size_t(0), count);
+            return;
+        }
+
+        // 取り残されたジョブが後から参照しても良いように参照を数える
+        const std::size_t helpers(std::min<std::size_t>(workers.size(), chunks - 1));
+        Range *const range(acquire());
+        range->invoke = [](const void *f, std::size_t begin, std::size_t end) {
+            (*static_cast<const Func *>(f))(begin, end);
+        };
+        range->func = &func;
+        range->count = count;
+        range->grain = grain;
+        range->chunks = chunks;
+        range->next = 0;
+        range->done = 0;
+        range->refs = static_cast<unsigned int>(helpers + 1);
+
+        // 呼び出し元も処理に加わる
+        for (std::size_t i = 0; i < helpers; i++) {
+            submit([this, range] { range->run(); release(range); });
+        }
+        range->run();
+
+        // 他のスレッドが処理している分割の終了を待つ
+        while (range->done.load(std::memory_order_acquire) < chunks) {
+            std::this_thread::yield();
+        }
+        release(range);
+    }
+
+    // アプリケーション全体で共有するスレッドプール
+    static ThreadPool &instance() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    ThreadPool(const ThreadPool &p);
+
+    // 代入によるコピー禁止
+    ThreadPool &operator=(const ThreadPool &p);
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+
+// 一つのスレッドが書き込み, 別の一つのスレッドが読み出すデータの三重バッファ
+//  書き込む側は裏のバッファを埋めて publish() で中間のバッファと入れ替え,
+//  読み出す側は update() で新しいものがあれば中間のバッファと表のバッファを入れ替える
+//  どちらの側も待たされることはなく, 読み出す側は常に最新の完全なデータを見る
+template <typename T>
+class TripleBuffer {
+
+    // 新しいデータが中間のバッファにあることを示すビット
+    static constexpr unsigned fresh = 4u;
+
+    // バッファ
+    T buffer[3];
+
+    // 中間のバッファの番号と fresh ビット
+    std::atomic<unsigned> middle;
+
+    // 書き込む側が使う裏のバッファの番号
+    unsigned back;
+
+    // 読み出す側が使う表のバッファの番号
+    unsigned front;
+
+public:
+
+    // コンストラクタ
+    TripleBuffer()
+        : buffer{}, middle(1u), back(0u), front(2u)
+    {
+    }
+
+    // デストラクタ
+    virtual ~TripleBuffer() {}
+
+    // 書き込む側: 裏のバッファを取り出す
+    T &getBack() { return buffer[back]; }
+
+    // 書き込む側: 裏のバッファを公開する
+    //  次の裏のバッファの内容は以前のものなので全体を書き直すこと
+    void publish() {
+        back = middle.exchange(back | fresh, std::memory_order_acq_rel) & ~fresh;
+    }
+
+    // 読み出す側: 新しいデータがあれば表のバッファと入れ替えて true を返す
+    bool update() {
+        if ((middle.load(std::memory_order_relaxed) & fresh) == 0) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & ~fresh;
+        return true;
+    }
+
+    // 読み出す側: 表のバッファを取り出す
+    const T &getFront() const { return buffer[front]; }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    TripleBuffer(const TripleBuffer &t);
+
+    // 代入によるコピー禁止
+    TripleBuffer &operator=(const TripleBuffer &t);
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <GL/glew.h>
+
+// 関節の階層と線形ブレンドスキニング
+#include "Skeleton.h"
+
+// 関節の鎖で曲げる円筒の頂点属性とインデックスを作る
+//  円筒は y 軸に沿って 0 から height まで伸び, 関節 j は高さ height * j / joints にあるものとする
+//  各頂点は上下の二つの関節に高さに応じた重みで影響される
+//  slices: 円周方向の分割数
+//  stacks: 高さ方向の分割数
+//  joints: 関節の数 (1 〜 256)
+//  radius: 半径
+//  height: 高さ
+//  vertex: 頂点属性の格納先
+//  index: 三角形の頂点のインデックスの格納先
+inline void createTube(int slices, int stacks, int joints, GLfloat radius, GLfloat height,
+    std::vector<Skeleton::Vertex> &vertex, std::vector<GLuint> &index)
+{
+    // 頂点属性を作る
+    vertex.clear();
+    vertex.reserve(static_cast<std::size_t>(slices + 1) * (stacks + 1));
+    for (int j = 0; j <= stacks; j++) {
+        const float t(static_cast<float>(j) / static_cast<float>(stacks));
+
+        // 下の関節とその次の関節への重み
+        const float f(std::min(std::max(t * joints, 0.0f), static_cast<float>(joints - 1)));
+        const int j0(static_cast<int>(f)), j1(std::min(j0 + 1, joints - 1));
+        const float w(f - static_cast<float>(j0));
+
+        for (int i = 0; i <= slices; i++) {
+            const float s(static_cast<float>(i) / static_cast<float>(slices));
+            const float z(std::cos(6.283185f * s)), x(std::sin(6.283185f * s));
+
+            // 頂点属性
+            const Skeleton::Vertex v = {
+                { x * radius, t * height, z * radius }, { x, 0.0f, z },
+                { static_cast<GLubyte>(j0), static_cast<GLubyte>(j1), 0, 0 }, { 1.0f - w, w, 0.0f, 0.0f }
+            };
+
+            // 頂点属性を追加
+            vertex.emplace_back(v);
+        }
+    }
+
+    // インデックスを作る
+    index.clear();
+    index.reserve(static_cast<std::size_t>(slices) * stacks * 6);
+    for (int j = 0; j < stacks; j++) {
+        const int k((slices + 1) * j);
+
+        for (int i = 0; i < slices; i++) {
+            // 頂点のインデックス
+            const GLuint k0(k + i);
+            const GLuint k1(k0 + 1);
+            const GLuint k2(k1 + slices);
+            const GLuint k3(k2 + 1);
+
+            // 左下の三角形
+            index.emplace_back(k0);
+            index.emplace_back(k1);
+            index.emplace_back(k3);
+
+            // 右上の三角形
+            index.emplace_back(k0);
+            index.emplace_back(k3);
+            index.emplace_back(k2);
+        }
+    }
+}
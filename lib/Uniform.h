@@ -1,84 +1,107 @@
 #pragma once
-#include <memory>
+#include <vector>
+#include <cstring>
 #include <GL/glew.h>
 
+// GL のオブジェクトの登録簿
+#include "Resources.h"
+
 // ユニフォームバッファオブジェクト
 template<typename Type>
 class Uniform {
-    struct UniformBuffer{
-        // ユニフォームバッファオブジェクト名
-        GLuint ubo;
-        
-        // ユニフォームブロックのサイズ
-        GLsizeiptr blocksize;
-
-        // コンストラクタ
-        //  data: uniformプロックに格納するデータ
-        //  count: 確保するuniformブロックの数
-        UniformBuffer(const Type *data, unsigned int count) {
-            // ユニフォームブロックのサイズを求める
-            GLint alignment;
-            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
-            blocksize = (((sizeof (Type) - 1) / alignment) + 1) * alignment;
-
-            // ユニフォームバッファオブジェクトを作成
-            glGenBuffers(1, &ubo);
-            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-            glBufferData(
-                GL_UNIFORM_BUFFER , count * blocksize, NULL, GL_STATIC_DRAW
-            );
-            for (unsigned int i = 0; i < count; i++) {
-                glBufferSubData(
-                    GL_UNIFORM_BUFFER, i * blocksize, sizeof (Type), data + i
-                );
-            }
-        }
+    // ユニフォームバッファのハンドル
+    const Resources::UniformHandle buffer;
 
-        // デストラクタ
-        ~UniformBuffer() {
-            // ユニフォームバッファオブジェクトを削除
-            glDeleteBuffers(1, &ubo);
-        }
-    };
+    // ユニフォームバッファを作って登録する
+    //  data: uniformプロックに格納するデータ
+    //  count: 確保するuniformブロックの数
+    static Resources::UniformHandle create(const Type *data, unsigned int count) {
+        // ユニフォームブロックのサイズを求める
+        GLint alignment;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        const GLsizeiptr blocksize(getBlockSize(alignment));
 
-    // バッファオブジェクト
-    const std::shared_ptr<const UniformBuffer> buffer;
+        // ユニフォームバッファオブジェクトを作成して一度に転送する
+        std::vector<GLubyte> packed;
+        if (data) pack(data, count, blocksize, packed);
+        return Resources::instance().addUniformBuffer(blocksize, count, data ? packed.data() : NULL);
+    }
 
 public:
 
+    // アラインメントに合わせたユニフォームブロックのサイズ
+    //  alignment: GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    static GLsizeiptr getBlockSize(GLint alignment) {
+        return (((sizeof (Type) - 1) / alignment) + 1) * alignment;
+    }
+
+    // ユニフォームブロックの並びに詰める
+    //  data: uniformブロックに格納するデータ
+    //  count: データの数
+    //  blocksize: ユニフォームブロックのサイズ
+    //  packed: 詰めたデータの格納先
+    static void pack(const Type *data, unsigned int count, GLsizeiptr blocksize, std::vector<GLubyte> &packed) {
+        packed.assign(count * blocksize, 0);
+        for (unsigned int i = 0; i < count; i++) {
+            std::memcpy(&packed[i * blocksize], data + i, sizeof (Type));
+        }
+    }
+
     // コンストラクタ
     //  data: uniformブロックに格納するデータ
     //  count: 確保するuniformブロックの数
     Uniform(const Type *data = NULL, unsigned int count = 1)
-        : buffer(new UniformBuffer(data, count))
+        : buffer(create(data, count))
     {}
 
     // デストラクタ
-    virtual ~Uniform()
-    {}
+    virtual ~Uniform() {
+        Resources::instance().removeUniformBuffer(buffer);
+    }
 
     // ユニフォームバッファオブジェクトにデータを格納
     //  data: uniformブロックに格納するデータ
     //  start: データを格納するuniformブロックの先頭位置
     //  count: データを格納するuniformプロックの数
     void set(const Type *data, unsigned int start = 0, unsigned int count = 1) const {
-        glBindBuffer(GL_UNIFORM_BUFFER, buffer->ubo);
-        for (unsigned int i = 0; i < count; i++) {
-            glBufferSubData(
-                GL_UNIFORM_BUFFER, (start + i) * buffer->blocksize,
-                sizeof (Type), data + i
-            );
+        const Resources::UniformBuffer *const b(Resources::instance().getUniformBuffer(buffer));
+        if (b == NULL) return;
+
+        // 一つなら詰めずにそのまま転送する
+        glBindBuffer(GL_UNIFORM_BUFFER, b->ubo);
+        if (count == 1) {
+            glBufferSubData(GL_UNIFORM_BUFFER, start * b->blocksize, sizeof (Type), data);
+            return;
         }
+
+        // 複数ならブロックの並びに詰めて一度に転送する (最後のブロックの余白は書かない)
+        std::vector<GLubyte> packed;
+        pack(data, count, b->blocksize, packed);
+        glBufferSubData(
+            GL_UNIFORM_BUFFER, start * b->blocksize,
+            (count - 1) * b->blocksize + sizeof (Type), packed.data()
+        );
     }
 
     // このユニフォームバッファオブジェクトを使用
     //  bp: 結合ポイント
     //  i : 結合するuniformブロックの位置 
     void select(GLuint bp, unsigned int i = 0) const {
+        const Resources::UniformBuffer *const b(Resources::instance().getUniformBuffer(buffer));
+        if (b == NULL) return;
+
         // 材質に設定するユニフォームバッファオブジェクトを指定
         glBindBufferRange(
-            GL_UNIFORM_BUFFER, bp, buffer->ubo,
-            i * buffer->blocksize, sizeof (Type)
+            GL_UNIFORM_BUFFER, bp, b->ubo,
+            i * b->blocksize, sizeof (Type)
         );
     }
+
+private:
+
+    // コピーコンストラクタによるコピー禁止
+    Uniform(const Uniform &u);
+
+    // 代入によるコピー禁止
+    Uniform &operator=(const Uniform &u);
 };
\ No newline at end of file
@@ -10,7 +10,7 @@ using Vector = std::array<GLfloat, 4>;
 // 行列とベクトルの乗算
 //  m: Matrix型の行列
 //  v: Vector型のベクトル
-Vector operator*(const Matrix &m, const Vector &v) {
+inline Vector operator*(const Matrix &m, const Vector &v) {
     Vector t;
 
     for (int i = 0; i < 4; i++) {
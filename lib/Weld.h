@@ -0,0 +1,213 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+// 図形データ
+#include "Object.h"
+
+// インデックスを使った三角形による描画
+#include "SolidShapeIndex.h"
+
+// 並列処理
+#include "ThreadPool.h"
+
+// 同じ頂点を一つにまとめる溶接処理
+class Weld {
+    // 量子化した頂点属性 (位置と法線)
+    struct Key {
+        std::int32_t q[6];
+
+        bool operator==(const Key &k) const {
+            return std::memcmp(q, k.q, sizeof q) == 0;
+        }
+    };
+
+    // 値を許容誤差の格子に量子化する
+    //  v: 値
+    //  epsilon: 許容誤差 (0 なら値そのものを比較する)
+    static std::int32_t quantize(GLfloat v, GLfloat epsilon) {
+        if (epsilon > 0.0f) {
+            const double q(std::floor(static_cast<double>(v) / epsilon + 0.5));
+            return static_cast<std::int32_t>(std::max(-2147483647.0, std::min(2147483647.0, q)));
+        }
+
+        // -0 を +0 にそろえてビット列を使う
+        const GLfloat z(v + 0.0f);
+        std::int32_t bits;
+        std::memcpy(&bits, &z, sizeof bits);
+        return bits;
+    }
+
+    // 量子化した頂点属性のハッシュ値
+    static std::uint64_t hash(const Key &k) {
+        std::uint64_t h(0x9e3779b97f4a7c15ull);
+        for (int i = 0; i < 6; i++) {
+            h ^= static_cast<std::uint32_t>(k.q[i]);
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 32;
+        }
+        return h;
+    }
+
+public:
+
+    // 溶接の結果
+    struct Mesh {
+        // 重複を取り除いた頂点属性
+        std::vector<Object::Vertex> vertex;
+
+        // 頂点のインデックス
+        std::vector<GLuint> index;
+    };
+
+    // 頂点属性を溶接する
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列
+    //  indexcount: 頂点のインデックスの要素数 (0 なら vertex を三角形の羅列とみなす)
+    //  index: 頂点のインデックスを格納した配列
+    //  positionEpsilon: 位置を同じとみなす格子の間隔
+    //  normalEpsilon: 法線を同じとみなす格子の間隔
+    //
+    // 許容誤差は格子への量子化で扱うので、格子の境界をまたぐ近い頂点は別になることがある
+    static Mesh weld(
+        GLsizei vertexcount, const Object::Vertex *vertex,
+        GLsizei indexcount = 0, const GLuint *index = NULL,
+        GLfloat positionEpsilon = 0.0f, GLfloat normalEpsilon = 0.0f) {
+        Mesh mesh;
+        if (vertexcount <= 0) return mesh;
+
+        ThreadPool &pool(ThreadPool::instance());
+        const std::size_t count(vertexcount);
+        const std::size_t grain(1 << 16);
+
+        // 頂点属性を量子化する
+        std::vector<Key> key(count);
+        pool.parallelFor(count, grain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                for (int k = 0; k < 3; k++) {
+                    key[i].q[k] = quantize(vertex[i].position[k], positionEpsilon);
+                    key[i].q[k + 3] = quantize(vertex[i].normal[k], normalEpsilon);
+                }
+            }
+        });
+
+        // 空きを 0 とし頂点番号 + 1 を格納するオープンアドレス法のハッシュ表
+        std::size_t capacity(16);
+        while (capacity < count * 2) capacity <<= 1;
+        const std::size_t mask(capacity - 1);
+        std::unique_ptr<std::atomic<GLuint>[]> table(new std::atomic<GLuint>[capacity]);
+        pool.parallelFor(capacity, grain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) table[i].store(0, std::memory_order_relaxed);
+        });
+
+        // 同じキーの中で最も小さい頂点番号を表に残す
+        pool.parallelFor(count, grain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                const GLuint mine(static_cast<GLuint>(i + 1));
+                for (std::size_t h = hash(key[i]) & mask;; h = (h + 1) & mask) {
+                    GLuint cur(table[h].load(std::memory_order_acquire));
+                    if (cur == 0) {
+                        if (table[h].compare_exchange_strong(cur, mine)) break;
+                        if (cur == 0) continue;
+                    }
+                    if (key[cur - 1] == key[i]) {
+                        while (mine < cur && !table[h].compare_exchange_weak(cur, mine));
+                        break;
+                    }
+                }
+            }
+        });
+
+        // 各頂点の代表の頂点番号を求める
+        std::vector<GLuint> representative(count);
+        pool.parallelFor(count, grain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                for (std::size_t h = hash(key[i]) & mask;; h = (h + 1) & mask) {
+                    const GLuint cur(table[h].load(std::memory_order_relaxed));
+                    if (key[cur - 1] == key[i]) {
+                        representative[i] = cur - 1;
+                        break;
+                    }
+                }
+            }
+        });
+        table.reset();
+        std::vector<Key>().swap(key);
+
+        // ブロックごとに代表の数を数えて新しい頂点番号の先頭を決める
+        const std::size_t blocks((count + grain - 1) / grain);
+        std::vector<std::size_t> offset(blocks + 1, 0);
+        pool.parallelFor(count, grain, [&](std::size_t begin, std::size_t end) {
+            std::size_t n(0);
+            for (std::size_t i = begin; i < end; i++) n += representative[i] == i;
+            offset[begin / grain + 1] = n;
+        });
+        for (std::size_t b = 0; b < blocks; b++) offset[b + 1] += offset[b];
+
+        // 代表の頂点を詰めて格納し、古い頂点番号から新しい頂点番号への対応を作る
+        mesh.vertex.resize(offset[blocks]);
+        std::vector<GLuint> remap(count);
+        pool.parallelFor(count, grain, [&](std::size_t begin, std::size_t end) {
+            std::size_t n(offset[begin / grain]);
+            for (std::size_t i = begin; i < end; i++) {
+                if (representative[i] == i) {
+                    mesh.vertex[n] = vertex[i];
+                    remap[i] = static_cast<GLuint>(n++);
+                }
+            }
+        });
+        pool.parallelFor(count, grain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) remap[i] = remap[representative[i]];
+        });
+
+        // インデックスを付け替える
+        if (indexcount > 0 && index != NULL) {
+            mesh.index.resize(indexcount);
+            pool.parallelFor(indexcount, grain, [&](std::size_t begin, std::size_t end) {
+                for (std::size_t i = begin; i < end; i++) mesh.index[i] = remap[index[i]];
+            });
+        } else {
+            mesh.index.swap(remap);
+        }
+
+        return mesh;
+    }
+
+    // 三角形の羅列を溶接してインデックスを使った三角形の図形を作る
+    //  size: 頂点の位置の次元
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列
+    //  positionEpsilon: 位置を同じとみなす格子の間隔
+    //  normalEpsilon: 法線を同じとみなす格子の間隔
+    static std::unique_ptr<SolidShapeIndex> solidShape(
+        GLint size, GLsizei vertexcount, const Object::Vertex *vertex,
+        GLfloat positionEpsilon = 0.0f, GLfloat normalEpsilon = 0.0f) {
+        return solidShapeIndex(size, vertexcount, vertex, 0, NULL,
+            positionEpsilon, normalEpsilon);
+    }
+
+    // インデックスを使った三角形の図形の頂点を溶接して作り直す
+    //  size: 頂点の位置の次元
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列
+    //  indexcount: 頂点のインデックスの要素数
+    //  index: 頂点のインデックスを格納した配列
+    //  positionEpsilon: 位置を同じとみなす格子の間隔
+    //  normalEpsilon: 法線を同じとみなす格子の間隔
+    static std::unique_ptr<SolidShapeIndex> solidShapeIndex(
+        GLint size, GLsizei vertexcount, const Object::Vertex *vertex,
+        GLsizei indexcount, const GLuint *index,
+        GLfloat positionEpsilon = 0.0f, GLfloat normalEpsilon = 0.0f) {
+        const Mesh mesh(weld(vertexcount, vertex, indexcount, index,
+            positionEpsilon, normalEpsilon));
+
+        return std::unique_ptr<SolidShapeIndex>(new SolidShapeIndex(size,
+            static_cast<GLsizei>(mesh.vertex.size()), mesh.vertex.data(),
+            static_cast<GLsizei>(mesh.index.size()), mesh.index.data()));
+    }
+};
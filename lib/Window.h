@@ -12,6 +12,9 @@ class Window {
     // ウィンドウのサイズ
     GLfloat size[2];
 
+    // フレームバッファのサイズ
+    GLint fbSize[2];
+
     // ワールド座標系に対するデバイス座標系の拡大率
     GLfloat scale;
 
@@ -23,12 +26,16 @@ class Window {
 
     int keyStatus;
 
+    // 最後に入力のあった時刻
+    double inputTime;
+
 public:
 
     // コンストラクタ
     Window(int width = 640, int height = 640, const char *title = "Hello! GLFW")
         : window(glfwCreateWindow(width, height, title, NULL, NULL))
-        , scale(100.0f), modelLoc{ 0.0f, 0.0f }, keyStatus(GLFW_RELEASE)
+        , scale(100.0f), modelLoc{ 0.0f, 0.0f }, mouseLoc{ 0.0f, 0.0f }
+        , keyStatus(GLFW_RELEASE), inputTime(0.0)
     {
         if (window == NULL) {
             // 失敗
@@ -72,6 +79,7 @@ public:
     }
 
     // 描画ループの継続判定
+    //  イベントの取り出し, 入力の読み取り, 終了判定をまとめて行う
     explicit operator bool() {
 
         // イベントを取り出す
@@ -79,7 +87,38 @@ public:
             glfwWaitEvents(); 
         else 
             glfwPollEvents(); 
-        
+
+        // マウスとキーボードの状態を読み取る
+        readInput();
+
+        // ウィンドウを閉じる必要がなければtrueを返す
+        return !shouldClose();
+    }
+
+    // イベントを取り出す
+    //  timeout: イベントを待つ最長の時間 (秒, 負ならイベントが来るまで眠る)
+    void waitEvents(double timeout) const {
+        if (timeout < 0.0)
+            glfwWaitEvents();
+        else if (timeout > 0.0)
+            glfwWaitEventsTimeout(timeout);
+        else
+            glfwPollEvents();
+    }
+
+    // イベントを待っているスレッドを起こす (どのスレッドから呼んでも良い)
+    static void wakeUp() {
+        glfwPostEmptyEvent();
+    }
+
+    // キーが押されたままなら true (イベントが来なくても入力を読み続ける必要がある)
+    bool isActive() const {
+        return keyStatus != GLFW_RELEASE;
+    }
+
+    // マウスとキーボードの状態を読み取る
+    void readInput() {
+
         // マウスの左ボタンの状態を調べる 
         if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_1) != GLFW_RELEASE) { 
             // マウスの左ボタンが押されていたらマウスカーソルの位置を取得する 
@@ -87,8 +126,11 @@ public:
             glfwGetCursorPos(window, &x, &y); 
         
             // マウスカーソルの正規化デバイス座標系上での位置を求める 
-            mouseLoc[0] = static_cast<GLfloat>(x) * 2.0f / size[0] - 1.0f; 
-            mouseLoc[1] = -(1.0f - static_cast<GLfloat>(y) * 2.0f / size[1]);
+            const GLfloat mx(static_cast<GLfloat>(x) * 2.0f / size[0] - 1.0f);
+            const GLfloat my(-(1.0f - static_cast<GLfloat>(y) * 2.0f / size[1]));
+            if (mx != mouseLoc[0] || my != mouseLoc[1]) inputTime = glfwGetTime();
+            mouseLoc[0] = mx;
+            mouseLoc[1] = my;
         }
 
         // キーボードの入力状態を調べる
@@ -100,11 +142,26 @@ public:
             modelLoc[1] -= 2.0f  / size[1];
         } else if (glfwGetKey(window, GLFW_KEY_UP) != GLFW_RELEASE) {
             modelLoc[1] += 2.0f  / size[1];
+        } else {
+            return;
         }
+        inputTime = glfwGetTime();
+    }
 
-        // ウィンドウを閉じる必要がなければtrueを返す
-        return !glfwWindowShouldClose(window) &&
-            !glfwGetKey(window, GLFW_KEY_ESCAPE);
+    // ウィンドウを閉じる必要があれば true
+    bool shouldClose() const {
+        return glfwWindowShouldClose(window) ||
+            glfwGetKey(window, GLFW_KEY_ESCAPE);
+    }
+
+    // OpenGL のコンテキストをこのスレッドで使う
+    void attachContext() const {
+        glfwMakeContextCurrent(window);
+    }
+
+    // OpenGL のコンテキストをこのスレッドから切り離す
+    void detachContext() const {
+        glfwMakeContextCurrent(NULL);
     }
 
     // ダブルバッファリング
@@ -119,9 +176,6 @@ public:
         int fbWidth, fbHeight;
         glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
 
-        // フレームバッファ全体をビューポートに設定
-        glViewport(0, 0, fbWidth, fbHeight);
-
         // このインスタンスのthisポインタを取得
         Window *const instance(static_cast<Window *>(glfwGetWindowUserPointer(window)));
 
@@ -129,6 +183,10 @@ public:
             // 開いたウィンドウのサイズを保持
             instance->size[0] = static_cast<GLfloat>(width);
             instance->size[1] = static_cast<GLfloat>(height);
+
+            // フレームバッファのサイズを保持 (ビューポートはコンテキストを持つスレッドで設定する)
+            instance->fbSize[0] = fbWidth;
+            instance->fbSize[1] = fbHeight;
         }
     }
     
@@ -140,6 +198,7 @@ public:
         if (instance != NULL) {
             // ワールド座標系に対するデバイス座標系の拡大率を更新
             instance->scale += static_cast<GLfloat>(y);
+            instance->inputTime = glfwGetTime();
         }
     }
 
@@ -151,12 +210,16 @@ public:
         if (instance != NULL) {
             // キー状態を保持
             instance->keyStatus = action;
+            instance->inputTime = glfwGetTime();
         }
     }
 
     // ウィンドウサイズを取り出す
     const GLfloat *getSize() const { return size; }
 
+    // フレームバッファのサイズを取り出す
+    const GLint *getFramebufferSize() const { return fbSize; }
+
     // ワールド座標系に対するデバイス座標系の拡大率を取り出す
     GLfloat getScale() const { return scale; }
 
@@ -165,4 +228,7 @@ public:
 
     // マウス位置を取り出す
     const GLfloat *getMouseLoc() const { return mouseLoc; }
+
+    // 最後に入力のあった時刻を取り出す
+    double getInputTime() const { return inputTime; }
 };
\ No newline at end of file
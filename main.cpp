@@ -1,374 +1,360 @@
 #include <windows.h>
+// シェーダのソースファイルはワーカースレッドで読むので読み込みの経過は表示しない
+#define SHADER_QUIET
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include <memory>
 #include <cmath>
 #include <random>
+#include <iterator>
+#include <cstdlib>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
 #include <GL/glew.h>
 #include <GL/glfw3.h>
 #include "lib/Matrix"
 
 using GLchar = char;
 using namespace std;
-// シェーダオブジェクトのコンパイル結果を表示する
-//  shader: シェーダオブジェクト名
-//  str: コンパイルエラーが発生した場所を表す文字列
-GLboolean printShaderInfoLog(GLuint shader, const char *str)
-{
-    // コンパイル結果を取得
-    GLint status;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-    printf("shader status: %s\n", status == GL_TRUE ? "Success" : "Failed");
-    if (status == GL_FALSE)
-    {
-        printf("Error : Compile Error in %s\n", str);
-    }
-
-    // シェーダのコンパイル時のログの長さを取得
-    GLsizei bufSize;
-    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &bufSize);
-
-    if (bufSize > 1)
-    {
-        // シェーダのコンパイル時のログ内容を取得
-        std::vector<GLchar> infoLog(bufSize);
-        GLsizei length;
-        glGetShaderInfoLog(shader, bufSize, &length, &infoLog[0]);
-        printf("printShader: %s", &infoLog[0]);
-    }
 
-    return static_cast<GLboolean>(status);
-}
+// 面ごとに法線を変えた六面体
+constexpr auto solidCube(Primitive::cube());
 
-// プログラムオブジェクトのリンク結果を表示する
-//  program: プログラムオブジェクト名
-GLboolean printProgramInfoLog(GLuint program)
-{
-    // リンク結果を取得
-    GLint status;
-    glGetProgramiv(program, GL_LINK_STATUS, &status);
-    printf("shader status: %s\n", status == GL_TRUE ? "Success" : "Failed");
-    if (status == GL_FALSE)
-    {
-        printf("Error : Link Error.\n");
-    }
+// 球と遮蔽カリングに使う粗い球 (継ぎ目と極で重なる頂点は起動時に溶接する)
+constexpr auto sphereShape(Primitive::sphere<32, 16>());
+constexpr auto occluderShape(Primitive::sphere<8, 4>());
 
-    // シェーダのリンク時のログの長さの取得
-    GLsizei bufSize;
-    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &bufSize);
+// シミュレーションの状態
+struct SceneState {
+    // マウスとキーボードで動かす位置
+    GLfloat mouseLoc[2];
+    GLfloat modelLoc[2];
 
-    if (bufSize > 1)
-    {
-        // シェーダのリンク時のログの内容の取得
-        std::vector<GLchar> infoLog(bufSize);
-        GLsizei length;
-        glGetProgramInfoLog(program, bufSize, &length, &infoLog[0]);
-        printf("printProgram: %s", &infoLog[0]);
-    }
+    // ワールド座標系に対するデバイス座標系の拡大率
+    GLfloat scale;
+};
 
-    return static_cast<GLboolean>(status);
+// 描画に影響する状態が同じなら true
+static bool same(const SceneState &a, const SceneState &b)
+{
+    return a.mouseLoc[0] == b.mouseLoc[0] && a.mouseLoc[1] == b.mouseLoc[1]
+        && a.modelLoc[0] == b.modelLoc[0] && a.modelLoc[1] == b.modelLoc[1]
+        && a.scale == b.scale;
 }
 
-// プログラムオブジェクトの作成
-//  vsrc: バーテックスシェーダのソースプログラムの文字列
-//  fsrc: フラグメントシェーダのソースプログラムの文字列
-GLuint createProgram(const char *vsrc, const char *fsrc)
-{
-    // 空のプログラムオブジェクトの作成
-    const GLuint program(glCreateProgram());
+// シミュレーションスレッドから描画スレッドに渡すスナップショット
+struct SceneSnapshot {
+    // 一つ前と最新のステップの状態
+    SceneState previous, current;
 
-    if (vsrc != NULL)
-    {
-        // バーテックスシェーダのシェーダオブジェクトの作成
-        const GLuint vobj(glCreateShader(GL_VERTEX_SHADER));
-        glShaderSource(vobj, 1, &vsrc, NULL);
-        glCompileShader(vobj);
-
-        // バーテックスシェーダのコンパイル結果を確認
-        if (printShaderInfoLog(vobj, "Vertex Shader"))
-        {
-            glAttachShader(program, vobj);
-            printf("Attached vertex shader\n");
-        }
-        else
-        {
-            printf("Vertex shader compilation failed\n");
-        }
-        glDeleteShader(vobj);
-    }
-    else
-    {
-        printf("vsrc is null\n");
-    }
+    // 最新のステップの時刻と時間刻み (秒)
+    double time, step;
 
-    if (fsrc != NULL)
-    {
-        // フラグメントシェーダのシェーダオブジェクトの作成
-        const GLuint fobj(glCreateShader(GL_FRAGMENT_SHADER));
-        glShaderSource(fobj, 1, &fsrc, NULL);
-        glCompileShader(fobj);
-
-        // フラグメントシェーダのコンパイル結果を確認
-        if (printShaderInfoLog(fobj, "Fragment Shader"))
-        {
-            glAttachShader(program, fobj);
-            printf("Attached fragment shader\n");
-        }
-        else
-        {
-            printf("Fragment shader compilation failed\n");
-        }
-        glDeleteShader(fobj);
-    }
-    else
-    {
-        printf("fsrc is null\n");
-    }
+    // スナップショットに含まれる最後の入力の時刻
+    double inputTime;
 
-    // プログラムオブジェクトをリンクする
-    glBindAttribLocation(program, 0, "position");
-    glBindAttribLocation(program, 1, "normal");
-    glBindFragDataLocation(program, 0, "fragment");
-    glLinkProgram(program);
+    // ウィンドウとフレームバッファのサイズ
+    GLfloat size[2];
+    GLint fbSize[2];
 
-    // 作成したプログラムオブジェクトを返す
-    if (printProgramInfoLog(program))
-    {
-        return program;
-    }
+    // これまでに進めたステップ数
+    unsigned steps;
 
-    // 失敗したら 0 を返す
-    glDeleteProgram(program);
-    return 0;
-}
+    // 描画に影響する変化があるたびに増える番号
+    unsigned revision;
+};
 
-// シェーダのソースファイルを読み込んだメモリを返す
-//  name: シェーダのソースファイル名
-//  buffer: 読み込んだソースファイルのテキスト
-vector<GLchar> readShaderSource(const char *name, std::vector<GLchar> &buffer)
-{
-    vector<GLchar> nullVec;
+// シミュレーションスレッドと描画スレッドの間の合図
+struct FrameSignal {
+    // 描画スレッドを起こすための排他制御と条件変数
+    std::mutex mutex;
+    std::condition_variable condition;
 
-    // ファイル名がNULL
-    if (name == NULL)
-        return nullVec;
+    // 公開したスナップショットの revision
+    unsigned revision;
 
-    printf("Trying to open source file: %s\n", name); // デバッグメッセージを追加
+    // 描画スレッドが時間で変わるもの (粒子) を描いていてステップを進める必要があれば true
+    std::atomic<bool> animating;
+};
 
-    // ソースファイルを開く
-    std::ifstream file(name, std::ios::binary);
+// 固定の時間刻みで状態を一ステップ進める
+static void simulate(SceneState &state, const Window &window)
+{
+    // 入力を状態に写す
+    std::copy(window.getMouseLoc(), window.getMouseLoc() + 2, state.mouseLoc);
+    std::copy(window.getModelLoc(), window.getModelLoc() + 2, state.modelLoc);
+    state.scale = window.getScale();
+}
 
-    if (!file.is_open())
-    {
-        printf("Error : Can't open source file: %s\n", name);
-        return nullVec;
+// 描画する時刻の状態を前後のステップから補間する
+//  描画は一ステップ遅れて previous から current に向かって進む
+static SceneState interpolate(const SceneSnapshot &snapshot, double now)
+{
+    const SceneState &a(snapshot.previous), &b(snapshot.current);
+    const GLfloat t(static_cast<GLfloat>(std::min(std::max((now - snapshot.time) / snapshot.step, 0.0), 1.0)));
+    const auto lerp([t](GLfloat x, GLfloat y) { return x + (y - x) * t; });
+
+    SceneState state(b);
+    for (int i = 0; i < 2; ++i) {
+        state.mouseLoc[i] = lerp(a.mouseLoc[i], b.mouseLoc[i]);
+        state.modelLoc[i] = lerp(a.modelLoc[i], b.modelLoc[i]);
     }
+    state.scale = lerp(a.scale, b.scale);
+    return state;
+}
 
-    // ファイルの末尾に移動し現在位置(=ファイルサイズ)を得る
-    file.seekg(0L, std::ios::end);
-    long long int length = file.tellg();
-    file.seekg(0L, std::ios::beg);
+// 波打たせる格子の一辺の頂点数
+static const int gridSize(1024);
 
-    printf("File length: %lld\n", length); // ファイルサイズを出力
+// スキニングする円筒の関節の数とキーフレームの数
+static const int tubeJoints(32), tubeKeys(17);
 
-    if (length <= 0)
-    {
-        printf("Error: File is empty or could not determine length.\n");
-        return nullVec;
-    }
+// 描画ループの統計
+//  環境変数 GLFWDRAFT_STATS があれば毎フレームの値を貯めて一秒ごとに平均と最大を表示する
+struct FrameStats {
+    // 表示するなら true
+    const bool enabled;
 
-    // データをchar型に (リサイズ)
-    std::vector<GLchar> data(length + 1); // std::vectorを使用してメモリ管理を簡素化
+    // 集計を始めた時刻と描画したフレームの数
+    double begin;
+    unsigned frames;
 
-    // ファイル読み込み
-    file.read(data.data(), length);
+    // フレームの間隔の合計と最大 (秒)
+    double frame, frameMax;
 
-    if (file.fail())
-    { // 読み込み失敗をチェック
-        printf("Error : Could not read source file.\n");
-        return nullVec;
-    }
+    // 入力から表示までの時間の合計と最大 (秒) と入力の数
+    double latency, latencyMax;
+    unsigned inputs;
 
-    // NULL終端を追加
-    data[length] = '\0';
+    // 遮蔽カリングで判定した数と隠れていた数, 判定にかかった時間の合計 (ミリ秒)
+    std::size_t tested, culled;
+    double occlusion;
 
-    printf("Done : File read.\n");
+    // メッシュレットの判定で捨てた三角形の数と判定した三角形の数
+    std::size_t rejected, triangles;
 
-    return data;
-}
+    // 格子の変形と転送, 円筒のスキニングと転送, 粒子の更新にかかった時間の合計 (秒) と格子の転送量 (バイト)
+    double deform, deformUpload, skin, skinUpload, particle, uploadBytes;
 
-// シェーダのソースファイルを読み込んでプロクラムオブジェクトを作成する
-//  vert: バーテックスシェーダのソースファイル名
-//  frag: フラグメントシェーダのソースファイル名
-GLuint loadProgram(const char *vert, const char *frag)
-{
+    // 格子を書き換えた回数と円筒をスキニングした回数
+    unsigned deforms, skins;
 
-    // シェーダのソースファイルを読み込む
-    std::vector<GLchar> vsrc = readShaderSource(vert, vsrc);
-    std::vector<GLchar> fsrc = readShaderSource(frag, fsrc);
+    // 選択できたフレームの数と最後に選択した図形
+    unsigned picks;
+    SceneBvh::Hit hit;
 
-    // 読み込んだ内容を出力
-    printf("Vertex File content: %s\n", vsrc.data());
-    printf("Fragment File content: %s\n", fsrc.data());
+    // コンストラクタ
+    //  now: 現在時刻
+    explicit FrameStats(double now) : enabled(getenv("GLFWDRAFT_STATS") != NULL) { reset(now); }
 
-    // プログラムオブジェクトを作成
-    printf("create program obj\n");
-    return vsrc.data() != nullptr && fsrc.data() != nullptr ? createProgram(vsrc.data(), fsrc.data()) : 0;
-}
+    // 集計をやり直す
+    //  now: 現在時刻
+    void reset(double now) {
+        begin = now;
+        frames = inputs = picks = deforms = skins = 0;
+        frame = frameMax = latency = latencyMax = occlusion = 0.0;
+        tested = culled = rejected = triangles = 0;
+        deform = deformUpload = skin = skinUpload = particle = uploadBytes = 0.0;
+    }
 
-// 矩形の頂点の位置
-constexpr Object::Vertex rectangleVertex1[] = {
-    {-1, -1, 0},
-    {1, -1, 0},
-    {1, 1, 0},
-    {-1, 1, 0}
-};
-constexpr Object::Vertex rectangleVertex2[] = {
-    {-0.5f, -0.5f, 0},
-    {0.5, -0.5f, 0},
-    {0.5f, 0.5f, 0},
-    {-0.5f, 0.5f, 0}
-};
-constexpr Object::Vertex dot[] = {
-    {-0.01f, -0.01f, 0},
-    {0.01f, -0.01f, 0},
-    {0.01f, 0.01f, 0},
-    {-0.01f, 0.01f, 0}
-};
-// 八面体の頂点の位置 
-constexpr Object::Vertex octahedronVertex[] = { 
-  {  0.0f,  1.0f,  0.0f }, 
-  { -1.0f,  0.0f,  0.0f }, 
-  {  0.0f, -1.0f,  0.0f }, 
-  {  1.0f,  0.0f,  0.0f }, 
-  {  0.0f,  1.0f,  0.0f }, 
-  {  0.0f,  0.0f,  1.0f }, 
-  {  0.0f, -1.0f,  0.0f }, 
-  {  0.0f,  0.0f, -1.0f }, 
-  { -1.0f,  0.0f,  0.0f }, 
-  {  0.0f,  0.0f,  1.0f }, 
-  {  1.0f,  0.0f,  0.0f }, 
-  {  0.0f,  0.0f, -1.0f } 
-};
-// 六面体の頂点の位置と色 
-constexpr Object::Vertex cubeVertex[] = 
-{ 
-  { -1.0f, -1.0f, -1.0f,  0.0f,  0.0f,  0.0f },  // (0) 
-  { -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  0.8f },  // (1) 
-  { -1.0f,  1.0f,  1.0f,  0.0f,  0.8f,  0.0f },  // (2) 
-  { -1.0f,  1.0f, -1.0f,  0.0f,  0.8f,  0.8f },  // (3) 
-  {  1.0f,  1.0f, -1.0f,  0.8f,  0.0f,  0.0f },  // (4) 
-  {  1.0f, -1.0f, -1.0f,  0.8f,  0.0f,  0.8f },  // (5) 
-  {  1.0f, -1.0f,  1.0f,  0.8f,  0.8f,  0.0f },  // (6) 
-  {  1.0f,  1.0f,  1.0f,  0.8f,  0.8f,  0.8f }   // (7) 
-};
-// 六面体の稜線の両端点のインデックス 
-constexpr GLuint wireCubeIndex[] = { 
-  1, 0, // (a) 
-  2, 7, // (b) 
-  3, 0, // (c) 
-  4, 7, // (d) 
-  5, 0, // (e) 
-  6, 7, // (f) 
-  1, 2, // (g) 
-  2, 3, // (h) 
-  3, 4, // (i) 
-  4, 5, // (j) 
-  5, 6, // (k) 
-  6, 1  // (l) 
-};
-// 面ごとに法線を変えた六面体の頂点属性 
-constexpr Object::Vertex solidCubeVertex[] = 
-{ 
-  // 左 
-  { -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f }, 
-  { -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f }, 
-  { -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f }, 
-  { -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f }, 
-  { -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f }, 
-  { -1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f }, 
- 
-  // 裏 
-  {  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f }, 
-  { -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f }, 
-  { -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f }, 
-  {  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f }, 
-  { -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f }, 
-  {  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f }, 
- 
-  // 下 
-  { -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f }, 
-  {  1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f }, 
-  {  1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f }, 
-  { -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f }, 
-  {  1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f }, 
-  { -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f }, 
- 
-  // 右 
-  {  1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f }, 
-  {  1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f }, 
-  {  1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f }, 
-  {  1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f }, 
-  {  1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f }, 
-  {  1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f }, 
- 
-  // 上 
-  { -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f }, 
-  { -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f }, 
-  {  1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f }, 
-  { -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f }, 
-  {  1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f }, 
-  {  1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f }, 
- 
-  // 前 
-  { -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f }, 
-  {  1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f }, 
-  {  1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f }, 
-  { -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f }, 
-  {  1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f }, 
-  { -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f } 
+    // 一秒経っていれば集計を表示してやり直す
+    //  now: 現在時刻
+    //  mouse: マウスの位置
+    //  particles: 粒子の数
+    //  steps: シミュレーションのステップ数
+    void report(double now, const GLfloat *mouse, std::size_t particles, unsigned steps) {
+        if (!enabled || frames == 0 || now - begin < 1.0) return;
+        const double n(frames);
+        printf("stats: %u frames in %.3f s, frame %.3f ms (max %.3f), simulation steps %u, mouse %.2f, %.2f\n",
+            frames, now - begin, frame * 1000.0 / n, frameMax * 1000.0, steps, mouse[0], mouse[1]);
+        if (inputs > 0) printf("stats: input latency %.3f ms (max %.3f)\n", latency * 1000.0 / inputs, latencyMax * 1000.0);
+        printf("stats: occlusion culled %.1f%%, %.3f ms; meshlets rejected %.1f%% of triangles\n",
+            tested ? 100.0 * culled / tested : 0.0, occlusion / n, triangles ? 100.0 * rejected / triangles : 0.0);
+        if (picks > 0) printf("stats: pick in %u frames, last instance %u, triangle %u, distance %.3f\n",
+            picks, hit.instance, hit.triangle, hit.distance);
+        if (deforms > 0) printf("stats: dynamic deform %u times, %.3f ms, upload %.3f ms (%.1f MB)\n",
+            deforms, deform * 1000.0 / deforms, deformUpload * 1000.0 / deforms, uploadBytes / deforms / 1048576.0);
+        if (skins > 0) printf("stats: skinning %u times, %.3f ms, upload %.3f ms\n",
+            skins, skin * 1000.0 / skins, skinUpload * 1000.0 / skins);
+        printf("stats: particles %zu, %.3f ms\n", particles, particle * 1000.0 / n);
+        reset(now);
+    }
 };
 
-// 六面体の面を塗りつぶす三角形の頂点のインデックス 
-constexpr GLuint solidCubeIndex[] = {
-     0,  1,  2,  3,  4,  5, // 左 
-     6,  7,  8,  9, 10, 11, // 裏 
-    12, 13, 14, 15, 16, 17, // 下 
-    18, 19, 20, 21, 22, 23, // 右 
-    24, 25, 26, 27, 28, 29, // 上 
-    30, 31, 32, 33, 34, 35  // 前
+// 起動時にワーカースレッドで用意する GL を使わないデータ
+//  描画スレッドは使う前に対応する段階を Startup::wait で待つ
+struct StartupAssets {
+    // 使う機能の組み合わせ
+    ShaderVariant clustered, instanced;
+
+    // ソースファイルを読み込んで前処理まで済ませたシェーダ (コンパイルは描画スレッドに移して行う)
+    std::unique_ptr<ProgramCache> shaders;
+
+    // 継ぎ目と極で重なる頂点を溶接した球とそのメッシュレット
+    Weld::Mesh sphere;
+    std::unique_ptr<Meshlets> sphereMeshlets;
+
+    // マウスによる選択に使う三角形の境界ボリューム階層
+    std::unique_ptr<MeshBvh> sphereBvh, cubeBvh;
+
+    // 粒子
+    std::unique_ptr<Particles> particles;
+
+    // 波打たせる格子 (grid が true のとき)
+    bool grid;
+    DynamicObject::Mode gridMode;
+    std::vector<Object::Vertex> gridVertex;
+    std::vector<GLuint> gridIndex;
+
+    // スキニングする円筒 (tube が true のとき)
+    bool tube;
+    std::unique_ptr<Skeleton> tubeSkeleton;
+    std::unique_ptr<Animation> tubeAnimation;
+    std::vector<Skeleton::Vertex> tubeVertex;
+    std::vector<Object::Vertex> tubeRest;
+    std::vector<GLuint> tubeIndex;
+
+    // それぞれを用意する段階
+    Startup::Stage shaderStage, sphereStage, meshletStage, bvhStage, particleStage, gridStage, tubeStage;
 };
 
-int main()
+// 起動時にワーカースレッドで行う段階を登録する
+//  startup: 起動処理の依存関係のグラフ
+//  assets: 用意するデータの格納先
+static void prepare(Startup &startup, StartupAssets &assets)
 {
+    // シェーダのソースファイルの読み込みと前処理
+    //  クラスタ化した光源と材質の表を使う組み合わせを起動時にコンパイルしておく
+    assets.clustered.set("CLUSTERED").set("MATERIAL_TABLE").set("MULTI_DRAW");
+    assets.instanced.set("CLUSTERED").set("MATERIAL_TABLE").set("INSTANCING");
+    assets.grid = getenv("GLFWDRAFT_DYNAMIC") != NULL;
+    assets.gridMode = assets.grid && std::string(getenv("GLFWDRAFT_DYNAMIC")) == "orphan" ? DynamicObject::Orphan : DynamicObject::Persistent;
+    assets.tube = getenv("GLFWDRAFT_SKINNING") != NULL;
+    assets.shaders.reset(new ProgramCache("../"));
+    assets.shaderStage = startup.add("shaders.preprocess", [&assets] {
+        std::vector<ProgramCache::Request> request = {
+            { "point.vert", "point.frag", assets.clustered },
+            { "particle.vert", "particle.frag", ShaderVariant() }
+        };
+        if (assets.grid || assets.tube) request.push_back({ "point.vert", "point.frag", assets.instanced });
+        assets.shaders->preload(request);
+    });
+
+    // コンパイル時に作った球の継ぎ目と極で重なる頂点を溶接する
+    assets.sphereStage = startup.add("sphere.weld", [&assets] {
+        assets.sphere = Weld::weld(
+            static_cast<GLsizei>(sphereShape.vertex.size()), sphereShape.vertex.data(),
+            static_cast<GLsizei>(sphereShape.index.size()), sphereShape.index.data(),
+            1.0e-5f, 1.0e-5f);
+    });
+
+    // 球をメッシュレットに分けるのと境界ボリューム階層を作るのは溶接の後で並行に行う
+    assets.meshletStage = startup.add("sphere.meshlets", [&assets] {
+        assets.sphereMeshlets.reset(new Meshlets(
+            static_cast<GLsizei>(assets.sphere.vertex.size()), assets.sphere.vertex.data(),
+            static_cast<GLsizei>(assets.sphere.index.size()), assets.sphere.index.data()));
+    }, { assets.sphereStage });
+    assets.bvhStage = startup.add("sphere.bvh", [&assets] {
+        assets.sphereBvh.reset(new MeshBvh(
+            static_cast<GLsizei>(assets.sphere.vertex.size()), assets.sphere.vertex.data(),
+            static_cast<GLsizei>(assets.sphere.index.size()), assets.sphere.index.data()));
+        assets.cubeBvh.reset(new MeshBvh(static_cast<GLsizei>(solidCube.vertex.size()), solidCube.vertex.data(),
+            static_cast<GLsizei>(solidCube.index.size()), solidCube.index.data()));
+    }, { assets.sphereStage });
+
+    // 粒子 (環境変数 GLFWDRAFT_PARTICLES で数を変えられる)
+    assets.particleStage = startup.add("particles.allocate", [&assets] {
+        const char *const particleEnv(getenv("GLFWDRAFT_PARTICLES"));
+        assets.particles.reset(new Particles(particleEnv ? std::strtoul(particleEnv, NULL, 10) : 1u << 20));
+    });
+
+    // 環境変数 GLFWDRAFT_DYNAMIC が persistent か orphan なら毎フレーム波打たせる 1024x1024 頂点の格子を描く
+    assets.gridStage = startup.add("grid.mesh", [&assets] {
+        if (!assets.grid) return;
+        std::vector<Object::Vertex> &vertex(assets.gridVertex);
+        vertex.resize(gridSize * gridSize);
+        for (int j = 0; j < gridSize; ++j) {
+            for (int i = 0; i < gridSize; ++i) {
+                const Object::Vertex v = {
+                    { static_cast<GLfloat>(i) * 4.0f / (gridSize - 1) - 2.0f, 0.0f, static_cast<GLfloat>(j) * 4.0f / (gridSize - 1) - 2.0f },
+                    { 0.0f, 1.0f, 0.0f }
+                };
+                vertex[j * gridSize + i] = v;
+            }
+        }
+        std::vector<GLuint> &index(assets.gridIndex);
+        index.reserve((gridSize - 1) * (gridSize - 1) * 6);
+        for (int j = 0; j < gridSize - 1; ++j) {
+            for (int i = 0; i < gridSize - 1; ++i) {
+                const GLuint k(j * gridSize + i);
+                index.insert(index.end(), { k, k + gridSize, k + 1, k + 1, k + gridSize, k + gridSize + 1 });
+            }
+        }
+    });
+
+    // 環境変数 GLFWDRAFT_SKINNING が設定されていれば関節の鎖で曲げる円筒を CPU でスキニングして描く
+    assets.tubeStage = startup.add("tube.mesh", [&assets] {
+        if (!assets.tube) return;
+
+        // 関節を円筒の軸に沿って並べ, 時間とともに根元から順に遅れて揺れる動きを作る
+        const GLfloat height(2.0f), link(height / tubeJoints);
+        assets.tubeSkeleton.reset(new Skeleton);
+        assets.tubeAnimation.reset(new Animation(tubeJoints, tubeKeys, 4.0f));
+        for (int j = 0; j < tubeJoints; ++j) assets.tubeSkeleton->addJoint(j - 1, Matrix::translate(0.0f, link * j, 0.0f));
+        for (int k = 0; k < tubeKeys; ++k) {
+            for (int j = 0; j < tubeJoints; ++j) {
+                const GLfloat a(6.283185f * (static_cast<GLfloat>(k) / (tubeKeys - 1) - static_cast<GLfloat>(j) / tubeJoints));
+                const Quaternion r(Quaternion::rotateAxis(0.08f * std::sin(a), 0.0f, 0.0f, 1.0f)
+                    * Quaternion::rotateAxis(0.05f * std::cos(a), 1.0f, 0.0f, 0.0f));
+                assets.tubeAnimation->setKey(k, j, r, 0.0f, j > 0 ? link : 0.0f, 0.0f);
+            }
+        }
 
-    char cdir[255];
-    GetCurrentDirectory(255, cdir);
-    printf("current_path: %s\n", cdir);
+        createTube(256, 1024, tubeJoints, 0.1f, height, assets.tubeVertex, assets.tubeIndex);
+        assets.tubeRest.resize(assets.tubeVertex.size());
+        for (std::size_t i = 0; i < assets.tubeRest.size(); ++i) {
+            std::copy(assets.tubeVertex[i].position, assets.tubeVertex[i].position + 3, assets.tubeRest[i].position);
+            std::copy(assets.tubeVertex[i].normal, assets.tubeVertex[i].normal + 3, assets.tubeRest[i].normal);
+        }
+    });
+}
 
-    // GLFWの初期化
-    if (glfwInit() != GLFW_TRUE)
+// OpenGL のコンテキストを持つ描画スレッドの処理
+//  window: 描画するウィンドウ (このスレッドではコンテキストとバッファの入れ替えにだけ使う)
+//  snapshots: シミュレーションスレッドから受け取るスナップショット
+//  running: どちらかのスレッドが終わると false になる
+//  signal: 変化のあったスナップショットの公開を待つための合図
+//  onDemand: true なら変化があるときかアニメーション中だけ描画する
+//  startup: 起動処理の依存関係のグラフ (GL を使う処理の時間をここに記録する)
+//  assets: ワーカースレッドで用意しているデータ
+static int render(Window &window, TripleBuffer<SceneSnapshot> &snapshots, const std::atomic<bool> &running,
+    FrameSignal &signal, bool onDemand, Startup &startup, StartupAssets &assets)
+{
+    // 環境変数 GLFWDRAFT_CAPTURE にファイル名があれば GL のコマンド列を記録する
+    const char *const captureFile(getenv("GLFWDRAFT_CAPTURE"));
+    if (captureFile) GlCapture::instance().begin(captureFile);
+
+    // 環境変数 GLFWDRAFT_EXPORT にパスがあればフレームを画像として書き出す
+    //  拡張子が .y4m なら Y4M ストリーム, .png なら連番 PNG, それ以外は連番 PPM
+    //  連番のときは拡張子を除いたものをファイル名の先頭に使う
+    //  GLFWDRAFT_EXPORT_BLOCK があれば書き出しが追いつかないときフレームを落とさずに待つ
+    std::unique_ptr<FrameExport> exporter;
+    if (const char *const exportPath = getenv("GLFWDRAFT_EXPORT"))
     {
-        printf("Error : Can't initialize GLFW.\n");
-        return 1;
+        std::string path(exportPath);
+        const std::string ext(path.size() > 4 ? path.substr(path.size() - 4) : "");
+        const FrameExport::Format format(ext == ".y4m" ? FrameExport::Y4m
+            : ext == ".png" ? FrameExport::Png : FrameExport::Ppm);
+        if (ext == ".png" || ext == ".ppm") path.resize(path.size() - 4);
+        const FrameExport::Policy policy(getenv("GLFWDRAFT_EXPORT_BLOCK") ? FrameExport::Block : FrameExport::Drop);
+        exporter.reset(new FrameExport(path, format, policy));
     }
 
-    // プログラム終了時の処理の登録
-    atexit(glfwTerminate);
-
-    // OpenGL Version 4.6 Core Profile を選択
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    // デフォルト設定
-    //  glfwDefaultWindowHints();
-
-    // ウィンドウ作成
-    Window window;
-
+    double stageBegin(startup.now());
     // 背景色を指定
     glClearColor(1.0f, 1.0f, 1.0f, 0.0f);
 
@@ -383,7 +369,19 @@ int main()
     glEnable(GL_DEPTH_TEST);
 
     // プログラムオブジェクトの作成
-    const GLuint program = loadProgram("../point.vert", "../point.frag");
+    //  読み込みと前処理はワーカースレッドで済ませてあるのでコンパイルとリンクだけを行う
+    startup.wait(assets.shaderStage);
+    startup.record("gl.state", Startup::Context, stageBegin);
+    stageBegin = startup.now();
+    const std::unique_ptr<ProgramCache> shaderCache(std::move(assets.shaders));
+    ProgramCache &shaders(*shaderCache);
+    shaders.precompile({
+        { "point.vert", "point.frag", assets.clustered }
+    });
+    //  プログラムオブジェクトは登録簿 (Resources) にハンドルで登録されている
+    Resources &resources(Resources::instance());
+    const Resources::ProgramHandle meshProgram(shaders.getHandle("point.vert", "point.frag", assets.clustered));
+    const GLuint program(resources.getProgram(meshProgram));
     if (program == 0)
     {
         printf("Error: Could not loadProgram.\n");
@@ -391,79 +389,96 @@ int main()
     }
 
     // uniform変数の場所を取得
-    const GLint modelviewLoc(glGetUniformLocation(program, "modelview"));
     const GLint projectionLoc(glGetUniformLocation(program, "projection"));
-    const GLint normalMatrixLoc(glGetUniformLocation(program, "normalMatrix"));
-    const GLint LposLoc(glGetUniformLocation(program, "Lpos"));
-    const GLint LambLoc(glGetUniformLocation(program, "Lamb"));
-    const GLint LdiffLoc(glGetUniformLocation(program, "Ldiff"));
-    const GLint LspecLoc(glGetUniformLocation(program, "Lspec"));
-
-    // uniform blockの場所を取得
-    const GLint materialLoc(glGetUniformBlockIndex(program, "Material"));
-
-    // uniform blockの場所を0番の結合ポインタに結び付ける
-    glUniformBlockBinding(program, materialLoc, 0);
-
-    // 球の分割数
-    const int slices(32), stacks(16);
-
-    // 頂点属性を作る
-    std::vector<Object::Vertex> solidSphereVertex;
-    for (int j = 0; j <= stacks; j++) {
-        const float t(static_cast<float>(j) / static_cast<float>(stacks));
-        const float y(cos(3.121593f * t)), r(sin(3.141593f * t));
-        
-        for (int i = 0; i <= slices; i++) {
-            const float s(static_cast<float>(i) / static_cast<float>(slices));
-            const float z(r * cos(6.283185f * s)), x(r * sin(6.283185 * s));
-
-            // 頂点属性
-            const Object::Vertex v = {x, y, z, x, y, z};
+    const GLint clusterCountLoc(glGetUniformLocation(program, "clusterCount"));
+    const GLint clusterDepthLoc(glGetUniformLocation(program, "clusterDepth"));
 
-            // 頂点属性を追加
-            solidSphereVertex.emplace_back(v);
-        }
+    // 粒子を描くプログラムオブジェクト
+    const Resources::ProgramHandle particleHandle(shaders.getHandle("particle.vert", "particle.frag"));
+    const GLuint particleProgram(resources.getProgram(particleHandle));
+    if (particleProgram == 0)
+    {
+        printf("Error: Could not loadProgram.\n");
+        return 1;
     }
-
-    // インデックスを作る
-    std::vector<GLuint> solidSphereIndex;
-
-    for (int j = 0; j < stacks; j++) { 
-        const int k((slices + 1) * j); 
-    
-        for (int i = 0; i < slices; i++) { 
-            // 頂点のインデックス 
-            const GLuint k0(k + i); 
-            const GLuint k1(k0 + 1); 
-            const GLuint k2(k1 + slices); 
-            const GLuint k3(k2 + 1);
-
-             // 左下の三角形 
-            solidSphereIndex.emplace_back(k0); 
-            solidSphereIndex.emplace_back(k2); 
-            solidSphereIndex.emplace_back(k3); 
-        
-            // 右上の三角形 
-            solidSphereIndex.emplace_back(k0); 
-            solidSphereIndex.emplace_back(k3); 
-            solidSphereIndex.emplace_back(k1); 
+    const GLint particleProjectionLoc(glGetUniformLocation(particleProgram, "projection"));
+    const GLint particleModelviewLoc(glGetUniformLocation(particleProgram, "modelview"));
+    const GLint spriteSizeLoc(glGetUniformLocation(particleProgram, "spriteSize"));
+
+    // 毎フレーム頂点を書き換える図形はモデルビュー変換行列をインスタンスごとに参照する組み合わせのプログラムで描く
+    //  モデルビュー変換行列は図形ごとのシェーダストレージバッファで渡す
+    Resources::ProgramHandle dynamicHandle{ 0 };
+    GLint dynamicProjectionLoc(-1), dynamicClusterCountLoc(-1), dynamicClusterDepthLoc(-1);
+    GLuint dynamicModelview[2] = { 0, 0 };
+    if (assets.grid || assets.tube)
+    {
+        dynamicHandle = shaders.getHandle("point.vert", "point.frag", assets.instanced);
+        const GLuint dynamicProgram(resources.getProgram(dynamicHandle));
+        dynamicProjectionLoc = glGetUniformLocation(dynamicProgram, "projection");
+        dynamicClusterCountLoc = glGetUniformLocation(dynamicProgram, "clusterCount");
+        dynamicClusterDepthLoc = glGetUniformLocation(dynamicProgram, "clusterDepth");
+        glGenBuffers(2, dynamicModelview);
+        for (GLuint buffer : dynamicModelview) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof (Matrix), NULL, GL_DYNAMIC_DRAW);
         }
     }
-
-    // 図形データを作成する
-    std::unique_ptr<const Shape> shape(new SolidShapeIndex(3,
-        static_cast<GLsizei>(solidSphereVertex.size()), solidSphereVertex.data(),
-        static_cast<GLsizei>(solidSphereIndex.size()), solidSphereIndex.data())
+    startup.record("gl.programs", Startup::Context, stageBegin);
+
+    // 溶接した球と, 並行に作ったメッシュレットと境界ボリューム階層
+    startup.wait(assets.meshletStage);
+    startup.wait(assets.bvhStage);
+    stageBegin = startup.now();
+    const Weld::Mesh &solidSphere(assets.sphere);
+    const Meshlets &sphereMeshlets(*assets.sphereMeshlets);
+    const MeshBvh &sphereBvh(*assets.sphereBvh);
+    const MeshBvh &cubeBvh(*assets.cubeBvh);
+
+    // 選択できるインスタンス (六面体は転送が終わってから加える)
+    SceneBvh scene;
+    const GLuint sphereInstance[] = {
+        scene.add(sphereBvh, Matrix::identity()),
+        scene.add(sphereBvh, Matrix::identity())
+    };
+    GLuint cubeInstance(~0u);
+
+    // 遮蔽カリングには中身に収まる粗い球と六面体そのものを遮蔽物に使う
+    OcclusionCuller culler;
+    const GLuint sphereOccluder(culler.addMesh(
+        static_cast<GLsizei>(occluderShape.vertex.size()), occluderShape.vertex.data(),
+        static_cast<GLsizei>(occluderShape.index.size()), occluderShape.index.data()));
+    const GLuint cubeOccluder(culler.addMesh(static_cast<GLsizei>(solidCube.vertex.size()), solidCube.vertex.data(),
+        static_cast<GLsizei>(solidCube.index.size()), solidCube.index.data()));
+
+    // 図形データを共有バッファに格納する (球のインデックスはメッシュレットの順に並べ替えたもの)
+    GeometryPool pool;
+    const GeometryPool::Mesh sphere(pool.add(
+        static_cast<GLsizei>(solidSphere.vertex.size()), solidSphere.vertex.data(),
+        static_cast<GLsizei>(sphereMeshlets.getIndex().size()), sphereMeshlets.getIndex().data())
     );
 
+    // 一度の呼び出しで描画する描画コマンド
+    MultiDraw multiDraw;
+
+    // 六面体はワーカースレッドで作って少しずつ共有バッファに転送する
+    MeshStream stream(pool);
+    const MeshStream::Ticket cube(stream.request([](MeshStream::Data &data) {
+        const Weld::Mesh welded(Weld::weld(
+            static_cast<GLsizei>(solidCube.vertex.size()), solidCube.vertex.data(),
+            static_cast<GLsizei>(solidCube.index.size()), solidCube.index.data()));
+        data.vertex = welded.vertex;
+        data.index = welded.index;
+        return !data.index.empty();
+    }));
+
     // 光源データ
-    GLfloat r = 0, g = 0, b = 0;
-    static const int Lcount(2);
-    static constexpr Vector Lpos[] = {0.0f, 0.0f, 5.0f, 1.0f, 0.0f, 5.0f, 0.0f, 1.0f};
-    static constexpr GLfloat Lamb[] = {0.2f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f};
-    static  GLfloat Ldiff[] = {1, 0.5f, 0.5f, 0.9f, 0.2f, 0.6f};
-    static constexpr GLfloat Lspec[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+    static constexpr Light Ldata[] = {
+        //        Lpos          |       Lamb       | 半径 |      Ldiff       |      Lspec
+        {0.0f, 0.0f, 5.0f, 1.0f, 0.2f, 0.1f, 0.1f, 0.0f, 1.0f, 0.5f, 0.5f, 1.0f, 0.5f, 0.5f},
+        {0.0f, 5.0f, 0.0f, 1.0f, 0.1f, 0.1f, 0.1f, 0.0f, 0.9f, 0.2f, 0.6f, 0.9f, 0.9f, 0.9f}
+    };
+    LightBuffer lights;
+    for (const Light &l : Ldata) lights.add(l);
 
     // 色データ
     static constexpr Material color[] = {
@@ -472,11 +487,56 @@ int main()
         {0.1f, 0.1f, 0.5f, 0.1f, 0.1f, 0.5f, 0.4f, 0.4f, 0.4f, 60.0f}
     };
 
-    const Uniform<Material> material(color, 2);
+    // 材質を登録して材質番号を得る
+    MaterialTable materials;
+    const GLuint material[] = { materials.add(color[0]), materials.add(color[1]) };
+    materials.update();
+    startup.record("gl.geometry", Startup::Context, stageBegin);
+
+    // 粒子
+    //  平均寿命の間に上限の数だけ放出するので定常状態では上限近くまで増える
+    //  必要なときだけ描画するときは放出しない
+    startup.wait(assets.particleStage);
+    stageBegin = startup.now();
+    Particles &particles(*assets.particles);
+    const Particles::Emitter emitter = {
+        { 0.0f, 0.0f, 0.0f }, { 0.0f, 4.0f, 0.0f }, 1.5f, 2.0f, onDemand ? 0.0f : static_cast<GLfloat>(particles.getCapacity()) / 1.5f
+    };
+    particles.setEmitter(emitter);
+    ParticleStream particleStream(particles.getCapacity());
+    unsigned particleSteps(0);
+    startup.record("gl.particles", Startup::Context, stageBegin);
+
+    // 波打たせる格子
+    //  頂点の転送にかかる時間を永続マップとバッファの孤立化で比べる
+    startup.wait(assets.gridStage);
+    startup.wait(assets.tubeStage);
+    stageBegin = startup.now();
+    //  シミュレーションの時刻が進んだときだけ書き換える
+    std::unique_ptr<DynamicObject> grid;
+    double gridTime(-1.0);
+    if (assets.grid)
+    {
+        grid.reset(new DynamicObject(assets.gridMode, GL_TRIANGLES, 3,
+            static_cast<GLsizei>(assets.gridVertex.size()), assets.gridVertex.data(),
+            static_cast<GLsizei>(assets.gridIndex.size()), assets.gridIndex.data()));
+    }
 
-    // タイマーを0にセット
-    glfwSetTime(0.0);
-    
+    // 関節の鎖で曲げる円筒
+    //  スキニングした頂点は DynamicObject の手元の写しに直接書き込んで転送する
+    //  格子と同じくシミュレーションの時刻が進んだときだけスキニングする
+    std::vector<Quaternion> tubeRotation(tubeJoints);
+    std::vector<GLfloat> tubeTranslation(tubeJoints * 3);
+    std::vector<Matrix> tubeSkin(tubeJoints);
+    std::unique_ptr<DynamicObject> tube;
+    double tubeTime(-1.0);
+    if (assets.tube)
+    {
+        tube.reset(new DynamicObject(DynamicObject::Persistent, GL_TRIANGLES, 3,
+            static_cast<GLsizei>(assets.tubeRest.size()), assets.tubeRest.data(),
+            static_cast<GLsizei>(assets.tubeIndex.size()), assets.tubeIndex.data()));
+    }
+    startup.record("gl.dynamic", Startup::Context, stageBegin);
 
     printf("OpenGL ver.: %s\n", glGetString(GL_VERSION));
     printf("GLSL ver.: %s\n", glGetString(GL_SHADING_LANGUAGE_VERSION));
@@ -485,88 +545,436 @@ int main()
     std::mt19937 engine{std::random_device{}()};
     std::uniform_real_distribution<float> dist(0, 1);
     
-    GLfloat lg = 0;
-    bool lf = false;
-    bool rgb = false;
-    // ウィンドウが開いている間
-    while (window)
-    {
-        if (r >= 1) rgb = true;
-        else if (r <= 0)rgb = false;
-        if (rgb) r -= 0.01f;
-        else r += 0.01f;
-        // Ldiff[0] = r;
-        // Ldiff[1] = r;
-        // Ldiff[2] = r;
-        
+    // フレームの間だけ使うデータの領域
+    FrameArena arena;
+
+    // 描画項目
+    struct DrawItem {
+        const GeometryPool::Mesh *mesh;
+        Matrix modelview;
+        GLuint material;
+
+        // メッシュレットに分けていれば NULL 以外
+        const Meshlets *meshlets;
+    };
 
-        if (lg >= 180.0f) lg = 0;
-        else lg += 0.1f;
+    // 視錐台と法線の円錐の判定で残ったメッシュレット
+    std::vector<GLuint> visibleMeshlet;
+
+    // フレームの間隔と入力から表示までの時間の計測
+    double lastSwap(glfwGetTime()), lastInput(0.0);
+    FrameStats stats(lastSwap);
+    GLint viewport[2] = { 0, 0 };
+
+    // 描画したスナップショットの revision と, 変化の後に続けて描くフレーム数
+    //  遮蔽カリングの結果は一フレーム遅れるので変化の後にもう一度描く
+    unsigned drawnRevision(~0u), settle(0);
+
+    // シミュレーションスレッドが続けている間
+    while (running.load())
+    {
+        // 前のフレームの一時データを解放する
+        arena.beginFrame();
+
+        // 最新のスナップショットを受け取り, 今の時刻の状態を補間で求める
+        snapshots.update();
+        const SceneSnapshot &snapshot(snapshots.getFront());
+        const double now(glfwGetTime());
+        const SceneState state(interpolate(snapshot, now));
+
+        // 変化がなく時間で変わるものもなければ次の変化まで眠る
+        if (snapshot.revision != drawnRevision) settle = 1;
+        const bool animating(particles.size() > 0 || grid || tube);
+        if (signal.animating.exchange(animating) != animating && animating) Window::wakeUp();
+        if (onDemand && snapshot.revision == drawnRevision && settle == 0 && !animating
+            && now >= snapshot.time + snapshot.step && stream.getState(cube) != MeshStream::Loading
+            && stream.getState(cube) != MeshStream::Uploading && !lights.isDirty() && !materials.isDirty()) {
+            std::unique_lock<std::mutex> lock(signal.mutex);
+            signal.condition.wait(lock, [&]() { return signal.revision != drawnRevision || !running.load(); });
+            continue;
+        }
+        if (snapshot.revision == drawnRevision && settle > 0) --settle;
+        drawnRevision = snapshot.revision;
+
+        // フレームバッファのサイズが変わっていればビューポートを設定し直す
+        if (snapshot.fbSize[0] != viewport[0] || snapshot.fbSize[1] != viewport[1]) {
+            viewport[0] = snapshot.fbSize[0];
+            viewport[1] = snapshot.fbSize[1];
+            glViewport(0, 0, viewport[0], viewport[1]);
+        }
 
         // ウィンドウを消去
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        GlCapture::clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // シェーダプログラムの使用開始
-        glUseProgram(program);
+        resources.use(meshProgram);
 
 
         // 透視投影変換行列を求める 
-        const GLfloat *const size(window.getSize()); 
-        const GLfloat fovy(window.getScale() * 0.01f);
+        const GLfloat *const size(snapshot.size); 
+        const GLfloat fovy(state.scale * 0.01f);
         const GLfloat aspect(size[0] / size[1]);
         const Matrix projection(Matrix::perspective(fovy, aspect, 1.0f, 10.0f));
 
         // モデル変換行列を求める
-        const GLfloat *const modelLoc(window.getModelLoc());
-        const GLfloat *const mouseLoc(window.getMouseLoc());
-
-        printf("x, y: %.2f, %.2f\n", mouseLoc[0], mouseLoc[1]);
-
-        const Matrix rx(Matrix::rotateAxis(mouseLoc[0] * 2, 0.0f, 1.0f, 0.0f));
-        const Matrix ry(Matrix::rotateAxis(mouseLoc[1] * 2, 1.0f, 0.0f, 0.0f));
-        const Matrix model(Matrix::translate(modelLoc[0] * 2, modelLoc[1] * 2, 0.0f) * ry * rx);
+        const GLfloat *const modelLoc(state.modelLoc);
+        const GLfloat *const mouseLoc(state.mouseLoc);
+
+        // マウスの位置による回転は四元数で合成して一度だけ行列にする
+        const Quaternion rx(Quaternion::rotate(2, mouseLoc[0] * 2));
+        const Quaternion ry(Quaternion::rotate(1, mouseLoc[1] * 2));
+        const DualQuaternion pose(DualQuaternion::rotateTranslate(ry * rx, modelLoc[0] * 2, modelLoc[1] * 2, 0.0f));
+        const Matrix model(pose.getMatrix());
         
         // ビュー変換行列を求める
         const Matrix view(Matrix::lookat(3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f)); 
 
-        // 法線ベクトルの変換行列の格納先
-        GLfloat normalMatrix[9];
-
         // モデルビュー変換行列を求める
         const Matrix modelview(view * model);
 
-        // 法線ベクトルの変換行列を求める
-        modelview.getNormalMatrix(normalMatrix);
+        // 前のフレームで判定した遮蔽カリングの結果を受け取る
+        culler.collect();
+        stats.tested += culler.getTested();
+        stats.culled += culler.getCulled();
+        stats.occlusion += culler.getMilliseconds();
 
-        // uniform 変数に値を設定する 
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, projection.data());
-        glUniformMatrix4fv(modelviewLoc, 1, GL_FALSE, modelview.data()); 
-        glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, normalMatrix);
-        for (int i = 0; i < Lcount; i++)
-            glUniform4fv(LposLoc + i, 1 , (view * Lpos[i]).data());
-        glUniform3fv(LambLoc, Lcount , Lamb);
-        glUniform3fv(LdiffLoc, Lcount , Ldiff);
-        glUniform3fv(LspecLoc, Lcount , Lspec);
-
-        // 図形の描画
-        material.select(0, 0);
-        shape->draw();
+        // 描画項目をフレームアリーナに積む (隠れていたものは描かない)
+        FrameVector<DrawItem> drawList{ ArenaAllocator<DrawItem>(arena) };
+        if (culler.isVisible(0)) drawList.push_back({ &sphere, modelview, material[0], &sphereMeshlets });
 
         // 二つ目のモデルビュー変換行列を求める
-        const Matrix modelview1(modelview * Matrix::translate(0.0f, 0.0f, 3.0f));
-        
-        // 二つ目の法線ベクトルの変換行列を求める
-        modelview1.getNormalMatrix(normalMatrix);
+        if (culler.isVisible(1)) drawList.push_back({ &sphere, modelview * Matrix::translate(0.0f, 0.0f, 3.0f), material[1], &sphereMeshlets });
+
+        // 転送の終わった六面体を描画項目に加える
+        stream.update();
+        if (stream.ready(cube)) {
+            if (culler.isVisible(2)) drawList.push_back({ &stream.getMesh(cube), modelview * Matrix::translate(0.0f, 0.0f, -3.0f), material[0], NULL });
+            if (cubeInstance == ~0u) cubeInstance = scene.add(cubeBvh, Matrix::identity());
+            scene.setTransform(cubeInstance, model * Matrix::translate(0.0f, 0.0f, -3.0f));
+        }
 
-        // uniform変数に値を設定
-        glUniformMatrix4fv(modelviewLoc, 1, GL_FALSE, modelview1.data());
-        glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, normalMatrix);
+        // マウスカーソルの下にある図形を調べる (mouseLoc の y は下向きなので反転する)
+        scene.setTransform(sphereInstance[0], model);
+        scene.setTransform(sphereInstance[1], model * Matrix::translate(0.0f, 0.0f, 3.0f));
+        scene.update();
+        SceneBvh::Hit hit;
+        if (scene.pick(Ray::unproject(projection, view, mouseLoc[0], -mouseLoc[1]), hit)) {
+            ++stats.picks;
+            stats.hit = hit;
+        }
+
+        // このフレームの遮蔽物とインスタンスの判定をワーカースレッドで始める
+        culler.setCamera(projection, view);
+        culler.addOccluder(sphereOccluder, model);
+        culler.addOccluder(sphereOccluder, model * Matrix::translate(0.0f, 0.0f, 3.0f));
+        culler.addInstance(sphereBvh.getBounds(), model);
+        culler.addInstance(sphereBvh.getBounds(), model * Matrix::translate(0.0f, 0.0f, 3.0f));
+        culler.addInstance(cubeBvh.getBounds(), model * Matrix::translate(0.0f, 0.0f, -3.0f));
+        if (stream.ready(cube)) culler.addOccluder(cubeOccluder, model * Matrix::translate(0.0f, 0.0f, -3.0f));
+        culler.submit();
+
+        // 光源をクラスタに割り当ててシェーダストレージバッファオブジェクトに格納する
+        //  光源も視点も変わっていなければ光源も uniform 変数も転送し直さない
+        const bool cameraChanged(lights.update(view, projection));
+        if (cameraChanged) {
+            GLuint clusterCount[3];
+            GLfloat clusterDepth[2];
+            lights.getCluster().getCount(clusterCount);
+            lights.getCluster().getDepthScale(clusterDepth);
+            glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, projection.data());
+            glUniform3uiv(clusterCountLoc, 1, clusterCount);
+            glUniform2fv(clusterDepthLoc, 1, clusterDepth);
+        }
+        lights.select(1);
+        materials.update();
+        materials.select(4);
+
+        // 描画項目を描画コマンドにして一度に描画する
+        //  メッシュレットに分けた図形は見えるメッシュレットだけを描画コマンドにする
+        multiDraw.clear();
+        std::size_t rejected(0), triangles(0);
+        for (const DrawItem &item : drawList) {
+            if (item.meshlets) {
+                rejected += item.meshlets->cull(projection, item.modelview, visibleMeshlet);
+                triangles += item.meshlets->getTriangleCount();
+                for (GLuint i : visibleMeshlet) {
+                    const Meshlets::Meshlet &m(item.meshlets->getMeshlets()[i]);
+                    multiDraw.add(*item.mesh, m.firstIndex, m.count, item.modelview, item.material);
+                }
+            }
+            else multiDraw.add(*item.mesh, item.modelview, item.material);
+        }
+        stats.rejected += rejected;
+        stats.triangles += triangles;
+        multiDraw.draw(pool);
+
+        // 毎フレーム頂点を書き換える図形のプログラムの uniform 変数を設定する
+        if (grid || tube) {
+            resources.use(dynamicHandle);
+            if (cameraChanged) {
+                GLuint clusterCount[3];
+                GLfloat clusterDepth[2];
+                lights.getCluster().getCount(clusterCount);
+                lights.getCluster().getDepthScale(clusterDepth);
+                glUniformMatrix4fv(dynamicProjectionLoc, 1, GL_FALSE, projection.data());
+                glUniform3uiv(dynamicClusterCountLoc, 1, clusterCount);
+                glUniform2fv(dynamicClusterDepthLoc, 1, clusterDepth);
+            }
+        }
 
-        // 二つ目の図形の描画
-        material.select(0, 1);
-        shape->draw();
+        // 格子を波打たせて書き換えた頂点を転送する
+        //  時刻が前に書き換えたときと同じなら前の領域をそのまま描く
+        if (grid) {
+            if (snapshot.time != gridTime) {
+                gridTime = snapshot.time;
+                const double deformStart(glfwGetTime());
+                const GLfloat t(static_cast<GLfloat>(snapshot.time));
+                Object::Vertex *const v(grid->edit(0, grid->getVertexCount()));
+                ThreadPool::instance().parallelFor(gridSize, 16, [v, t](std::size_t begin, std::size_t end) {
+                    for (std::size_t j = begin; j < end; ++j) {
+                        for (int i = 0; i < gridSize; ++i) {
+                            Object::Vertex &p(v[j * gridSize + i]);
+                            const GLfloat x(p.position[0]), z(p.position[2]);
+                            const GLfloat r(std::sqrt(x * x + z * z) + 1.0e-6f);
+                            const GLfloat d(0.05f * 8.0f * std::cos(8.0f * r - 2.0f * t) / r);
+                            p.position[1] = 0.05f * std::sin(8.0f * r - 2.0f * t);
+                            const GLfloat nx(-d * x), nz(-d * z), l(1.0f / std::sqrt(nx * nx + 1.0f + nz * nz));
+                            p.normal[0] = nx * l;
+                            p.normal[1] = l;
+                            p.normal[2] = nz * l;
+                        }
+                    }
+                });
+                const double uploadStart(glfwGetTime());
+                const GLsizeiptr bytes(grid->commit());
+                const double uploadEnd(glfwGetTime());
+                stats.deform += uploadStart - deformStart;
+                stats.deformUpload += uploadEnd - uploadStart;
+                stats.uploadBytes += static_cast<double>(bytes);
+                ++stats.deforms;
+            }
+
+            const Matrix gridView(view * Matrix::translate(0.0f, -1.5f, 0.0f));
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, dynamicModelview[0]);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof (Matrix), gridView.data());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, dynamicModelview[0]);
+            grid->draw(material[1]);
+        }
+
+        // 関節の姿勢を補間して円筒をスキニングする
+        if (tube) {
+            if (snapshot.time != tubeTime) {
+                tubeTime = snapshot.time;
+                const double skinStart(glfwGetTime());
+                assets.tubeAnimation->sample(snapshot.time, tubeRotation.data(), tubeTranslation.data());
+                assets.tubeSkeleton->pose(tubeRotation.data(), tubeTranslation.data(), tubeSkin.data());
+                Skeleton::skin(assets.tubeVertex.size(), assets.tubeVertex.data(), tubeSkin.data(), tube->edit(0, tube->getVertexCount()));
+                const double uploadStart(glfwGetTime());
+                tube->commit();
+                const double uploadEnd(glfwGetTime());
+                stats.skin += uploadStart - skinStart;
+                stats.skinUpload += uploadEnd - uploadStart;
+                ++stats.skins;
+            }
+
+            const Matrix tubeView(view * Matrix::translate(2.5f, -1.0f, 0.0f));
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, dynamicModelview[1]);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof (Matrix), tubeView.data());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, dynamicModelview[1]);
+            tube->draw(material[0]);
+        }
+
+        // 粒子をシミュレーションと同じ時間刻みで進めて一度に描画する
+        const double particleStart(glfwGetTime());
+        const unsigned advance(std::min(snapshot.steps - particleSteps, 5u));
+        particleSteps = snapshot.steps;
+        for (unsigned i = 0; i < advance; ++i) particles.update(static_cast<GLfloat>(snapshot.step));
+        particleStream.update(particles);
+        stats.particle += glfwGetTime() - particleStart;
+        resources.use(particleHandle);
+        if (cameraChanged) {
+            const GLfloat spriteSize[] = { 0.01f, 0.01f };
+            glUniformMatrix4fv(particleProjectionLoc, 1, GL_FALSE, projection.data());
+            glUniformMatrix4fv(particleModelviewLoc, 1, GL_FALSE, view.data());
+            glUniform2fv(spriteSizeLoc, 1, spriteSize);
+        }
+        particleStream.draw();
+
+        // 書き出すフレームを読み出す
+        if (exporter) exporter->capture();
 
         // カラーバッファを入れ替え
+        GlCapture::instance().frame();
         window.swapBuffers();
+
+        // 最初のフレームなら起動の各段階の時間を表示する
+        startup.firstFrame();
+
+        // フレームの間隔と, 新しい入力があれば入力から表示までの時間を計る
+        const double swapped(glfwGetTime());
+        ++stats.frames;
+        stats.frame += swapped - lastSwap;
+        stats.frameMax = std::max(stats.frameMax, swapped - lastSwap);
+        if (snapshot.inputTime > lastInput) {
+            ++stats.inputs;
+            stats.latency += swapped - snapshot.inputTime;
+            stats.latencyMax = std::max(stats.latencyMax, swapped - snapshot.inputTime);
+            lastInput = snapshot.inputTime;
+        }
+        lastSwap = swapped;
+        stats.report(swapped, mouseLoc, particles.size(), snapshot.steps);
+
+        // GPU が使い終わった GL のオブジェクトを削除する
+        DeletionQueue::instance().collect();
     }
-}
\ No newline at end of file
+
+    return 0;
+}
+
+int main()
+{
+    // 起動処理の依存関係のグラフ
+    //  シェーダの読み込みと図形データの作成をワーカースレッドで始めてから, その間にウィンドウとコンテキストを作る
+    //  (Startup のデストラクタがワーカースレッドを待つので assets を先に作っておく)
+    StartupAssets assets;
+    Startup startup;
+    prepare(startup, assets);
+    startup.start();
+    double stageBegin(startup.now());
+
+    char cdir[255];
+    GetCurrentDirectory(255, cdir);
+    printf("current_path: %s\n", cdir);
+
+    // GLFWの初期化
+    if (glfwInit() != GLFW_TRUE)
+    {
+        printf("Error : Can't initialize GLFW.\n");
+        return 1;
+    }
+    startup.record("glfw.init", Startup::Main, stageBegin);
+    stageBegin = startup.now();
+
+    // プログラム終了時の処理の登録
+    atexit(glfwTerminate);
+
+    // OpenGL Version 4.6 Core Profile を選択
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    // デフォルト設定
+    //  glfwDefaultWindowHints();
+
+    // ウィンドウ作成
+    Window window;
+    startup.record("window.context", Startup::Main, stageBegin);
+
+    // シミュレーションの時間刻み
+    const double step(1.0 / 60.0);
+
+    // 遅れたときに一度に進める最大のステップ数
+    const unsigned maxSteps(5);
+
+    // 環境変数 GLFWDRAFT_ON_DEMAND があれば変化のあるときだけ描画し, 静止していればイベントを待って眠る
+    //  このとき粒子の放出は止める
+    const bool onDemand(getenv("GLFWDRAFT_ON_DEMAND") != NULL);
+
+    // タイマーを0にセット
+    glfwSetTime(0.0);
+
+    // 最初の状態を描画スレッドに渡す
+    SceneState state{};
+    simulate(state, window);
+    unsigned steps(0);
+    TripleBuffer<SceneSnapshot> snapshots;
+    FrameSignal signal;
+    signal.revision = 0;
+    signal.animating = false;
+
+    // 前に公開したものから描画に影響する変化があれば revision を進めて描画スレッドを起こす
+    SceneSnapshot last{};
+    const auto publish([&](const SceneState &previous, double time) {
+        const bool changed(!same(previous, last.previous) || !same(state, last.current)
+            || !std::equal(window.getSize(), window.getSize() + 2, last.size)
+            || !std::equal(window.getFramebufferSize(), window.getFramebufferSize() + 2, last.fbSize));
+        if (changed) {
+            std::lock_guard<std::mutex> lock(signal.mutex);
+            ++signal.revision;
+        }
+        SceneSnapshot &snapshot(snapshots.getBack());
+        snapshot.previous = previous;
+        snapshot.current = state;
+        snapshot.time = time;
+        snapshot.step = step;
+        snapshot.inputTime = window.getInputTime();
+        std::copy(window.getSize(), window.getSize() + 2, snapshot.size);
+        std::copy(window.getFramebufferSize(), window.getFramebufferSize() + 2, snapshot.fbSize);
+        snapshot.steps = steps;
+        snapshot.revision = signal.revision;
+        last = snapshot;
+        snapshots.publish();
+        if (changed) signal.condition.notify_one();
+    });
+    publish(state, 0.0);
+
+    // OpenGL のコンテキストを描画スレッドに移す
+    std::atomic<bool> running(true);
+    int status(0);
+    window.detachContext();
+    std::thread renderer([&]() {
+        window.attachContext();
+        status = render(window, snapshots, running, signal, onDemand, startup, assets);
+
+        // render の中の図形やバッファのデストラクタが予約した削除も含めて, コンテキストがあるうちに削除する
+        DeletionQueue::instance().flush();
+        window.detachContext();
+        running.store(false);
+        Window::wakeUp();
+    });
+
+    // イベントを取り出しながら固定の時間刻みで状態を進める
+    double next(step);
+    bool settled(false);
+    while (running.load())
+    {
+        // 次のステップの時刻までイベントを待つ
+        //  必要なときだけ描画するなら, 静止していてキーも押されておらず粒子もなければイベントが来るまで眠る
+        const bool idle(onDemand && settled && !window.isActive() && !signal.animating.load());
+        window.waitEvents(idle ? -1.0 : next - glfwGetTime());
+        if (window.shouldClose()) break;
+
+        // 眠っていたら起きた時刻から, 大きく遅れたときは追いつくのをあきらめる
+        const double now(glfwGetTime());
+        if (idle) next = now;
+        else if (now - next > maxSteps * step) next = now - maxSteps * step;
+
+        // 時刻に追いつくまでステップを進める
+        SceneState previous(state);
+        bool stepped(false);
+        while (next <= now) {
+            previous = state;
+            window.readInput();
+            simulate(state, window);
+            next += step;
+            ++steps;
+            stepped = true;
+        }
+
+        // 進めた状態を描画スレッドに渡す (前後のステップが同じなら静止している)
+        if (stepped) {
+            settled = same(previous, state);
+            publish(previous, next - step);
+        }
+    }
+
+    // 描画スレッドの終了を待つ
+    {
+        std::lock_guard<std::mutex> lock(signal.mutex);
+        running.store(false);
+    }
+    signal.condition.notify_one();
+    renderer.join();
+    return status;
+}
@@ -0,0 +1,10 @@
+// particle fragment shader
+#version 460 core
+in vec2 corner;
+in float life;
+out vec4 fragment;
+void main() {
+    // 正方形に内接する円の外は捨てる
+    if (dot(corner, corner) > 1.0) discard;
+    fragment = vec4(mix(vec3(0.2, 0.3, 1.0), vec3(1.0, 0.6, 0.1), life), 1.0);
+}
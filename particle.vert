@@ -0,0 +1,23 @@
+// particle vertex shader
+#version 460 core
+layout (std430, binding = 6) readonly buffer Particles {
+    vec4 particle[];
+};
+uniform mat4 projection;
+uniform mat4 modelview;
+uniform vec2 spriteSize;
+out vec2 corner;
+out float life;
+void main() {
+    // 6 頂点で一つの粒子の正方形を作る
+    const vec2 quad[6] = vec2[](
+        vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+        vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0)
+    );
+    vec4 p = particle[gl_VertexID / 6];
+    corner = quad[gl_VertexID % 6];
+    life = p.w;
+    vec4 P = modelview * vec4(p.xyz, 1.0);
+    P.xy += corner * spriteSize;
+    gl_Position = projection * P;
+}
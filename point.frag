@@ -1,29 +1,81 @@
 //vertex shader
 #version 460 core
-const int Lcount = 2;
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 2
+#endif
+#ifndef CLUSTERED
+#define CLUSTERED 0
+#endif
+#ifndef MATERIAL_TABLE
+#define MATERIAL_TABLE 0
+#endif
+#include "shading.glsl"
+#if CLUSTERED
+layout (std430, binding = 1) readonly buffer Lights {
+    Light light[];
+};
+layout (std430, binding = 2) readonly buffer ClusterGrid {
+    uvec2 grid[];
+};
+layout (std430, binding = 3) readonly buffer ClusterIndex {
+    uint lightIndex[];
+};
+uniform mat4 projection;
+uniform uvec3 clusterCount;
+uniform vec2 clusterDepth;
+#else
+const int Lcount = LIGHT_COUNT;
 uniform vec4 Lpos[Lcount];
 uniform vec3 Lamb[Lcount]; 
 uniform vec3 Ldiff[Lcount];
 uniform vec3 Lspec[Lcount];
+#endif
+#if MATERIAL_TABLE
+layout (std430, binding = 4) readonly buffer Materials {
+    MaterialData material[];
+};
+flat in uint materialId;
+#else
 layout (std140) uniform Material {
     vec3 Kamb;
     vec3 Kdiff;
     vec3 Kspec;
     float Kshi;
 };
+#endif
 in vec4 P;
 in vec3 N;
 out vec4 fragment;
 void main() {
+#if MATERIAL_TABLE
+    MaterialData m = material[materialId];
+#else
+    MaterialData m = MaterialData(Kamb, Kdiff, Kspec, Kshi);
+#endif
     vec3 V = -normalize(P.xyz);
     vec3 Idiff = vec3(0.0);
     vec3 Ispec = vec3(0.0);
+#if CLUSTERED
+    vec4 clip = projection * P;
+    uvec2 tile = uvec2(clamp((clip.xy / clip.w * 0.5 + 0.5) * vec2(clusterCount.xy),
+        vec2(0.0), vec2(clusterCount.xy - 1u)));
+    float slice = log(-P.z / P.w) * clusterDepth.x + clusterDepth.y;
+    uint s = uint(clamp(slice, 0.0, float(clusterCount.z - 1u)));
+    uvec2 cell = grid[(s * clusterCount.y + tile.y) * clusterCount.x + tile.x];
+    for (uint k = 0u; k < cell.y; ++k) {
+        Light l = light[lightIndex[cell.x + k]];
+        float a = 1.0;
+        if (l.radius > 0.0 && l.position.w != 0.0) {
+            float d = length((l.position * P.w - P * l.position.w).xyz) / l.radius;
+            a = clamp(1.0 - d * d * d * d, 0.0, 1.0);
+            a *= a;
+        }
+        blinnPhong(l.position, l.ambient, l.diffuse, l.specular, a, P, N, V, m, Idiff, Ispec);
+    }
+#else
     for (int i = 0; i < Lcount; ++i) {
-        vec3 L = normalize((Lpos[i] * P.w - P * Lpos[i].w).xyz);
-        vec3 Iamb = Kamb * Lamb[i]; 
-        Idiff += max(dot(N, L), 0.0) * Kdiff * Ldiff[i] + Iamb; 
-        vec3 H = normalize(L + V);
-        Ispec += pow(max(dot(normalize(N), H), 0.0), Kshi) * Kspec * Lspec[i];
+        blinnPhong(Lpos[i], Lamb[i], Ldiff[i], Lspec[i], 1.0, P, N, V, m, Idiff, Ispec);
     }
+#endif
     fragment = vec4(Idiff + Ispec, 1.0);
-}
\ No newline at end of file
+}
@@ -1,14 +1,48 @@
 // fragment shader
 #version 460 core
-uniform mat4 modelview;
+#ifndef INSTANCING
+#define INSTANCING 0
+#endif
+#ifndef MULTI_DRAW
+#define MULTI_DRAW 0
+#endif
+#ifndef VERTEX_NORMAL
+#define VERTEX_NORMAL 1
+#endif
 uniform mat4 projection;
+#if INSTANCING || MULTI_DRAW
+layout (std430, binding = 5) readonly buffer Instances {
+    mat4 instanceModelview[];
+};
+#else
+uniform mat4 modelview;
 uniform mat3 normalMatrix;
+#endif
 in vec4 position;
+#if VERTEX_NORMAL
 in vec3 normal;
+#endif
 out vec4 P;
 out vec3 N;
+flat out uint materialId;
 void main() {
-    P = modelview * position; 
-    N = normalize(normalMatrix * normal);
+#if MULTI_DRAW
+    mat4 mv = instanceModelview[gl_DrawID];
+    mat3 nm = transpose(inverse(mat3(mv)));
+#elif INSTANCING
+    mat4 mv = instanceModelview[gl_InstanceID];
+    mat3 nm = transpose(inverse(mat3(mv)));
+#else
+    mat4 mv = modelview;
+    mat3 nm = normalMatrix;
+#endif
+#if VERTEX_NORMAL
+    vec3 n = normal;
+#else
+    vec3 n = vec3(0.0, 0.0, 1.0);
+#endif
+    P = mv * position; 
+    N = normalize(nm * n);
     gl_Position = projection * P;
-}
\ No newline at end of file
+    materialId = uint(gl_BaseInstance);
+}
@@ -0,0 +1,584 @@
+// GlCapture で記録した GL のコマンド列の再生
+//  glfwdraft_replay ファイル名 [--null] [--finish]
+//      --null: GL を呼ばずにコマンド列を読むだけにする (ウィンドウを開かない)
+//      --finish: フレームの終わりで glFinish を呼んで GPU の時間を含める
+#include <stdio.h>
+#include <cstdlib>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <unordered_map>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "lib/GlCapture.h"
+
+// コマンド列の再生
+class Replay {
+    // 読み込んだファイル
+    std::vector<char> data;
+
+    // 読み出し位置
+    std::size_t cursor;
+
+    // GL を呼ばないなら true
+    const bool null;
+
+    // Blob の先頭位置と大きさ
+    struct Blob {
+        const char *data;
+        std::size_t size;
+    };
+    std::vector<Blob> blob;
+
+    // 記録したときのオブジェクト名から再生中のオブジェクト名への対応
+    std::unordered_map<GLuint, GLuint> buffer, vertexArray, shader, program;
+    std::unordered_map<std::uint64_t, GLsync> sync;
+
+    // 記録したときの uniform 変数の場所から再生中の場所への対応 (プログラムごと)
+    std::unordered_map<std::uint64_t, GLint> location;
+
+    // 使用中のプログラム (記録したときの名前)
+    GLuint current;
+
+    // ターゲットに結合しているバッファオブジェクト (記録したときの名前)
+    std::unordered_map<GLenum, GLuint> binding;
+
+    // マップしているバッファオブジェクトの領域
+    struct Mapping {
+        char *pointer;
+        std::uint64_t offset, length;
+    };
+    std::unordered_map<GLuint, Mapping> mapping;
+
+    // 壊れたファイルを読んだので再生をやめて終了する
+    //  what: 読めなかったもの
+    [[noreturn]] void fail(const char *what) const {
+        printf("Error : Corrupt capture file (%s at offset %zu)\n", what, cursor);
+        std::exit(1);
+    }
+
+    // 読み出し位置から size バイトが残っていなければ終了する
+    //  size: 読み出す大きさ
+    //  what: 読み出すもの
+    void need(std::uint64_t size, const char *what) const {
+        if (size > data.size() - cursor) fail(what);
+    }
+
+    // 値を読み出す
+    template<typename T>
+    T get() {
+        need(sizeof (T), "truncated command");
+        T value;
+        std::memcpy(&value, &data[cursor], sizeof value);
+        cursor += sizeof value;
+        return value;
+    }
+
+    // Blob の番号を読み出してデータを返す
+    const Blob &getBlob() {
+        static const Blob empty = { NULL, 0 };
+        const std::uint32_t id(get<std::uint32_t>());
+        return id < blob.size() ? blob[id] : empty;
+    }
+
+    // Blob の番号を読み出して終端のある文字列を返す
+    const GLchar *getString() {
+        const Blob &b(getBlob());
+        if (b.data == NULL || b.size == 0 || b.data[b.size - 1] != '\0') fail("unterminated name");
+        return b.data;
+    }
+
+    // オブジェクト名を置き換える (0 はそのまま)
+    static GLuint name(const std::unordered_map<GLuint, GLuint> &map, GLuint n) {
+        const auto i(map.find(n));
+        return i == map.end() ? 0 : i->second;
+    }
+
+    // uniform 変数の場所を置き換える
+    GLint uniform(GLint l) const {
+        const auto i(location.find(static_cast<std::uint64_t>(current) << 32 | static_cast<std::uint32_t>(l)));
+        return i == location.end() ? -1 : i->second;
+    }
+
+    // 名前の並びを読み出す
+    void getNames(std::vector<GLuint> &n) {
+        const std::uint32_t count(get<std::uint32_t>());
+        need(static_cast<std::uint64_t>(count) * sizeof (std::uint32_t), "truncated name list");
+        n.resize(count);
+        for (GLuint &v : n) v = get<std::uint32_t>();
+    }
+
+    // オフセットをポインタにする
+    static const void *offset(std::uint64_t o) {
+        return reinterpret_cast<const void *>(static_cast<std::uintptr_t>(o));
+    }
+
+    // コマンドを一つ実行する
+    //  戻り値: フレームの終わりなら true
+    bool execute(GlCapture::Op o) {
+        std::vector<GLuint> n;
+        switch (o) {
+        case GlCapture::Blob: {
+            const std::uint32_t id(get<std::uint32_t>());
+            const std::uint64_t size(get<std::uint64_t>());
+            need(size, "truncated blob");
+            if (blob.size() <= id) blob.resize(id + 1);
+            blob[id].data = &data[cursor];
+            blob[id].size = static_cast<std::size_t>(size);
+            cursor += size;
+            break;
+        }
+        case GlCapture::Frame:
+            return true;
+        case GlCapture::State: {
+            const GlCapture::Fixed f(get<GlCapture::Fixed>());
+            if (null) break;
+            glViewport(f.viewport[0], f.viewport[1], f.viewport[2], f.viewport[3]);
+            glClearColor(f.clearColor[0], f.clearColor[1], f.clearColor[2], f.clearColor[3]);
+            glClearDepth(f.clearDepth);
+            if (f.depthTest) glEnable(GL_DEPTH_TEST);
+            else glDisable(GL_DEPTH_TEST);
+            if (f.cullFace) glEnable(GL_CULL_FACE);
+            else glDisable(GL_CULL_FACE);
+            glCullFace(f.cullFaceMode);
+            glFrontFace(f.frontFace);
+            glDepthFunc(f.depthFunc);
+            break;
+        }
+        case GlCapture::Clear: {
+            const GLbitfield mask(get<std::uint32_t>());
+            if (!null) glClear(mask);
+            break;
+        }
+        case GlCapture::GenBuffers:
+        case GlCapture::GenVertexArrays: {
+            getNames(n);
+            std::vector<GLuint> created(n.size());
+            if (!null) {
+                if (o == GlCapture::GenBuffers) glGenBuffers(static_cast<GLsizei>(n.size()), created.data());
+                else glGenVertexArrays(static_cast<GLsizei>(n.size()), created.data());
+            }
+            std::unordered_map<GLuint, GLuint> &map(o == GlCapture::GenBuffers ? buffer : vertexArray);
+            for (std::size_t i = 0; i < n.size(); ++i) map[n[i]] = created[i];
+            break;
+        }
+        case GlCapture::DeleteBuffers:
+        case GlCapture::DeleteVertexArrays: {
+            getNames(n);
+            std::unordered_map<GLuint, GLuint> &map(o == GlCapture::DeleteBuffers ? buffer : vertexArray);
+            std::vector<GLuint> deleted;
+            for (GLuint v : n) {
+                deleted.push_back(name(map, v));
+                map.erase(v);
+                if (o == GlCapture::DeleteBuffers) mapping.erase(v);
+            }
+            if (null) break;
+            if (o == GlCapture::DeleteBuffers) glDeleteBuffers(static_cast<GLsizei>(deleted.size()), deleted.data());
+            else glDeleteVertexArrays(static_cast<GLsizei>(deleted.size()), deleted.data());
+            break;
+        }
+        case GlCapture::BindBuffer: {
+            const GLenum target(get<std::uint32_t>());
+            const GLuint b(get<std::uint32_t>());
+            binding[target] = b;
+            if (!null) glBindBuffer(target, name(buffer, b));
+            break;
+        }
+        case GlCapture::BufferData: {
+            const GLenum target(get<std::uint32_t>());
+            const GLsizeiptr size(static_cast<GLsizeiptr>(get<std::uint64_t>()));
+            const Blob &b(getBlob());
+            const GLenum usage(get<std::uint32_t>());
+            if (b.data && static_cast<std::uint64_t>(b.size) < static_cast<std::uint64_t>(size)) fail("short buffer data");
+            if (!null) glBufferData(target, size, b.data, usage);
+            break;
+        }
+        case GlCapture::BufferSubData: {
+            const GLenum target(get<std::uint32_t>());
+            const GLintptr at(static_cast<GLintptr>(get<std::uint64_t>()));
+            const Blob &b(getBlob());
+            if (!null) glBufferSubData(target, at, static_cast<GLsizeiptr>(b.size), b.data);
+            break;
+        }
+        case GlCapture::BufferStorage: {
+            const GLenum target(get<std::uint32_t>());
+            const GLsizeiptr size(static_cast<GLsizeiptr>(get<std::uint64_t>()));
+            const Blob &b(getBlob());
+            const GLbitfield flags(get<std::uint32_t>());
+            if (b.data && static_cast<std::uint64_t>(b.size) < static_cast<std::uint64_t>(size)) fail("short buffer data");
+            if (!null) glBufferStorage(target, size, b.data, flags);
+            break;
+        }
+        case GlCapture::MapBufferRange: {
+            const GLenum target(get<std::uint32_t>());
+            const std::uint64_t at(get<std::uint64_t>());
+            const std::uint64_t length(get<std::uint64_t>());
+            const GLbitfield access(get<std::uint32_t>());
+            if (null) break;
+            void *const pointer(glMapBufferRange(target, static_cast<GLintptr>(at), static_cast<GLsizeiptr>(length), access));
+            if (pointer) {
+                const Mapping m = { static_cast<char *>(pointer), at, length };
+                mapping[binding[target]] = m;
+            }
+            break;
+        }
+        case GlCapture::UnmapBuffer: {
+            const GLenum target(get<std::uint32_t>());
+            mapping.erase(binding[target]);
+            if (!null) glUnmapBuffer(target);
+            break;
+        }
+        case GlCapture::MappedWrite: {
+            const GLuint b(get<std::uint32_t>());
+            const std::uint64_t at(get<std::uint64_t>());
+            const Blob &d(getBlob());
+            const auto m(mapping.find(b));
+            if (m == mapping.end() || d.data == NULL) break;
+            if (at < m->second.offset || at - m->second.offset > m->second.length
+                || d.size > m->second.length - (at - m->second.offset)) fail("write outside the mapped range");
+            std::memcpy(m->second.pointer + (at - m->second.offset), d.data, d.size);
+            break;
+        }
+        case GlCapture::CopyBufferSubData: {
+            const GLenum readTarget(get<std::uint32_t>());
+            const GLenum writeTarget(get<std::uint32_t>());
+            const GLintptr readOffset(static_cast<GLintptr>(get<std::uint64_t>()));
+            const GLintptr writeOffset(static_cast<GLintptr>(get<std::uint64_t>()));
+            const GLsizeiptr size(static_cast<GLsizeiptr>(get<std::uint64_t>()));
+            if (!null) glCopyBufferSubData(readTarget, writeTarget, readOffset, writeOffset, size);
+            break;
+        }
+        case GlCapture::FlushMappedBufferRange: {
+            const GLenum target(get<std::uint32_t>());
+            const GLintptr at(static_cast<GLintptr>(get<std::uint64_t>()));
+            const GLsizeiptr length(static_cast<GLsizeiptr>(get<std::uint64_t>()));
+            if (!null) glFlushMappedBufferRange(target, at, length);
+            break;
+        }
+        case GlCapture::BindBufferBase: {
+            const GLenum target(get<std::uint32_t>());
+            const GLuint index(get<std::uint32_t>());
+            const GLuint b(get<std::uint32_t>());
+            binding[target] = b;
+            if (!null) glBindBufferBase(target, index, name(buffer, b));
+            break;
+        }
+        case GlCapture::BindBufferRange: {
+            const GLenum target(get<std::uint32_t>());
+            const GLuint index(get<std::uint32_t>());
+            const GLuint b(get<std::uint32_t>());
+            const GLintptr at(static_cast<GLintptr>(get<std::uint64_t>()));
+            const GLsizeiptr size(static_cast<GLsizeiptr>(get<std::uint64_t>()));
+            binding[target] = b;
+            if (!null) glBindBufferRange(target, index, name(buffer, b), at, size);
+            break;
+        }
+        case GlCapture::BindVertexArray: {
+            const GLuint a(get<std::uint32_t>());
+            if (!null) glBindVertexArray(name(vertexArray, a));
+            break;
+        }
+        case GlCapture::VertexAttribPointer: {
+            const GLuint index(get<std::uint32_t>());
+            const GLint size(get<std::int32_t>());
+            const GLenum type(get<std::uint32_t>());
+            const GLboolean normalized(static_cast<GLboolean>(get<std::uint32_t>()));
+            const GLsizei stride(get<std::int32_t>());
+            const std::uint64_t pointer(get<std::uint64_t>());
+            if (!null) glVertexAttribPointer(index, size, type, normalized, stride, offset(pointer));
+            break;
+        }
+        case GlCapture::EnableVertexAttribArray: {
+            const GLuint index(get<std::uint32_t>());
+            if (!null) glEnableVertexAttribArray(index);
+            break;
+        }
+        case GlCapture::CreateShader: {
+            const GLenum type(get<std::uint32_t>());
+            const GLuint s(get<std::uint32_t>());
+            shader[s] = null ? s : glCreateShader(type);
+            break;
+        }
+        case GlCapture::ShaderSource: {
+            const GLuint s(get<std::uint32_t>());
+            const Blob &b(getBlob());
+            const GLchar *const source(b.data);
+            const GLint length(static_cast<GLint>(b.size));
+            if (!null) glShaderSource(name(shader, s), 1, &source, &length);
+            break;
+        }
+        case GlCapture::CompileShader: {
+            const GLuint s(get<std::uint32_t>());
+            if (!null) glCompileShader(name(shader, s));
+            break;
+        }
+        case GlCapture::DeleteShader: {
+            const GLuint s(get<std::uint32_t>());
+            if (!null) glDeleteShader(name(shader, s));
+            shader.erase(s);
+            break;
+        }
+        case GlCapture::CreateProgram: {
+            const GLuint p(get<std::uint32_t>());
+            program[p] = null ? p : glCreateProgram();
+            break;
+        }
+        case GlCapture::AttachShader:
+        case GlCapture::DetachShader: {
+            const GLuint p(get<std::uint32_t>());
+            const GLuint s(get<std::uint32_t>());
+            if (null) break;
+            if (o == GlCapture::AttachShader) glAttachShader(name(program, p), name(shader, s));
+            else glDetachShader(name(program, p), name(shader, s));
+            break;
+        }
+        case GlCapture::BindAttribLocation:
+        case GlCapture::BindFragDataLocation: {
+            const GLuint p(get<std::uint32_t>());
+            const GLuint index(get<std::uint32_t>());
+            const GLchar *const n(getString());
+            if (null) break;
+            if (o == GlCapture::BindAttribLocation) glBindAttribLocation(name(program, p), index, n);
+            else glBindFragDataLocation(name(program, p), index, n);
+            break;
+        }
+        case GlCapture::LinkProgram: {
+            const GLuint p(get<std::uint32_t>());
+            if (!null) glLinkProgram(name(program, p));
+            break;
+        }
+        case GlCapture::DeleteProgram: {
+            const GLuint p(get<std::uint32_t>());
+            if (!null) glDeleteProgram(name(program, p));
+            program.erase(p);
+            break;
+        }
+        case GlCapture::UseProgram: {
+            current = get<std::uint32_t>();
+            if (!null) glUseProgram(name(program, current));
+            break;
+        }
+        case GlCapture::GetUniformLocation: {
+            const GLuint p(get<std::uint32_t>());
+            const GLchar *const n(getString());
+            const GLint l(get<std::int32_t>());
+            location[static_cast<std::uint64_t>(p) << 32 | static_cast<std::uint32_t>(l)]
+                = null ? l : glGetUniformLocation(name(program, p), n);
+            break;
+        }
+        case GlCapture::UniformMatrix4fv:
+        case GlCapture::Uniform3uiv:
+        case GlCapture::Uniform2fv: {
+            const GLint l(get<std::int32_t>());
+            const std::uint32_t count(get<std::uint32_t>());
+            const GLboolean transpose(o == GlCapture::UniformMatrix4fv ? static_cast<GLboolean>(get<std::uint32_t>()) : GL_FALSE);
+            const std::uint64_t components(o == GlCapture::UniformMatrix4fv ? 16 : o == GlCapture::Uniform3uiv ? 3 : 2);
+            need(components * count * 4, "truncated uniform values");
+            const std::size_t n(static_cast<std::size_t>(components * count));
+            const char *const value(data.data() + cursor);
+            cursor += n * 4;
+            if (null) break;
+            if (o == GlCapture::UniformMatrix4fv) {
+                std::vector<GLfloat> v(n);
+                std::memcpy(v.data(), value, n * 4);
+                glUniformMatrix4fv(uniform(l), static_cast<GLsizei>(count), transpose, v.data());
+            }
+            else if (o == GlCapture::Uniform3uiv) {
+                std::vector<GLuint> v(n);
+                std::memcpy(v.data(), value, n * 4);
+                glUniform3uiv(uniform(l), static_cast<GLsizei>(count), v.data());
+            }
+            else {
+                std::vector<GLfloat> v(n);
+                std::memcpy(v.data(), value, n * 4);
+                glUniform2fv(uniform(l), static_cast<GLsizei>(count), v.data());
+            }
+            break;
+        }
+        case GlCapture::DrawArraysInstancedBaseInstance: {
+            const GLenum mode(get<std::uint32_t>());
+            const GLint first(get<std::int32_t>());
+            const GLsizei count(get<std::int32_t>());
+            const GLsizei instancecount(get<std::int32_t>());
+            const GLuint baseinstance(get<std::uint32_t>());
+            if (!null) glDrawArraysInstancedBaseInstance(mode, first, count, instancecount, baseinstance);
+            break;
+        }
+        case GlCapture::DrawElementsInstancedBaseInstance: {
+            const GLenum mode(get<std::uint32_t>());
+            const GLsizei count(get<std::int32_t>());
+            const GLenum type(get<std::uint32_t>());
+            const std::uint64_t indices(get<std::uint64_t>());
+            const GLsizei instancecount(get<std::int32_t>());
+            const GLuint baseinstance(get<std::uint32_t>());
+            if (!null) glDrawElementsInstancedBaseInstance(mode, count, type, offset(indices), instancecount, baseinstance);
+            break;
+        }
+        case GlCapture::MultiDrawElementsIndirect: {
+            const GLenum mode(get<std::uint32_t>());
+            const GLenum type(get<std::uint32_t>());
+            const std::uint64_t indirect(get<std::uint64_t>());
+            const GLsizei drawcount(get<std::int32_t>());
+            const GLsizei stride(get<std::int32_t>());
+            if (!null) glMultiDrawElementsIndirect(mode, type, offset(indirect), drawcount, stride);
+            break;
+        }
+        case GlCapture::FenceSync: {
+            const GLenum condition(get<std::uint32_t>());
+            const GLbitfield flags(get<std::uint32_t>());
+            const std::uint64_t s(get<std::uint64_t>());
+            sync[s] = null ? NULL : glFenceSync(condition, flags);
+            break;
+        }
+        case GlCapture::ClientWaitSync: {
+            const std::uint64_t s(get<std::uint64_t>());
+            const GLbitfield flags(get<std::uint32_t>());
+            const GLuint64 timeout(get<std::uint64_t>());
+            if (!null) glClientWaitSync(sync[s], flags, timeout);
+            break;
+        }
+        case GlCapture::DeleteSync: {
+            const std::uint64_t s(get<std::uint64_t>());
+            if (!null) glDeleteSync(sync[s]);
+            sync.erase(s);
+            break;
+        }
+        default:
+            --cursor;
+            fail("unknown command");
+        }
+        return false;
+    }
+
+public:
+
+    // コンストラクタ
+    //  null: GL を呼ばないなら true
+    Replay(bool null)
+        : cursor(0), null(null), current(0)
+    {}
+
+    // ファイルを読み込む
+    //  filename: GlCapture で記録したファイル名
+    //  width, height: 記録したときのビューポートの大きさの格納先
+    //  戻り値: 読み込めたら true
+    bool load(const char *filename, int &width, int &height) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file) {
+            printf("Error : Can't open capture file: %s\n", filename);
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        const std::size_t header(sizeof GlCapture::magic + sizeof (std::uint32_t) + 2 * sizeof (std::int32_t));
+        if (data.size() < header || std::memcmp(data.data(), GlCapture::magic, sizeof GlCapture::magic) != 0) {
+            printf("Error : Not a capture file: %s\n", filename);
+            return false;
+        }
+        cursor = sizeof GlCapture::magic;
+        if (get<std::uint32_t>() != GlCapture::version) {
+            printf("Error : Unsupported capture version: %s\n", filename);
+            return false;
+        }
+        width = get<std::int32_t>();
+        height = get<std::int32_t>();
+        return true;
+    }
+
+    // 次のフレームまで再生する
+    //  commands: 実行したコマンドの数の格納先
+    //  戻り値: フレームの終わりまで再生できたら true
+    bool frame(std::size_t &commands) {
+        commands = 0;
+        while (cursor < data.size()) {
+            const GlCapture::Op o(static_cast<GlCapture::Op>(get<std::uint8_t>()));
+            if (o != GlCapture::Blob) ++commands;
+            if (execute(o)) return true;
+        }
+        return false;
+    }
+};
+
+int main(int argc, char **argv)
+{
+    const char *filename(NULL);
+    bool null(false), finish(false);
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--null") == 0) null = true;
+        else if (std::strcmp(argv[i], "--finish") == 0) finish = true;
+        else if (argv[i][0] != '-' && filename == NULL) filename = argv[i];
+        else {
+            printf("Error : Unknown argument: %s\n", argv[i]);
+            filename = NULL;
+            break;
+        }
+    }
+    if (filename == NULL) {
+        printf("usage: %s file [--null] [--finish]\n", argv[0]);
+        return 1;
+    }
+
+    Replay replay(null);
+    int width, height;
+    if (!replay.load(filename, width, height)) return 1;
+
+    // 見えないウィンドウを開いて垂直同期を待たずに描く
+    GLFWwindow *window(NULL);
+    if (!null) {
+        if (glfwInit() != GLFW_TRUE) {
+            printf("Error : Can't initialize GLFW.\n");
+            return 1;
+        }
+        atexit(glfwTerminate);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        window = glfwCreateWindow(width > 0 ? width : 640, height > 0 ? height : 640, "replay", NULL, NULL);
+        if (window == NULL) {
+            printf("Error : Could not create GLFW window.\n");
+            return 1;
+        }
+        glfwMakeContextCurrent(window);
+        glewExperimental = GL_TRUE;
+        if (glewInit() != GLEW_OK) {
+            printf("Error : Could not initialize GLEW.\n");
+            return 1;
+        }
+        glfwSwapInterval(0);
+    }
+
+    // フレームごとの時間を計る
+    std::vector<double> time;
+    std::size_t commands;
+    for (;;) {
+        const std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+        const bool complete(replay.frame(commands));
+        if (!null) {
+            if (finish) glFinish();
+            glfwSwapBuffers(window);
+        }
+        const double ms(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        if (!complete) break;
+        time.push_back(ms);
+        printf("frame %zu: %.3f ms, %zu commands\n", time.size() - 1, ms, commands);
+    }
+    if (time.empty()) {
+        printf("Error : No frames in %s\n", filename);
+        return 1;
+    }
+
+    std::vector<double> sorted(time);
+    std::sort(sorted.begin(), sorted.end());
+    double total(0.0);
+    for (double t : time) total += t;
+    printf("frames: %zu, mean %.3f ms, median %.3f ms, p95 %.3f ms, min %.3f ms, max %.3f ms\n",
+        time.size(), total / time.size(), sorted[sorted.size() / 2],
+        sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)], sorted.front(), sorted.back());
+    return 0;
+}
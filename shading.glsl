@@ -0,0 +1,26 @@
+#ifndef SPECULAR
+#define SPECULAR 1
+#endif
+struct Light {
+    vec4 position;
+    vec3 ambient;
+    float radius;
+    vec3 diffuse;
+    vec3 specular;
+};
+struct MaterialData {
+    vec3 Kamb;
+    vec3 Kdiff;
+    vec3 Kspec;
+    float Kshi;
+};
+void blinnPhong(vec4 Lpos, vec3 Lamb, vec3 Ldiff, vec3 Lspec, float attenuation,
+    vec4 P, vec3 N, vec3 V, MaterialData m, inout vec3 Idiff, inout vec3 Ispec) {
+    vec3 L = normalize((Lpos * P.w - P * Lpos.w).xyz);
+    vec3 Iamb = m.Kamb * Lamb * attenuation;
+    Idiff += max(dot(N, L), 0.0) * m.Kdiff * Ldiff * attenuation + Iamb;
+#if SPECULAR
+    vec3 H = normalize(L + V);
+    Ispec += pow(max(dot(normalize(N), H), 0.0), m.Kshi) * m.Kspec * Lspec * attenuation;
+#endif
+}